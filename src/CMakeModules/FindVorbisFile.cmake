@@ -0,0 +1,52 @@
+# - Find libvorbisfile, for the OGG files of the SOFT sound system
+#
+# VORBISFILE_FOUND        - TRUE if the header and the libraries are found
+# VORBISFILE_INCLUDE_DIR  - where to find vorbis/vorbisfile.h
+# VORBISFILE_LIBRARIES    - vorbisfile and what it needs
+# --------------------------------
+
+FIND_PATH(VORBISFILE_INCLUDE_DIR vorbis/vorbisfile.h
+  "${VORBISFILE_DIR}/include"
+  "$ENV{VORBISFILE_DIR}/include"
+  /usr/local/include
+  /usr/include
+  /opt/local/include
+  )
+
+SET(VORBISFILE_POSSIBLE_LIBRARY_PATHS
+  "${VORBISFILE_DIR}/lib"
+  "$ENV{VORBISFILE_DIR}/lib"
+  /usr/local/lib
+  /usr/lib
+  /opt/local/lib
+  )
+
+FIND_LIBRARY(VORBISFILE_LIBRARY
+  NAMES vorbisfile
+  PATHS ${VORBISFILE_POSSIBLE_LIBRARY_PATHS} )
+
+FIND_LIBRARY(VORBISFILE_VORBIS_LIBRARY
+  NAMES vorbis
+  PATHS ${VORBISFILE_POSSIBLE_LIBRARY_PATHS} )
+
+FIND_LIBRARY(VORBISFILE_OGG_LIBRARY
+  NAMES ogg
+  PATHS ${VORBISFILE_POSSIBLE_LIBRARY_PATHS} )
+
+# --------------------------------
+# decide if we found all we require:
+IF (VORBISFILE_INCLUDE_DIR AND VORBISFILE_LIBRARY AND VORBISFILE_VORBIS_LIBRARY AND VORBISFILE_OGG_LIBRARY)
+  SET(VORBISFILE_FOUND TRUE)
+  SET(VORBISFILE_LIBRARIES
+    ${VORBISFILE_LIBRARY}
+    ${VORBISFILE_VORBIS_LIBRARY}
+    ${VORBISFILE_OGG_LIBRARY}
+    )
+ENDIF (VORBISFILE_INCLUDE_DIR AND VORBISFILE_LIBRARY AND VORBISFILE_VORBIS_LIBRARY AND VORBISFILE_OGG_LIBRARY)
+
+MARK_AS_ADVANCED(
+  VORBISFILE_INCLUDE_DIR
+  VORBISFILE_LIBRARY
+  VORBISFILE_VORBIS_LIBRARY
+  VORBISFILE_OGG_LIBRARY
+  )
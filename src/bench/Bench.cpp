@@ -0,0 +1,241 @@
+/*
+ * File:   Bench.cpp
+ *
+ * See Bench.h
+ */
+
+#include "Bench.h"
+#include "SexyAppBase.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+using namespace Sexy;
+
+namespace
+{
+
+struct BenchInfo
+{
+    const char* name;
+    BenchFunc   func;
+};
+
+std::vector<BenchInfo>& GetBenchmarks()
+{
+    static std::vector<BenchInfo> benchmarks;
+    return benchmarks;
+}
+
+struct BenchResult
+{
+    std::string name;
+    long        iterations;
+    double      ns_per_iter;
+    double      items_per_sec;
+    double      bytes_per_sec;
+    std::vector<std::pair<std::string, double> > counters;
+};
+
+std::string JsonEscape(const std::string& s)
+{
+    std::string out;
+    for (size_t i = 0; i < s.size(); ++i) {
+        if (s[i] == '"' || s[i] == '\\')
+            out += '\\';
+        out += s[i];
+    }
+    return out;
+}
+
+void WriteJson(FILE* fp, const std::vector<BenchResult>& results)
+{
+    fprintf(fp, "{\n  \"benchmarks\": [\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& r = results[i];
+        fprintf(fp, "    {\"name\": \"%s\", \"iterations\": %ld, \"ns_per_iter\": %.3f",
+                JsonEscape(r.name).c_str(), r.iterations, r.ns_per_iter);
+        if (r.items_per_sec > 0)
+            fprintf(fp, ", \"items_per_second\": %.3f", r.items_per_sec);
+        if (r.bytes_per_sec > 0)
+            fprintf(fp, ", \"bytes_per_second\": %.3f", r.bytes_per_sec);
+        for (size_t c = 0; c < r.counters.size(); ++c)
+            fprintf(fp, ", \"%s\": %.3f", JsonEscape(r.counters[c].first).c_str(), r.counters[c].second);
+        fprintf(fp, "}%s\n", i + 1 < results.size() ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+}
+
+}
+
+BenchState::BenchState(long iterations)
+    : mMaxIterations(iterations),
+      mIteration(0),
+      mRunning(false),
+      mElapsed(0.0),
+      mItems(0.0),
+      mBytes(0.0)
+{
+}
+
+bool BenchState::KeepRunning()
+{
+    if (!mRunning) {
+        mRunning = true;
+        mTimer.start();
+    }
+    if (mIteration < mMaxIterations && mError.empty()) {
+        ++mIteration;
+        return true;
+    }
+    PauseTiming();
+    return false;
+}
+
+void BenchState::PauseTiming()
+{
+    if (!mRunning)
+        return;
+    mTimer.stop();
+    mElapsed += mTimer.getElapsedTime();
+    mRunning = false;
+}
+
+void BenchState::ResumeTiming()
+{
+    if (mRunning)
+        return;
+    mRunning = true;
+    mTimer.start();
+}
+
+void BenchState::SetCounter(const std::string& name, double value)
+{
+    for (size_t i = 0; i < mCounters.size(); ++i) {
+        if (mCounters[i].first == name) {
+            mCounters[i].second = value;
+            return;
+        }
+    }
+    mCounters.push_back(std::make_pair(name, value));
+}
+
+void BenchState::SkipWithError(const std::string& message)
+{
+    if (mError.empty())
+        mError = message.empty() ? "failed" : message;
+}
+
+BenchRegistrar::BenchRegistrar(const char* name, BenchFunc func)
+{
+    BenchInfo info = { name, func };
+    GetBenchmarks().push_back(info);
+}
+
+SexyAppBase* Sexy::GetBenchApp()
+{
+    // Never deleted, ~SexyAppBase() calls exit()
+    static SexyAppBase* anApp = NULL;
+    if (anApp == NULL) {
+        setenv("SDL_VIDEODRIVER", "dummy", 0);
+        setenv("SDL_AUDIODRIVER", "dummy", 0);
+        anApp = new SexyAppBase();
+    }
+    return anApp;
+}
+
+int Sexy::RunBenchmarks(int argc, char** argv)
+{
+    std::string filter;
+    std::string json_file;
+    bool json = false;
+    double min_time = 0.2;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], "--filter=", 9) == 0) {
+            filter = argv[i] + 9;
+        } else if (strncmp(argv[i], "--min-time=", 11) == 0) {
+            min_time = atof(argv[i] + 11);
+        } else if (strcmp(argv[i], "--json") == 0) {
+            json = true;
+        } else if (strncmp(argv[i], "--json=", 7) == 0) {
+            json = true;
+            json_file = argv[i] + 7;
+        } else if (strcmp(argv[i], "--list") == 0) {
+            for (size_t b = 0; b < GetBenchmarks().size(); ++b)
+                printf("%s\n", GetBenchmarks()[b].name);
+            return 0;
+        } else {
+            fprintf(stderr, "usage: %s [--filter=name] [--min-time=seconds] [--json[=file]] [--list]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // With JSON on stdout the table goes to stderr.
+    FILE* table = (json && json_file.empty()) ? stderr : stdout;
+    fprintf(table, "%-44s %12s %14s %14s\n", "Benchmark", "Iterations", "ns/iter", "items/s");
+
+    std::vector<BenchResult> results;
+    int failed = 0;
+    for (size_t b = 0; b < GetBenchmarks().size(); ++b) {
+        const BenchInfo& info = GetBenchmarks()[b];
+        if (!filter.empty() && strstr(info.name, filter.c_str()) == NULL)
+            continue;
+
+        // Grow the iteration count until the benchmark runs long enough.
+        long iterations = 1;
+        for (;;) {
+            BenchState state(iterations);
+            info.func(state);
+            double elapsed = state.ElapsedSeconds();
+
+            if (state.HasError()) {
+                fprintf(table, "%-44s ERROR: %s\n", info.name, state.Error().c_str());
+                ++failed;
+                break;
+            }
+            if (elapsed >= min_time || iterations >= 1000000000L) {
+                BenchResult r;
+                r.name = info.name;
+                r.iterations = iterations;
+                r.ns_per_iter = elapsed * 1e9 / iterations;
+                r.items_per_sec = elapsed > 0 ? state.Items() / elapsed : 0;
+                r.bytes_per_sec = elapsed > 0 ? state.Bytes() / elapsed : 0;
+                r.counters = state.Counters();
+                results.push_back(r);
+
+                fprintf(table, "%-44s %12ld %14.1f %14.1f", r.name.c_str(), r.iterations, r.ns_per_iter, r.items_per_sec);
+                if (r.bytes_per_sec > 0)
+                    fprintf(table, "  %.1f MB/s", r.bytes_per_sec / (1024.0 * 1024.0));
+                for (size_t c = 0; c < r.counters.size(); ++c)
+                    fprintf(table, "  %s=%g", r.counters[c].first.c_str(), r.counters[c].second);
+                fprintf(table, "\n");
+                break;
+            }
+
+            // Aim a bit over the minimum time, but grow at most 10x per round.
+            double factor = elapsed > 0 ? (min_time * 1.4) / elapsed : 10.0;
+            if (factor > 10.0)
+                factor = 10.0;
+            long next = (long) ceil(iterations * factor);
+            iterations = next > iterations ? next : iterations + 1;
+        }
+    }
+
+    if (json) {
+        FILE* fp = json_file.empty() ? stdout : fopen(json_file.c_str(), "w");
+        if (fp == NULL) {
+            fprintf(stderr, "Couldn't open %s\n", json_file.c_str());
+            return 1;
+        }
+        WriteJson(fp, results);
+        if (fp != stdout)
+            fclose(fp);
+    }
+    if (failed > 0) {
+        fprintf(stderr, "%d benchmark(s) failed\n", failed);
+        return 1;
+    }
+    return 0;
+}
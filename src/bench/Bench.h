@@ -0,0 +1,102 @@
+/*
+ * File:   Bench.h
+ *
+ * A small in-tree micro-benchmark harness in the spirit of Google Benchmark.
+ *
+ *   static void BM_Something(Sexy::BenchState& state)
+ *   {
+ *       ...setup...
+ *       while (state.KeepRunning()) {
+ *           ...code to measure...
+ *       }
+ *       state.SetItemsProcessed(state.Iterations() * items_per_iteration);
+ *   }
+ *   TUXCAP_BENCH(BM_Something);
+ *
+ * Each benchmark is run with a growing iteration count until it ran for at
+ * least the minimum time. Results are printed as a table, or as JSON with --json.
+ *
+ * Benchmarks that check their results call state.SkipWithError() when they
+ * are wrong, the run then fails. "tuxcap_bench --min-time=0" runs each
+ * benchmark once, ctest runs it like that.
+ */
+
+#ifndef __TUXCAP_BENCH_H__
+#define __TUXCAP_BENCH_H__
+
+#include <string>
+#include <vector>
+#include "Timer.h"
+
+namespace Sexy
+{
+
+class SexyAppBase;
+
+class BenchState
+{
+public:
+    explicit BenchState(long iterations);
+
+    // Returns true as long as the benchmark loop should run.
+    bool KeepRunning();
+
+    // Exclude setup work inside the loop from the measurement.
+    void PauseTiming();
+    void ResumeTiming();
+
+    long Iterations() const { return mMaxIterations; }
+
+    void SetItemsProcessed(double items) { mItems = items; }
+    void SetBytesProcessed(double bytes) { mBytes = bytes; }
+    // Free form extra value reported next to the timings. (e.g. "contacts")
+    void SetCounter(const std::string& name, double value);
+
+    double ElapsedSeconds() const { return mElapsed; }
+    double Items() const { return mItems; }
+    double Bytes() const { return mBytes; }
+    const std::vector<std::pair<std::string, double> >& Counters() const { return mCounters; }
+
+    // Stops the benchmark, KeepRunning() returns false from now on, and
+    // reports it as failed.
+    void SkipWithError(const std::string& message);
+    bool HasError() const { return !mError.empty(); }
+    const std::string& Error() const { return mError; }
+
+private:
+    long        mMaxIterations;
+    long        mIteration;
+    bool        mRunning;
+    double      mElapsed;
+    double      mItems;
+    double      mBytes;
+    Timer       mTimer;
+    std::vector<std::pair<std::string, double> > mCounters;
+    std::string mError;
+};
+
+typedef void (*BenchFunc)(BenchState& state);
+
+class BenchRegistrar
+{
+public:
+    BenchRegistrar(const char* name, BenchFunc func);
+};
+
+// Runs the registered benchmarks. Options:
+//   --filter=<substring>   only run benchmarks whose name contains substring
+//   --min-time=<seconds>   minimum run time per benchmark (default 0.2)
+//   --json[=<file>]        write JSON results to file, or stdout
+//   --list                 list the benchmark names
+// Returns 1 if a benchmark failed.
+int RunBenchmarks(int argc, char** argv);
+
+// The SexyAppBase for benchmarks that need one, images register with it.
+// It is never Init()ed, no window is opened and SDL runs its dummy drivers.
+SexyAppBase* GetBenchApp();
+
+}
+
+#define TUXCAP_BENCH(func) static Sexy::BenchRegistrar func##_registrar(#func, &func)
+
+#endif
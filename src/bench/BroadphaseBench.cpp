@@ -0,0 +1,88 @@
+/*
+ * File:   BroadphaseBench.cpp
+ *
+ * Compares the spatial hash and the AABB tree broadphase on a level that
+ * mixes tiny debris, a few big crates and huge static terrain.
+ */
+
+#include "Bench.h"
+#include "Physics.h"
+#include "PhysicsListener.h"
+
+using namespace Sexy;
+
+namespace
+{
+
+void BuildMixedLevel(Physics& physics, cpSpatialIndexType type, float cell_size)
+{
+    physics.Init();
+    physics.SetGravity(SexyVector2(0.0f, 300.0f));
+    physics.ResizeActiveHash(cell_size, 10000);
+    physics.ResizeStaticHash(cell_size, 10000);
+    physics.SetSpatialIndex(type);
+
+    // Terrain, a few very long segments.
+    PhysicsObject* terrain = physics.CreateStaticObject();
+    terrain->AddSegmentShape(SexyVector2(0, 900), SexyVector2(2400, 1000), 2.0f, 0.0f, 1.0f);
+    terrain->AddSegmentShape(SexyVector2(0, 0), SexyVector2(0, 900), 2.0f, 0.0f, 1.0f);
+    terrain->AddSegmentShape(SexyVector2(2400, 0), SexyVector2(2400, 1000), 2.0f, 0.0f, 1.0f);
+    terrain->AddSegmentShape(SexyVector2(400, 700), SexyVector2(1200, 760), 2.0f, 0.0f, 1.0f);
+
+    // Debris.
+    for (int i = 0; i < 1500; ++i) {
+        PhysicsObject* obj = physics.CreateObject(0.2f, physics.ComputeMomentForCircle(0.2f, 0.0f, 2.0f, SexyVector2(0, 0)));
+        obj->AddCircleShape(2.0f, SexyVector2(0, 0), 0.0f, 0.7f);
+        obj->SetPosition(SexyVector2(20.0f + (i % 200) * 11.0f, 100.0f + (i / 200) * 11.0f));
+    }
+
+    // Crates.
+    SexyVector2 box[4] = {
+        SexyVector2(-40, -40), SexyVector2(-40, 40), SexyVector2(40, 40), SexyVector2(40, -40)
+    };
+    for (int i = 0; i < 20; ++i) {
+        PhysicsObject* obj = physics.CreateObject(10.0f, physics.ComputeMomentForPoly(10.0f, 4, box, SexyVector2(0, 0)));
+        obj->AddPolyShape(4, box, SexyVector2(0, 0), 0.0f, 0.7f);
+        obj->SetPosition(SexyVector2(60.0f + i * 115.0f, 40.0f));
+    }
+
+    for (int i = 0; i < 60; ++i)
+        physics.Update();
+}
+
+void RunBroadphase(BenchState& state, cpSpatialIndexType type, float cell_size = 8.0f)
+{
+    PhysicsListener listener;
+    Physics physics;
+    physics.SetPhysicsListener(&listener);
+    BuildMixedLevel(physics, type, cell_size);
+
+    while (state.KeepRunning())
+        physics.Update();
+
+    state.SetItemsProcessed((double) state.Iterations());
+    state.SetCounter("contacts_per_step", physics.GetStepStats().contacts);
+}
+
+// Cell size tuned for the debris.
+void BM_Broadphase_SpaceHash(BenchState& state)
+{
+    RunBroadphase(state, CP_SPACE_HASH);
+}
+
+// Cell size tuned for the crates.
+void BM_Broadphase_SpaceHash_BigCells(BenchState& state)
+{
+    RunBroadphase(state, CP_SPACE_HASH, 80.0f);
+}
+
+void BM_Broadphase_BBTree(BenchState& state)
+{
+    RunBroadphase(state, CP_BB_TREE);
+}
+
+}
+
+TUXCAP_BENCH(BM_Broadphase_SpaceHash);
+TUXCAP_BENCH(BM_Broadphase_SpaceHash_BigCells);
+TUXCAP_BENCH(BM_Broadphase_BBTree);
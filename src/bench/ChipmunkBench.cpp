@@ -0,0 +1,164 @@
+/*
+ * File:   ChipmunkBench.cpp
+ *
+ * cpSpaceStep() on a few canned scenes, without the Physics wrapper: a box
+ * pyramid (persistent stacked contacts), hanging chains (joints only) and
+ * a ball pit (many short lived contacts).
+ */
+
+#include <cmath>                // Before chipmunk.h, for INFINITY
+
+#include "Bench.h"
+#include "chipmunk.h"
+
+using namespace Sexy;
+
+namespace
+{
+
+const cpFloat   kTimeStep = 1.0 / 60.0;
+
+class Scene
+{
+public:
+    Scene()
+    {
+        cpInitChipmunk();
+        cpResetShapeIdCounter();
+        mSpace = cpSpaceNew();
+        mSpace->gravity = cpv(0, 300);
+        mStaticBody = cpBodyNew(INFINITY, INFINITY);
+    }
+
+    ~Scene()
+    {
+        cpSpaceFreeChildren(mSpace);
+        cpSpaceFree(mSpace);
+        cpBodyFree(mStaticBody);
+    }
+
+    void AddWall(cpVect a, cpVect b)
+    {
+        cpShape* aShape = cpSegmentShapeNew(mStaticBody, a, b, 1.0);
+        aShape->e = 0.0;
+        aShape->u = 1.0;
+        cpSpaceAddStaticShape(mSpace, aShape);
+    }
+
+    cpBody* AddBox(cpVect thePos, cpFloat theSize)
+    {
+        cpFloat h = theSize / 2;
+        cpVect aVerts[4] = { cpv(-h, -h), cpv(-h, h), cpv(h, h), cpv(h, -h) };
+        cpBody* aBody = cpBodyNew(1.0, cpMomentForPoly(1.0, 4, aVerts, cpvzero));
+        aBody->p = thePos;
+        cpSpaceAddBody(mSpace, aBody);
+        cpShape* aShape = cpPolyShapeNew(aBody, 4, aVerts, cpvzero);
+        aShape->e = 0.0;
+        aShape->u = 0.8;
+        cpSpaceAddShape(mSpace, aShape);
+        return aBody;
+    }
+
+    cpBody* AddBall(cpVect thePos, cpFloat theRadius)
+    {
+        cpBody* aBody = cpBodyNew(1.0, cpMomentForCircle(1.0, 0.0, theRadius, cpvzero));
+        aBody->p = thePos;
+        cpSpaceAddBody(mSpace, aBody);
+        cpShape* aShape = cpCircleShapeNew(aBody, theRadius, cpvzero);
+        aShape->e = 0.3;
+        aShape->u = 0.5;
+        cpSpaceAddShape(mSpace, aShape);
+        return aBody;
+    }
+
+    void Settle(int theSteps)
+    {
+        for (int i = 0; i < theSteps; ++i)
+            cpSpaceStep(mSpace, kTimeStep);
+    }
+
+    cpSpace*    mSpace;
+    cpBody*     mStaticBody;
+};
+
+void BuildPyramid(Scene& theScene, int theBase)
+{
+    cpSpaceResizeActiveHash(theScene.mSpace, 20.0, theBase * theBase);
+    theScene.AddWall(cpv(-1000, 600), cpv(2000, 600));
+    for (int aRow = 0; aRow < theBase; ++aRow)
+        for (int i = 0; i < theBase - aRow; ++i)
+            theScene.AddBox(cpv(400 + (i - (theBase - aRow) / 2.0) * 21.0, 590 - aRow * 20.5), 20.0);
+}
+
+// Each chain hangs from the ceiling, the links are pivot joints
+void BuildChains(Scene& theScene, int theChains, int theLinks)
+{
+    cpSpaceResizeActiveHash(theScene.mSpace, 10.0, theChains * theLinks);
+    for (int c = 0; c < theChains; ++c) {
+        cpFloat x = 20.0 + c * 25.0;
+        cpBody* aPrev = theScene.mStaticBody;
+        for (int i = 0; i < theLinks; ++i) {
+            cpVect aPos = cpv(x + i * 8.0, 50.0 + i * 2.0);
+            cpBody* aLink = theScene.AddBall(aPos, 3.0);
+            cpSpaceAddJoint(theScene.mSpace, cpPivotJointNew(aPrev, aLink, cpv(aPos.x - 4.0, aPos.y)));
+            aPrev = aLink;
+        }
+    }
+}
+
+void BuildBallPit(Scene& theScene, int theCount)
+{
+    cpSpaceResizeActiveHash(theScene.mSpace, 12.0, theCount * 2);
+    theScene.AddWall(cpv(0, 600), cpv(800, 600));
+    theScene.AddWall(cpv(0, 0), cpv(0, 600));
+    theScene.AddWall(cpv(800, 0), cpv(800, 600));
+    for (int i = 0; i < theCount; ++i)
+        theScene.AddBall(cpv(10.0 + (i % 70) * 11.3, 590.0 - (i / 70) * 11.0), 5.0 + (i % 3));
+}
+
+void RunScene(BenchState& state, Scene& theScene, int theBodies)
+{
+    theScene.Settle(30);
+    while (state.KeepRunning())
+        cpSpaceStep(theScene.mSpace, kTimeStep);
+
+    state.SetItemsProcessed((double) state.Iterations() * theBodies);
+    state.SetCounter("contacts_per_step", theScene.mSpace->stepStats.contacts);
+    state.SetCounter("allocs_per_step", theScene.mSpace->stepStats.allocations);
+}
+
+void BM_cpSpaceStep_Pyramid(BenchState& state)
+{
+    Scene aScene;
+    BuildPyramid(aScene, 30);
+    RunScene(state, aScene, 30 * 31 / 2);
+}
+
+void BM_cpSpaceStep_Chains(BenchState& state)
+{
+    Scene aScene;
+    BuildChains(aScene, 30, 30);
+    RunScene(state, aScene, 30 * 30);
+}
+
+void BM_cpSpaceStep_BallPit(BenchState& state)
+{
+    Scene aScene;
+    BuildBallPit(aScene, 2000);
+    RunScene(state, aScene, 2000);
+}
+
+void BM_cpSpaceStep_BallPit_4Threads(BenchState& state)
+{
+    Scene aScene;
+    BuildBallPit(aScene, 2000);
+    cpSpaceSetThreads(aScene.mSpace, 4);
+    RunScene(state, aScene, 2000);
+}
+
+}
+
+TUXCAP_BENCH(BM_cpSpaceStep_Pyramid);
+TUXCAP_BENCH(BM_cpSpaceStep_Chains);
+TUXCAP_BENCH(BM_cpSpaceStep_BallPit);
+TUXCAP_BENCH(BM_cpSpaceStep_BallPit_4Threads);
@@ -0,0 +1,110 @@
+/*
+ * File:   ImageFontBench.cpp
+ *
+ * ImageFont::StringWidth and ImageFont::DrawStringEx into a MemoryImage.
+ * The font is built in memory, a 8x12 glyph atlas with a shadow layer and
+ * a few kerning pairs, so no font files are needed.
+ */
+
+#include "Bench.h"
+#include "Graphics.h"
+#include "ImageFont.h"
+#include "MemoryImage.h"
+#include "SexyAppBase.h"
+
+using namespace Sexy;
+
+namespace
+{
+
+const int       kGlyphWidth = 8;
+const int       kGlyphHeight = 12;
+const int       kGlyphsPerRow = 16;
+
+const char*     kText = "The quick brown fox jumps over the lazy dog. AV To Ty 0123456789 (Score: 1,234,567)";
+
+ImageFont* CreateFont()
+{
+    MemoryImage* anImage = new MemoryImage(GetBenchApp());
+    anImage->Create(kGlyphsPerRow * kGlyphWidth, (128 - 32) / kGlyphsPerRow * kGlyphHeight);
+    uint32_t* aBits = anImage->GetBits();
+    for (int i = 0; i < anImage->GetWidth() * anImage->GetHeight(); ++i)
+        aBits[i] = ((i * 7) % 5) < 2 ? 0xFFFFFFFF : 0x00FFFFFF;
+    anImage->BitsChanged();
+
+    ImageFont* aFont = new ImageFont(anImage);
+    FontLayer* aLayer = &aFont->mFontData->mFontLayerList.back();
+    aLayer->mAscent = kGlyphHeight - 2;
+    aLayer->mHeight = kGlyphHeight;
+    aLayer->mDefaultHeight = kGlyphHeight;
+    aLayer->mSpacing = 1;
+    for (int c = 32; c < 128; ++c) {
+        int anIdx = c - 32;
+        CharData* aCharData = &aLayer->mCharData[c];
+        aCharData->mImageRect = Rect((anIdx % kGlyphsPerRow) * kGlyphWidth, (anIdx / kGlyphsPerRow) * kGlyphHeight, kGlyphWidth, kGlyphHeight);
+        aCharData->mWidth = kGlyphWidth - (c % 3);
+    }
+    aLayer->SetKerningOffset('A', 'V', -2);
+    aLayer->SetKerningOffset('T', 'o', -1);
+    aLayer->SetKerningOffset('T', 'y', -1);
+
+    // Drop shadow, drawn below the main layer
+    aFont->mFontData->mFontLayerList.push_back(*aLayer);
+    FontLayer* aShadow = &aFont->mFontData->mFontLayerList.back();
+    aShadow->mOffset = Point(1, 1);
+    aShadow->mColorMult = Color(0, 0, 0, 160);
+    aShadow->mBaseOrder = -1;
+
+    aFont->mActiveListValid = false;
+    return aFont;
+}
+
+// The font doesn't own an image given to its constructor
+void DestroyFont(ImageFont* theFont)
+{
+    Image* anImage = theFont->mFontData->mFontLayerList.front().mImage;
+    delete theFont;
+    delete anImage;
+}
+
+void BM_ImageFont_StringWidth(BenchState& state)
+{
+    ImageFont* aFont = CreateFont();
+    SexyString aText = kText;
+
+    long aWidth = 0;
+    while (state.KeepRunning())
+        aWidth += aFont->StringWidth(aText);
+
+    state.SetItemsProcessed((double) state.Iterations() * aText.length());
+    state.SetCounter("width", (double) aWidth / state.Iterations());
+    DestroyFont(aFont);
+}
+
+void BM_ImageFont_DrawStringEx(BenchState& state)
+{
+    ImageFont* aFont = CreateFont();
+    MemoryImage* aDest = new MemoryImage(GetBenchApp());
+    aDest->Create(800, 600);
+    SexyString aText = kText;
+    Rect aClipRect(0, 0, 800, 600);
+    Color aColor(255, 220, 120);
+
+    long aLines = 0;
+    {
+        Graphics g(aDest);
+        while (state.KeepRunning()) {
+            for (int y = kGlyphHeight; y < 600; y += 3 * kGlyphHeight, ++aLines)
+                aFont->DrawStringEx(&g, 4, y, aText, aColor, &aClipRect, NULL, NULL);
+        }
+    }
+
+    state.SetItemsProcessed((double) aLines * aText.length());
+    delete aDest;
+    DestroyFont(aFont);
+}
+
+}
+
+TUXCAP_BENCH(BM_ImageFont_StringWidth);
+TUXCAP_BENCH(BM_ImageFont_DrawStringEx);
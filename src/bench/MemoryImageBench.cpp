@@ -0,0 +1,190 @@
+/*
+ * File:   MemoryImageBench.cpp
+ *
+ * The software blitters of MemoryImage: normal and additive blits, fast and
+ * slow stretches, rotated blits and rectangle fills into a 640x480 image.
+ */
+
+#include "Bench.h"
+#include "Graphics.h"
+#include "MemoryImage.h"
+#include "SexyAppBase.h"
+
+using namespace Sexy;
+
+namespace
+{
+
+const int       kDestWidth = 640;
+const int       kDestHeight = 480;
+const int       kSpriteSize = 64;
+
+// A sprite with a soft alpha edge, like most of the game art
+MemoryImage* CreateSprite(int theSize, bool hasAlpha)
+{
+    MemoryImage* anImage = new MemoryImage(GetBenchApp());
+    anImage->Create(theSize, theSize);
+    uint32_t* aBits = anImage->GetBits();
+    for (int y = 0; y < theSize; ++y) {
+        for (int x = 0; x < theSize; ++x) {
+            int dx = 2 * x - theSize;
+            int dy = 2 * y - theSize;
+            int anAlpha = 255 - (dx * dx + dy * dy) * 255 / (2 * theSize * theSize);
+            if (!hasAlpha)
+                anAlpha = 255;
+            *aBits++ = (anAlpha << 24) | ((x * 4) << 16) | ((y * 4) << 8) | 0x80;
+        }
+    }
+    anImage->BitsChanged();
+    anImage->SetImageMode(hasAlpha, hasAlpha);
+    return anImage;
+}
+
+MemoryImage* CreateDest()
+{
+    MemoryImage* anImage = new MemoryImage(GetBenchApp());
+    anImage->Create(kDestWidth, kDestHeight);
+    anImage->SetImageMode(false, false);
+    return anImage;
+}
+
+void RunBlt(BenchState& state, bool hasAlpha, int theDrawMode)
+{
+    MemoryImage* aSprite = CreateSprite(kSpriteSize, hasAlpha);
+    MemoryImage* aDest = CreateDest();
+    Rect aSrcRect(0, 0, kSpriteSize, kSpriteSize);
+    Color aColor(255, 255, 255);
+
+    long aCount = 0;
+    while (state.KeepRunning()) {
+        for (int y = 0; y + kSpriteSize <= kDestHeight; y += kSpriteSize / 2)
+            for (int x = 0; x + kSpriteSize <= kDestWidth; x += kSpriteSize / 2, ++aCount)
+                aDest->Blt(aSprite, x, y, aSrcRect, aColor, theDrawMode);
+    }
+
+    state.SetItemsProcessed((double) aCount);
+    state.SetBytesProcessed((double) aCount * kSpriteSize * kSpriteSize * 4);
+    delete aDest;
+    delete aSprite;
+}
+
+void BM_MemoryImage_Blt_Opaque(BenchState& state)
+{
+    RunBlt(state, false, Graphics::DRAWMODE_NORMAL);
+}
+
+void BM_MemoryImage_Blt_Alpha(BenchState& state)
+{
+    RunBlt(state, true, Graphics::DRAWMODE_NORMAL);
+}
+
+void BM_MemoryImage_Blt_Additive(BenchState& state)
+{
+    RunBlt(state, true, Graphics::DRAWMODE_ADDITIVE);
+}
+
+// Stretches the sprite to 2.5x its size all over the destination
+void RunStretchBlt(BenchState& state, bool fastStretch)
+{
+    MemoryImage* aSprite = CreateSprite(kSpriteSize, true);
+    MemoryImage* aDest = CreateDest();
+    Rect aSrcRect(0, 0, kSpriteSize, kSpriteSize);
+    Rect aClipRect(0, 0, kDestWidth, kDestHeight);
+    Color aColor(255, 255, 255);
+    int aSize = kSpriteSize * 5 / 2;
+
+    long aCount = 0;
+    long aPixels = 0;
+    while (state.KeepRunning()) {
+        for (int y = 0; y + aSize <= kDestHeight; y += aSize / 2) {
+            for (int x = 0; x + aSize <= kDestWidth; x += aSize / 2) {
+                aDest->StretchBlt(aSprite, Rect(x, y, aSize, aSize), aSrcRect, aClipRect, aColor, Graphics::DRAWMODE_NORMAL, fastStretch);
+                ++aCount;
+                aPixels += aSize * aSize;
+            }
+        }
+    }
+
+    state.SetItemsProcessed((double) aCount);
+    state.SetCounter("dest_pixels", (double) aPixels / state.Iterations());
+    delete aDest;
+    delete aSprite;
+}
+
+void BM_MemoryImage_StretchBlt_Fast(BenchState& state)
+{
+    RunStretchBlt(state, true);
+}
+
+void BM_MemoryImage_StretchBlt_Slow(BenchState& state)
+{
+    RunStretchBlt(state, false);
+}
+
+void RunBltRotated(BenchState& state, int theDrawMode)
+{
+    MemoryImage* aSprite = CreateSprite(kSpriteSize, true);
+    MemoryImage* aDest = CreateDest();
+    Rect aSrcRect(0, 0, kSpriteSize, kSpriteSize);
+    Rect aClipRect(0, 0, kDestWidth, kDestHeight);
+    Color aColor(255, 255, 255);
+    float aCenter = kSpriteSize / 2.0f;
+
+    long aCount = 0;
+    while (state.KeepRunning()) {
+        for (int y = 0; y + kSpriteSize <= kDestHeight; y += kSpriteSize) {
+            for (int x = 0; x + kSpriteSize <= kDestWidth; x += kSpriteSize, ++aCount) {
+                double aRot = (aCount % 64) * 0.1;
+                aDest->BltRotated(aSprite, (float) x, (float) y, aSrcRect, aClipRect, aColor, theDrawMode, aRot, aCenter, aCenter);
+            }
+        }
+    }
+
+    state.SetItemsProcessed((double) aCount);
+    delete aDest;
+    delete aSprite;
+}
+
+void BM_MemoryImage_BltRotated(BenchState& state)
+{
+    RunBltRotated(state, Graphics::DRAWMODE_NORMAL);
+}
+
+void BM_MemoryImage_BltRotated_Additive(BenchState& state)
+{
+    RunBltRotated(state, Graphics::DRAWMODE_ADDITIVE);
+}
+
+void RunFillRect(BenchState& state, const Color& theColor)
+{
+    MemoryImage* aDest = CreateDest();
+    Rect aRect(8, 8, kDestWidth - 16, kDestHeight - 16);
+
+    while (state.KeepRunning())
+        aDest->FillRect(aRect, theColor, Graphics::DRAWMODE_NORMAL);
+
+    state.SetBytesProcessed((double) state.Iterations() * aRect.mWidth * aRect.mHeight * 4);
+    delete aDest;
+}
+
+void BM_MemoryImage_FillRect_Opaque(BenchState& state)
+{
+    RunFillRect(state, Color(40, 80, 120));
+}
+
+void BM_MemoryImage_FillRect_Blend(BenchState& state)
+{
+    RunFillRect(state, Color(40, 80, 120, 128));
+}
+
+}
+
+TUXCAP_BENCH(BM_MemoryImage_Blt_Opaque);
+TUXCAP_BENCH(BM_MemoryImage_Blt_Alpha);
+TUXCAP_BENCH(BM_MemoryImage_Blt_Additive);
+TUXCAP_BENCH(BM_MemoryImage_StretchBlt_Fast);
+TUXCAP_BENCH(BM_MemoryImage_StretchBlt_Slow);
+TUXCAP_BENCH(BM_MemoryImage_BltRotated);
+TUXCAP_BENCH(BM_MemoryImage_BltRotated_Additive);
+TUXCAP_BENCH(BM_MemoryImage_FillRect_Opaque);
+TUXCAP_BENCH(BM_MemoryImage_FillRect_Blend);
@@ -0,0 +1,202 @@
+/*
+ * File:   PakInterfaceBench.cpp
+ *
+ * Reads from a pak: PakXorCopy on its own, large FReads, FGetS over a text
+ * file and FOpen lookups among a few thousand small entries. The pak is
+ * written to the current directory on first use.
+ */
+
+#include "Bench.h"
+#include "PakInterface.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace Sexy;
+
+namespace
+{
+
+const char*     kPakName = "tuxcap_bench.pak";
+const int       kBinarySize = 16 << 20;
+const int       kLineCount = 100000;
+const int       kSmallCount = 4000;
+
+std::string SmallName(int theIdx)
+{
+    char aName[64];
+    snprintf(aName, sizeof(aName), "images/level%d/thing_%d.png", theIdx % 20, theIdx);
+    return aName;
+}
+
+std::string BuildText()
+{
+    std::string text;
+    char line[128];
+    for (int i = 0; i < kLineCount; ++i) {
+        snprintf(line, sizeof(line), "<Image id=\"IMAGE_THING_%d\" path=\"images/thing_%d.png\"/>%s\n", i, i, i % 3 ? "" : "\r");
+        text += line;
+    }
+    return text;
+}
+
+void AddEntry(std::string& header, std::string& data, const std::string& name, const std::string& contents)
+{
+    uint32_t aSize = contents.size();
+    uint64_t aFileTime = 0;
+    header += (char) 0;
+    header += (char) name.size();
+    header += name;
+    header.append((const char*) &aSize, sizeof(aSize));
+    header.append((const char*) &aFileTime, sizeof(aFileTime));
+    data += contents;
+}
+
+PakInterface* GetPak()
+{
+    static PakInterface* aPak = NULL;
+    if (aPak != NULL)
+        return aPak;
+
+    std::string aBinary(kBinarySize, 0);
+    for (int i = 0; i < kBinarySize; ++i)
+        aBinary[i] = (char) (i * 2654435761u >> 24);
+
+    uint32_t aMagic = 0xBAC04AC0;
+    uint32_t aVersion = 0;
+    std::string aHeader((const char*) &aMagic, sizeof(aMagic));
+    aHeader.append((const char*) &aVersion, sizeof(aVersion));
+    std::string aData;
+    AddEntry(aHeader, aData, "binary.dat", aBinary);
+    AddEntry(aHeader, aData, "text.xml", BuildText());
+    for (int i = 0; i < kSmallCount; ++i)
+        AddEntry(aHeader, aData, SmallName(i), std::string(64 + i % 200, (char) i));
+    aHeader += (char) 0x80;
+
+    std::string aPakData = aHeader + aData;
+    for (size_t i = 0; i < aPakData.size(); ++i)
+        aPakData[i] ^= 0xF7;
+
+    FILE* aFP = fopen(kPakName, "wb");
+    if (aFP == NULL)
+        return NULL;
+    fwrite(aPakData.data(), 1, aPakData.size(), aFP);
+    fclose(aFP);
+
+    aPak = new PakInterface();
+    if (!aPak->AddPakFile(kPakName)) {
+        delete aPak;
+        aPak = NULL;
+    }
+    remove(kPakName);       // Stays mapped
+    return aPak;
+}
+
+void BM_PakXorCopy(BenchState& state)
+{
+    std::vector<unsigned char> aSrc(kBinarySize, 0x5A);
+    std::vector<unsigned char> aDest(kBinarySize);
+
+    while (state.KeepRunning())
+        PakXorCopy(&aDest[0], &aSrc[0], aSrc.size());
+
+    state.SetBytesProcessed((double) state.Iterations() * aSrc.size());
+}
+
+// What FRead did before PakXorCopy, for comparison
+void BM_PakXorCopy_ByteLoop(BenchState& state)
+{
+    std::vector<unsigned char> aSrc(kBinarySize, 0x5A);
+    std::vector<unsigned char> aDest(kBinarySize);
+
+    while (state.KeepRunning()) {
+        volatile unsigned char* aDestPtr = &aDest[0];
+        for (size_t i = 0; i < aSrc.size(); ++i)
+            aDestPtr[i] = aSrc[i] ^ 0xF7;
+    }
+
+    state.SetBytesProcessed((double) state.Iterations() * aSrc.size());
+}
+
+void BM_PakInterface_FRead(BenchState& state)
+{
+    PakInterface* aPak = GetPak();
+    if (aPak == NULL)
+        return;
+
+    std::vector<char> aBuffer(256 << 10);
+    size_t aBytes = 0;
+    while (state.KeepRunning()) {
+        PFILE* aFP = aPak->FOpen("binary.dat", "rb");
+        size_t aRead;
+        while ((aRead = aPak->FRead(&aBuffer[0], 1, aBuffer.size(), aFP)) > 0)
+            aBytes += aRead;
+        aPak->FClose(aFP);
+    }
+
+    state.SetBytesProcessed((double) aBytes);
+}
+
+void BM_PakInterface_FGetS(BenchState& state)
+{
+    PakInterface* aPak = GetPak();
+    if (aPak == NULL)
+        return;
+
+    char aLine[256];
+    size_t aBytes = 0;
+    long aLines = 0;
+    while (state.KeepRunning()) {
+        PFILE* aFP = aPak->FOpen("text.xml", "rb");
+        while (aPak->FGetS(aLine, sizeof(aLine), aFP) != NULL) {
+            aBytes += strlen(aLine);
+            ++aLines;
+        }
+        aPak->FClose(aFP);
+    }
+
+    state.SetBytesProcessed((double) aBytes);
+    state.SetCounter("lines", (double) aLines / state.Iterations());
+}
+
+// Opens every small entry, the way the resource manager does while loading,
+// with Windows style paths for half of them
+void BM_PakInterface_FOpen(BenchState& state)
+{
+    PakInterface* aPak = GetPak();
+    if (aPak == NULL)
+        return;
+
+    std::vector<std::string> aNames;
+    for (int i = 0; i < kSmallCount; ++i) {
+        std::string aName = SmallName((i * 7919) % kSmallCount);
+        if (i & 1)
+            for (size_t j = 0; j < aName.size(); ++j)
+                if (aName[j] == '/')
+                    aName[j] = '\\';
+        aNames.push_back(aName);
+    }
+
+    long aFound = 0;
+    while (state.KeepRunning()) {
+        for (size_t i = 0; i < aNames.size(); ++i) {
+            PFILE* aFP = aPak->FOpen(aNames[i].c_str(), "rb");
+            if (aFP != NULL) {
+                ++aFound;
+                aPak->FClose(aFP);
+            }
+        }
+    }
+
+    state.SetItemsProcessed((double) state.Iterations() * aNames.size());
+    state.SetCounter("found", (double) aFound / state.Iterations());
+}
+
+}
+
+TUXCAP_BENCH(BM_PakXorCopy);
+TUXCAP_BENCH(BM_PakXorCopy_ByteLoop);
+TUXCAP_BENCH(BM_PakInterface_FRead);
+TUXCAP_BENCH(BM_PakInterface_FGetS);
+TUXCAP_BENCH(BM_PakInterface_FOpen);
@@ -0,0 +1,133 @@
+/*
+ * File:   ParticleBench.cpp
+ *
+ * hgeParticleSystem::_update() with a full system (MAX_PARTICLES alive),
+ * moving emitters and a burst of many small systems. Nothing is rendered.
+ */
+
+#include "Bench.h"
+#include "hgeparticle.h"
+#include "hgeRandom.h"
+
+#include <vector>
+
+using namespace Sexy;
+using namespace HGE;
+
+namespace
+{
+
+const float     kTimeStep = 1.0f / 60.0f;
+
+// Calls _update() directly, Update() only adds the fixed fps bookkeeping
+class BenchParticleSystem : public hgeParticleSystem
+{
+public:
+    BenchParticleSystem(hgeParticleSystemInfo* psi) : hgeParticleSystem(psi) {}
+
+    void Step(float fDeltaTime) { _update(fDeltaTime); }
+};
+
+void FillInfo(hgeParticleSystemInfo& info, int nEmission)
+{
+    info.sprite = NULL;
+    info.nEmission = nEmission;
+    info.fLifetime = -1.0f;             // Emit forever
+    info.fParticleLifeMin = 1.0f;
+    info.fParticleLifeMax = 2.0f;
+    info.fDirection = 0.0f;
+    info.fSpread = M_PI;
+    info.bRelative = false;
+    info.fSpeedMin = 1.0f;
+    info.fSpeedMax = 3.0f;
+    info.fGravityMin = 20.0f;
+    info.fGravityMax = 60.0f;
+    info.fRadialAccelMin = -10.0f;
+    info.fRadialAccelMax = 10.0f;
+    info.fTangentialAccelMin = -20.0f;
+    info.fTangentialAccelMax = 20.0f;
+    info.fSizeStart = 1.0f;
+    info.fSizeEnd = 0.2f;
+    info.fSizeVar = 0.5f;
+    info.fSpinStart = 0.0f;
+    info.fSpinEnd = 6.0f;
+    info.fSpinVar = 0.5f;
+    info.colColorStart = hgeColor(1.0f, 0.8f, 0.2f, 1.0f);
+    info.colColorEnd = hgeColor(1.0f, 0.1f, 0.0f, 0.0f);
+    info.fColorVar = 0.5f;
+    info.fAlphaVar = 0.2f;
+}
+
+void BM_hgeParticleSystem_Update(BenchState& state)
+{
+    Random_Seed(0);
+    hgeParticleSystemInfo info;
+    FillInfo(info, 1000);
+    BenchParticleSystem aSystem(&info);
+    aSystem.FireAt(400.0f, 300.0f);
+    for (int i = 0; i < 120; ++i)
+        aSystem.Step(kTimeStep);
+
+    long aParticles = 0;
+    while (state.KeepRunning()) {
+        aSystem.Step(kTimeStep);
+        aParticles += aSystem.GetParticlesAlive();
+    }
+
+    state.SetItemsProcessed((double) aParticles);
+    state.SetCounter("alive", (double) aParticles / state.Iterations());
+}
+
+// A trail, the emitter moves every step and the bounding box is tracked
+void BM_hgeParticleSystem_Update_Moving(BenchState& state)
+{
+    Random_Seed(0);
+    hgeParticleSystemInfo info;
+    FillInfo(info, 400);
+    info.bRelative = true;
+    BenchParticleSystem aSystem(&info);
+    aSystem.TrackBoundingBox(true);
+    aSystem.FireAt(0.0f, 300.0f);
+
+    long aParticles = 0;
+    long aStep = 0;
+    while (state.KeepRunning()) {
+        aSystem.MoveTo((float) (aStep++ % 800), 300.0f);
+        aSystem.Step(kTimeStep);
+        aParticles += aSystem.GetParticlesAlive();
+    }
+
+    state.SetItemsProcessed((double) aParticles);
+    state.SetCounter("alive", (double) aParticles / state.Iterations());
+}
+
+// Many small explosions, like a busy game screen
+void BM_hgeParticleSystem_Update_100Systems(BenchState& state)
+{
+    Random_Seed(0);
+    hgeParticleSystemInfo info;
+    FillInfo(info, 60);
+    std::vector<BenchParticleSystem*> aSystems;
+    for (int i = 0; i < 100; ++i) {
+        aSystems.push_back(new BenchParticleSystem(&info));
+        aSystems.back()->FireAt((float) (i % 10) * 80.0f, (float) (i / 10) * 60.0f);
+    }
+
+    long aParticles = 0;
+    while (state.KeepRunning()) {
+        for (size_t i = 0; i < aSystems.size(); ++i) {
+            aSystems[i]->Step(kTimeStep);
+            aParticles += aSystems[i]->GetParticlesAlive();
+        }
+    }
+
+    state.SetItemsProcessed((double) aParticles);
+    for (size_t i = 0; i < aSystems.size(); ++i)
+        delete aSystems[i];
+}
+
+}
+
+TUXCAP_BENCH(BM_hgeParticleSystem_Update);
+TUXCAP_BENCH(BM_hgeParticleSystem_Update_Moving);
+TUXCAP_BENCH(BM_hgeParticleSystem_Update_100Systems);
@@ -0,0 +1,138 @@
+/*
+ * File:   PhysicsBench.cpp
+ *
+ * Physics::Update() with a pile of objects and collision callbacks enabled,
+ * this exercises the shape/body to PhysicsObject lookup for every contact.
+ */
+
+#include "Bench.h"
+#include "Physics.h"
+#include "PhysicsListener.h"
+
+using namespace Sexy;
+
+namespace
+{
+
+class CountingListener : public PhysicsListener
+{
+public:
+    CountingListener() : mCollisions(0), mTypedCollisions(0) {}
+
+    virtual void HandleCollision(CollisionObject* col)
+    {
+        if (col->object1 != NULL && col->object2 != NULL)
+            ++mCollisions;
+    }
+
+    virtual bool HandleTypedCollision(CollisionObject* col)
+    {
+        if (col->object1 != NULL && col->object2 != NULL)
+            ++mTypedCollisions;
+        return true;
+    }
+
+    long mCollisions;
+    long mTypedCollisions;
+};
+
+enum
+{
+    TYPE_FLOOR = 1,
+    TYPE_BALL,
+    TYPE_BOX
+};
+
+// Drops balls and boxes into a walled bin and lets them settle a bit, so the
+// measured steps see a dense, persistent set of contacts.
+void BuildPile(Physics& physics, int count)
+{
+    physics.Init();
+    physics.SetGravity(SexyVector2(0.0f, 300.0f));
+    physics.ResizeActiveHash(20.0f, count * 4);
+    physics.ResizeStaticHash(40.0f, 100);
+    physics.RegisterCollisionType(TYPE_BALL, TYPE_BOX);
+    physics.RegisterCollisionType(TYPE_BALL, TYPE_FLOOR);
+
+    PhysicsObject* floor = physics.CreateStaticObject();
+    floor->AddSegmentShape(SexyVector2(0, 600), SexyVector2(800, 600), 1.0f, 0.0f, 1.0f);
+    floor->AddSegmentShape(SexyVector2(0, 0), SexyVector2(0, 600), 1.0f, 0.0f, 1.0f);
+    floor->AddSegmentShape(SexyVector2(800, 0), SexyVector2(800, 600), 1.0f, 0.0f, 1.0f);
+    for (int i = 0; i < 3; ++i)
+        floor->SetCollisionType(TYPE_FLOOR, i);
+
+    SexyVector2 box[4] = {
+        SexyVector2(-5, -5), SexyVector2(-5, 5), SexyVector2(5, 5), SexyVector2(5, -5)
+    };
+
+    int per_row = 60;
+    for (int i = 0; i < count; ++i) {
+        float x = 20.0f + (i % per_row) * 12.5f;
+        float y = 590.0f - (i / per_row) * 12.0f;
+        PhysicsObject* obj;
+        if (i & 1) {
+            obj = physics.CreateObject(1.0f, physics.ComputeMomentForPoly(1.0f, 4, box, SexyVector2(0, 0)));
+            obj->AddPolyShape(4, box, SexyVector2(0, 0), 0.0f, 0.8f);
+            obj->SetCollisionType(TYPE_BOX);
+        } else {
+            obj = physics.CreateObject(1.0f, physics.ComputeMomentForCircle(1.0f, 0.0f, 5.0f, SexyVector2(0, 0)));
+            obj->AddCircleShape(5.0f, SexyVector2(0, 0), 0.0f, 0.8f);
+            obj->SetCollisionType(TYPE_BALL);
+        }
+        obj->SetPosition(SexyVector2(x, y));
+    }
+
+    for (int i = 0; i < 30; ++i)
+        physics.Update();
+}
+
+void RunPhysicsUpdate(BenchState& state, int count, int threads, bool events = false)
+{
+    CountingListener listener;
+    Physics physics;
+    physics.SetPhysicsListener(&listener);
+    BuildPile(physics, count);
+    physics.SetThreads(threads);
+    physics.EnableCollisionEvents(events);
+
+    listener.mCollisions = 0;
+    listener.mTypedCollisions = 0;
+    long num_events = 0;
+    while (state.KeepRunning()) {
+        physics.Update();
+        num_events += physics.GetCollisionEvents().size();
+    }
+
+    state.SetItemsProcessed((double) state.Iterations() * count);
+    state.SetCounter("callbacks_per_step", (double) (listener.mCollisions + listener.mTypedCollisions) / state.Iterations());
+    state.SetCounter("events_per_step", (double) num_events / state.Iterations());
+    state.SetCounter("allocs_per_step", physics.GetStepStats().allocations);
+    state.SetCounter("contacts_per_step", physics.GetStepStats().contacts);
+}
+
+void BM_PhysicsUpdate_500(BenchState& state)
+{
+    RunPhysicsUpdate(state, 500, 1);
+}
+
+void BM_PhysicsUpdate_2000(BenchState& state)
+{
+    RunPhysicsUpdate(state, 2000, 1);
+}
+
+void BM_PhysicsUpdate_2000_4Threads(BenchState& state)
+{
+    RunPhysicsUpdate(state, 2000, 4);
+}
+
+void BM_PhysicsUpdate_2000_Events(BenchState& state)
+{
+    RunPhysicsUpdate(state, 2000, 1, true);
+}
+
+}
+
+TUXCAP_BENCH(BM_PhysicsUpdate_500);
+TUXCAP_BENCH(BM_PhysicsUpdate_2000);
+TUXCAP_BENCH(BM_PhysicsUpdate_2000_4Threads);
+TUXCAP_BENCH(BM_PhysicsUpdate_2000_Events);
@@ -0,0 +1,56 @@
+/*
+ * File:   QuantizeBench.cpp
+ *
+ * Quantize8Bit() on a 512x512 image, once with a palette that fits (the
+ * common case for Palletize()) and once with too many colors, which bails
+ * out when the 257th color shows up.
+ */
+
+#include "Bench.h"
+#include "Quantize.h"
+
+#include <vector>
+
+using namespace Sexy;
+
+namespace
+{
+
+const int       kSize = 512;
+
+void RunQuantize(BenchState& state, int theColors)
+{
+    std::vector<uint32_t> aBits(kSize * kSize);
+    uint32_t aSeed = 12345;
+    for (size_t i = 0; i < aBits.size(); ++i) {
+        // Runs of the same color, like flat shaded art
+        if (i % 7 == 0)
+            aSeed = aSeed * 1664525 + 1013904223;
+        uint32_t anIdx = (aSeed >> 8) % theColors;
+        aBits[i] = 0xFF000000 | (anIdx * 0x9E3779B1u >> 8);
+    }
+
+    std::vector<uchar> anIndices(kSize * kSize);
+    uint32_t aColorTable[256];
+    long aFits = 0;
+    while (state.KeepRunning())
+        aFits += Quantize8Bit(&aBits[0], kSize, kSize, &anIndices[0], aColorTable);
+
+    state.SetBytesProcessed((double) state.Iterations() * aBits.size() * 4);
+    state.SetCounter("fits", (double) aFits / state.Iterations());
+}
+
+void BM_Quantize8Bit_200Colors(BenchState& state)
+{
+    RunQuantize(state, 200);
+}
+
+void BM_Quantize8Bit_TooManyColors(BenchState& state)
+{
+    RunQuantize(state, 4096);
+}
+
+}
+
+TUXCAP_BENCH(BM_Quantize8Bit_200Colors);
+TUXCAP_BENCH(BM_Quantize8Bit_TooManyColors);
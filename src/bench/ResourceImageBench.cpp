@@ -0,0 +1,120 @@
+/*
+ * File:   ResourceImageBench.cpp
+ *
+ * Images the ResourceManager loaded, read from their file again after
+ * UpdateImageMemory() evicted their bits and their texture. Fails if the
+ * pixels don't come back.
+ */
+
+#include "Bench.h"
+#include "ImageLib.h"
+#include "MemoryImage.h"
+#include "ResourceManager.h"
+#include "SexyAppBase.h"
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+using namespace Sexy;
+
+namespace
+{
+
+const int       kImageSize = 128;
+
+uint32_t PixelAt(int x, int y)
+{
+    return 0xFF000000 | ((x * 2) << 16) | ((y * 2) << 8) | ((x + y) & 0xFF);
+}
+
+// Writes an image and a resources file with it to theFolder
+bool WriteResources(const std::string& theFolder)
+{
+    MemoryImage anImage(GetBenchApp());
+    anImage.Create(kImageSize, kImageSize);
+    uint32_t* aBits = anImage.GetBits();
+    for (int y = 0; y < kImageSize; ++y)
+        for (int x = 0; x < kImageSize; ++x)
+            *aBits++ = PixelAt(x, y);
+    anImage.BitsChanged();
+    anImage.SaveImageToBMP("bench_image", theFolder);
+
+    FILE* fp = fopen((theFolder + "/bench_resources.xml").c_str(), "w");
+    if (fp == NULL)
+        return false;
+    // Keep the bits after loading, purging them needs a display
+    fprintf(fp,
+            "<ResourceManifest>\n"
+            "  <Resources id=\"Bench\">\n"
+            "    <Image id=\"IMAGE_BENCH\" path=\"%s/bench_image.bmp\" nobits2d=\"false\" noalpha=\"true\"/>\n"
+            "  </Resources>\n"
+            "</ResourceManifest>\n", theFolder.c_str());
+    fclose(fp);
+    return true;
+}
+
+bool HasPixels(MemoryImage* theImage)
+{
+    uint32_t* aBits = theImage->GetBits();
+    for (int y = 0; y < kImageSize; ++y)
+        for (int x = 0; x < kImageSize; ++x)
+            if ((*aBits++ | 0xFF000000) != PixelAt(x, y))
+                return false;
+    return true;
+}
+
+void BM_ResourceImage_EvictAndReload(BenchState& state)
+{
+    const char* aTmpDir = getenv("TMPDIR");
+    std::string aFolder = aTmpDir != NULL ? aTmpDir : "/tmp";
+
+    // Don't leave decoded copies in an image cache
+    std::string anImageCache = ImageLib::gImageCacheFolder;
+    std::string aPrebuiltImageCache = ImageLib::gPrebuiltImageCacheFolder;
+    ImageLib::gImageCacheFolder = "";
+    ImageLib::gPrebuiltImageCacheFolder = "";
+
+    SexyAppBase* anApp = GetBenchApp();
+    ResourceManager* aResourceManager = new ResourceManager(anApp);
+    anApp->mResourceManager = aResourceManager;
+
+    MemoryImage* anImage = NULL;
+    if (!WriteResources(aFolder))
+        state.SkipWithError("can't write the resources to " + aFolder);
+    else if (!aResourceManager->ParseResourcesFile(aFolder + "/bench_resources.xml") || !aResourceManager->LoadResources("Bench"))
+        state.SkipWithError("can't load the resources: " + aResourceManager->GetErrorText());
+    else
+        anImage = dynamic_cast<MemoryImage*>(aResourceManager->GetImage("IMAGE_BENCH"));
+
+    if (anImage != NULL && !HasPixels(anImage))
+        state.SkipWithError("the image isn't what was written");
+
+    // Over any budget, every frame drops the bits. The texture goes too, the
+    // image then has neither.
+    aResourceManager->SetImageMemoryBudget(1, 1);
+
+    while (state.KeepRunning()) {
+        aResourceManager->UpdateImageMemory();
+        anApp->Remove3DData(anImage);
+        if (anImage->GetBitsMemSize() != 0 || anImage->HasTextureData()) {
+            state.SkipWithError("the image wasn't evicted");
+            break;
+        }
+        if (!HasPixels(anImage)) {
+            state.SkipWithError("the evicted image didn't come back");
+            break;
+        }
+    }
+    state.SetItemsProcessed(state.Iterations());
+
+    anApp->mResourceManager = NULL;
+    delete aResourceManager;
+    ImageLib::gImageCacheFolder = anImageCache;
+    ImageLib::gPrebuiltImageCacheFolder = aPrebuiltImageCache;
+    remove((aFolder + "/bench_image.bmp").c_str());
+    remove((aFolder + "/bench_resources.xml").c_str());
+}
+
+}
+
+TUXCAP_BENCH(BM_ResourceImage_EvictAndReload);
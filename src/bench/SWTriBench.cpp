@@ -0,0 +1,104 @@
+/*
+ * File:   SWTriBench.cpp
+ *
+ * The software triangle rasterizer (SWTri) through MemoryImage::BltTrianglesTex,
+ * a grid of textured quads with and without vertex colors and blending.
+ */
+
+#include "Bench.h"
+#include "Graphics.h"
+#include "MemoryImage.h"
+#include "SexyAppBase.h"
+#include "SWTri.h"
+#include "TriVertex.h"
+
+#include <vector>
+
+using namespace Sexy;
+
+namespace
+{
+
+const int       kDestWidth = 640;
+const int       kDestHeight = 480;
+const int       kTextureSize = 64;
+const int       kCellSize = 40;
+
+MemoryImage* CreateTexture()
+{
+    MemoryImage* anImage = new MemoryImage(GetBenchApp());
+    anImage->Create(kTextureSize, kTextureSize);
+    uint32_t* aBits = anImage->GetBits();
+    for (int y = 0; y < kTextureSize; ++y)
+        for (int x = 0; x < kTextureSize; ++x)
+            *aBits++ = (((x ^ y) & 8) ? 0xFF000000 : 0x80000000) | ((x * 4) << 16) | ((y * 4) << 8);
+    anImage->BitsChanged();
+    return anImage;
+}
+
+// Two triangles per cell, slightly skewed so no edge is axis aligned
+void BuildTriangles(std::vector<TriVertex>& theVertices, bool vertexColors)
+{
+    Uint32 aColors[4] = { 0xFFFF0000, 0xFF00FF00, 0xFF0000FF, 0xC0FFFFFF };
+    if (!vertexColors)
+        aColors[0] = aColors[1] = aColors[2] = aColors[3] = 0;
+
+    for (int y = 0; y + kCellSize < kDestHeight; y += kCellSize) {
+        for (int x = 0; x + kCellSize < kDestWidth; x += kCellSize) {
+            TriVertex a((float) x + 3, (float) y, 0.0f, 0.0f, aColors[0]);
+            TriVertex b((float) x + kCellSize, (float) y + 3, 1.0f, 0.0f, aColors[1]);
+            TriVertex c((float) x + kCellSize - 3, (float) y + kCellSize, 1.0f, 1.0f, aColors[2]);
+            TriVertex d((float) x, (float) y + kCellSize - 3, 0.0f, 1.0f, aColors[3]);
+            theVertices.push_back(a);
+            theVertices.push_back(b);
+            theVertices.push_back(c);
+            theVertices.push_back(a);
+            theVertices.push_back(c);
+            theVertices.push_back(d);
+        }
+    }
+}
+
+void RunTriangles(BenchState& state, bool vertexColors, bool blend)
+{
+    SWTri_AddAllDrawTriFuncs();
+
+    MemoryImage* aTexture = CreateTexture();
+    MemoryImage* aDest = new MemoryImage(GetBenchApp());
+    aDest->Create(kDestWidth, kDestHeight);
+
+    std::vector<TriVertex> aVertices;
+    BuildTriangles(aVertices, vertexColors);
+    int aNumTriangles = aVertices.size() / 3;
+    const TriVertex (*aTriangles)[3] = (const TriVertex (*)[3]) &aVertices[0];
+    Rect aClipRect(0, 0, kDestWidth, kDestHeight);
+    Color aColor(255, 255, 255);
+
+    while (state.KeepRunning())
+        aDest->BltTrianglesTex(aTexture, aTriangles, aNumTriangles, aClipRect, aColor, Graphics::DRAWMODE_NORMAL, 0.0f, 0.0f, blend);
+
+    state.SetItemsProcessed((double) state.Iterations() * aNumTriangles);
+    delete aDest;
+    delete aTexture;
+}
+
+void BM_SWTri_Textured(BenchState& state)
+{
+    RunTriangles(state, false, false);
+}
+
+void BM_SWTri_Textured_Blend(BenchState& state)
+{
+    RunTriangles(state, false, true);
+}
+
+void BM_SWTri_VertexColor_Blend(BenchState& state)
+{
+    RunTriangles(state, true, true);
+}
+
+}
+
+TUXCAP_BENCH(BM_SWTri_Textured);
+TUXCAP_BENCH(BM_SWTri_Textured_Blend);
+TUXCAP_BENCH(BM_SWTri_VertexColor_Blend);
@@ -0,0 +1,118 @@
+/*
+ * File:   SoftMixerBench.cpp
+ *
+ * SoftMixer::Mix() without an audio device: commands are queued like the
+ * game thread does, then mixed like the audio callback does. Before the
+ * timing the output is checked against the voice volumes and bus gains,
+ * and the mixer must refuse a voice once all of them are taken.
+ */
+
+#include "Bench.h"
+#include "SoftMixer.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+using namespace Sexy;
+
+namespace
+{
+
+const int       kVoices = 8;
+const int       kFrames = 1024;
+const float     kLevel = 0.25f;
+
+// Every sample is the same, so is every frame of the output
+MixerSample* MakeSample()
+{
+    MixerSample* aSample = new MixerSample();
+    aSample->mFrames = 4096;
+    aSample->mChannels = 1;
+    aSample->mRate = 44100;
+    aSample->mData = new float[aSample->mFrames];
+    for (int i = 0; i < aSample->mFrames; ++i)
+        aSample->mData[i] = kLevel;
+    return aSample;
+}
+
+// Mixes a buffer and checks both sides of every frame are theExpected
+bool MixesTo(SoftMixer& theMixer, std::vector<float>& theBuffer, float theExpected, std::string& theError)
+{
+    theMixer.Mix(&theBuffer[0], kFrames);
+    for (int i = 0; i < kFrames * 2; ++i) {
+        if (fabs(theBuffer[i] - theExpected) > 1e-4f) {
+            char aBuf[128];
+            sprintf(aBuf, "sample %d is %g instead of %g", i, theBuffer[i], theExpected);
+            theError = aBuf;
+            return false;
+        }
+    }
+    return true;
+}
+
+void BM_SoftMixer_Mix(BenchState& state)
+{
+    SoftMixer aMixer(kVoices, 44100, kFrames, false);
+    MixerSample* aSample = MakeSample();
+    std::vector<float> aBuffer(kFrames * 2);
+    std::string anError;
+
+    std::vector<int> aVoices;
+    for (int i = 0; i < kVoices; ++i)
+        aVoices.push_back(aMixer.AllocVoice());
+    if (aVoices[kVoices - 1] < 0)
+        state.SkipWithError("the mixer ran out of voices early");
+    else if (aMixer.AllocVoice() >= 0)
+        state.SkipWithError("the mixer gave out more voices than it has");
+
+    // Half of the voices play, a quarter on the sfx bus and a quarter on the UI bus
+    int aNumPlaying = kVoices / 2;
+    for (int i = 0; i < aNumPlaying; ++i)
+        aMixer.Play(aVoices[i], aSample, i % 2 == 0 ? MixerBus_Sfx : MixerBus_UI, true, 0.25f, 0.0f, 1.0f);
+
+    float aVoiceLevel = kLevel * 0.25f;
+    if (!state.HasError() && !MixesTo(aMixer, aBuffer, aVoiceLevel * aNumPlaying, anError))
+        state.SkipWithError("playing: " + anError);
+
+    // Bus volumes ramp over the first block, the next buffer is all at the new gain
+    aMixer.SetBusVolume(MixerBus_Sfx, 0.5f);
+    aMixer.Mix(&aBuffer[0], kFrames);
+    if (!state.HasError() && !MixesTo(aMixer, aBuffer, aVoiceLevel * aNumPlaying * 0.75f, anError))
+        state.SkipWithError("sfx bus at 0.5: " + anError);
+
+    aMixer.SetMasterVolume(0.5f);
+    aMixer.Mix(&aBuffer[0], kFrames);
+    if (!state.HasError() && !MixesTo(aMixer, aBuffer, aVoiceLevel * aNumPlaying * 0.375f, anError))
+        state.SkipWithError("master at 0.5: " + anError);
+    aMixer.SetMasterVolume(1.0f);
+    aMixer.SetBusVolume(MixerBus_Sfx, 1.0f);
+
+    // Stopped without a fade, a voice is out of the mix right away. The
+    // first buffer still ramps the buses back up.
+    aMixer.Stop(aVoices[0], 0);
+    if (aMixer.IsPlaying(aVoices[0]))
+        state.SkipWithError("a stopped voice is still playing");
+    aMixer.Mix(&aBuffer[0], kFrames);
+    if (!state.HasError() && !MixesTo(aMixer, aBuffer, aVoiceLevel * (aNumPlaying - 1), anError))
+        state.SkipWithError("after a stop: " + anError);
+
+    // A freed voice can be had again
+    aMixer.FreeVoice(aVoices[0]);
+    if (aMixer.AllocVoice() != aVoices[0])
+        state.SkipWithError("a freed voice didn't come back");
+    aMixer.Play(aVoices[0], aSample, MixerBus_Sfx, true, 0.25f, 0.0f, 1.0f);
+
+    while (state.KeepRunning())
+        aMixer.Mix(&aBuffer[0], kFrames);
+    state.SetItemsProcessed((double) state.Iterations() * kFrames);
+    state.SetCounter("voices", aNumPlaying);
+
+    aMixer.Forget(aSample);
+    delete aSample;
+}
+
+}
+
+TUXCAP_BENCH(BM_SoftMixer_Mix);
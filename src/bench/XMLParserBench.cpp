@@ -0,0 +1,61 @@
+/*
+ * File:   XMLParserBench.cpp
+ *
+ * XMLParser on a generated resource manifest of about 1.5 MB, the way
+ * ResourceManager::ParseResourcesFile walks it.
+ */
+
+#include "Bench.h"
+#include "XMLParser.h"
+
+#include <cstdio>
+
+using namespace Sexy;
+
+namespace
+{
+
+std::string BuildManifest()
+{
+    std::string manifest = "<?xml version=\"1.0\"?>\n<ResourceManifest>\n";
+    char line[256];
+
+    for (int group = 0; group < 200; ++group) {
+        snprintf(line, sizeof(line), "  <Resources id=\"Group%d\">\n    <SetDefaults path=\"images\" idprefix=\"IMAGE_\"/>\n", group);
+        manifest += line;
+        for (int i = 0; i < 50; ++i) {
+            snprintf(line, sizeof(line), "    <Image id=\"IMG_%d_%d\" path=\"images/thing_%d.png\" a8r8g8b8=\"true\" rows=\"%d\" cols=\"%d\"/>\n",
+                     group, i, i, 1 + i % 4, 1 + i % 7);
+            manifest += line;
+            snprintf(line, sizeof(line), "    <Sound id=\"SND_%d_%d\" path=\"sounds/s_%d.ogg\"/>\n", group, i, i);
+            manifest += line;
+            if (i % 10 == 0)
+                manifest += "    <!-- section break -->\n";
+        }
+        manifest += "  </Resources>\n";
+    }
+    manifest += "</ResourceManifest>\n";
+    return manifest;
+}
+
+void BM_XMLParser_Manifest(BenchState& state)
+{
+    std::string manifest = BuildManifest();
+    long elements = 0;
+
+    while (state.KeepRunning()) {
+        XMLParser parser;
+        parser.SetStringSource(manifest);
+
+        XMLElement element;
+        while (parser.NextElement(&element))
+            ++elements;
+    }
+
+    state.SetBytesProcessed((double) state.Iterations() * manifest.size());
+    state.SetCounter("elements", (double) elements / state.Iterations());
+}
+
+}
+
+TUXCAP_BENCH(BM_XMLParser_Manifest);
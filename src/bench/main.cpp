@@ -0,0 +1,13 @@
+/*
+ * File:   main.cpp
+ *
+ * tuxcap_bench, micro-benchmarks for the framework hot paths.
+ * Everything runs headless, no window or audio device is opened.
+ */
+
+#include "Bench.h"
+
+int main(int argc, char** argv)
+{
+    return Sexy::RunBenchmarks(argc, argv);
+}
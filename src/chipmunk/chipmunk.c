@@ -31,10 +31,32 @@ extern "C" {
 }
 #endif
 
+void *(*cpmalloc)(size_t size) = malloc;
+void *(*cpcalloc)(size_t count, size_t size) = calloc;
+void *(*cprealloc)(void *ptr, size_t size) = realloc;
+void (*cpfree)(void *ptr) = free;
+
+static int cpInitialized = 0;
+
+int
+cpSetAllocator(void *(*mallocFunc)(size_t), void *(*callocFunc)(size_t, size_t),
+               void *(*reallocFunc)(void *, size_t), void (*freeFunc)(void *))
+{
+	// Memory already allocated would be freed by the wrong allocator.
+	if(cpInitialized)
+		return 0;
+	
+	cpmalloc = mallocFunc;
+	cpcalloc = callocFunc;
+	cprealloc = reallocFunc;
+	cpfree = freeFunc;
+	return 1;
+}
 
 void
 cpInitChipmunk(void)
 {
+	cpInitialized = 1;
 	cpInitCollisionFuncs();
 }
 
@@ -47,7 +69,7 @@ cpMomentForCircle(cpFloat m, cpFloat r1, cpFloat r2, cpVect offset)
 cpFloat
 cpMomentForPoly(cpFloat m, const int numVerts, cpVect *verts, cpVect offset)
 {
-	cpVect *tVerts = (cpVect *)calloc(numVerts, sizeof(cpVect));
+	cpVect *tVerts = (cpVect *)cpcalloc(numVerts, sizeof(cpVect));
 	for(int i=0; i<numVerts; i++)
 		tVerts[i] = cpvadd(verts[i], offset);
 	
@@ -64,6 +86,6 @@ cpMomentForPoly(cpFloat m, const int numVerts, cpVect *verts, cpVect offset)
 		sum2 += a;
 	}
 	
-	free(tVerts);
+	cpfree(tVerts);
 	return (m*sum1)/(6.0f*sum2);
 }
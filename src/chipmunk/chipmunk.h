@@ -52,13 +52,27 @@ cpfmin(cpFloat a, cpFloat b)
 #endif
 
 #include <inttypes.h>
+#include <stdlib.h>
+
+// Everything chipmunk allocates goes through these, they default to the C
+// library. cpSetAllocator() replaces them, e.g. to account for the memory,
+// and only works before the first cpInitChipmunk().
+extern void *(*cpmalloc)(size_t size);
+extern void *(*cpcalloc)(size_t count, size_t size);
+extern void *(*cprealloc)(void *ptr, size_t size);
+extern void (*cpfree)(void *ptr);
+
+int cpSetAllocator(void *(*mallocFunc)(size_t), void *(*callocFunc)(size_t, size_t),
+                   void *(*reallocFunc)(void *, size_t), void (*freeFunc)(void *));
 
 #include "cpVect.h"
 #include "cpBB.h"
 #include "cpBody.h"
 #include "cpArray.h"
 #include "cpHashSet.h"
+#include "cpSpatialIndex.h"
 #include "cpSpaceHash.h"
+#include "cpBBTree.h"
 
 #include "cpShape.h"
 #include "cpPolyShape.h"
@@ -68,8 +82,12 @@ cpfmin(cpFloat a, cpFloat b)
 	
 #include "cpJoint.h"
 
+#include "cpWorkerPool.h"
 #include "cpSpace.h"
 
+// Size of the blocks that pooled objects (bins, handles, arbiters, contacts) are allocated in.
+#define CP_BUFFER_BYTES (32*1024)
+
 #define CP_HASH_COEF (3344921057ul)
 #define CP_HASH_PAIR(A, B) ((uintptr_t)(A)*CP_HASH_COEF ^ (uintptr_t)(B)*CP_HASH_COEF)
 
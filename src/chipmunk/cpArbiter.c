@@ -75,7 +75,7 @@ cpContactsSumImpulsesWithFriction(cpContact *contacts, int numContacts)
 cpArbiter*
 cpArbiterAlloc(void)
 {
-	return (cpArbiter *)calloc(1, sizeof(cpArbiter));
+	return (cpArbiter *)cpcalloc(1, sizeof(cpArbiter));
 }
 
 cpArbiter*
@@ -88,6 +88,7 @@ cpArbiterInit(cpArbiter *arb, cpShape *a, cpShape *b, int stamp)
 	arb->b = b;
 	
 	arb->stamp = stamp;
+	arb->firstColl = 1;
 		
 	return arb;
 }
@@ -101,14 +102,14 @@ cpArbiterNew(cpShape *a, cpShape *b, int stamp)
 void
 cpArbiterDestroy(cpArbiter *arb)
 {
-	free(arb->contacts);
+	// The contacts are owned by the space's contact buffers.
 }
 
 void
 cpArbiterFree(cpArbiter *arb)
 {
 	if(arb) cpArbiterDestroy(arb);
-	free(arb);
+	cpfree(arb);
 }
 
 void
@@ -130,8 +131,6 @@ cpArbiterInject(cpArbiter *arb, cpContact *contacts, int numContacts)
 		}
 	}
 
-	free(arb->contacts);
-	
 	arb->contacts = contacts;
 	arb->numContacts = numContacts;
 }
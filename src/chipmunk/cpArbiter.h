@@ -65,6 +65,8 @@ typedef struct cpArbiter{
 	
 	// Time stamp of the arbiter. (from cpSpace)
 	int stamp;
+	// True if the shapes weren't colliding in the step before.
+	int firstColl;
 } cpArbiter;
 
 // Basic allocation/destruction functions.
@@ -77,6 +79,8 @@ void cpArbiterFree(cpArbiter *arb);
 
 // These functions are all intended to be used internally.
 // Inject new contact points into the arbiter while preserving contact history.
+// The arbiter doesn't take ownership of the contacts, they are kept in the
+// space's contact buffers for as long as the arbiter can persist.
 void cpArbiterInject(cpArbiter *arb, cpContact *contacts, int numContacts);
 // Precalculate values used by the solver.
 void cpArbiterPreStep(cpArbiter *arb, cpFloat dt_inv);
@@ -32,7 +32,7 @@
 cpArray*
 cpArrayAlloc(void)
 {
-	return (cpArray *)calloc(1, sizeof(cpArray));
+	return (cpArray *)cpcalloc(1, sizeof(cpArray));
 }
 
 cpArray*
@@ -42,7 +42,7 @@ cpArrayInit(cpArray *arr, int size)
 	
 	size = (size ? size : CP_ARRAY_INCREMENT);
 	arr->max = size;
-	arr->arr = (void **)malloc(size*sizeof(void**));
+	arr->arr = (void **)cpmalloc(size*sizeof(void**));
 	
 	return arr;
 }
@@ -56,7 +56,7 @@ cpArrayNew(int size)
 void
 cpArrayDestroy(cpArray *arr)
 {
-	free(arr->arr);
+	cpfree(arr->arr);
 }
 
 void
@@ -64,21 +64,29 @@ cpArrayFree(cpArray *arr)
 {
 	if(!arr) return;
 	cpArrayDestroy(arr);
-	free(arr);
+	cpfree(arr);
 }
 
 void
 cpArrayPush(cpArray *arr, void *object)
 {
 	if(arr->num == arr->max){
-		arr->max += CP_ARRAY_INCREMENT;
-		arr->arr = (void **)realloc(arr->arr, arr->max*sizeof(void**));
+		// Grow geometrically, the pools push thousands of objects at once.
+		arr->max *= 2;
+		arr->arr = (void **)cprealloc(arr->arr, arr->max*sizeof(void**));
 	}
 	
 	arr->arr[arr->num] = object;
 	arr->num++;
 }
 
+void *
+cpArrayPop(cpArray *arr)
+{
+	arr->num--;
+	return arr->arr[arr->num];
+}
+
 void
 cpArrayDeleteIndex(cpArray *arr, int index)
 {
@@ -0,0 +1,541 @@
+/* Copyright (c) 2007 Scott Lembcke
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+ 
+#include <stdlib.h>
+#include <assert.h>
+
+#include "chipmunk.h"
+
+#define DEFAULT_MARGIN 0.1f
+#define DEFAULT_VELOCITY_COEF 0.1f
+
+static void freeWrap(void *ptr, void *unused){cpfree(ptr);}
+
+static inline cpBB
+bbMerge(cpBB a, cpBB b)
+{
+	return cpBBNew(cpfmin(a.l, b.l), cpfmin(a.b, b.b), cpfmax(a.r, b.r), cpfmax(a.t, b.t));
+}
+
+// Half the perimeter. Used as the cost of a node when choosing where to insert.
+static inline cpFloat
+bbCost(cpBB bb)
+{
+	return (bb.r - bb.l) + (bb.t - bb.b);
+}
+
+static inline int
+isLeaf(cpBBTreeNode *node)
+{
+	return (node->a == NULL);
+}
+
+static inline cpBB
+fatten(cpBBTree *tree, void *obj, cpBB bb)
+{
+	cpFloat m = tree->margin*cpfmax(bb.r - bb.l, bb.t - bb.b);
+	cpBB fat = cpBBNew(bb.l - m, bb.b - m, bb.r + m, bb.t + m);
+	
+	if(tree->velocityFunc){
+		cpVect d = cpvmult(tree->velocityFunc(obj), tree->velocityCoef);
+		if(d.x < 0.0f) fat.l += d.x; else fat.r += d.x;
+		if(d.y < 0.0f) fat.b += d.y; else fat.t += d.y;
+	}
+	
+	return fat;
+}
+
+// Get a recycled node, or allocate a new block of them.
+static cpBBTreeNode *
+nodeAlloc(cpBBTree *tree)
+{
+	cpBBTreeNode *node = tree->pooledNodes;
+	
+	if(node){
+		tree->pooledNodes = node->parent;
+	} else {
+		int count = CP_BUFFER_BYTES/sizeof(cpBBTreeNode);
+		cpBBTreeNode *buffer = (cpBBTreeNode *)cpmalloc(count*sizeof(cpBBTreeNode));
+		cpArrayPush(tree->allocatedBuffers, buffer);
+		tree->allocations++;
+		
+		// Keep the first node, recycle the rest.
+		for(int i=1; i<count; i++){
+			buffer[i].parent = tree->pooledNodes;
+			tree->pooledNodes = buffer + i;
+		}
+		
+		node = buffer;
+	}
+	
+	node->parent = node->a = node->b = NULL;
+	node->obj = NULL;
+	node->index = -1;
+	node->height = 0;
+	
+	return node;
+}
+
+static inline void
+nodeRecycle(cpBBTree *tree, cpBBTreeNode *node)
+{
+	node->parent = tree->pooledNodes;
+	tree->pooledNodes = node;
+}
+
+// Equality function for the leafSet.
+static int
+leafSetEql(void *obj, void *elt)
+{
+	return (obj == ((cpBBTreeNode *)elt)->obj);
+}
+
+// Transformation function for the leafSet.
+static void *
+leafSetTrans(void *obj, void *data)
+{
+	cpBBTreeNode *leaf = nodeAlloc((cpBBTree *)data);
+	leaf->obj = obj;
+	
+	return leaf;
+}
+
+static const cpSpatialIndexClass bbTreeClass;
+
+cpBBTree *
+cpBBTreeAlloc(void)
+{
+	return (cpBBTree *)cpcalloc(1, sizeof(cpBBTree));
+}
+
+cpBBTree *
+cpBBTreeInit(cpBBTree *tree, cpSpatialIndexBBFunc bbfunc)
+{
+	tree->index.klass = &bbTreeClass;
+	tree->bbfunc = bbfunc;
+	tree->velocityFunc = NULL;
+	
+	tree->root = NULL;
+	tree->leafSet = cpHashSetNew(0, &leafSetEql, &leafSetTrans);
+	tree->leafList = cpArrayNew(0);
+	
+	tree->margin = DEFAULT_MARGIN;
+	tree->velocityCoef = DEFAULT_VELOCITY_COEF;
+	
+	tree->pooledNodes = NULL;
+	tree->allocatedBuffers = cpArrayNew(0);
+	tree->allocations = 0;
+	
+	return tree;
+}
+
+cpBBTree *
+cpBBTreeNew(cpSpatialIndexBBFunc bbfunc)
+{
+	return cpBBTreeInit(cpBBTreeAlloc(), bbfunc);
+}
+
+void
+cpBBTreeDestroy(cpBBTree *tree)
+{
+	cpHashSetFree(tree->leafSet);
+	cpArrayFree(tree->leafList);
+	
+	cpArrayEach(tree->allocatedBuffers, &freeWrap, NULL);
+	cpArrayFree(tree->allocatedBuffers);
+}
+
+void
+cpBBTreeFree(cpBBTree *tree)
+{
+	if(!tree) return;
+	cpBBTreeDestroy(tree);
+	cpfree(tree);
+}
+
+void
+cpBBTreeSetVelocityFunc(cpBBTree *tree, cpBBTreeVelocityFunc func)
+{
+	tree->velocityFunc = func;
+}
+
+// Replace the link from node's parent (or the root) to node with other.
+static inline void
+replaceChild(cpBBTree *tree, cpBBTreeNode *node, cpBBTreeNode *other)
+{
+	cpBBTreeNode *parent = node->parent;
+	other->parent = parent;
+	
+	if(!parent){
+		tree->root = other;
+	} else if(parent->a == node){
+		parent->a = other;
+	} else {
+		parent->b = other;
+	}
+}
+
+static inline void
+refitNode(cpBBTreeNode *node)
+{
+	node->bb = bbMerge(node->a->bb, node->b->bb);
+	node->height = 1 + (node->a->height > node->b->height ? node->a->height : node->b->height);
+}
+
+// Rotate node's taller grandchild up if its children are unbalanced.
+// Returns the root of the subtree.
+static cpBBTreeNode *
+balance(cpBBTree *tree, cpBBTreeNode *node)
+{
+	if(isLeaf(node) || node->height < 2) return node;
+	
+	cpBBTreeNode *a = node->a;
+	cpBBTreeNode *b = node->b;
+	int diff = b->height - a->height;
+	
+	if(diff > 1){
+		// Rotate b up.
+		cpBBTreeNode *f = b->a;
+		cpBBTreeNode *g = b->b;
+		
+		replaceChild(tree, node, b);
+		b->a = node;
+		node->parent = b;
+		
+		// Keep the taller of b's children with b.
+		if(f->height > g->height){
+			b->b = f;
+			node->b = g;
+			g->parent = node;
+		} else {
+			b->b = g;
+			node->b = f;
+			f->parent = node;
+		}
+		
+		refitNode(node);
+		refitNode(b);
+		return b;
+	} else if(diff < -1){
+		// Rotate a up.
+		cpBBTreeNode *d = a->a;
+		cpBBTreeNode *e = a->b;
+		
+		replaceChild(tree, node, a);
+		a->a = node;
+		node->parent = a;
+		
+		if(d->height > e->height){
+			a->b = d;
+			node->a = e;
+			e->parent = node;
+		} else {
+			a->b = e;
+			node->a = d;
+			d->parent = node;
+		}
+		
+		refitNode(node);
+		refitNode(a);
+		return a;
+	}
+	
+	return node;
+}
+
+// Refit and rebalance the ancestors of a changed node.
+static void
+fixUpwards(cpBBTree *tree, cpBBTreeNode *node)
+{
+	while(node){
+		refitNode(node);
+		node = balance(tree, node);
+		node = node->parent;
+	}
+}
+
+static void
+insertLeaf(cpBBTree *tree, cpBBTreeNode *leaf)
+{
+	if(!tree->root){
+		leaf->parent = NULL;
+		tree->root = leaf;
+		return;
+	}
+	
+	// Walk down to the cheapest sibling for the leaf.
+	cpBB bb = leaf->bb;
+	cpBBTreeNode *node = tree->root;
+	while(!isLeaf(node)){
+		cpFloat cost = bbCost(node->bb);
+		cpFloat mergedCost = bbCost(bbMerge(node->bb, bb));
+		
+		// Cost of making a new parent for this node and the leaf.
+		cpFloat siblingCost = 2.0f*mergedCost;
+		// Minimum cost of pushing the leaf further down.
+		cpFloat inheritedCost = 2.0f*(mergedCost - cost);
+		
+		cpBBTreeNode *a = node->a;
+		cpBBTreeNode *b = node->b;
+		cpFloat costA = bbCost(bbMerge(a->bb, bb)) - (isLeaf(a) ? 0.0f : bbCost(a->bb)) + inheritedCost;
+		cpFloat costB = bbCost(bbMerge(b->bb, bb)) - (isLeaf(b) ? 0.0f : bbCost(b->bb)) + inheritedCost;
+		
+		if(siblingCost < costA && siblingCost < costB) break;
+		node = (costA < costB ? a : b);
+	}
+	
+	// Make a new parent for the sibling and the leaf.
+	cpBBTreeNode *parent = nodeAlloc(tree);
+	replaceChild(tree, node, parent);
+	parent->a = node;
+	parent->b = leaf;
+	node->parent = parent;
+	leaf->parent = parent;
+	
+	fixUpwards(tree, parent);
+}
+
+static void
+removeLeaf(cpBBTree *tree, cpBBTreeNode *leaf)
+{
+	cpBBTreeNode *parent = leaf->parent;
+	
+	if(!parent){
+		tree->root = NULL;
+		return;
+	}
+	
+	// Replace the parent with the leaf's sibling.
+	cpBBTreeNode *sibling = (parent->a == leaf ? parent->b : parent->a);
+	replaceChild(tree, parent, sibling);
+	nodeRecycle(tree, parent);
+	leaf->parent = NULL;
+	
+	fixUpwards(tree, sibling->parent);
+}
+
+void
+cpBBTreeInsert(cpBBTree *tree, void *obj, unsigned int id, cpBB bb)
+{
+	// Don't add an object twice.
+	if(cpHashSetFind(tree->leafSet, id, obj)) return;
+	
+	cpBBTreeNode *leaf = (cpBBTreeNode *)cpHashSetInsert(tree->leafSet, id, obj, tree);
+	leaf->bb = fatten(tree, leaf->obj, bb);
+	insertLeaf(tree, leaf);
+	
+	leaf->index = tree->leafList->num;
+	cpArrayPush(tree->leafList, leaf);
+}
+
+void
+cpBBTreeRemove(cpBBTree *tree, void *obj, unsigned int id)
+{
+	cpBBTreeNode *leaf = (cpBBTreeNode *)cpHashSetRemove(tree->leafSet, id, obj);
+	if(!leaf) return;
+	
+	removeLeaf(tree, leaf);
+	
+	// Move the last leaf into the hole in the list.
+	cpArray *list = tree->leafList;
+	cpBBTreeNode *last = (cpBBTreeNode *)cpArrayPop(list);
+	if(last != leaf){
+		last->index = leaf->index;
+		list->arr[leaf->index] = last;
+	}
+	
+	nodeRecycle(tree, leaf);
+}
+
+void
+cpBBTreeEach(cpBBTree *tree, cpSpatialIndexIterator func, void *data)
+{
+	cpArray *list = tree->leafList;
+	for(int i=0; i<list->num; i++)
+		func(((cpBBTreeNode *)list->arr[i])->obj, data);
+}
+
+// Reinsert a leaf if its object moved out of the fat box.
+static inline void
+updateLeaf(cpBBTree *tree, cpBBTreeNode *leaf)
+{
+	cpBB bb = tree->bbfunc(leaf->obj);
+	if(cpBBcontainsBB(leaf->bb, bb)) return;
+	
+	removeLeaf(tree, leaf);
+	leaf->bb = fatten(tree, leaf->obj, bb);
+	insertLeaf(tree, leaf);
+}
+
+void
+cpBBTreeRehash(cpBBTree *tree)
+{
+	cpArray *list = tree->leafList;
+	for(int i=0; i<list->num; i++)
+		updateLeaf(tree, (cpBBTreeNode *)list->arr[i]);
+}
+
+void
+cpBBTreeRehashObject(cpBBTree *tree, void *obj, unsigned int id)
+{
+	cpBBTreeNode *leaf = (cpBBTreeNode *)cpHashSetFind(tree->leafSet, id, obj);
+	if(leaf) updateLeaf(tree, leaf);
+}
+
+static void
+subtreeQuery(cpBBTreeNode *node, void *obj, cpBB bb, cpSpatialIndexQueryFunc func, void *data)
+{
+	if(!cpBBintersects(node->bb, bb)) return;
+	
+	if(isLeaf(node)){
+		if(node->obj != obj) func(obj, node->obj, data);
+	} else {
+		subtreeQuery(node->a, obj, bb, func, data);
+		subtreeQuery(node->b, obj, bb, func, data);
+	}
+}
+
+void
+cpBBTreeQuery(cpBBTree *tree, void *obj, cpBB bb, cpSpatialIndexQueryFunc func, void *data)
+{
+	if(tree->root) subtreeQuery(tree->root, obj, bb, func, data);
+}
+
+// Report the pairs of overlapping leaves between two subtrees.
+static void
+crossQuery(cpBBTreeNode *a, cpBBTreeNode *b, cpSpatialIndexQueryFunc func, void *data)
+{
+	if(!cpBBintersects(a->bb, b->bb)) return;
+	
+	if(isLeaf(a)){
+		if(isLeaf(b)){
+			func(a->obj, b->obj, data);
+		} else {
+			crossQuery(a, b->a, func, data);
+			crossQuery(a, b->b, func, data);
+		}
+	} else if(isLeaf(b) || a->height > b->height){
+		// Descend into the taller subtree first.
+		crossQuery(a->a, b, func, data);
+		crossQuery(a->b, b, func, data);
+	} else {
+		crossQuery(a, b->a, func, data);
+		crossQuery(a, b->b, func, data);
+	}
+}
+
+// Report the pairs of overlapping leaves within a subtree.
+static void
+selfQuery(cpBBTreeNode *node, cpSpatialIndexQueryFunc func, void *data)
+{
+	if(isLeaf(node)) return;
+	
+	selfQuery(node->a, func, data);
+	selfQuery(node->b, func, data);
+	crossQuery(node->a, node->b, func, data);
+}
+
+void
+cpBBTreeQueryRehash(cpBBTree *tree, cpSpatialIndexQueryFunc func, void *data)
+{
+	cpBBTreeRehash(tree);
+	
+	// Every pair of leaves has exactly one lowest common ancestor,
+	// so the self query finds every overlapping pair exactly once.
+	if(tree->root) selfQuery(tree->root, func, data);
+}
+
+// cpSpatialIndex interface.
+
+static void
+indexDestroy(cpSpatialIndex *index)
+{
+	cpBBTreeDestroy((cpBBTree *)index);
+}
+
+static void
+indexInsert(cpSpatialIndex *index, void *obj, unsigned int id, cpBB bb)
+{
+	cpBBTreeInsert((cpBBTree *)index, obj, id, bb);
+}
+
+static void
+indexRemove(cpSpatialIndex *index, void *obj, unsigned int id)
+{
+	cpBBTreeRemove((cpBBTree *)index, obj, id);
+}
+
+static void
+indexEach(cpSpatialIndex *index, cpSpatialIndexIterator func, void *data)
+{
+	cpBBTreeEach((cpBBTree *)index, func, data);
+}
+
+static void
+indexRehash(cpSpatialIndex *index)
+{
+	cpBBTreeRehash((cpBBTree *)index);
+}
+
+static void
+indexRehashObject(cpSpatialIndex *index, void *obj, unsigned int id)
+{
+	cpBBTreeRehashObject((cpBBTree *)index, obj, id);
+}
+
+static void
+indexQuery(cpSpatialIndex *index, void *obj, cpBB bb, cpSpatialIndexQueryFunc func, void *data)
+{
+	cpBBTreeQuery((cpBBTree *)index, obj, bb, func, data);
+}
+
+static void
+indexQueryRehash(cpSpatialIndex *index, cpSpatialIndexQueryFunc func, void *data)
+{
+	cpBBTreeQueryRehash((cpBBTree *)index, func, data);
+}
+
+static void
+indexResize(cpSpatialIndex *index, cpFloat celldim, int numcells)
+{
+	// The tree has no cells to resize.
+}
+
+static int
+indexAllocations(cpSpatialIndex *index)
+{
+	cpBBTree *tree = (cpBBTree *)index;
+	return tree->allocations + tree->leafSet->allocations;
+}
+
+static const cpSpatialIndexClass bbTreeClass = {
+	CP_BB_TREE,
+	indexDestroy,
+	indexInsert,
+	indexRemove,
+	indexEach,
+	indexRehash,
+	indexRehashObject,
+	indexQuery,
+	indexQueryRehash,
+	indexResize,
+	indexAllocations,
+};
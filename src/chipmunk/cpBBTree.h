@@ -0,0 +1,98 @@
+/* Copyright (c) 2007 Scott Lembcke
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+ 
+// cpBBTree is a dynamic AABB tree broadphase. (see cpSpatialIndex.h)
+// Leaves store a "fat" bounding box that is a bit larger than the object, so
+// an object only needs to be reinserted once it moves out of it. The tree is
+// kept balanced with rotations. Unlike cpSpaceHash there is no cell size to tune,
+// so it copes well with objects of very different sizes.
+
+typedef struct cpBBTreeNode {
+	// Fat bounding box for leaves, union of the children for internal nodes.
+	cpBB bb;
+	
+	struct cpBBTreeNode *parent;
+	// Children of internal nodes, NULL for leaves.
+	struct cpBBTreeNode *a, *b;
+	
+	// The object of a leaf.
+	void *obj;
+	// Position of a leaf in cpBBTree.leafList.
+	int index;
+	// Height of the subtree, 0 for leaves.
+	int height;
+} cpBBTreeNode;
+
+// Velocity callback. Optional, used to stretch the leaf boxes in the direction objects move.
+typedef cpVect (*cpBBTreeVelocityFunc)(void *obj);
+
+typedef struct cpBBTree {
+	// Spatial index interface, see cpSpatialIndex.h.
+	cpSpatialIndex index;
+	
+	// BBox and velocity callbacks.
+	cpSpatialIndexBBFunc bbfunc;
+	cpBBTreeVelocityFunc velocityFunc;
+	
+	cpBBTreeNode *root;
+	// Leaves by object and leaves in iteration order.
+	cpHashSet *leafSet;
+	cpArray *leafList;
+	
+	// Leaf boxes are enlarged by this fraction of the object's size, and
+	// stretched by the distance the object moves in velocityCoef seconds.
+	cpFloat margin;
+	cpFloat velocityCoef;
+	
+	// Recycled nodes and the blocks of memory they were allocated in.
+	cpBBTreeNode *pooledNodes;
+	cpArray *allocatedBuffers;
+	// Number of heap allocations made by the tree for its nodes.
+	int allocations;
+} cpBBTree;
+
+// Basic allocation/destruction functions.
+cpBBTree *cpBBTreeAlloc(void);
+cpBBTree *cpBBTreeInit(cpBBTree *tree, cpSpatialIndexBBFunc bbfunc);
+cpBBTree *cpBBTreeNew(cpSpatialIndexBBFunc bbfunc);
+
+void cpBBTreeDestroy(cpBBTree *tree);
+void cpBBTreeFree(cpBBTree *tree);
+
+void cpBBTreeSetVelocityFunc(cpBBTree *tree, cpBBTreeVelocityFunc func);
+
+// Add an object to the tree.
+void cpBBTreeInsert(cpBBTree *tree, void *obj, unsigned int id, cpBB bb);
+// Remove an object from the tree.
+void cpBBTreeRemove(cpBBTree *tree, void *obj, unsigned int id);
+
+// Iterate over the objects in the tree.
+void cpBBTreeEach(cpBBTree *tree, cpSpatialIndexIterator func, void *data);
+
+// Reinsert the objects that moved out of their leaf boxes.
+void cpBBTreeRehash(cpBBTree *tree);
+// Reinsert a specific object if it moved out of its leaf box.
+void cpBBTreeRehashObject(cpBBTree *tree, void *obj, unsigned int id);
+
+// Query the tree for a given BBox.
+void cpBBTreeQuery(cpBBTree *tree, void *obj, cpBB bb, cpSpatialIndexQueryFunc func, void *data);
+// Rehash, then call func once for every pair of objects with overlapping boxes.
+void cpBBTreeQueryRehash(cpBBTree *tree, cpSpatialIndexQueryFunc func, void *data);
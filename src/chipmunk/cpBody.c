@@ -28,7 +28,7 @@
 cpBody*
 cpBodyAlloc(void)
 {
-	return (cpBody *)malloc(sizeof(cpBody));
+	return (cpBody *)cpmalloc(sizeof(cpBody));
 }
 
 cpBody*
@@ -48,6 +48,9 @@ cpBodyInit(cpBody *body, cpFloat m, cpFloat i)
 	body->v_bias = cpvzero;
 	body->w_bias = 0.0f;
 	
+	body->data = NULL;
+	body->color_mask = 0;
+	
 //	body->active = 1;
 
 	return body;
@@ -65,7 +68,7 @@ void
 cpBodyFree(cpBody *body)
 {
 	if(body) cpBodyDestroy(body);
-	free(body);
+	cpfree(body);
 }
 
 void
@@ -33,6 +33,12 @@ typedef struct cpBody{
 	// Unit length 
 	cpVect rot; 
 	
+	// User defined data pointer for the body.
+	void *data;
+	
+	// Used internally by the threaded solver to color the constraints.
+	unsigned int color_mask;
+	
 //	int active;
 } cpBody;
 
@@ -70,10 +76,19 @@ cpBodyWorld2Local(cpBody *body, cpVect v)
 	return cpvunrotate(cpvsub(v, body->p), body->rot);
 }
 
+// Infinite mass and moment, impulses can't move the body.
+static inline int
+cpBodyIsStatic(cpBody *body)
+{
+	return (body->m_inv == 0.0f && body->i_inv == 0.0f);
+}
+
 // Apply an impulse (in world coordinates) to the body.
+// Static bodies are left alone, constraints solved in parallel may share one.
 static inline void
 cpBodyApplyImpulse(cpBody *body, cpVect j, cpVect r)
 {
+	if(cpBodyIsStatic(body)) return;
 	body->v = cpvadd(body->v, cpvmult(j, body->m_inv));
 	body->w += body->i_inv*cpvcross(r, j);
 }
@@ -82,6 +97,7 @@ cpBodyApplyImpulse(cpBody *body, cpVect j, cpVect r)
 static inline void
 cpBodyApplyBiasImpulse(cpBody *body, cpVect j, cpVect r)
 {
+	if(cpBodyIsStatic(body)) return;
 	body->v_bias = cpvadd(body->v_bias, cpvmult(j, body->m_inv));
 	body->w_bias += body->i_inv*cpvcross(r, j);
 }
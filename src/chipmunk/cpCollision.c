@@ -26,14 +26,14 @@
 
 #include "chipmunk.h"
 
-typedef int (*collisionFunc)(cpShape*, cpShape*, cpContact**);
+typedef int (*collisionFunc)(cpShape*, cpShape*, cpContact*);
 
 static collisionFunc *colfuncs = NULL;
 
 // Add contact points for circle to circle collisions.
 // Used by several collision tests.
 static int
-circle2circleQuery(cpVect p1, cpVect p2, cpFloat r1, cpFloat r2, cpContact **con)
+circle2circleQuery(cpVect p1, cpVect p2, cpFloat r1, cpFloat r2, cpContact *con)
 {
 	cpFloat mindist = r1 + r2;
 	cpVect delta = cpvsub(p2, p1);
@@ -44,10 +44,9 @@ circle2circleQuery(cpVect p1, cpVect p2, cpFloat r1, cpFloat r2, cpContact **con
 	// To avoid singularities, do nothing in the case of dist = 0.
 	cpFloat non_zero_dist = (dist ? dist : INFINITY);
 
-	// Allocate and initialize the contact.
-	(*con) = (cpContact *)malloc(sizeof(cpContact));
+	// Initialize the contact.
 	cpContactInit(
-		(*con),
+		con,
 		cpvadd(p1, cpvmult(delta, 0.5 + (r1 - 0.5*mindist)/non_zero_dist)),
 		cpvmult(delta, 1.0/non_zero_dist),
 		dist - mindist,
@@ -59,7 +58,7 @@ circle2circleQuery(cpVect p1, cpVect p2, cpFloat r1, cpFloat r2, cpContact **con
 
 // Collide circle shapes.
 static int
-circle2circle(cpShape *shape1, cpShape *shape2, cpContact **arr)
+circle2circle(cpShape *shape1, cpShape *shape2, cpContact *arr)
 {
 	cpCircleShape *circ1 = (cpCircleShape *)shape1;
 	cpCircleShape *circ2 = (cpCircleShape *)shape2;
@@ -69,7 +68,7 @@ circle2circle(cpShape *shape1, cpShape *shape2, cpContact **arr)
 
 // Collide circles to segment shapes.
 static int
-circle2segment(cpShape *circleShape, cpShape *segmentShape, cpContact **con)
+circle2segment(cpShape *circleShape, cpShape *segmentShape, cpContact *con)
 {
 	cpCircleShape *circ = (cpCircleShape *)circleShape;
 	cpSegmentShape *seg = (cpSegmentShape *)segmentShape;
@@ -94,9 +93,8 @@ circle2segment(cpShape *circleShape, cpShape *segmentShape, cpContact **con)
 	} else {
 		if(dt < dtMax){
 			cpVect n = (dn < 0.0f) ? seg->tn : cpvneg(seg->tn);
-			(*con) = (cpContact *)malloc(sizeof(cpContact));
 			cpContactInit(
-				(*con),
+				con,
 				cpvadd(circ->tc, cpvmult(n, circ->r + dist*0.5f)),
 				n,
 				dist,
@@ -115,22 +113,12 @@ circle2segment(cpShape *circleShape, cpShape *segmentShape, cpContact **con)
 	return 1;
 }
 
-// Helper function for allocating contact point lists.
-static cpContact *
-addContactPoint(cpContact **arr, int *max, int *num)
+// Helper function for adding points to a contact list.
+// The caller makes sure there is room, see cpCollideShapesMaxContacts().
+static inline cpContact *
+addContactPoint(cpContact *arr, int *num)
 {
-	if(*arr == NULL){
-		// Allocate the array if it hasn't been done.
-		(*max) = 2;
-		(*num) = 0;
-		(*arr) = (cpContact *)malloc((*max)*sizeof(cpContact));
-	} else if(*num == *max){
-		// Extend it if necessary.
-		(*max) *= 2;
-		(*arr) = (cpContact *)realloc(*arr, (*max)*sizeof(cpContact));
-	}
-	
-	cpContact *con = &(*arr)[*num];
+	cpContact *con = &arr[*num];
 	(*num)++;
 	
 	return con;
@@ -160,21 +148,20 @@ findMSA(cpPolyShape *poly, cpPolyShapeAxis *axes, int num, cpFloat *min_out)
 
 // Add contacts for penetrating vertexes.
 static inline int
-findVerts(cpContact **arr, cpPolyShape *poly1, cpPolyShape *poly2, cpVect n, cpFloat dist)
+findVerts(cpContact *arr, cpPolyShape *poly1, cpPolyShape *poly2, cpVect n, cpFloat dist)
 {
-	int max = 0;
 	int num = 0;
 	
 	for(int i=0; i<poly1->numVerts; i++){
 		cpVect v = poly1->tVerts[i];
 		if(cpPolyShapeContainsVert(poly2, v))
-			cpContactInit(addContactPoint(arr, &max, &num), v, n, dist, CP_HASH_PAIR(poly1, i));
+			cpContactInit(addContactPoint(arr, &num), v, n, dist, CP_HASH_PAIR(poly1, i));
 	}
 	
 	for(int i=0; i<poly2->numVerts; i++){
 		cpVect v = poly2->tVerts[i];
 		if(cpPolyShapeContainsVert(poly1, v))
-			cpContactInit(addContactPoint(arr, &max, &num), v, n, dist, CP_HASH_PAIR(poly2, i));
+			cpContactInit(addContactPoint(arr, &num), v, n, dist, CP_HASH_PAIR(poly2, i));
 	}
 	
 	//	if(!num)
@@ -185,7 +172,7 @@ findVerts(cpContact **arr, cpPolyShape *poly1, cpPolyShape *poly2, cpVect n, cpF
 
 // Collide poly shapes together.
 static int
-poly2poly(cpShape *shape1, cpShape *shape2, cpContact **arr)
+poly2poly(cpShape *shape1, cpShape *shape2, cpContact *arr)
 {
 	cpPolyShape *poly1 = (cpPolyShape *)shape1;
 	cpPolyShape *poly2 = (cpPolyShape *)shape2;
@@ -216,7 +203,7 @@ segValueOnAxis(cpSegmentShape *seg, cpVect n, cpFloat d)
 
 // Identify vertexes that have penetrated the segment.
 static inline void
-findPointsBehindSeg(cpContact **arr, int *max, int *num, cpSegmentShape *seg, cpPolyShape *poly, cpFloat pDist, cpFloat coef) 
+findPointsBehindSeg(cpContact *arr, int *num, cpSegmentShape *seg, cpPolyShape *poly, cpFloat pDist, cpFloat coef) 
 {
 	cpFloat dta = cpvcross(seg->tn, seg->ta);
 	cpFloat dtb = cpvcross(seg->tn, seg->tb);
@@ -227,7 +214,7 @@ findPointsBehindSeg(cpContact **arr, int *max, int *num, cpSegmentShape *seg, cp
 		if(cpvdot(v, n) < cpvdot(seg->tn, seg->ta)*coef + seg->r){
 			cpFloat dt = cpvcross(seg->tn, v);
 			if(dta >= dt && dt >= dtb){
-				cpContactInit(addContactPoint(arr, max, num), v, n, pDist, CP_HASH_PAIR(poly, i));
+				cpContactInit(addContactPoint(arr, num), v, n, pDist, CP_HASH_PAIR(poly, i));
 			}
 		}
 	}
@@ -236,7 +223,7 @@ findPointsBehindSeg(cpContact **arr, int *max, int *num, cpSegmentShape *seg, cp
 // This one is complicated and gross. Just don't go there...
 // TODO: Comment me!
 static int
-seg2poly(cpShape *shape1, cpShape *shape2, cpContact **arr)
+seg2poly(cpShape *shape1, cpShape *shape2, cpContact *arr)
 {
 	cpSegmentShape *seg = (cpSegmentShape *)shape1;
 	cpPolyShape *poly = (cpPolyShape *)shape2;
@@ -260,7 +247,6 @@ seg2poly(cpShape *shape1, cpShape *shape2, cpContact **arr)
 		}
 	}
 	
-	int max = 0;
 	int num = 0;
 	
 	cpVect poly_n = cpvneg(axes[mini].n);
@@ -268,18 +254,18 @@ seg2poly(cpShape *shape1, cpShape *shape2, cpContact **arr)
 	cpVect va = cpvadd(seg->ta, cpvmult(poly_n, seg->r));
 	cpVect vb = cpvadd(seg->tb, cpvmult(poly_n, seg->r));
 	if(cpPolyShapeContainsVert(poly, va))
-		cpContactInit(addContactPoint(arr, &max, &num), va, poly_n, poly_min, CP_HASH_PAIR(seg, 0));
+		cpContactInit(addContactPoint(arr, &num), va, poly_n, poly_min, CP_HASH_PAIR(seg, 0));
 	if(cpPolyShapeContainsVert(poly, vb))
-		cpContactInit(addContactPoint(arr, &max, &num), vb, poly_n, poly_min, CP_HASH_PAIR(seg, 1));
+		cpContactInit(addContactPoint(arr, &num), vb, poly_n, poly_min, CP_HASH_PAIR(seg, 1));
 
 	// Floating point precision problems here.
 	// This will have to do for now.
 	poly_min -= cp_collision_slop;
 	if(minNorm >= poly_min || minNeg >= poly_min) {
 		if(minNorm > minNeg)
-			findPointsBehindSeg(arr, &max, &num, seg, poly, minNorm, 1.0f);
+			findPointsBehindSeg(arr, &num, seg, poly, minNorm, 1.0f);
 		else
-			findPointsBehindSeg(arr, &max, &num, seg, poly, minNeg, -1.0f);
+			findPointsBehindSeg(arr, &num, seg, poly, minNeg, -1.0f);
 	}
 
 	return num;
@@ -288,7 +274,7 @@ seg2poly(cpShape *shape1, cpShape *shape2, cpContact **arr)
 // This one is less gross, but still gross.
 // TODO: Comment me!
 static int
-circle2poly(cpShape *shape1, cpShape *shape2, cpContact **con)
+circle2poly(cpShape *shape1, cpShape *shape2, cpContact *con)
 {
 	cpCircleShape *circ = (cpCircleShape *)shape1;
 	cpPolyShape *poly = (cpPolyShape *)shape2;
@@ -316,9 +302,8 @@ circle2poly(cpShape *shape1, cpShape *shape2, cpContact **con)
 	if(dt < dtb){
 		return circle2circleQuery(circ->tc, b, circ->r, 0.0f, con);
 	} else if(dt < dta) {
-		(*con) = (cpContact *)malloc(sizeof(cpContact));
 		cpContactInit(
-			(*con),
+			con,
 			cpvsub(circ->tc, cpvmult(n, circ->r + min/2.0f)),
 			cpvneg(n),
 			min,
@@ -346,7 +331,7 @@ extern "C" {
 	cpInitCollisionFuncs(void)
 	{
 		if(!colfuncs)
-			colfuncs = (collisionFunc *)calloc(CP_NUM_SHAPES*CP_NUM_SHAPES, sizeof(collisionFunc));
+			colfuncs = (collisionFunc *)cpcalloc(CP_NUM_SHAPES*CP_NUM_SHAPES, sizeof(collisionFunc));
 		
 		addColFunc(CP_CIRCLE_SHAPE,  CP_CIRCLE_SHAPE,  circle2circle);
 		addColFunc(CP_CIRCLE_SHAPE,  CP_SEGMENT_SHAPE, circle2segment);
@@ -358,8 +343,25 @@ extern "C" {
 }
 #endif
 
+// Number of features of a shape that can end up as contact points.
+static inline int
+shapeMaxContacts(cpShape *shape)
+{
+	switch(shape->type){
+		case CP_POLY_SHAPE: return ((cpPolyShape *)shape)->numVerts;
+		case CP_SEGMENT_SHAPE: return 2;
+		default: return 1;
+	}
+}
+
+int
+cpCollideShapesMaxContacts(cpShape *a, cpShape *b)
+{
+	return shapeMaxContacts(a) + shapeMaxContacts(b);
+}
+
 int
-cpCollideShapes(cpShape *a, cpShape *b, cpContact **arr)
+cpCollideShapes(cpShape *a, cpShape *b, cpContact *arr)
 {
 	// Their shape types must be in order.
 	assert(a->type <= b->type);
@@ -20,4 +20,8 @@
  */
 
 // Collides two cpShape structures. (this function is lonely :( )
-int cpCollideShapes(cpShape *a, cpShape *b, cpContact **arr);
+// The contacts are written to arr, which must have room for
+// cpCollideShapesMaxContacts() contacts. Returns the number of contacts.
+int cpCollideShapes(cpShape *a, cpShape *b, cpContact *arr);
+// Upper bound on the number of contacts between two shapes.
+int cpCollideShapesMaxContacts(cpShape *a, cpShape *b);
@@ -25,35 +25,30 @@
 #include "chipmunk.h"
 #include "prime.h"
 
+static void freeWrap(void *ptr, void *unused){cpfree(ptr);}
+
 void
 cpHashSetDestroy(cpHashSet *set)
 {
-	// Free the chains.
-	for(int i=0; i<set->size; i++){
-		// Free the bins in the chain.
-		cpHashSetBin *bin = set->table[i];
-		while(bin){
-			cpHashSetBin *next = bin->next;
-			free(bin);
-			bin = next;
-		}
-	}
-	
 	// Free the table.
-	free(set->table);
+	cpfree(set->table);
+	
+	// Free the bins.
+	cpArrayEach(set->allocatedBuffers, &freeWrap, NULL);
+	cpArrayFree(set->allocatedBuffers);
 }
 
 void
 cpHashSetFree(cpHashSet *set)
 {
 	if(set) cpHashSetDestroy(set);
-	free(set);
+	cpfree(set);
 }
 
 cpHashSet *
 cpHashSetAlloc(void)
 {
-	return (cpHashSet *)calloc(1, sizeof(cpHashSet));
+	return (cpHashSet *)cpcalloc(1, sizeof(cpHashSet));
 }
 
 cpHashSet *
@@ -67,7 +62,11 @@ cpHashSetInit(cpHashSet *set, int size, cpHashSetEqlFunc eqlFunc, cpHashSetTrans
 	
 	set->default_value = NULL;
 	
-	set->table = (cpHashSetBin **)calloc(set->size, sizeof(cpHashSetBin *));
+	set->table = (cpHashSetBin **)cpcalloc(set->size, sizeof(cpHashSetBin *));
+	
+	set->pooledBins = NULL;
+	set->allocatedBuffers = cpArrayNew(0);
+	set->allocations = 1;
 	
 	return set;
 }
@@ -90,7 +89,7 @@ cpHashSetResize(cpHashSet *set)
 	// Get the next approximate doubled prime.
 	int newSize = next_prime(set->size + 1);
 	// Allocate a new table.
-	cpHashSetBin **newTable = (cpHashSetBin **)calloc(newSize, sizeof(cpHashSetBin *));
+	cpHashSetBin **newTable = (cpHashSetBin **)cpcalloc(newSize, sizeof(cpHashSetBin *));
 	
 	// Iterate over the chains.
 	for(int i=0; i<set->size; i++){
@@ -107,10 +106,39 @@ cpHashSetResize(cpHashSet *set)
 		}
 	}
 	
-	free(set->table);
+	cpfree(set->table);
 	
 	set->table = newTable;
 	set->size = newSize;
+	set->allocations++;
+}
+
+static inline void
+recycleBin(cpHashSet *set, cpHashSetBin *bin)
+{
+	bin->next = set->pooledBins;
+	set->pooledBins = bin;
+}
+
+// Get a recycled bin, or allocate a new block of them.
+static cpHashSetBin *
+getUnusedBin(cpHashSet *set)
+{
+	cpHashSetBin *bin = set->pooledBins;
+	
+	if(bin){
+		set->pooledBins = bin->next;
+		return bin;
+	}
+	
+	int count = CP_BUFFER_BYTES/sizeof(cpHashSetBin);
+	cpHashSetBin *buffer = (cpHashSetBin *)cpmalloc(count*sizeof(cpHashSetBin));
+	cpArrayPush(set->allocatedBuffers, buffer);
+	set->allocations++;
+	
+	// Keep the first bin, pool the rest.
+	for(int i=1; i<count; i++) recycleBin(set, buffer + i);
+	return buffer;
 }
 
 void *
@@ -125,7 +153,7 @@ cpHashSetInsert(cpHashSet *set, unsigned int hash, void *ptr, void *data)
 	
 	// Create it necessary.
 	if(!bin){
-		bin = (cpHashSetBin *)malloc(sizeof(cpHashSetBin));
+		bin = getUnusedBin(set);
 		bin->hash = hash;
 		bin->elt = set->trans(ptr, data); // Transform the pointer.
 		
@@ -165,7 +193,7 @@ cpHashSetRemove(cpHashSet *set, unsigned int hash, void *ptr)
 		set->entries--;
 		
 		void *return_value = bin->elt;
-		free(bin);
+		recycleBin(set, bin);
 		return return_value;
 	}
 	
@@ -210,7 +238,7 @@ cpHashSetReject(cpHashSet *set, cpHashSetRejectFunc func, void *data)
 				(*prev_ptr) = next;
 
 				set->entries--;
-				free(bin);
+				recycleBin(set, bin);
 			}
 			
 			bin = next;
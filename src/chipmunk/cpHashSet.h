@@ -55,6 +55,12 @@ typedef struct cpHashSet {
 	void *default_value;
 	
 	cpHashSetBin **table;
+	
+	// Recycled bins and the blocks of memory they were allocated in.
+	cpHashSetBin *pooledBins;
+	cpArray *allocatedBuffers;
+	// Number of heap allocations made by the set for bins and tables.
+	int allocations;
 } cpHashSet;
 
 // Basic allocation/destruction functions.
@@ -34,7 +34,7 @@ void
 cpJointFree(cpJoint *joint)
 {
 	if(joint) cpJointDestroy(joint);
-	free(joint);
+	cpfree(joint);
 }
 
 static void
@@ -110,7 +110,7 @@ pinJointApplyImpulse(cpJoint *joint)
 cpPinJoint *
 cpPinJointAlloc(void)
 {
-	return (cpPinJoint *)malloc(sizeof(cpPinJoint));
+	return (cpPinJoint *)cpmalloc(sizeof(cpPinJoint));
 }
 
 cpPinJoint *
@@ -229,7 +229,7 @@ SlideJointApplyImpulse(cpJoint *joint)
 cpSlideJoint *
 cpSlideJointAlloc(void)
 {
-	return (cpSlideJoint *)malloc(sizeof(cpSlideJoint));
+	return (cpSlideJoint *)cpmalloc(sizeof(cpSlideJoint));
 }
 
 cpSlideJoint *
@@ -347,7 +347,7 @@ pivotJointApplyImpulse(cpJoint *joint)
 cpPivotJoint *
 cpPivotJointAlloc(void)
 {
-	return (cpPivotJoint *)malloc(sizeof(cpPivotJoint));
+	return (cpPivotJoint *)cpmalloc(sizeof(cpPivotJoint));
 }
 
 cpPivotJoint *
@@ -502,7 +502,7 @@ grooveJointApplyImpulse(cpJoint *joint)
 cpGrooveJoint *
 cpGrooveJointAlloc(void)
 {
-	return (cpGrooveJoint *)malloc(sizeof(cpGrooveJoint));
+	return (cpGrooveJoint *)cpmalloc(sizeof(cpGrooveJoint));
 }
 
 cpGrooveJoint *
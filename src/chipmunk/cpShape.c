@@ -69,7 +69,7 @@ void
 cpShapeFree(cpShape *shape)
 {
 	if(shape) cpShapeDestroy(shape);
-	free(shape);
+	cpfree(shape);
 }
 
 cpBB
@@ -85,7 +85,7 @@ cpShapeCacheBB(cpShape *shape)
 cpCircleShape *
 cpCircleShapeAlloc(void)
 {
-	return (cpCircleShape *)calloc(1, sizeof(cpCircleShape));
+	return (cpCircleShape *)cpcalloc(1, sizeof(cpCircleShape));
 }
 
 static inline cpBB
@@ -125,7 +125,7 @@ cpCircleShapeNew(cpBody *body, cpFloat radius, cpVect offset)
 cpSegmentShape *
 cpSegmentShapeAlloc(void)
 {
-	return (cpSegmentShape *)calloc(1, sizeof(cpSegmentShape));
+	return (cpSegmentShape *)cpcalloc(1, sizeof(cpSegmentShape));
 }
 
 static cpBB
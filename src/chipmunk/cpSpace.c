@@ -28,6 +28,38 @@
 
 int cp_contact_persistence = 3;
 
+// Maximum number of constraint colors used by the threaded solver.
+// Constraints that don't fit are solved serially after the colored ones.
+#define CP_MAX_COLORS 32
+
+// A pair of shapes found by the broadphase of the threaded step.
+typedef struct cpSpacePair {
+	cpShape *a, *b;
+	cpCollPairFunc *pairFunc;
+	
+	// Filled in by the narrow-phase.
+	cpContact *contacts;
+	int numContacts;
+} cpSpacePair;
+
+// Contacts are allocated from a ring of buffers, each buffer holds the contacts of
+// a single step. A buffer is reused once all of the arbiters that could still
+// point into it have been thrown away. (see cp_contact_persistence)
+typedef struct cpContactBuffer {
+	// Stamp of the step that filled the buffer.
+	int stamp;
+	int numContacts, maxContacts;
+	struct cpContactBuffer *next;
+	cpContact contacts[];
+} cpContactBuffer;
+
+// An arbiter or joint for the threaded solver.
+typedef struct cpSolverItem {
+	cpArbiter *arb;
+	cpJoint *joint;
+	int color;
+} cpSolverItem;
+
 // Equal function for contactSet.
 static int
 contactSetEql(void *ptr, void *elt)
@@ -51,7 +83,87 @@ contactSetTrans(void *ptr, void *data)
 	
 	cpSpace *space = (cpSpace *)data;
 	
-	return cpArbiterNew(a, b, space->stamp);
+	// Take an arbiter from the pool, allocate a new block of them if it's empty.
+	if(space->pooledArbiters->num == 0){
+		int count = CP_BUFFER_BYTES/sizeof(cpArbiter);
+		cpArbiter *buffer = (cpArbiter *)cpcalloc(count, sizeof(cpArbiter));
+		cpArrayPush(space->allocatedBuffers, buffer);
+		space->allocations++;
+		
+		for(int i=0; i<count; i++) cpArrayPush(space->pooledArbiters, buffer + i);
+	}
+	
+	space->stepStats.arbiters++;
+	return cpArbiterInit((cpArbiter *)cpArrayPop(space->pooledArbiters), a, b, space->stamp);
+}
+
+// Makes the next buffer in the ring the current contact buffer.
+// Reuses the oldest buffer if possible, otherwise inserts a new one.
+static void
+pushContactBuffer(cpSpace *space, int minContacts)
+{
+	cpContactBuffer *head = space->contactBuffersHead;
+	cpContactBuffer *buffer;
+	
+	if(head && (space->stamp - head->next->stamp) > cp_contact_persistence && head->next->maxContacts >= minContacts){
+		// The oldest buffer isn't referenced by any arbiters anymore.
+		buffer = head->next;
+	} else {
+		int count = CP_BUFFER_BYTES/sizeof(cpContact);
+		if(count < minContacts) count = minContacts;
+		
+		buffer = (cpContactBuffer *)cpmalloc(sizeof(cpContactBuffer) + count*sizeof(cpContact));
+		buffer->maxContacts = count;
+		space->allocations++;
+		
+		if(head){
+			buffer->next = head->next;
+			head->next = buffer;
+		} else {
+			buffer->next = buffer;
+		}
+	}
+	
+	buffer->stamp = space->stamp;
+	buffer->numContacts = 0;
+	space->contactBuffersHead = buffer;
+}
+
+// Returns room for count contacts in the current contact buffer.
+// The contacts are only kept if contactBufferCommit() is called.
+static inline cpContact *
+contactBufferReserve(cpSpace *space, int count)
+{
+	cpContactBuffer *head = space->contactBuffersHead;
+	if(head->numContacts + count > head->maxContacts){
+		pushContactBuffer(space, count);
+		head = space->contactBuffersHead;
+	}
+	
+	return head->contacts + head->numContacts;
+}
+
+static inline void
+contactBufferCommit(cpSpace *space, int count)
+{
+	space->contactBuffersHead->numContacts += count;
+}
+
+static void
+freeContactBuffers(cpSpace *space)
+{
+	cpContactBuffer *head = space->contactBuffersHead;
+	if(!head) return;
+	
+	cpContactBuffer *buffer = head->next;
+	head->next = NULL;
+	while(buffer){
+		cpContactBuffer *next = buffer->next;
+		cpfree(buffer);
+		buffer = next;
+	}
+	
+	space->contactBuffersHead = NULL;
 }
 
 // Collision pair function wrapper struct.
@@ -80,7 +192,7 @@ collFuncSetTrans(void *ptr, void *data)
 	unsigned int *ids = (unsigned int *)ptr;
 	collFuncData *funcData = (collFuncData *)data;
 
-	cpCollPairFunc *pair = (cpCollPairFunc *)malloc(sizeof(cpCollPairFunc));
+	cpCollPairFunc *pair = (cpCollPairFunc *)cpmalloc(sizeof(cpCollPairFunc));
 	pair->a = ids[0];
 	pair->b = ids[1];
 	pair->func = funcData->func;
@@ -105,16 +217,15 @@ bbfunc(void *ptr)
 }
 
 // Iterator functions for destructors.
-static void        freeWrap(void *ptr, void *unused){          free(             ptr);}
+static void        freeWrap(void *ptr, void *unused){        cpfree(             ptr);}
 static void   shapeFreeWrap(void *ptr, void *unused){   cpShapeFree((cpShape *)  ptr);}
-static void arbiterFreeWrap(void *ptr, void *unused){ cpArbiterFree((cpArbiter *)ptr);}
 static void    bodyFreeWrap(void *ptr, void *unused){    cpBodyFree((cpBody *)   ptr);}
 static void   jointFreeWrap(void *ptr, void *unused){   cpJointFree((cpJoint *)  ptr);}
 
 cpSpace*
 cpSpaceAlloc(void)
 {
-	return (cpSpace *)calloc(1, sizeof(cpSpace));
+	return (cpSpace *)cpcalloc(1, sizeof(cpSpace));
 }
 
 #define DEFAULT_DIM_SIZE 100.0f
@@ -132,8 +243,8 @@ cpSpaceInit(cpSpace *space)
 	
 	space->stamp = 0;
 
-	space->staticShapes = cpSpaceHashNew(DEFAULT_DIM_SIZE, DEFAULT_COUNT, &bbfunc);
-	space->activeShapes = cpSpaceHashNew(DEFAULT_DIM_SIZE, DEFAULT_COUNT, &bbfunc);
+	space->staticShapes = (cpSpatialIndex *)cpSpaceHashNew(DEFAULT_DIM_SIZE, DEFAULT_COUNT, &bbfunc);
+	space->activeShapes = (cpSpatialIndex *)cpSpaceHashNew(DEFAULT_DIM_SIZE, DEFAULT_COUNT, &bbfunc);
 	
 	space->bodies = cpArrayNew(0);
 	space->arbiters = cpArrayNew(0);
@@ -146,6 +257,27 @@ cpSpaceInit(cpSpace *space)
 	space->collFuncSet = cpHashSetNew(0, collFuncSetEql, collFuncSetTrans);
 	space->collFuncSet->default_value = &space->defaultPairFunc;
 	
+	space->threads = 1;
+	space->deterministic = 0;
+	
+	space->workers = cpWorkerPoolNew(1);
+	space->shapeList = cpArrayNew(0);
+	space->pairs = NULL;
+	space->numPairs = 0;
+	space->maxPairs = 0;
+	space->solverItems = NULL;
+	space->maxSolverItems = 0;
+	space->colorStart = (int *)cpcalloc(CP_MAX_COLORS + 2, sizeof(int));
+	space->numColors = 0;
+	
+	space->pooledArbiters = cpArrayNew(0);
+	space->allocatedBuffers = cpArrayNew(0);
+	space->contactBuffersHead = NULL;
+	space->allocations = 0;
+	
+	cpSpaceStepStats stats = {0, 0, 0};
+	space->stepStats = stats;
+	
 	return space;
 }
 
@@ -158,39 +290,117 @@ cpSpaceNew(void)
 void
 cpSpaceDestroy(cpSpace *space)
 {
-	cpSpaceHashFree(space->staticShapes);
-	cpSpaceHashFree(space->activeShapes);
+	cpSpatialIndexFree(space->staticShapes);
+	cpSpatialIndexFree(space->activeShapes);
 	
 	cpArrayFree(space->bodies);
 	
 	cpArrayFree(space->joints);
 	
-	if(space->contactSet)
-		cpHashSetEach(space->contactSet, &arbiterFreeWrap, NULL);
+	// The arbiters and contacts are freed with the pools below.
 	cpHashSetFree(space->contactSet);
 	cpArrayFree(space->arbiters);
 	
 	if(space->collFuncSet)
 		cpHashSetEach(space->collFuncSet, &freeWrap, NULL);
 	cpHashSetFree(space->collFuncSet);
+	
+	cpWorkerPoolFree(space->workers);
+	cpArrayFree(space->shapeList);
+	cpfree(space->pairs);
+	cpfree(space->solverItems);
+	cpfree(space->colorStart);
+	
+	cpArrayEach(space->allocatedBuffers, &freeWrap, NULL);
+	cpArrayFree(space->allocatedBuffers);
+	cpArrayFree(space->pooledArbiters);
+	freeContactBuffers(space);
 }
 
 void
 cpSpaceFree(cpSpace *space)
 {
 	if(space) cpSpaceDestroy(space);
-	free(space);
+	cpfree(space);
 }
 
 void
 cpSpaceFreeChildren(cpSpace *space)
 {
-	cpSpaceHashEach(space->staticShapes, &shapeFreeWrap, NULL);
-	cpSpaceHashEach(space->activeShapes, &shapeFreeWrap, NULL);
+	cpSpatialIndexEach(space->staticShapes, &shapeFreeWrap, NULL);
+	cpSpatialIndexEach(space->activeShapes, &shapeFreeWrap, NULL);
 	cpArrayEach(space->bodies, &bodyFreeWrap, NULL);
 	cpArrayEach(space->joints, &jointFreeWrap, NULL);
 }
 
+void
+cpSpaceSetThreads(cpSpace *space, int threads)
+{
+	if(threads < 1) threads = 1;
+	if(threads == space->threads) return;
+	
+	cpWorkerPoolFree(space->workers);
+	space->workers = cpWorkerPoolNew(threads);
+	
+	// The pool might not have been able to start all of the threads.
+	space->threads = cpWorkerPoolThreads(space->workers);
+}
+
+// Velocity callback for the active shape tree.
+static cpVect
+shapeVelocityFunc(void *ptr)
+{
+	cpShape *shape = (cpShape *)ptr;
+	return shape->body->v;
+}
+
+static cpSpatialIndex *
+spatialIndexNew(cpSpatialIndexType type, int isStatic)
+{
+	if(type == CP_BB_TREE){
+		cpBBTree *tree = cpBBTreeNew(&bbfunc);
+		
+		if(isStatic){
+			// Static shapes don't move, they don't need fat boxes.
+			tree->margin = 0.0f;
+		} else {
+			cpBBTreeSetVelocityFunc(tree, &shapeVelocityFunc);
+		}
+		
+		return (cpSpatialIndex *)tree;
+	}
+	
+	return (cpSpatialIndex *)cpSpaceHashNew(DEFAULT_DIM_SIZE, DEFAULT_COUNT, &bbfunc);
+}
+
+// Iterator used to move shapes into a new index.
+static void
+spatialIndexInsertShape(void *ptr, void *data)
+{
+	cpShape *shape = (cpShape *)ptr;
+	cpSpatialIndexInsert((cpSpatialIndex *)data, shape, shape->id, shape->bb);
+}
+
+// Returns index converted to the given type.
+static cpSpatialIndex *
+spatialIndexConvert(cpSpatialIndex *index, cpSpatialIndexType type, int isStatic)
+{
+	if(cpSpatialIndexGetType(index) == type) return index;
+	
+	cpSpatialIndex *newIndex = spatialIndexNew(type, isStatic);
+	cpSpatialIndexEach(index, &spatialIndexInsertShape, newIndex);
+	cpSpatialIndexFree(index);
+	
+	return newIndex;
+}
+
+void
+cpSpaceSetSpatialIndex(cpSpace *space, cpSpatialIndexType type)
+{
+	space->staticShapes = spatialIndexConvert(space->staticShapes, type, 1);
+	space->activeShapes = spatialIndexConvert(space->activeShapes, type, 0);
+}
+
 void
 cpSpaceAddCollisionPairFunc(cpSpace *space, unsigned int a, unsigned int b,
                                  cpCollFunc func, void *data)
@@ -210,7 +420,7 @@ cpSpaceRemoveCollisionPairFunc(cpSpace *space, unsigned int a, unsigned int b)
 	unsigned int ids[] = {a, b};
 	unsigned int hash = CP_HASH_PAIR(a, b);
 	cpCollPairFunc *old_pair = (cpCollPairFunc *)cpHashSetRemove(space->collFuncSet, hash, ids);
-	free(old_pair);
+	cpfree(old_pair);
 }
 
 void
@@ -223,13 +433,13 @@ cpSpaceSetDefaultCollisionPairFunc(cpSpace *space, cpCollFunc func, void *data)
 void
 cpSpaceAddShape(cpSpace *space, cpShape *shape)
 {
-	cpSpaceHashInsert(space->activeShapes, shape, shape->id, shape->bb);
+	cpSpatialIndexInsert(space->activeShapes, shape, shape->id, shape->bb);
 }
 
 void
 cpSpaceAddStaticShape(cpSpace *space, cpShape *shape)
 {
-	cpSpaceHashInsert(space->staticShapes, shape, shape->id, shape->bb);
+	cpSpatialIndexInsert(space->staticShapes, shape, shape->id, shape->bb);
 }
 
 void
@@ -247,13 +457,13 @@ cpSpaceAddJoint(cpSpace *space, cpJoint *joint)
 void
 cpSpaceRemoveShape(cpSpace *space, cpShape *shape)
 {
-	cpSpaceHashRemove(space->activeShapes, shape, shape->id);
+	cpSpatialIndexRemove(space->activeShapes, shape, shape->id);
 }
 
 void
 cpSpaceRemoveStaticShape(cpSpace *space, cpShape *shape)
 {
-	cpSpaceHashRemove(space->staticShapes, shape, shape->id);
+	cpSpatialIndexRemove(space->staticShapes, shape, shape->id);
 }
 
 void
@@ -288,21 +498,21 @@ updateBBCache(void *ptr, void *unused)
 void
 cpSpaceResizeStaticHash(cpSpace *space, cpFloat dim, int count)
 {
-	cpSpaceHashResize(space->staticShapes, dim, count);
-	cpSpaceHashRehash(space->staticShapes);
+	cpSpatialIndexResize(space->staticShapes, dim, count);
+	cpSpatialIndexRehash(space->staticShapes);
 }
 
 void
 cpSpaceResizeActiveHash(cpSpace *space, cpFloat dim, int count)
 {
-	cpSpaceHashResize(space->activeShapes, dim, count);
+	cpSpatialIndexResize(space->activeShapes, dim, count);
 }
 
 void 
 cpSpaceRehashStatic(cpSpace *space)
 {
-	cpSpaceHashEach(space->staticShapes, &updateBBCache, NULL);
-	cpSpaceHashRehash(space->staticShapes);
+	cpSpatialIndexEach(space->staticShapes, &updateBBCache, NULL);
+	cpSpatialIndexRehash(space->staticShapes);
 }
 
 static inline int
@@ -319,37 +529,34 @@ queryReject(cpShape *a, cpShape *b)
 	   || !(a->layers & b->layers);
 }
 
-// Callback from the spatial hash.
-// TODO: Refactor this into separate functions?
-static int
-queryFunc(void *p1, void *p2, void *data)
+// Find the collision pair function for two shapes that passed queryReject().
+// Swaps the shapes into the order required by cpCollideShapes().
+// Returns NULL if the shapes should never collide.
+static inline cpCollPairFunc *
+queryPairFunc(cpSpace *space, cpShape **a, cpShape **b)
 {
-	// Cast the generic pointers from the spatial hash back to usefull types
-	cpShape *a = (cpShape *)p1;
-	cpShape *b = (cpShape *)p2;
-	cpSpace *space = (cpSpace *)data;
-	
-	// Reject any of the simple cases
-	if(queryReject(a,b)) return 0;
-	
 	// Shape 'a' should have the lower shape type. (required by cpCollideShapes() )
-	if(a->type > b->type){
-		cpShape *temp = a;
-		a = b;
-		b = temp;
+	if((*a)->type > (*b)->type){
+		cpShape *temp = *a;
+		*a = *b;
+		*b = temp;
 	}
 	
 	// Find the collision pair function for the shapes.
-	unsigned int ids[] = {a->collision_type, b->collision_type};
-	unsigned int hash = CP_HASH_PAIR(a->collision_type, b->collision_type);
+	unsigned int ids[] = {(*a)->collision_type, (*b)->collision_type};
+	unsigned int hash = CP_HASH_PAIR((*a)->collision_type, (*b)->collision_type);
 	cpCollPairFunc *pairFunc = (cpCollPairFunc *)cpHashSetFind(space->collFuncSet, hash, ids);
-	if(!pairFunc->func) return 0; // A NULL pair function means don't collide at all.
-	
-	// Narrow-phase collision detection.
-	cpContact *contacts = NULL;
-	int numContacts = cpCollideShapes(a, b, &contacts);
-	if(!numContacts) return 0; // Shapes are not colliding.
+	if(!pairFunc->func) return NULL; // A NULL pair function means don't collide at all.
 	
+	return pairFunc;
+}
+
+// Run the collision pair function on the narrow-phase results
+// and record the contacts in an arbiter if it accepts them.
+// The contacts must be committed to the contact buffers when accepted.
+static int
+queryCommit(cpSpace *space, cpShape *a, cpShape *b, cpCollPairFunc *pairFunc, cpContact *contacts, int numContacts)
+{
 	// The collision pair function requires objects to be ordered by their collision types.
 	cpShape *pair_a = a;
 	cpShape *pair_b = b;
@@ -371,7 +578,8 @@ queryFunc(void *p1, void *p2, void *data)
 		cpShape *shape_pair[] = {a, b};
 		cpArbiter *arb = (cpArbiter *)cpHashSetInsert(space->contactSet, CP_HASH_PAIR(a, b), shape_pair, space);
 		
-		// Timestamp the arbiter.
+		// Timestamp the arbiter. New arbiters already carry the current stamp.
+		arb->firstColl = (arb->stamp != space->stamp - 1);
 		arb->stamp = space->stamp;
 		arb->a = a; arb->b = b; // TODO: Investigate why this is still necessary?
 		// Inject the new contact points into the arbiter.
@@ -380,22 +588,96 @@ queryFunc(void *p1, void *p2, void *data)
 		// Add the arbiter to the list of active arbiters.
 		cpArrayPush(space->arbiters, arb);
 		
+		space->stepStats.contacts += numContacts;
 		return numContacts;
 	} else {
 		// The collision pair function rejected the collision.
-		
-		free(contacts);
 		return 0;
 	}
 }
 
+// Callback from the spatial hash.
+static int
+queryFunc(void *p1, void *p2, void *data)
+{
+	// Cast the generic pointers from the spatial hash back to usefull types
+	cpShape *a = (cpShape *)p1;
+	cpShape *b = (cpShape *)p2;
+	cpSpace *space = (cpSpace *)data;
+	
+	// Reject any of the simple cases
+	if(queryReject(a,b)) return 0;
+	
+	cpCollPairFunc *pairFunc = queryPairFunc(space, &a, &b);
+	if(!pairFunc) return 0;
+	
+	// Narrow-phase collision detection.
+	cpContact *contacts = contactBufferReserve(space, cpCollideShapesMaxContacts(a, b));
+	int numContacts = cpCollideShapes(a, b, contacts);
+	if(!numContacts) return 0; // Shapes are not colliding.
+	
+	numContacts = queryCommit(space, a, b, pairFunc, contacts, numContacts);
+	contactBufferCommit(space, numContacts);
+	return numContacts;
+}
+
 // Iterator for active/static hash collisions.
 static void
 active2staticIter(void *ptr, void *data)
 {
 	cpShape *shape = (cpShape *)ptr;
 	cpSpace *space = (cpSpace *)data;
-	cpSpaceHashQuery(space->staticShapes, shape, shape->bb, &queryFunc, space);
+	cpSpatialIndexQuery(space->staticShapes, shape, shape->bb, &queryFunc, space);
+}
+
+// Callback from the spatial hash for the threaded step.
+// Only records the pair, the narrow-phase is run later on the worker threads.
+static int
+queryGatherFunc(void *p1, void *p2, void *data)
+{
+	cpShape *a = (cpShape *)p1;
+	cpShape *b = (cpShape *)p2;
+	cpSpace *space = (cpSpace *)data;
+	
+	if(queryReject(a,b)) return 0;
+	
+	cpCollPairFunc *pairFunc = queryPairFunc(space, &a, &b);
+	if(!pairFunc) return 0;
+	
+	if(space->numPairs == space->maxPairs){
+		space->maxPairs = (space->maxPairs ? space->maxPairs*2 : 64);
+		space->pairs = (cpSpacePair *)cprealloc(space->pairs, space->maxPairs*sizeof(cpSpacePair));
+	}
+	
+	// Every pair gets its own room in the contact buffer so the worker
+	// threads never allocate. Unused room is lost until the buffer is reused.
+	int maxContacts = cpCollideShapesMaxContacts(a, b);
+	
+	cpSpacePair *pair = &space->pairs[space->numPairs++];
+	pair->a = a;
+	pair->b = b;
+	pair->pairFunc = pairFunc;
+	pair->contacts = contactBufferReserve(space, maxContacts);
+	pair->numContacts = 0;
+	contactBufferCommit(space, maxContacts);
+	
+	return 0;
+}
+
+// Iterator for active/static hash collisions for the threaded step.
+static void
+active2staticGatherIter(void *ptr, void *data)
+{
+	cpShape *shape = (cpShape *)ptr;
+	cpSpace *space = (cpSpace *)data;
+	cpSpatialIndexQuery(space->staticShapes, shape, shape->bb, &queryGatherFunc, space);
+}
+
+// Iterator used to flatten the active shapes into space->shapeList.
+static void
+shapeListPush(void *ptr, void *data)
+{
+	cpArrayPush((cpArray *)data, ptr);
 }
 
 // Hashset reject func to throw away old arbiters.
@@ -406,17 +688,278 @@ contactSetReject(void *ptr, void *data)
 	cpSpace *space = (cpSpace *)data;
 	
 	if((space->stamp - arb->stamp) > cp_contact_persistence){
-		cpArbiterFree(arb);
+		cpArrayPush(space->pooledArbiters, arb);
 		return 0;
 	}
 	
 	return 1;
 }
 
-void
-cpSpaceStep(cpSpace *space, cpFloat dt)
+// The impulse functions never write to static bodies, so the solver doesn't
+// need to color constraints by them.
+static inline unsigned int
+bodyColors(cpBody *body)
+{
+	return (cpBodyIsStatic(body) ? 0 : body->color_mask);
+}
+
+static inline void
+markBodyColor(cpBody *body, int color)
+{
+	if(!cpBodyIsStatic(body)) body->color_mask |= (1u << color);
+}
+
+// Greedy graph coloring of the arbiters and joints. Constraints with the same color
+// never share a body, so each color can be solved in parallel without locking.
+// The coloring only depends on the order of space->arbiters and space->joints.
+static void
+colorConstraints(cpSpace *space)
+{
+	cpArray *arbiters = space->arbiters;
+	cpArray *joints = space->joints;
+	int count = arbiters->num + joints->num;
+	
+	// The second half of the buffer holds the unsorted items.
+	if(2*count > space->maxSolverItems){
+		space->maxSolverItems = 2*count;
+		space->solverItems = (cpSolverItem *)cprealloc(space->solverItems, space->maxSolverItems*sizeof(cpSolverItem));
+	}
+	cpSolverItem *sorted = space->solverItems;
+	cpSolverItem *items = space->solverItems + count;
+	
+	for(int i=0; i<arbiters->num; i++){
+		cpArbiter *arb = (cpArbiter *)arbiters->arr[i];
+		arb->a->body->color_mask = 0;
+		arb->b->body->color_mask = 0;
+		items[i].arb = arb;
+		items[i].joint = NULL;
+	}
+	
+	for(int i=0; i<joints->num; i++){
+		cpJoint *joint = (cpJoint *)joints->arr[i];
+		joint->a->color_mask = 0;
+		joint->b->color_mask = 0;
+		items[arbiters->num + i].arb = NULL;
+		items[arbiters->num + i].joint = joint;
+	}
+	
+	int counts[CP_MAX_COLORS + 1] = {0};
+	int numColors = 0;
+	
+	for(int i=0; i<count; i++){
+		cpSolverItem *item = &items[i];
+		cpBody *a = (item->arb ? item->arb->a->body : item->joint->a);
+		cpBody *b = (item->arb ? item->arb->b->body : item->joint->b);
+		
+		// Take the first color that neither body uses yet.
+		unsigned int used = bodyColors(a) | bodyColors(b);
+		int color = 0;
+		while(color < CP_MAX_COLORS && (used & (1u << color))) color++;
+		
+		if(color < CP_MAX_COLORS){
+			markBodyColor(a, color);
+			markBodyColor(b, color);
+			if(color >= numColors) numColors = color + 1;
+		}
+		
+		item->color = color;
+		counts[color]++;
+	}
+	
+	// Counting sort the items by color. Keeps the original order within a color.
+	int *start = space->colorStart;
+	start[0] = 0;
+	for(int c=0; c<=CP_MAX_COLORS; c++)
+		start[c + 1] = start[c] + counts[c];
+	
+	int fill[CP_MAX_COLORS + 1];
+	for(int c=0; c<=CP_MAX_COLORS; c++)
+		fill[c] = start[c];
+	
+	for(int i=0; i<count; i++)
+		sorted[fill[items[i].color]++] = items[i];
+	
+	space->numColors = numColors;
+}
+
+// Shared data for the jobs of the threaded step.
+typedef struct stepData {
+	cpSpace *space;
+	cpFloat dt, dt_inv;
+	cpFloat damping;
+} stepData;
+
+static void
+updateVelocityJob(cpWorkerPool *pool, int index, void *data)
+{
+	stepData *step = (stepData *)data;
+	cpSpace *space = step->space;
+	cpArray *bodies = space->bodies;
+	
+	int start, end;
+	cpWorkerPoolRange(pool, index, bodies->num, &start, &end);
+	for(int i=start; i<end; i++)
+		cpBodyUpdateVelocity((cpBody *)bodies->arr[i], space->gravity, step->damping, step->dt);
+}
+
+static void
+updatePositionJob(cpWorkerPool *pool, int index, void *data)
+{
+	stepData *step = (stepData *)data;
+	cpArray *bodies = step->space->bodies;
+	
+	int start, end;
+	cpWorkerPoolRange(pool, index, bodies->num, &start, &end);
+	for(int i=start; i<end; i++)
+		cpBodyUpdatePosition((cpBody *)bodies->arr[i], step->dt);
+}
+
+static void
+updateBBCacheJob(cpWorkerPool *pool, int index, void *data)
+{
+	stepData *step = (stepData *)data;
+	cpArray *shapes = step->space->shapeList;
+	
+	int start, end;
+	cpWorkerPoolRange(pool, index, shapes->num, &start, &end);
+	for(int i=start; i<end; i++)
+		cpShapeCacheBB((cpShape *)shapes->arr[i]);
+}
+
+static void
+collideJob(cpWorkerPool *pool, int index, void *data)
+{
+	stepData *step = (stepData *)data;
+	cpSpace *space = step->space;
+	
+	int start, end;
+	cpWorkerPoolRange(pool, index, space->numPairs, &start, &end);
+	for(int i=start; i<end; i++){
+		cpSpacePair *pair = &space->pairs[i];
+		pair->numContacts = cpCollideShapes(pair->a, pair->b, pair->contacts);
+	}
+}
+
+// Prestep or solve this thread's share of one color.
+static void
+solveColor(cpSpace *space, cpWorkerPool *pool, int index, int color, int prestep, cpFloat dt_inv)
+{
+	int first = space->colorStart[color];
+	int count = space->colorStart[color + 1] - first;
+	
+	int start, end;
+	if(color == CP_MAX_COLORS){
+		// The overflow constraints may share bodies, only one thread can solve them.
+		start = 0;
+		end = (index == 0 ? count : 0);
+	} else {
+		cpWorkerPoolRange(pool, index, count, &start, &end);
+	}
+	
+	for(int i=start; i<end; i++){
+		cpSolverItem *item = &space->solverItems[first + i];
+		
+		if(item->arb){
+			if(prestep)
+				cpArbiterPreStep(item->arb, dt_inv);
+			else
+				cpArbiterApplyImpulse(item->arb);
+		} else {
+			cpJoint *joint = item->joint;
+			if(prestep)
+				joint->preStep(joint, dt_inv);
+			else
+				joint->applyImpulse(joint);
+		}
+	}
+}
+
+static void
+solverJob(cpWorkerPool *pool, int index, void *data)
+{
+	stepData *step = (stepData *)data;
+	cpSpace *space = step->space;
+	int *start = space->colorStart;
+	
+	// Prestep the arbiters and joints.
+	for(int c=0; c<=CP_MAX_COLORS; c++){
+		if(start[c] == start[c + 1]) continue;
+		
+		solveColor(space, pool, index, c, 1, step->dt_inv);
+		cpWorkerPoolSync(pool, index);
+	}
+	
+	// Run the impulse solver.
+	for(int i=0; i<space->iterations; i++){
+		for(int c=0; c<=CP_MAX_COLORS; c++){
+			if(start[c] == start[c + 1]) continue;
+			
+			solveColor(space, pool, index, c, 0, step->dt_inv);
+			cpWorkerPoolSync(pool, index);
+		}
+	}
+}
+
+// Threaded version of cpSpaceStep().
+// Collision pair functions are still called on the calling thread and in the same order as the serial step.
+static void
+threadedStep(cpSpace *space, cpFloat dt)
+{
+	cpWorkerPool *pool = space->workers;
+	stepData step = {space, dt, 1.0f/dt, pow(1.0f/space->damping, -dt)};
+	
+	// Empty the arbiter list.
+	cpHashSetReject(space->contactSet, &contactSetReject, space);
+	space->arbiters->num = 0;
+	pushContactBuffer(space, 0);
+	
+	// Integrate velocities.
+	cpWorkerPoolRun(pool, &updateVelocityJob, &step);
+	
+	// Pre-cache BBoxes and shape data.
+	space->shapeList->num = 0;
+	cpSpatialIndexEach(space->activeShapes, &shapeListPush, space->shapeList);
+	cpWorkerPoolRun(pool, &updateBBCacheJob, &step);
+	
+	// Find the colliding pairs. This rebuilds the active hash, so it stays serial.
+	space->numPairs = 0;
+	cpSpatialIndexEach(space->activeShapes, &active2staticGatherIter, space);
+	cpSpatialIndexQueryRehash(space->activeShapes, &queryGatherFunc, space);
+	
+	// Narrow-phase collision detection.
+	cpWorkerPoolRun(pool, &collideJob, &step);
+	
+	// Pass the contacts through the collision pair functions in broadphase order.
+	for(int i=0; i<space->numPairs; i++){
+		cpSpacePair *pair = &space->pairs[i];
+		if(pair->numContacts)
+			queryCommit(space, pair->a, pair->b, pair->pairFunc, pair->contacts, pair->numContacts);
+	}
+	
+	// Prestep and solve the colored constraints.
+	colorConstraints(space);
+	cpWorkerPoolRun(pool, &solverJob, &step);
+	
+	// Integrate positions.
+	cpWorkerPoolRun(pool, &updatePositionJob, &step);
+	
+	// Increment the stamp.
+	space->stamp++;
+}
+
+int
+cpSpaceAllocations(cpSpace *space)
+{
+	return space->allocations
+		+ space->contactSet->allocations
+		+ space->collFuncSet->allocations
+		+ cpSpatialIndexAllocations(space->staticShapes)
+		+ cpSpatialIndexAllocations(space->activeShapes);
+}
+
+static void
+serialStep(cpSpace *space, cpFloat dt)
 {
-	if(!dt) return; // prevents div by zero.
 	cpFloat dt_inv = 1.0f/dt;
 
 	cpArray *bodies = space->bodies;
@@ -426,6 +969,7 @@ cpSpaceStep(cpSpace *space, cpFloat dt)
 	// Empty the arbiter list.
 	cpHashSetReject(space->contactSet, &contactSetReject, space);
 	space->arbiters->num = 0;
+	pushContactBuffer(space, 0);
 	
 	// Integrate velocities.
 	cpFloat damping = pow(1.0f/space->damping, -dt);
@@ -433,11 +977,11 @@ cpSpaceStep(cpSpace *space, cpFloat dt)
 		cpBodyUpdateVelocity((cpBody *)bodies->arr[i], space->gravity, damping, dt);
 	
 	// Pre-cache BBoxes and shape data.
-	cpSpaceHashEach(space->activeShapes, &updateBBCache, NULL);
+	cpSpatialIndexEach(space->activeShapes, &updateBBCache, NULL);
 	
 	// Collide!
-	cpSpaceHashEach(space->activeShapes, &active2staticIter, space);
-	cpSpaceHashQueryRehash(space->activeShapes, &queryFunc, space);
+	cpSpatialIndexEach(space->activeShapes, &active2staticIter, space);
+	cpSpatialIndexQueryRehash(space->activeShapes, &queryFunc, space);
 	
 	// Prestep the arbiters.
 	for(int i=0; i<arbiters->num; i++)
@@ -471,3 +1015,20 @@ cpSpaceStep(cpSpace *space, cpFloat dt)
 	// Increment the stamp.
 	space->stamp++;
 }
+
+void
+cpSpaceStep(cpSpace *space, cpFloat dt)
+{
+	if(!dt) return; // prevents div by zero.
+	
+	int allocations = cpSpaceAllocations(space);
+	space->stepStats.contacts = 0;
+	space->stepStats.arbiters = 0;
+	
+	if(space->threads > 1 || space->deterministic)
+		threadedStep(space, dt);
+	else
+		serialStep(space, dt);
+	
+	space->stepStats.allocations = cpSpaceAllocations(space) - allocations;
+}
@@ -34,6 +34,17 @@ typedef struct cpCollPairFunc {
 	void *data;
 } cpCollPairFunc;
 
+// Allocation statistics of the last call to cpSpaceStep().
+typedef struct cpSpaceStepStats {
+	// Heap allocations made by the pools, hash sets and spatial hashes.
+	// Drops to zero once the pools are large enough for the scene.
+	int allocations;
+	// Contacts the collision pair functions accepted.
+	int contacts;
+	// Arbiters taken from the arbiter pool.
+	int arbiters;
+} cpSpaceStepStats;
+
 typedef struct cpSpace{
 	// Number of iterations to use in the impulse solver.
 	int iterations;
@@ -46,9 +57,9 @@ typedef struct cpSpace{
 	// Time stamp. Is incremented on every call to cpSpaceStep().
 	int stamp;
 
-	// The static and active shape spatial hashes.
-	cpSpaceHash *staticShapes;
-	cpSpaceHash *activeShapes;
+	// The static and active shape spatial indexes. (cpSpaceHash by default)
+	cpSpatialIndex *staticShapes;
+	cpSpatialIndex *activeShapes;
 	
 	// List of bodies in the system.
 	cpArray *bodies;
@@ -64,6 +75,35 @@ typedef struct cpSpace{
 	cpHashSet *collFuncSet;
 	// Default collision pair function.
 	cpCollPairFunc defaultPairFunc;
+	
+	// Number of threads used by cpSpaceStep(). Use cpSpaceSetThreads() to change it.
+	int threads;
+	// When set, the colored solver of the threaded step is also used when
+	// running on a single thread. Results then don't depend on the thread count.
+	int deterministic;
+	
+	// Used internally by the threaded step.
+	cpWorkerPool *workers;
+	// Flattened list of the active shapes.
+	cpArray *shapeList;
+	// Collision pairs found by the broadphase, waiting for the narrow-phase.
+	struct cpSpacePair *pairs;
+	int numPairs, maxPairs;
+	// Constraints sorted by color and the start of each color in that list.
+	struct cpSolverItem *solverItems;
+	int maxSolverItems;
+	int *colorStart;
+	int numColors;
+	
+	// Unused arbiters and the blocks of memory the arbiters were allocated in.
+	cpArray *pooledArbiters;
+	cpArray *allocatedBuffers;
+	// Ring of contact buffers, points to the newest one.
+	struct cpContactBuffer *contactBuffersHead;
+	// Heap allocations made by the space itself.
+	int allocations;
+	// Allocation statistics of the last step.
+	cpSpaceStepStats stepStats;
 } cpSpace;
 
 // Basic allocation/destruction functions.
@@ -99,9 +139,20 @@ typedef void (*cpSpaceBodyIterator)(cpBody *body, void *data);
 void cpSpaceEachBody(cpSpace *space, cpSpaceBodyIterator func, void *data);
 
 // Spatial hash management functions.
+// Resizing only has an effect when the space uses a cpSpaceHash.
 void cpSpaceResizeStaticHash(cpSpace *space, cpFloat dim, int count);
 void cpSpaceResizeActiveHash(cpSpace *space, cpFloat dim, int count);
 void cpSpaceRehashStatic(cpSpace *space);
 
+// Switch the broadphase of the space. The shapes are moved to the new indexes.
+// CP_BB_TREE doesn't need any tuning and handles mixed object sizes better.
+void cpSpaceSetSpatialIndex(cpSpace *space, cpSpatialIndexType type);
+
+// Set the number of threads used by cpSpaceStep(). 1 (the default) runs the classic serial step.
+void cpSpaceSetThreads(cpSpace *space, int threads);
+
 // Update the space.
 void cpSpaceStep(cpSpace *space, cpFloat dt);
+
+// Total number of heap allocations made by the space and its pools so far.
+int cpSpaceAllocations(cpSpace *space);
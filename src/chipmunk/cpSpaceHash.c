@@ -27,11 +27,7 @@
 #include "chipmunk.h"
 #include "prime.h"
 
-static cpHandle*
-cpHandleAlloc(void)
-{
-	return (cpHandle *)malloc(sizeof(cpHandle));
-}
+static void freeWrap(void *ptr, void *unused){cpfree(ptr);}
 
 static cpHandle*
 cpHandleInit(cpHandle *hand, void *obj)
@@ -43,47 +39,59 @@ cpHandleInit(cpHandle *hand, void *obj)
 	return hand;
 }
 
+// Get a recycled handle, or allocate a new block of them.
 static cpHandle*
-cpHandleNew(void *obj)
+cpHandleAlloc(cpSpaceHash *hash)
 {
-	return cpHandleInit(cpHandleAlloc(), obj);
+	if(hash->pooledHandles->num)
+		return (cpHandle *)cpArrayPop(hash->pooledHandles);
+	
+	int count = CP_BUFFER_BYTES/sizeof(cpHandle);
+	cpHandle *buffer = (cpHandle *)cpmalloc(count*sizeof(cpHandle));
+	cpArrayPush(hash->allocatedBuffers, buffer);
+	hash->allocations++;
+	
+	// Keep the first handle, pool the rest.
+	for(int i=1; i<count; i++) cpArrayPush(hash->pooledHandles, buffer + i);
+	return buffer;
 }
 
-static inline void
-cpHandleRetain(cpHandle *hand)
+static cpHandle*
+cpHandleNew(cpSpaceHash *hash, void *obj)
 {
-	hand->retain++;
+	return cpHandleInit(cpHandleAlloc(hash), obj);
 }
 
 static inline void
-cpHandleFree(cpHandle *hand)
+cpHandleRetain(cpHandle *hand)
 {
-	free(hand);
+	hand->retain++;
 }
 
 static inline void
-cpHandleRelease(cpHandle *hand)
+cpHandleRelease(cpSpaceHash *hash, cpHandle *hand)
 {
 	hand->retain--;
 	if(hand->retain == 0)
-		cpHandleFree(hand);
+		cpArrayPush(hash->pooledHandles, hand);
 }
 
 
 cpSpaceHash*
 cpSpaceHashAlloc(void)
 {
-	return (cpSpaceHash *)calloc(1, sizeof(cpSpaceHash));
+	return (cpSpaceHash *)cpcalloc(1, sizeof(cpSpaceHash));
 }
 
 // Frees the old table, and allocates a new one.
 static void
 cpSpaceHashAllocTable(cpSpaceHash *hash, int numcells)
 {
-	free(hash->table);
+	cpfree(hash->table);
 	
 	hash->numcells = numcells;
-	hash->table = (cpSpaceHashBin **)calloc(numcells, sizeof(cpSpaceHashBin *));
+	hash->table = (cpSpaceHashBin **)cpcalloc(numcells, sizeof(cpSpaceHashBin *));
+	hash->allocations++;
 }
 
 // Equality function for the handleset.
@@ -96,17 +104,21 @@ handleSetEql(void *obj, void *elt)
 
 // Transformation function for the handleset.
 static void *
-handleSetTrans(void *obj, void *unused)
+handleSetTrans(void *obj, void *data)
 {
-	cpHandle *hand = cpHandleNew(obj);
+	cpHandle *hand = cpHandleNew((cpSpaceHash *)data, obj);
 	cpHandleRetain(hand);
 	
 	return hand;
 }
 
+static const cpSpatialIndexClass spaceHashClass;
+
 cpSpaceHash*
 cpSpaceHashInit(cpSpaceHash *hash, cpFloat celldim, int numcells, cpSpaceHashBBFunc bbfunc)
 {
+	hash->index.klass = &spaceHashClass;
+	hash->allocations = 0;
 	cpSpaceHashAllocTable(hash, next_prime(numcells));
 	hash->celldim = celldim;
 	hash->bbfunc = bbfunc;
@@ -114,6 +126,9 @@ cpSpaceHashInit(cpSpaceHash *hash, cpFloat celldim, int numcells, cpSpaceHashBBF
 	hash->bins = NULL;
 	hash->handleSet = cpHashSetNew(0, &handleSetEql, &handleSetTrans);
 	
+	hash->pooledHandles = cpArrayNew(0);
+	hash->allocatedBuffers = cpArrayNew(0);
+	
 	hash->stamp = 1;
 	
 	return hash;
@@ -133,7 +148,7 @@ clearHashCell(cpSpaceHash *hash, int index)
 		cpSpaceHashBin *next = bin->next;
 		
 		// Release the lock on the handle.
-		cpHandleRelease(bin->handle);
+		cpHandleRelease(hash, bin->handle);
 		// Recycle the bin.
 		bin->next = hash->bins;
 		hash->bins = bin;
@@ -152,37 +167,17 @@ clearHash(cpSpaceHash *hash)
 		clearHashCell(hash, i);
 }
 
-// Free the recycled hash bins.
-static void
-freeBins(cpSpaceHash *hash)
-{
-	cpSpaceHashBin *bin = hash->bins;
-	while(bin){
-		cpSpaceHashBin *next = bin->next;
-		free(bin);
-		bin = next;
-	}
-}
-
-// Hashset iterator function to free the handles.
-static void
-handleFreeWrap(void *elt, void *unused)
-{
-	cpHandle *hand = (cpHandle *)elt;
-	cpHandleFree(hand);
-}
-
 void
 cpSpaceHashDestroy(cpSpaceHash *hash)
 {
-	clearHash(hash);
-	freeBins(hash);
-	
-	// Free the handles.
-	cpHashSetEach(hash->handleSet, &handleFreeWrap, NULL);
 	cpHashSetFree(hash->handleSet);
 	
-	free(hash->table);
+	// Free the handles and bins.
+	cpArrayEach(hash->allocatedBuffers, &freeWrap, NULL);
+	cpArrayFree(hash->allocatedBuffers);
+	cpArrayFree(hash->pooledHandles);
+	
+	cpfree(hash->table);
 }
 
 void
@@ -190,7 +185,7 @@ cpSpaceHashFree(cpSpaceHash *hash)
 {
 	if(!hash) return;
 	cpSpaceHashDestroy(hash);
-	free(hash);
+	cpfree(hash);
 }
 
 void
@@ -215,17 +210,29 @@ containsHandle(cpSpaceHashBin *bin, cpHandle *hand)
 	return 0;
 }
 
-// Get a recycled or new bin.
+// Get a recycled bin, or allocate a new block of them.
 static inline cpSpaceHashBin *
 getEmptyBin(cpSpaceHash *hash)
 {
 	cpSpaceHashBin *bin = hash->bins;
 	
-	// Make a new one if necessary.
-	if(bin == NULL) return (cpSpaceHashBin *)malloc(sizeof(cpSpaceHashBin));
-
-	hash->bins = bin->next;
-	return bin;
+	if(bin){
+		hash->bins = bin->next;
+		return bin;
+	}
+	
+	int count = CP_BUFFER_BYTES/sizeof(cpSpaceHashBin);
+	cpSpaceHashBin *buffer = (cpSpaceHashBin *)cpmalloc(count*sizeof(cpSpaceHashBin));
+	cpArrayPush(hash->allocatedBuffers, buffer);
+	hash->allocations++;
+	
+	// Keep the first bin, recycle the rest.
+	for(int i=1; i<count; i++){
+		buffer[i].next = hash->bins;
+		hash->bins = buffer + i;
+	}
+	
+	return buffer;
 }
 
 // The hash function itself.
@@ -267,7 +274,7 @@ hashHandle(cpSpaceHash *hash, cpHandle *hand, cpBB bb)
 void
 cpSpaceHashInsert(cpSpaceHash *hash, void *obj, unsigned int id, cpBB bb)
 {
-	cpHandle *hand = (cpHandle *)cpHashSetInsert(hash->handleSet, id, obj, NULL);
+	cpHandle *hand = (cpHandle *)cpHashSetInsert(hash->handleSet, id, obj, hash);
 	hashHandle(hash, hand, bb);
 }
 
@@ -302,7 +309,13 @@ cpSpaceHashRemove(cpSpaceHash *hash, void *obj, unsigned int id)
 {
 	cpHandle *hand = (cpHandle *)cpHashSetRemove(hash->handleSet, id, obj);
 	hand->obj = NULL;
-	cpHandleRelease(hand);
+	cpHandleRelease(hash, hand);
+}
+
+int
+cpSpaceHashAllocations(cpSpaceHash *hash)
+{
+	return hash->allocations + hash->handleSet->allocations;
 }
 
 // Used by the cpSpaceHashEach() iterator.
@@ -437,3 +450,79 @@ cpSpaceHashQueryRehash(cpSpaceHash *hash, cpSpaceHashQueryFunc func, void *data)
 	queryRehashPair pair = {hash, func, data};
 	cpHashSetEach(hash->handleSet, &handleQueryRehashHelper, &pair);
 }
+
+// cpSpatialIndex interface.
+
+static void
+indexDestroy(cpSpatialIndex *index)
+{
+	cpSpaceHashDestroy((cpSpaceHash *)index);
+}
+
+static void
+indexInsert(cpSpatialIndex *index, void *obj, unsigned int id, cpBB bb)
+{
+	cpSpaceHashInsert((cpSpaceHash *)index, obj, id, bb);
+}
+
+static void
+indexRemove(cpSpatialIndex *index, void *obj, unsigned int id)
+{
+	cpSpaceHashRemove((cpSpaceHash *)index, obj, id);
+}
+
+static void
+indexEach(cpSpatialIndex *index, cpSpatialIndexIterator func, void *data)
+{
+	cpSpaceHashEach((cpSpaceHash *)index, func, data);
+}
+
+static void
+indexRehash(cpSpatialIndex *index)
+{
+	cpSpaceHashRehash((cpSpaceHash *)index);
+}
+
+static void
+indexRehashObject(cpSpatialIndex *index, void *obj, unsigned int id)
+{
+	cpSpaceHashRehashObject((cpSpaceHash *)index, obj, id);
+}
+
+static void
+indexQuery(cpSpatialIndex *index, void *obj, cpBB bb, cpSpatialIndexQueryFunc func, void *data)
+{
+	cpSpaceHashQuery((cpSpaceHash *)index, obj, bb, func, data);
+}
+
+static void
+indexQueryRehash(cpSpatialIndex *index, cpSpatialIndexQueryFunc func, void *data)
+{
+	cpSpaceHashQueryRehash((cpSpaceHash *)index, func, data);
+}
+
+static void
+indexResize(cpSpatialIndex *index, cpFloat celldim, int numcells)
+{
+	cpSpaceHashResize((cpSpaceHash *)index, celldim, numcells);
+}
+
+static int
+indexAllocations(cpSpatialIndex *index)
+{
+	return cpSpaceHashAllocations((cpSpaceHash *)index);
+}
+
+static const cpSpatialIndexClass spaceHashClass = {
+	CP_SPACE_HASH,
+	indexDestroy,
+	indexInsert,
+	indexRemove,
+	indexEach,
+	indexRehash,
+	indexRehashObject,
+	indexQuery,
+	indexQueryRehash,
+	indexResize,
+	indexAllocations,
+};
@@ -43,6 +43,9 @@ typedef struct cpSpaceHashBin{
 typedef cpBB (*cpSpaceHashBBFunc)(void *obj);
 
 typedef struct cpSpaceHash{
+	// Spatial index interface, see cpSpatialIndex.h.
+	cpSpatialIndex index;
+	
 	// Number of cells in the table.
 	int numcells;
 	// Dimentions of the cells.
@@ -57,6 +60,11 @@ typedef struct cpSpaceHash{
 	cpSpaceHashBin **table;
 	// List of recycled bins.
 	cpSpaceHashBin *bins;
+	// Recycled handles and the blocks of memory the handles and bins were allocated in.
+	cpArray *pooledHandles;
+	cpArray *allocatedBuffers;
+	// Number of heap allocations made by the hash for bins, handles and tables.
+	int allocations;
 
 	// Incremented on each query. See cpHandle.stamp.
 	int stamp;
@@ -88,6 +96,9 @@ void cpSpaceHashRehash(cpSpaceHash *hash);
 // Rehash only a specific object.
 void cpSpaceHashRehashObject(cpSpaceHash *hash, void *obj, unsigned int id);
 
+// Total number of heap allocations made by the hash, including its handle set.
+int cpSpaceHashAllocations(cpSpaceHash *hash);
+
 // Query callback.
 typedef int (*cpSpaceHashQueryFunc)(void *obj1, void *obj2, void *data);
 // Query the hash for a given BBox.
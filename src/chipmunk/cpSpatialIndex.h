@@ -0,0 +1,135 @@
+/* Copyright (c) 2007 Scott Lembcke
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+ 
+// cpSpatialIndex is the interface shared by the broadphase data structures.
+// cpSpace only talks to its static and active shapes through it, so the
+// spatial hash (cpSpaceHash) and the dynamic AABB tree (cpBBTree) can be swapped.
+
+typedef struct cpSpatialIndex cpSpatialIndex;
+
+// BBox callback. Called whenever the index needs a bounding box from an object.
+typedef cpBB (*cpSpatialIndexBBFunc)(void *obj);
+// Iterator function.
+typedef void (*cpSpatialIndexIterator)(void *obj, void *data);
+// Query callback.
+typedef int (*cpSpatialIndexQueryFunc)(void *obj1, void *obj2, void *data);
+
+typedef enum cpSpatialIndexType {
+	CP_SPACE_HASH,
+	CP_BB_TREE
+} cpSpatialIndexType;
+
+// Function table of an index implementation.
+typedef struct cpSpatialIndexClass {
+	cpSpatialIndexType type;
+	
+	void (*destroy)(cpSpatialIndex *index);
+	
+	void (*insert)(cpSpatialIndex *index, void *obj, unsigned int id, cpBB bb);
+	void (*remove)(cpSpatialIndex *index, void *obj, unsigned int id);
+	void (*each)(cpSpatialIndex *index, cpSpatialIndexIterator func, void *data);
+	
+	void (*rehash)(cpSpatialIndex *index);
+	void (*rehashObject)(cpSpatialIndex *index, void *obj, unsigned int id);
+	
+	void (*query)(cpSpatialIndex *index, void *obj, cpBB bb, cpSpatialIndexQueryFunc func, void *data);
+	void (*queryRehash)(cpSpatialIndex *index, cpSpatialIndexQueryFunc func, void *data);
+	
+	// Tuning hint for indexes with a fixed cell size. Ignored by the others.
+	void (*resize)(cpSpatialIndex *index, cpFloat celldim, int numcells);
+	// Number of heap allocations made by the index so far.
+	int (*allocations)(cpSpatialIndex *index);
+} cpSpatialIndexClass;
+
+// Must be the first member of every index implementation.
+struct cpSpatialIndex {
+	const cpSpatialIndexClass *klass;
+};
+
+// Destroys and frees an index created by cpSpaceHashNew() or cpBBTreeNew().
+void cpSpatialIndexFree(cpSpatialIndex *index);
+
+static inline cpSpatialIndexType
+cpSpatialIndexGetType(cpSpatialIndex *index)
+{
+	return index->klass->type;
+}
+
+// Add an object to the index.
+static inline void
+cpSpatialIndexInsert(cpSpatialIndex *index, void *obj, unsigned int id, cpBB bb)
+{
+	index->klass->insert(index, obj, id, bb);
+}
+
+// Remove an object from the index.
+static inline void
+cpSpatialIndexRemove(cpSpatialIndex *index, void *obj, unsigned int id)
+{
+	index->klass->remove(index, obj, id);
+}
+
+// Iterate over the objects in the index.
+static inline void
+cpSpatialIndexEach(cpSpatialIndex *index, cpSpatialIndexIterator func, void *data)
+{
+	index->klass->each(index, func, data);
+}
+
+// Update the index for the current bounding boxes of all objects.
+static inline void
+cpSpatialIndexRehash(cpSpatialIndex *index)
+{
+	index->klass->rehash(index);
+}
+
+// Update a specific object only.
+static inline void
+cpSpatialIndexRehashObject(cpSpatialIndex *index, void *obj, unsigned int id)
+{
+	index->klass->rehashObject(index, obj, id);
+}
+
+// Call func for the objects that might overlap bb.
+static inline void
+cpSpatialIndexQuery(cpSpatialIndex *index, void *obj, cpBB bb, cpSpatialIndexQueryFunc func, void *data)
+{
+	index->klass->query(index, obj, bb, func, data);
+}
+
+// Rehash the index and call func once for every pair of objects that might overlap.
+static inline void
+cpSpatialIndexQueryRehash(cpSpatialIndex *index, cpSpatialIndexQueryFunc func, void *data)
+{
+	index->klass->queryRehash(index, func, data);
+}
+
+static inline void
+cpSpatialIndexResize(cpSpatialIndex *index, cpFloat celldim, int numcells)
+{
+	index->klass->resize(index, celldim, numcells);
+}
+
+static inline int
+cpSpatialIndexAllocations(cpSpatialIndex *index)
+{
+	return index->klass->allocations(index);
+}
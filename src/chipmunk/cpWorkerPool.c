@@ -0,0 +1,195 @@
+/* Copyright (c) 2007 Scott Lembcke
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+ 
+#include <stdlib.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "chipmunk.h"
+
+struct cpWorkerPool {
+	// Number of threads taking part in a job, including the calling thread.
+	int numThreads;
+	pthread_t *threads;
+	
+	pthread_mutex_t lock;
+	pthread_cond_t start;
+	pthread_cond_t done;
+	
+	// Incremented for every job. Workers wait for it to change.
+	int generation;
+	// Number of workers that haven't finished the current job.
+	int pending;
+	int quit;
+	
+	// The current job.
+	cpWorkerFunc func;
+	void *data;
+	
+	// Sense reversing barrier used by cpWorkerPoolSync().
+	volatile int barrierCount;
+	volatile int barrierSense;
+	int *localSense;
+};
+
+// Start up data for a worker thread.
+typedef struct workerArg {
+	cpWorkerPool *pool;
+	int index;
+} workerArg;
+
+static void *
+workerMain(void *ptr)
+{
+	workerArg *arg = (workerArg *)ptr;
+	cpWorkerPool *pool = arg->pool;
+	int index = arg->index;
+	cpfree(arg);
+	
+	// Jobs can only be started after the pool is created, so no job was missed yet.
+	int seen = 0;
+	pthread_mutex_lock(&pool->lock);
+	
+	for(;;){
+		while(pool->generation == seen && !pool->quit)
+			pthread_cond_wait(&pool->start, &pool->lock);
+		if(pool->quit) break;
+		
+		seen = pool->generation;
+		cpWorkerFunc func = pool->func;
+		void *data = pool->data;
+		pthread_mutex_unlock(&pool->lock);
+		
+		func(pool, index, data);
+		
+		pthread_mutex_lock(&pool->lock);
+		pool->pending--;
+		if(pool->pending == 0) pthread_cond_signal(&pool->done);
+	}
+	
+	pthread_mutex_unlock(&pool->lock);
+	return NULL;
+}
+
+cpWorkerPool *
+cpWorkerPoolNew(int threads)
+{
+	cpWorkerPool *pool = (cpWorkerPool *)cpcalloc(1, sizeof(cpWorkerPool));
+	
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->start, NULL);
+	pthread_cond_init(&pool->done, NULL);
+	
+	if(threads < 1) threads = 1;
+	pool->localSense = (int *)cpcalloc(threads, sizeof(int));
+	pool->threads = (pthread_t *)cpcalloc(threads, sizeof(pthread_t));
+	pool->numThreads = 1;
+	
+	// Worker 0 is the calling thread.
+	for(int i=1; i<threads; i++){
+		workerArg *arg = (workerArg *)cpmalloc(sizeof(workerArg));
+		arg->pool = pool;
+		arg->index = i;
+		
+		if(pthread_create(&pool->threads[i], NULL, &workerMain, arg)){
+			// Run with whatever we managed to start.
+			cpfree(arg);
+			break;
+		}
+		
+		pool->numThreads++;
+	}
+	
+	return pool;
+}
+
+void
+cpWorkerPoolFree(cpWorkerPool *pool)
+{
+	if(!pool) return;
+	
+	pthread_mutex_lock(&pool->lock);
+	pool->quit = 1;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->lock);
+	
+	for(int i=1; i<pool->numThreads; i++)
+		pthread_join(pool->threads[i], NULL);
+	
+	pthread_cond_destroy(&pool->done);
+	pthread_cond_destroy(&pool->start);
+	pthread_mutex_destroy(&pool->lock);
+	
+	cpfree(pool->threads);
+	cpfree(pool->localSense);
+	cpfree(pool);
+}
+
+int
+cpWorkerPoolThreads(cpWorkerPool *pool)
+{
+	return pool->numThreads;
+}
+
+void
+cpWorkerPoolRun(cpWorkerPool *pool, cpWorkerFunc func, void *data)
+{
+	if(pool->numThreads == 1){
+		func(pool, 0, data);
+		return;
+	}
+	
+	pthread_mutex_lock(&pool->lock);
+	pool->func = func;
+	pool->data = data;
+	pool->pending = pool->numThreads - 1;
+	pool->generation++;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->lock);
+	
+	func(pool, 0, data);
+	
+	pthread_mutex_lock(&pool->lock);
+	while(pool->pending)
+		pthread_cond_wait(&pool->done, &pool->lock);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+void
+cpWorkerPoolSync(cpWorkerPool *pool, int index)
+{
+	if(pool->numThreads == 1) return;
+	
+	int sense = !pool->localSense[index];
+	pool->localSense[index] = sense;
+	
+	if(__sync_add_and_fetch(&pool->barrierCount, 1) == pool->numThreads){
+		// Last one in releases everybody else.
+		pool->barrierCount = 0;
+		__sync_synchronize();
+		pool->barrierSense = sense;
+	} else {
+		while(pool->barrierSense != sense)
+			sched_yield();
+	}
+	
+	__sync_synchronize();
+}
@@ -0,0 +1,53 @@
+/* Copyright (c) 2007 Scott Lembcke
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+ 
+// cpWorkerPool is a tiny fork/join thread pool used by the threaded cpSpaceStep().
+// The calling thread always takes part in a job as worker 0, so a pool with a
+// single thread never creates any threads and simply runs the job inline.
+
+typedef struct cpWorkerPool cpWorkerPool;
+
+// Job callback. Called once on every thread of the pool with the thread's index.
+typedef void (*cpWorkerFunc)(cpWorkerPool *pool, int index, void *data);
+
+// Basic allocation/destruction functions.
+cpWorkerPool *cpWorkerPoolNew(int threads);
+void cpWorkerPoolFree(cpWorkerPool *pool);
+
+// Number of threads taking part in a job. (including the caller)
+int cpWorkerPoolThreads(cpWorkerPool *pool);
+
+// Run func on all threads of the pool and wait until every thread has returned.
+void cpWorkerPoolRun(cpWorkerPool *pool, cpWorkerFunc func, void *data);
+
+// Wait until all threads of the pool reached this point of the current job.
+// Only valid from inside a cpWorkerFunc.
+void cpWorkerPoolSync(cpWorkerPool *pool, int index);
+
+// Get the contiguous slice [*start, *end) of count elements that belongs to thread index.
+// The split only depends on count and the number of threads.
+static inline void
+cpWorkerPoolRange(cpWorkerPool *pool, int index, int count, int *start, int *end)
+{
+	int threads = cpWorkerPoolThreads(pool);
+	*start = (int)(((long long)count*index)/threads);
+	*end = (int)(((long long)count*(index + 1))/threads);
+}
@@ -3,6 +3,7 @@
 */
 #include    "hgeRandom.h"
 #include    "Common.h"
+#include    "InputRecorder.h"
 
 namespace HGE {
 
@@ -11,7 +12,7 @@ unsigned int g_seed=0;
 void Random_Seed(int seed)
 {
     if(!seed) g_seed=Sexy::Rand();
-    else g_seed=seed;
+    else g_seed=Sexy::InputRecorder::FilterSeed(seed);
 }
 
 float Random_Float(float min, float max)
@@ -24,6 +24,8 @@
 #include "SWTri.h"
 #include "PakInterface.h"
 #include "Logging.h"
+#include "FrameCounters.h"
+#include "MemoryStats.h"
 
 #include "hgeparticle.h"
 #include "hgeRandom.h"
@@ -155,6 +157,8 @@ InfoCache * InfoCache::lookup_add(const std::string & fname)
     ic->_info.fColorVar = ic->getFloat(120);
     ic->_info.fAlphaVar = ic->getFloat(124);
 
+    // Kept until exit
+    Sexy::MemoryStats::Alloc(Sexy::MemoryTag_Particles, sizeof(InfoCache) + ic->_bufsize);
     _cache[fname] = ic;
     return ic;
 }
@@ -191,6 +195,21 @@ float InfoCache::getFloat(int offset) const
 #endif
 }
 
+void* hgeParticleSystem::operator new(size_t size)
+{
+    void* p = ::operator new(size);
+    Sexy::MemoryStats::Alloc(Sexy::MemoryTag_Particles, size);
+    return p;
+}
+
+void hgeParticleSystem::operator delete(void* p, size_t size)
+{
+    if (p == NULL)
+        return;
+    Sexy::MemoryStats::Free(Sexy::MemoryTag_Particles, size);
+    ::operator delete(p);
+}
+
 hgeParticleSystem::hgeParticleSystem(const char *filename, DDImage *sprite, float fps /*= 0.0f*/, bool parseMetaData /*= true*/, bool old_format /*=true*/) // Change default behavior in header
 {
     mLogFacil = NULL;
@@ -778,6 +797,7 @@ void hgeParticleSystem::Render(Graphics *g)
         g->SetDrawMode(Graphics::DRAWMODE_NORMAL);
 
     g->SetColorizeImages(true);
+    Sexy::FrameCounters::Add(Sexy::FrameCounter_Particles, nParticlesAlive);
     int i;
     //DWORD col;
     hgeParticle *par = particles;
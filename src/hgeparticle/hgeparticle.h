@@ -120,6 +120,10 @@ public:
     hgeParticleSystem(const hgeParticleSystem &ps);
     virtual ~hgeParticleSystem() {}
 
+    // Counted as MemoryTag_Particles, the particles are part of the object
+    static void*                operator new(size_t size);
+    static void                 operator delete(void* p, size_t size);
+
 #ifdef DEBUG
     void                        dumpInfo(const char *fname) const;
 #endif
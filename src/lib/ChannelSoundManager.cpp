@@ -0,0 +1,339 @@
+#include "ChannelSoundManager.h"
+#include "SexyAppBase.h"
+#include "PakInterface.h"
+
+using namespace Sexy;
+using namespace std;
+
+ChannelSoundInstance::ChannelSoundInstance()
+{
+    mSfxID = 0;
+    mPlayOrder = 0;
+    mAutoRelease = false;
+    mReleased = false;
+    mHasPlayed = false;
+
+    mBaseVolume = 1.0f;
+    mBasePan = 0.0f;
+    mBasePitch = 1.0f;
+
+    mVolume = 1.0f;
+    mPan = 0.0f;
+    mPitch = 1.0f;
+}
+
+ChannelSoundManager::ChannelSoundManager()
+{
+    mCullVolume = 0.0f;
+    mPlayCount = 0;
+    mMutex = SDL_CreateMutex();
+}
+
+// The derived manager has released its channels and sounds by now
+ChannelSoundManager::~ChannelSoundManager()
+{
+    for (size_t i = 0; i < mFreeInstances.size(); i++)
+        delete mFreeInstances[i];
+    mFreeInstances.clear();
+    for (size_t i = 0; i < mHeldInstances.size(); i++)
+        delete mHeldInstances[i];
+    mHeldInstances.clear();
+
+    SDL_DestroyMutex(mMutex);
+}
+
+// With mMutex held
+void ChannelSoundManager::GrowSoundTable(unsigned int theSize)
+{
+    if (theSize <= mBaseVolumes.size())
+        return;
+
+    mBaseVolumes.resize(theSize, 1.0f);
+    mBasePans.resize(theSize, 0);
+    mBasePitches.resize(theSize, 1.0f);
+    mPriorities.resize(theSize, 0);
+    mMaxInstances.resize(theSize, 0);
+}
+
+string ChannelSoundManager::GetSoundFileName(const string& theFilename)
+{
+    if (GetPakPtr()->isLoaded())
+        return ReplaceBackSlashes(theFilename);
+
+    // Use relative path to AppResource if name does not start with slash
+    return gSexyAppBase->GetAppResourceFileName(theFilename);
+}
+
+// Returns a free channel for theSfxID, taking one over from a fire and
+// forget sound if it has to. -1 if there is nothing that may be stopped.
+int ChannelSoundManager::FindFreeChannel(unsigned int theSfxID)
+{
+    int aPriority = mPriorities[theSfxID];
+    int aFreeChannel = -1;
+    int aVictim = -1;
+    int aNumInstances = 0;
+    int anOldestInstance = -1;
+
+    for (int i = 0; i < (int) mPlayingSounds.size(); i++)
+    {
+        ChannelSoundInstance* anInstance = mPlayingSounds[i];
+        if (anInstance != NULL && anInstance->IsReleased())
+        {
+            FreeChannel(i);
+            anInstance = NULL;
+        }
+
+        if (anInstance == NULL)
+        {
+            if (aFreeChannel < 0)
+                aFreeChannel = i;
+            continue;
+        }
+
+        // Sounds somebody holds on to are never stopped behind their back
+        bool canSteal = anInstance->mAutoRelease && anInstance->mHasPlayed;
+
+        if (anInstance->mSfxID == theSfxID)
+        {
+            aNumInstances++;
+            if (canSteal && (anOldestInstance < 0 || anInstance->mPlayOrder < mPlayingSounds[anOldestInstance]->mPlayOrder))
+                anOldestInstance = i;
+        }
+
+        if (!canSteal || mPriorities[anInstance->mSfxID] > aPriority)
+            continue;
+
+        // Lowest priority first, then the quietest, then the oldest
+        if (aVictim < 0)
+        {
+            aVictim = i;
+            continue;
+        }
+        ChannelSoundInstance* aVictimInstance = mPlayingSounds[aVictim];
+        int aVictimPriority = mPriorities[aVictimInstance->mSfxID];
+        int anInstancePriority = mPriorities[anInstance->mSfxID];
+        if (anInstancePriority != aVictimPriority)
+        {
+            if (anInstancePriority < aVictimPriority)
+                aVictim = i;
+            continue;
+        }
+        float aVictimVolume = aVictimInstance->mBaseVolume * aVictimInstance->mVolume;
+        float anInstanceVolume = anInstance->mBaseVolume * anInstance->mVolume;
+        if (anInstanceVolume != aVictimVolume)
+        {
+            if (anInstanceVolume < aVictimVolume)
+                aVictim = i;
+            continue;
+        }
+        if (anInstance->mPlayOrder < aVictimInstance->mPlayOrder)
+            aVictim = i;
+    }
+
+    if (mMaxInstances[theSfxID] > 0 && aNumInstances >= mMaxInstances[theSfxID])
+    {
+        // Make way by stopping the oldest one of its own
+        if (anOldestInstance >= 0)
+            FreeChannel(anOldestInstance);
+        return anOldestInstance;
+    }
+
+    if (aFreeChannel >= 0)
+        return aFreeChannel;
+
+    if (aVictim >= 0)
+        FreeChannel(aVictim);
+    return aVictim;
+}
+
+void ChannelSoundManager::FreeChannel(int theChannel)
+{
+    ChannelSoundInstance* anInstance = mPlayingSounds[theChannel];
+    if (anInstance == NULL)
+        return;
+
+    mPlayingSounds[theChannel] = NULL;
+
+    // Somebody still holds this one, it can't be handed out again before
+    // they let go of it
+    if (!anInstance->IsReleased() && !anInstance->mAutoRelease)
+    {
+        anInstance->Detach();
+        mHeldInstances.push_back(anInstance);
+        return;
+    }
+
+    if (!anInstance->mReleased)
+        anInstance->Release();
+    mFreeInstances.push_back(anInstance);
+}
+
+ChannelSoundInstance* ChannelSoundManager::TakeFreeInstance()
+{
+    for (size_t i = 0; i < mHeldInstances.size(); )
+    {
+        if (mHeldInstances[i]->mReleased)
+        {
+            mFreeInstances.push_back(mHeldInstances[i]);
+            mHeldInstances.erase(mHeldInstances.begin() + i);
+        }
+        else
+            i++;
+    }
+
+    if (mFreeInstances.empty())
+        return NULL;
+
+    ChannelSoundInstance* anInstance = mFreeInstances.back();
+    mFreeInstances.pop_back();
+    return anInstance;
+}
+
+void ChannelSoundManager::StartInstance(int theChannel, ChannelSoundInstance* theInstance)
+{
+    unsigned int anId = theInstance->mSfxID;
+    mPlayingSounds[theChannel] = theInstance;
+
+    theInstance->SetBasePan(mBasePans[anId]);
+    theInstance->SetBaseVolume(mBaseVolumes[anId]);
+    theInstance->AdjustBasePitch(mBasePitches[anId]);
+}
+
+ChannelSoundInstance* ChannelSoundManager::FindPlayingInstance(unsigned int theSfxID)
+{
+    for (size_t i = 0; i < mPlayingSounds.size(); i++)
+    {
+        if (mPlayingSounds[i] != NULL && !mPlayingSounds[i]->mReleased && mPlayingSounds[i]->mSfxID == theSfxID)
+            return mPlayingSounds[i];
+    }
+    return NULL;
+}
+
+int ChannelSoundManager::LoadSound(const string& theFilename)
+{
+    AutoMutex aLock(mMutex);
+    int id = GetFreeSoundId();
+
+    if (id != -1)
+    {
+        if (LoadSound(id, theFilename))
+            return id;
+    }
+    return -1;
+}
+
+int ChannelSoundManager::GetFreeSoundId()
+{
+    AutoMutex aLock(mMutex);
+    for (unsigned int i = 0; i < GetSoundTableSize(); ++i)
+    {
+        if (!IsSoundIdUsed(i))
+            return i;
+    }
+
+    // All taken, make room for more
+    int anId = GetSoundTableSize();
+    GrowSoundTable(anId + MAX_SOURCE_SOUNDS);
+    return anId;
+}
+
+bool ChannelSoundManager::SetBaseVolume(unsigned int theSfxID, double theBaseVolume)
+{
+    AutoMutex aLock(mMutex);
+    if (theSfxID >= GetSoundTableSize())
+        return false;
+
+    mBaseVolumes[theSfxID] = (float) theBaseVolume;
+    return true;
+}
+
+bool ChannelSoundManager::SetBasePan(unsigned int theSfxID, int theBasePan)
+{
+    AutoMutex aLock(mMutex);
+    if (theSfxID >= GetSoundTableSize())
+        return false;
+
+    mBasePans[theSfxID] = theBasePan;
+    return true;
+}
+
+bool ChannelSoundManager::SetBasePitch(unsigned int theSfxID, float theBasePitch)
+{
+    AutoMutex aLock(mMutex);
+    if (theSfxID >= GetSoundTableSize())
+        return false;
+
+    mBasePitches[theSfxID] = theBasePitch;
+    return true;
+}
+
+bool ChannelSoundManager::SetPriority(unsigned int theSfxID, int thePriority)
+{
+    AutoMutex aLock(mMutex);
+    if (theSfxID >= GetSoundTableSize())
+        return false;
+
+    mPriorities[theSfxID] = thePriority;
+    return true;
+}
+
+bool ChannelSoundManager::SetMaxInstances(unsigned int theSfxID, int theMaxInstances)
+{
+    AutoMutex aLock(mMutex);
+    if (theSfxID >= GetSoundTableSize())
+        return false;
+
+    mMaxInstances[theSfxID] = theMaxInstances;
+    return true;
+}
+
+void ChannelSoundManager::SetCullVolume(double theVolume)
+{
+    AutoMutex aLock(mMutex);
+    mCullVolume = (float) theVolume;
+}
+
+void ChannelSoundManager::ReleaseSounds()
+{
+    AutoMutex aLock(mMutex);
+    for (unsigned int i = 0; i < GetSoundTableSize(); i++)
+        ReleaseSound(i);
+}
+
+void ChannelSoundManager::ReleaseChannels()
+{
+    AutoMutex aLock(mMutex);
+    for (size_t i = 0; i < mPlayingSounds.size(); i++)
+        FreeChannel(i);
+}
+
+void ChannelSoundManager::StopAllSounds()
+{
+    AutoMutex aLock(mMutex);
+    for (size_t i = 0; i < mPlayingSounds.size(); i++)
+    {
+        if (mPlayingSounds[i] != NULL)
+        {
+            bool isAutoRelease = mPlayingSounds[i]->mAutoRelease;
+            mPlayingSounds[i]->Stop();
+            mPlayingSounds[i]->mAutoRelease = isAutoRelease;
+        }
+    }
+}
+
+void ChannelSoundManager::StopSound(int theSfxID)
+{
+    AutoMutex aLock(mMutex);
+    for (size_t i = 0; i < mPlayingSounds.size(); i++)
+        if (mPlayingSounds[i] != NULL && mPlayingSounds[i]->mSfxID == (unsigned int) theSfxID)
+            mPlayingSounds[i]->Stop();
+}
+
+bool ChannelSoundManager::IsSoundPlaying(int theSfxID)
+{
+    AutoMutex aLock(mMutex);
+    for (size_t i = 0; i < mPlayingSounds.size(); i++)
+        if (mPlayingSounds[i] != NULL && mPlayingSounds[i]->mSfxID == (unsigned int) theSfxID && mPlayingSounds[i]->IsPlaying())
+            return true;
+    return false;
+}
@@ -0,0 +1,113 @@
+#ifndef __CHANNELSOUNDMANAGER_H__
+#define __CHANNELSOUNDMANAGER_H__
+
+#ifndef WIN32
+#define HWND void*
+#endif
+
+#include "SoundManager.h"
+#include "SoundInstance.h"
+#include <SDL.h>
+#include <string>
+#include <vector>
+
+namespace Sexy
+{
+
+class ChannelSoundManager;
+
+// What ChannelSoundManager needs to know of the instances it hands out
+class ChannelSoundInstance : public SoundInstance
+{
+    friend class ChannelSoundManager;
+
+protected:
+    unsigned int            mSfxID;
+    Uint32                  mPlayOrder;     // For picking the oldest voice to steal
+    bool                    mAutoRelease;
+    bool                    mReleased;
+    bool                    mHasPlayed;
+
+    float                   mBaseVolume;
+    float                   mBasePan;
+    float                   mBasePitch;
+
+    float                   mVolume;
+    float                   mPan;
+    float                   mPitch;
+
+public:
+    ChannelSoundInstance();
+
+    virtual void            AdjustBasePitch(float thePitch) = 0; //+0.5 to +2.0 relative to normal playing speed
+    // Stops and lets go of the channel and the sound, without releasing
+    virtual void            Detach() = 0;
+};
+
+// The sound id tables, channels and voice stealing that the SDL_mixer and
+// the SoftMixer sound managers share. A derived manager keeps the sounds
+// themselves, grows its own tables along in GrowSoundTable() and makes
+// the instances, one per channel.
+//
+// The main thread and the ResourceManager's loading thread both use the
+// sound manager. mMutex guards the tables and the channels, every public
+// call takes it. It may be taken again by the thread holding it.
+class ChannelSoundManager : public SoundManager
+{
+protected:
+    std::vector<float>      mBaseVolumes;
+    std::vector<int>        mBasePans;
+    std::vector<float>      mBasePitches;
+    std::vector<int>        mPriorities;
+    std::vector<int>        mMaxInstances;
+    std::vector<ChannelSoundInstance*> mPlayingSounds;  // One per channel
+    std::vector<ChannelSoundInstance*> mFreeInstances;
+    std::vector<ChannelSoundInstance*> mHeldInstances;  // Detached, waiting on their owner's Release()
+    float                   mCullVolume;
+    Uint32                  mPlayCount;
+
+    SDL_mutex*              mMutex;
+
+protected:
+    unsigned int            GetSoundTableSize() { return mBaseVolumes.size(); }
+    virtual void            GrowSoundTable(unsigned int theSize);
+    // Loaded, or loading, so GetFreeSoundId() passes it by
+    virtual bool            IsSoundIdUsed(unsigned int theSfxID) = 0;
+    std::string             GetSoundFileName(const std::string& theFilename);
+
+    int                     FindFreeChannel(unsigned int theSfxID);
+    void                    FreeChannel(int theChannel);
+    // A pooled instance for the derived manager to Reset(), or NULL
+    ChannelSoundInstance*   TakeFreeInstance();
+    // Puts theInstance on theChannel with the base values of its sound
+    void                    StartInstance(int theChannel, ChannelSoundInstance* theInstance);
+    ChannelSoundInstance*   FindPlayingInstance(unsigned int theSfxID);
+
+public:
+    ChannelSoundManager();
+    virtual ~ChannelSoundManager();
+
+    virtual int             LoadSound(const std::string& theFilename);
+    virtual bool            LoadSound(unsigned int theSfxID, const std::string& theFilename) = 0;
+    virtual int             GetFreeSoundId();
+
+    virtual bool            SetBaseVolume(unsigned int theSfxID, double theBaseVolume);
+    virtual bool            SetBasePan(unsigned int theSfxID, int theBasePan);
+    virtual bool            SetBasePitch(unsigned int theSfxID, float theBasePitch);
+
+    virtual bool            SetPriority(unsigned int theSfxID, int thePriority);
+    virtual bool            SetMaxInstances(unsigned int theSfxID, int theMaxInstances);
+    virtual void            SetCullVolume(double theVolume);
+    int                     GetNumChannels() { return mPlayingSounds.size(); }
+
+    virtual void            ReleaseSounds();
+    virtual void            ReleaseChannels();
+
+    virtual void            StopAllSounds();
+    virtual void            StopSound(int theSfxID);
+    virtual bool            IsSoundPlaying(int theSfxID);
+};
+
+}
+
+#endif //__CHANNELSOUNDMANAGER_H__
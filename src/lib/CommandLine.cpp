@@ -3,6 +3,8 @@
 // A class to parse the command line options.
 //
 
+#include <stdlib.h>
+
 #include "Logging.h"
 #include "anyoption.h"
 #include "CommandLine.h"
@@ -51,6 +53,11 @@ bool CmdLine::ParseCommandLine(int argc, char** argv)
     opt->addUsage(" -p  --fps             ?");
     opt->setFlag("fps", 'p');
 
+    opt->addUsage("     --stats           show the per frame counters");
+    opt->setFlag("stats");
+    opt->addUsage("     --track-memory    account for the memory chipmunk allocates");
+    opt->setFlag("track-memory");
+
     opt->addUsage(" -o  --opengl          use OpenGL(ES) renderer");
     opt->setFlag("opengl", 'o');
     opt->addUsage(" -s  --software        use software renderer");
@@ -59,9 +66,19 @@ bool CmdLine::ParseCommandLine(int argc, char** argv)
     opt->addUsage("     --resource-dir DIR set the resource directory");
     opt->setOption("resource-dir");
 
+    opt->addUsage("     --record FNAME    record the input of this session");
+    opt->setOption("record");
+    opt->addUsage("     --replay FNAME    replay a recorded session headless, at a fixed timestep");
+    opt->setOption("replay");
+    opt->addUsage("     --replay-timings FNAME write the per frame timings of the replay as JSON (\"-\" is stdout)");
+    opt->setOption("replay-timings");
+
     opt->addUsage("     --log FNAME       set the file name for logging (\"-\" is stdout)");
     opt->setOption("log");
 
+    opt->addUsage("     --log-sync        write each log entry before going on (slower, but nothing is lost in a crash)");
+    opt->setFlag("log-sync");
+
     opt->addUsage("     --log-level LEVEL set the logging level (see below)");
     opt->addUsage(" LEVEL is a string with one or more of <name>=<level>, separated by commas");
     opt->addUsage("   <name>     is the component name to enable logging/diagnostic for (Can be anything, you have to know what to use)");
@@ -86,6 +103,7 @@ bool CmdLine::ParseCommandLine(int argc, char** argv)
 
     if (opt->getValue("log") != NULL) {
         std::string log_fname = opt->getValue("log");
+        Logger::set_async(!opt->getFlag("log-sync"));
         if (log_fname == "-") {
             StdoutLogger::create_logger();
         }
@@ -102,6 +120,12 @@ bool CmdLine::ParseCommandLine(int argc, char** argv)
         }
     }
 
+    // Must be set before SDL_Init() in the SexyAppBase constructor
+    if (opt->getValue("replay") != NULL) {
+        setenv("SDL_VIDEODRIVER", "dummy", 0);
+        setenv("SDL_AUDIODRIVER", "dummy", 0);
+    }
+
     // The rest of inquiries is done in SexyAppBase::ParseCommandLine
     _cmdline->_opt = opt;
     return true;
@@ -247,6 +247,17 @@ struct StringLessNoCase
     }
 };
 
+// Holds an SDL mutex for as long as it lives
+class AutoMutex
+{
+public:
+    AutoMutex(SDL_mutex* theMutex) : mMutex(theMutex) { SDL_LockMutex(mMutex); }
+    ~AutoMutex() { SDL_UnlockMutex(mMutex); }
+
+private:
+    SDL_mutex*      mMutex;
+};
+
 inline unsigned short SwapTwoBytes(unsigned short w)
 {
     unsigned short tmp;
@@ -290,6 +290,8 @@ bool D3DInterface::CreateImageTexture(Image *theImage)
 {
     bool wantPurge = false;
 
+    theImage->mDrawn = true;
+
     if (!theImage->HasTextureData()) {
         theImage->CreateTextureData();
 
@@ -373,6 +375,7 @@ void D3DInterface::SetupDrawMode(int theDrawMode, const Color &theColor, Image *
 {
     if (lastDrawMode == theDrawMode)
         return;
+    FrameCounters::Add(FrameCounter_StateChanges);
     if (theDrawMode == Graphics::DRAWMODE_NORMAL) {
         glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     } else // Additive
@@ -615,7 +618,7 @@ void D3DInterface::DrawLine(double theStartX, double theStartY, double theEndX,
     GLState::getInstance()->enableClientState(GL_COLOR_ARRAY);
     glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(D3DTLVERTEX), &(aVertex[0].color));
     glVertexPointer(2, GL_SHORT, sizeof(D3DTLVERTEX), &(aVertex[0].sx));
-    glDrawArrays(GL_LINE_STRIP, 0, 2);
+    GLState::getInstance()->drawArrays(GL_LINE_STRIP, 0, 2);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -661,7 +664,7 @@ void D3DInterface::FillRect(const Rect& theRect, const Color& theColor, int theD
     GLState::getInstance()->enableClientState(GL_COLOR_ARRAY);
     glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(D3DTLVERTEX), &(aVertex[0].color));
     glVertexPointer(2, GL_SHORT, sizeof(D3DTLVERTEX), &(aVertex[0].sx));
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    GLState::getInstance()->drawArrays(GL_TRIANGLE_STRIP, 0, 4);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -698,7 +701,7 @@ void D3DInterface::DrawTriangle(const TriVertex &p1, const TriVertex &p2, const
     GLState::getInstance()->enableClientState(GL_COLOR_ARRAY);
     glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(D3DTLVERTEX), &(aVertex[0].color));
     glVertexPointer(2, GL_SHORT, sizeof(D3DTLVERTEX), &(aVertex[0].sx));
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 3);
+    GLState::getInstance()->drawArrays(GL_TRIANGLE_STRIP, 0, 3);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -737,7 +740,7 @@ void D3DInterface::FillPoly(const Point theVertices[], int theNumVertices, const
         GLState::getInstance()->enableClientState(GL_COLOR_ARRAY);
         glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(D3DTLVERTEX), &(aList[0].color));
         glVertexPointer(2, GL_SHORT, sizeof(D3DTLVERTEX), &(aList[0].sx));
-        glDrawArrays(GL_TRIANGLE_FAN, 0, aList.size());
+        GLState::getInstance()->drawArrays(GL_TRIANGLE_FAN, 0, aList.size());
     }
 }
 
@@ -39,7 +39,10 @@ enum D3DImageFlags
     D3DImageFlag_MinimizeNumSubdivisions    =           0x0001,     // subdivide image into fewest possible textures (may use more memory)
     D3DImageFlag_Use64By64Subdivisions      =           0x0002,     // good to use with image strips so the entire texture isn't pulled in when drawing just a piece
     D3DImageFlag_UseA4R4G4B4                =           0x0004,     // images with not too many color gradients work well in this format
-    D3DImageFlag_UseA8R8G8B8                =           0x0008      // non-alpha images will be stored as R5G6B5 by default so use this option if you want a 32-bit non-alpha image
+    D3DImageFlag_UseA8R8G8B8                =           0x0008,     // non-alpha images may be stored as R5G6B5 (see TextureData::SetTexturePixelFormats) so use this option if you want a 32-bit non-alpha image
+    D3DImageFlag_UseR5G6B5                  =           0x0010,     // for images without alpha, others fall back to A8R8G8B8
+    D3DImageFlag_UseA8                      =           0x0020,     // for images that are white where they aren't transparent, others fall back to A8R8G8B8
+    D3DImageFlag_Dither                     =           0x0040      // ordered dithering when converting to a 16-bit format
 };
 
 ///////////////////////////////////////////////////////////////////////////////
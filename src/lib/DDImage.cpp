@@ -5,6 +5,7 @@
 #include "Graphics.h"
 #include "SexyAppBase.h"
 #include "D3DInterface.h"
+#include "FrameCounters.h"
 
 #if 0
 #include "Debug.h"
@@ -1800,6 +1801,7 @@ uint32_t* DDImage::GetBits()
 
         mBits = new uint32_t[mWidth * mHeight + 1];
         mBits[mWidth * mHeight] = MEMORYCHECK_ID;
+        FrameCounters::Add(FrameCounter_BytesAllocated, (mWidth * mHeight + 1) * sizeof(uint32_t));
 
         //int aRRound = (1 << (7 - mDDInterface->mRedBits));
         //int aGRound = (1 << (7 - mDDInterface->mGreenBits));
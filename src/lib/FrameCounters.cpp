@@ -0,0 +1,156 @@
+#include "FrameCounters.h"
+
+#include <assert.h>
+#include <algorithm>
+#include <vector>
+
+using namespace Sexy;
+
+SDL_atomic_t FrameCounters::sValues[MAX_FRAME_COUNTERS];
+
+static int gHistory[MAX_FRAME_COUNTERS][FRAME_COUNTER_HISTORY];
+static int gHistoryPos = 0;            // Where the next ended frame goes
+static int gHistoryCount = 0;
+
+struct CounterInfo
+{
+    std::string             mName;
+    bool                    mIsGauge;
+};
+
+// Built on first use, games may Register() from static constructors
+static std::vector<CounterInfo>& GetCounters()
+{
+    static std::vector<CounterInfo> aCounters;
+    if (aCounters.empty()) {
+        static const char* aNames[NUM_FRAME_COUNTERS] = {
+            "draw calls", "vertices", "texture binds", "texture uploads", "upload bytes",
+            "state changes", "bytes allocated", "widgets drawn", "physics bodies",
+            "physics arbiters", "particles"
+        };
+        for (int i = 0; i < NUM_FRAME_COUNTERS; i++) {
+            CounterInfo anInfo;
+            anInfo.mName = aNames[i];
+            anInfo.mIsGauge = i == FrameCounter_PhysicsBodies || i == FrameCounter_PhysicsArbiters;
+            aCounters.push_back(anInfo);
+        }
+    }
+    return aCounters;
+}
+
+int FrameCounters::Register(const std::string& theName, bool isGauge)
+{
+    int aCounter = Find(theName);
+    if (aCounter >= 0)
+        return aCounter;
+
+    std::vector<CounterInfo>& aCounters = GetCounters();
+    assert(aCounters.size() < MAX_FRAME_COUNTERS);
+    if (aCounters.size() >= MAX_FRAME_COUNTERS)
+        return -1;
+
+    CounterInfo anInfo;
+    anInfo.mName = theName;
+    anInfo.mIsGauge = isGauge;
+    aCounters.push_back(anInfo);
+    return aCounters.size() - 1;
+}
+
+int FrameCounters::Find(const std::string& theName)
+{
+    std::vector<CounterInfo>& aCounters = GetCounters();
+    for (size_t i = 0; i < aCounters.size(); i++) {
+        if (aCounters[i].mName == theName)
+            return i;
+    }
+    return -1;
+}
+
+int FrameCounters::GetNumCounters()
+{
+    return GetCounters().size();
+}
+
+const std::string& FrameCounters::GetName(int theCounter)
+{
+    return GetCounters()[theCounter].mName;
+}
+
+bool FrameCounters::IsGauge(int theCounter)
+{
+    return GetCounters()[theCounter].mIsGauge;
+}
+
+void FrameCounters::EndFrame()
+{
+    std::vector<CounterInfo>& aCounters = GetCounters();
+    for (size_t i = 0; i < aCounters.size(); i++) {
+        if (aCounters[i].mIsGauge)
+            gHistory[i][gHistoryPos] = SDL_AtomicGet(&sValues[i]);
+        else
+            gHistory[i][gHistoryPos] = SDL_AtomicSet(&sValues[i], 0);
+    }
+    gHistoryPos = (gHistoryPos + 1) % FRAME_COUNTER_HISTORY;
+    if (gHistoryCount < FRAME_COUNTER_HISTORY)
+        gHistoryCount++;
+}
+
+void FrameCounters::Reset()
+{
+    for (int i = 0; i < MAX_FRAME_COUNTERS; i++)
+        SDL_AtomicSet(&sValues[i], 0);
+    gHistoryPos = 0;
+    gHistoryCount = 0;
+}
+
+int FrameCounters::GetCurrent(int theCounter)
+{
+    return SDL_AtomicGet(&sValues[theCounter]);
+}
+
+int FrameCounters::GetFrameCount()
+{
+    return gHistoryCount;
+}
+
+int FrameCounters::GetHistory(int theCounter, int theAgo)
+{
+    if (theAgo < 0 || theAgo >= gHistoryCount)
+        return 0;
+    return gHistory[theCounter][(gHistoryPos - 1 - theAgo + FRAME_COUNTER_HISTORY) % FRAME_COUNTER_HISTORY];
+}
+
+int FrameCounters::GetLast(int theCounter)
+{
+    return GetHistory(theCounter, 0);
+}
+
+int FrameCounters::GetMin(int theCounter)
+{
+    if (gHistoryCount == 0)
+        return 0;
+    int aMin = gHistory[theCounter][0];
+    for (int i = 1; i < gHistoryCount; i++)
+        aMin = std::min(aMin, gHistory[theCounter][i]);
+    return aMin;
+}
+
+int FrameCounters::GetMax(int theCounter)
+{
+    if (gHistoryCount == 0)
+        return 0;
+    int aMax = gHistory[theCounter][0];
+    for (int i = 1; i < gHistoryCount; i++)
+        aMax = std::max(aMax, gHistory[theCounter][i]);
+    return aMax;
+}
+
+double FrameCounters::GetAvg(int theCounter)
+{
+    if (gHistoryCount == 0)
+        return 0.0;
+    double aSum = 0.0;
+    for (int i = 0; i < gHistoryCount; i++)
+        aSum += gHistory[theCounter][i];
+    return aSum / gHistoryCount;
+}
@@ -0,0 +1,77 @@
+#ifndef __FRAMECOUNTERS_H__
+#define __FRAMECOUNTERS_H__
+
+#include <SDL.h>
+#include <string>
+
+namespace Sexy
+{
+
+// The counters of the framework. Games Register() their own after these.
+enum FrameCounter
+{
+    FrameCounter_DrawCalls,             // glDrawArrays() through GLState
+    FrameCounter_Vertices,              // Vertices of those draw calls
+    FrameCounter_TextureBinds,          // Binds GLState didn't skip
+    FrameCounter_TextureUploads,
+    FrameCounter_TextureUploadBytes,
+    FrameCounter_StateChanges,          // Blend function, enables and disables
+    FrameCounter_BytesAllocated,        // Image buffers
+    FrameCounter_WidgetsDrawn,
+    FrameCounter_PhysicsBodies,         // Gauge, as of the last Physics::Update()
+    FrameCounter_PhysicsArbiters,       // Gauge
+    FrameCounter_Particles,             // Live particles rendered
+    NUM_FRAME_COUNTERS
+};
+
+#define MAX_FRAME_COUNTERS      64
+#define FRAME_COUNTER_HISTORY   120     // Frames kept for Min/Avg/Max
+
+// Per frame counters. Subsystems Add() to them from any thread,
+// SexyAppBase::DrawDirtyStuff() ends the frame, which moves the values into
+// a rolling history and clears them. Gauges keep their value across frames,
+// they are Set() when the value changes.
+//
+// All static, like the state they count. The StatsWidget shows them on
+// screen; tests and tools can read them with GetLast() and friends.
+class FrameCounters
+{
+public:
+    // Returns the existing counter if theName is known
+    static int              Register(const std::string& theName, bool isGauge = false);
+    static int              Find(const std::string& theName);
+    static int              GetNumCounters();
+    static const std::string& GetName(int theCounter);
+    static bool             IsGauge(int theCounter);
+
+    static void             Add(int theCounter, int theAmount = 1)
+    {
+        SDL_AtomicAdd(&sValues[theCounter], theAmount);
+    }
+    static void             Set(int theCounter, int theValue)
+    {
+        SDL_AtomicSet(&sValues[theCounter], theValue);
+    }
+
+    static void             EndFrame();
+    // Clears the values and the history
+    static void             Reset();
+
+    // Of the current, not yet ended frame
+    static int              GetCurrent(int theCounter);
+    // Of the frames in the history, 0 when there are none
+    static int              GetFrameCount();
+    static int              GetLast(int theCounter);
+    static int              GetMin(int theCounter);
+    static int              GetMax(int theCounter);
+    static double           GetAvg(int theCounter);
+    // theAgo 0 is the last ended frame
+    static int              GetHistory(int theCounter, int theAgo);
+
+private:
+    static SDL_atomic_t     sValues[MAX_FRAME_COUNTERS];
+};
+
+}
+
+#endif //__FRAMECOUNTERS_H__
@@ -9,6 +9,7 @@
 #define GLSTATE_H
 
 #include "Common.h"
+#include "FrameCounters.h"
 
 #include <SDL.h>
 #ifdef USE_OPENGLES
@@ -40,13 +41,23 @@ public:
             if (texture != texture_2d) {
                 glBindTexture(GL_TEXTURE_2D, texture);
                 texture_2d = texture;
+                Sexy::FrameCounters::Add(Sexy::FrameCounter_TextureBinds);
             }
             break;
         default:
             glBindTexture(target, texture);
+            Sexy::FrameCounters::Add(Sexy::FrameCounter_TextureBinds);
         }
     }
 
+    // All draw calls go through here, to be counted
+    void drawArrays(GLenum mode, GLint first, GLsizei count)
+    {
+        glDrawArrays(mode, first, count);
+        Sexy::FrameCounters::Add(Sexy::FrameCounter_DrawCalls);
+        Sexy::FrameCounters::Add(Sexy::FrameCounter_Vertices, count);
+    }
+
     void enable(GLenum cap)
     {
         switch (cap) {
@@ -54,12 +65,14 @@ public:
             if (!blending) {
                 glEnable(cap);
                 blending = true;
+                Sexy::FrameCounters::Add(Sexy::FrameCounter_StateChanges);
             }
             break;
         case GL_TEXTURE_2D:
             if (!texture2D) {
                 glEnable(cap);
                 texture2D = true;
+                Sexy::FrameCounters::Add(Sexy::FrameCounter_StateChanges);
             }
             break;
         default:
@@ -75,12 +88,14 @@ public:
             if (blending) {
                 glDisable(cap);
                 blending = false;
+                Sexy::FrameCounters::Add(Sexy::FrameCounter_StateChanges);
             }
             break;
         case GL_TEXTURE_2D:
             if (texture2D) {
                 glDisable(cap);
                 texture2D = false;
+                Sexy::FrameCounters::Add(Sexy::FrameCounter_StateChanges);
             }
             break;
         default:
@@ -325,7 +325,7 @@ void Image::StretchBltMirror(Image* theImage, const Rect& theDestRect, const Rec
 {
 }
 
-GLuint Image::CreateTexture(int x, int y, int w, int h)
+GLuint Image::CreateTexture(int x, int y, int w, int h, PixelFormat theFormat, bool dither)
 {
     // This is a dummy function. It should never be called.
     assert(0);
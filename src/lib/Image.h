@@ -129,6 +129,7 @@ public:
     Graphics*           GetGraphics();
 
     void                    SetFilePath(const std::string & path) { mFilePath = path; }
+    const std::string&      GetFilePath() const { return mFilePath; }
 
     virtual bool            PolyFill3D(const Point theVertices[], int theNumVertices, const Rect *theClipRect, const Color &theColor, int theDrawMode, int tx, int ty, bool convex);
     virtual void            FillRect(const Rect& theRect, const Color& theColor, int theDrawMode);
@@ -156,9 +157,10 @@ public:
 
     virtual bool            Palletize() { return false; }
 
-    virtual GLuint          CreateTexture(int x, int y, int w, int h);
+    virtual GLuint          CreateTexture(int x, int y, int w, int h, PixelFormat theFormat = PixelFormat_A8R8G8B8, bool dither = false);
 
     uint32_t                GetD3DFlags() const { return mD3DFlags; }
+    void                    SetD3DFlags(uint32_t theFlags) { mD3DFlags = theFlags; }
     bool                    HasTextureData() const { return mD3DData != NULL; }
     void                    CreateTextureData();
     void                    DeleteTextureData();
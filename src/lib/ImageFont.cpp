@@ -4,6 +4,11 @@
 #include "SexyAppBase.h"
 #include "MemoryImage.h"
 #include "Logging.h"
+#include "PakInterface.h"
+#include "ImageLib.h"
+
+#include <stdio.h>
+#include <string.h>
 
 using namespace Sexy;
 
@@ -83,14 +88,12 @@ CharData::CharData()
 {
     mWidth = 0;
     mOrder = 0;
-
-    for (uint32_t i = 0; i < 256; i++)
-        mKerningOffsets[i] = 0;
 }
 
 FontLayer::FontLayer(FontData* theFontData)
 {
     mFontData = theFontData;
+    mImage = NULL;
     mDrawMode = -1;
     mSpacing = 0;
     mPointSize = 0;
@@ -110,9 +113,11 @@ FontLayer::FontLayer(const FontLayer& theFontLayer) :
     mFontData(theFontLayer.mFontData),
     mRequiredTags(theFontLayer.mRequiredTags),
     mExcludedTags(theFontLayer.mExcludedTags),
+    mKerningPairs(theFontLayer.mKerningPairs),
     mColorMult(theFontLayer.mColorMult),
     mColorAdd(theFontLayer.mColorAdd),
     mImage(theFontLayer.mImage),
+    mImagePath(theFontLayer.mImagePath),
     mDrawMode(theFontLayer.mDrawMode),
     mOffset(theFontLayer.mOffset),
     mSpacing(theFontLayer.mSpacing),
@@ -132,6 +137,37 @@ FontLayer::FontLayer(const FontLayer& theFontLayer) :
         mCharData[i] = theFontLayer.mCharData[i];
 }
 
+int FontLayer::GetKerningOffset(uchar theChar, uchar theNextChar) const
+{
+    if (mKerningPairs.empty())
+        return 0;
+
+    FontKerningPair aKey;
+    aKey.mPair = (ushort) ((theChar << 8) | theNextChar);
+    FontKerningPairVector::const_iterator anItr = std::lower_bound(mKerningPairs.begin(), mKerningPairs.end(), aKey);
+    if (anItr == mKerningPairs.end() || anItr->mPair != aKey.mPair)
+        return 0;
+    return anItr->mOffset;
+}
+
+void FontLayer::SetKerningOffset(uchar theChar, uchar theNextChar, int theOffset)
+{
+    FontKerningPair aKey;
+    aKey.mPair = (ushort) ((theChar << 8) | theNextChar);
+    aKey.mOffset = (char) theOffset;    // The offsets used to be chars
+
+    FontKerningPairVector::iterator anItr = std::lower_bound(mKerningPairs.begin(), mKerningPairs.end(), aKey);
+    if (anItr != mKerningPairs.end() && anItr->mPair == aKey.mPair)
+    {
+        if (aKey.mOffset == 0)
+            mKerningPairs.erase(anItr);
+        else
+            anItr->mOffset = aKey.mOffset;
+    }
+    else if (aKey.mOffset != 0)
+        mKerningPairs.insert(anItr, aKey);
+}
+
 FontData::FontData()
 {
     mLogFacil = NULL;
@@ -140,6 +176,7 @@ FontData::FontData()
 #endif
 
     mInitialized = false;
+    mDecoding = false;
 
     mApp = NULL;
     mRefCount = 0;
@@ -160,6 +197,9 @@ FontData::~FontData()
         delete aDataElement;
         ++anItr;
     }
+
+    for (std::map<std::string, ImageLib::Image*>::iterator anImageItr = mDecodedImages.begin(); anImageItr != mDecodedImages.end(); ++anImageItr)
+        delete anImageItr->second;
 }
 
 void FontData::Ref()
@@ -190,7 +230,7 @@ bool FontData::Error(const std::string& theError)
 #endif
     }
 
-    return false;
+    return DescParser::Error(theError);
 }
 
 bool FontData::DataToLayer(DataElement* theSource, FontLayer** theFontLayer)
@@ -567,13 +607,13 @@ bool FontData::HandleCommand(const ListDataElement& theParams)
             if ((DataToLayer(theParams.mElementVector[1], &aLayer)) &&
                 (DataToString(theParams.mElementVector[2], &aFileNameString)))
             {
-                std::string aFileName = GetPathFrom(aFileNameString, GetFileDir(mSourceFile));
-                TLOG(mLogFacil, 1, Logger::format("LayerSetImage: mSourceFile='%s'", mSourceFile.c_str()));
-                TLOG(mLogFacil, 1, Logger::format("LayerSetImage: aFileName='%s'", aFileName.c_str()));
-
-                Image* anImage = mApp->GetImage(aFileName, true, true);
-                anImage->Palletize();
-                aLayer->mImage = anImage;
+                // Compiling only keeps the path
+                aLayer->mImagePath = aFileNameString;
+                if ((mApp != NULL || mDecoding) && !LoadLayerImage(aLayer))
+                {
+                    Error("Failed to load image");
+                    return false;
+                }
             }
             else
                 invalidParamFormat = true;
@@ -792,10 +832,12 @@ bool FontData::HandleCommand(const ListDataElement& theParams)
             {
                 if (aCharsVector.size() == aRectList.mElementVector.size())
                 {
-                    if ((Image*) aLayer->mImage != NULL)
+                    if ((Image*) aLayer->mImage != NULL || !aLayer->mImagePath.empty())
                     {
-                        int anImageWidth = aLayer->mImage->GetWidth();
-                        int anImageHeight = aLayer->mImage->GetHeight();
+                        // Without the image the rects are checked when the compiled font is loaded
+                        bool checkBounds = (Image*) aLayer->mImage != NULL;
+                        int anImageWidth = checkBounds ? aLayer->mImage->GetWidth() : 0;
+                        int anImageHeight = checkBounds ? aLayer->mImage->GetHeight() : 0;
 
                         for (uint32_t i = 0; i < aCharsVector.size(); i++)
                         {
@@ -809,7 +851,7 @@ bool FontData::HandleCommand(const ListDataElement& theParams)
                                 Rect aRect = Rect(aRectElement[0], aRectElement[1], aRectElement[2], aRectElement[3]);
 
                                 if ((aRect.mX < 0) || (aRect.mY < 0) ||
-                                    (aRect.mX + aRect.mWidth > anImageWidth) || (aRect.mY + aRect.mHeight > anImageHeight))
+                                    (checkBounds && ((aRect.mX + aRect.mWidth > anImageWidth) || (aRect.mY + aRect.mHeight > anImageHeight))))
                                 {
                                     Error("Image rectangle out of bounds");
                                     return false;
@@ -897,8 +939,7 @@ bool FontData::HandleCommand(const ListDataElement& theParams)
                     {
                         if (aPairsVector[i].length() == 2)
                         {
-                            aLayer->mCharData[(uchar) aPairsVector[i][0]].mKerningOffsets
-                                [(uchar) aPairsVector[i][1]] = anOffsetsVector[i];
+                            aLayer->SetKerningOffset((uchar) aPairsVector[i][0], (uchar) aPairsVector[i][1], anOffsetsVector[i]);
                         }
                         else
                             invalidParamFormat = true;
@@ -1020,11 +1061,101 @@ bool FontData::Load(SexyAppBase* theSexyApp, const std::string& theFontDescFileN
 
     mSourceFile = daFontDescFileName;
 
-    mInitialized = LoadDescriptor(daFontDescFileName);  ;
+    if (LoadCompiled(GetCompiledFileName(daFontDescFileName), daFontDescFileName))
+        mInitialized = true;
+    else
+        mInitialized = LoadDescriptor(daFontDescFileName);
 
     return !hasErrors;
 }
 
+bool FontData::Decode(const std::string& theFontDescFileName)
+{
+    if (mInitialized)
+        return false;
+
+    std::string daFontDescFileName = gSexyAppBase->GetAppResourceFileName(theFontDescFileName);
+
+    // No app, LoadLayerImage() only decodes
+    mApp = NULL;
+    mDecoding = true;
+    mCurrentLine = "";
+    mFontErrorHeader = "Font Descriptor Error in " + daFontDescFileName + "\r\n";
+    mSourceFile = daFontDescFileName;
+
+    bool aSuccess = LoadCompiled(GetCompiledFileName(daFontDescFileName), daFontDescFileName) ||
+        LoadDescriptor(daFontDescFileName);
+    mDecoding = false;
+    return aSuccess;
+}
+
+bool FontData::FinishLoad(SexyAppBase* theSexyApp)
+{
+    if (mInitialized)
+        return false;
+
+    mApp = theSexyApp;
+
+    std::map<std::string, Image*> anImageMap;
+    bool aSuccess = true;
+    for (FontLayerList::iterator anItr = mFontLayerList.begin(); anItr != mFontLayerList.end() && aSuccess; ++anItr)
+    {
+        FontLayer* aFontLayer = &*anItr;
+        if (aFontLayer->mImagePath.empty())
+            continue;
+
+        std::string aFileName = GetPathFrom(aFontLayer->mImagePath, GetFileDir(mSourceFile));
+        std::map<std::string, Image*>::iterator anImageItr = anImageMap.find(aFileName);
+        if (anImageItr != anImageMap.end())
+        {
+            aFontLayer->mImage = anImageItr->second;
+        }
+        else
+        {
+            std::map<std::string, ImageLib::Image*>::iterator aDecodedItr = mDecodedImages.find(aFileName);
+            if (aDecodedItr == mDecodedImages.end())
+            {
+                aSuccess = false;
+                break;
+            }
+
+            // What SexyAppBase::GetImage() and LoadLayerImage() do with it
+            ImageLib::Image* aDecoded = aDecodedItr->second;
+            MemoryImage* anImage = new MemoryImage();
+            anImage->SetBits(aDecoded->GetBits(), aDecoded->GetWidth(), aDecoded->GetHeight(), true);
+            anImage->Palletize();
+            aFontLayer->mImage = anImage;
+            anImageMap[aFileName] = anImage;
+        }
+
+        // The rects could only be checked against the images now
+        for (int aCharNum = 0; aCharNum < 256 && aSuccess; aCharNum++)
+        {
+            const Rect& aRect = aFontLayer->mCharData[aCharNum].mImageRect;
+            if ((aRect.mX < 0) || (aRect.mY < 0) ||
+                (aRect.mX + aRect.mWidth > aFontLayer->mImage->GetWidth()) ||
+                (aRect.mY + aRect.mHeight > aFontLayer->mImage->GetHeight()))
+                aSuccess = false;
+        }
+    }
+
+    for (std::map<std::string, ImageLib::Image*>::iterator aDecodedItr = mDecodedImages.begin(); aDecodedItr != mDecodedImages.end(); ++aDecodedItr)
+        delete aDecodedItr->second;
+    mDecodedImages.clear();
+
+    if (!aSuccess)
+    {
+        for (FontLayerList::iterator anItr = mFontLayerList.begin(); anItr != mFontLayerList.end(); ++anItr)
+            anItr->mImage = NULL;
+        for (std::map<std::string, Image*>::iterator anImageItr = anImageMap.begin(); anImageItr != anImageMap.end(); ++anImageItr)
+            delete anImageItr->second;
+        return false;
+    }
+
+    mInitialized = true;
+    return true;
+}
+
 bool FontData::LoadLegacy(Image* theFontImage, const std::string& theFontDescFileName)
 {
     if (mInitialized)
@@ -1100,6 +1231,460 @@ bool FontData::LoadLegacy(Image* theFontImage, const std::string& theFontDescFil
     return true;
 }
 
+////
+// Compiled font descriptors, see FontData::Compile() and tuxres.
+//
+// A header, then the sections in this order: layers, char data (256 for
+// each layer), kerning pairs, tags (string indices, required ones first for
+// each layer), defines (pairs of string indices), string offsets and the
+// strings. String 0 is "". Numbers are in host byte order, like the
+// compiled resources.
+////
+#define COMPILED_FONT_MAGIC     (0x544E4654)        // "TFNT"
+#define COMPILED_FONT_VERSION   (1)
+
+struct CompiledFontHeader
+{
+    uint32_t mMagic;
+    uint32_t mVersion;
+    uint32_t mSourceSize;           // Descriptor it was compiled from
+    uint32_t mSourceHash;
+    int32_t  mDefaultPointSize;
+    uchar    mCharMap[256];
+    uint32_t mNumLayers;
+    uint32_t mNumKerningPairs;
+    uint32_t mNumTags;
+    uint32_t mNumDefines;
+    uint32_t mNumStrings;
+    uint32_t mStringBytes;
+};
+
+struct CompiledFontLayer
+{
+    uint32_t mName;
+    uint32_t mImagePath;
+    uint32_t mFirstTag;
+    uint32_t mNumRequiredTags;
+    uint32_t mNumExcludedTags;
+    uint32_t mFirstKerningPair;
+    uint32_t mNumKerningPairs;
+    int32_t  mColorMult[4];
+    int32_t  mColorAdd[4];
+    int32_t  mDrawMode;
+    int32_t  mOffsetX;
+    int32_t  mOffsetY;
+    int32_t  mSpacing;
+    int32_t  mMinPointSize;
+    int32_t  mMaxPointSize;
+    int32_t  mPointSize;
+    int32_t  mAscent;
+    int32_t  mAscentPadding;
+    int32_t  mHeight;
+    int32_t  mDefaultHeight;
+    int32_t  mLineSpacingOffset;
+    int32_t  mBaseOrder;
+};
+
+struct CompiledFontChar
+{
+    int16_t  mX;
+    int16_t  mY;
+    int16_t  mWidth;
+    int16_t  mHeight;
+    int16_t  mOffsetX;
+    int16_t  mOffsetY;
+    int16_t  mCharWidth;
+    int16_t  mOrder;
+};
+
+// FNV-1a, tells whether the descriptor changed since it was compiled.
+static uint32_t HashFontSource(const std::vector<char>& theData)
+{
+    uint32_t aHash = 2166136261U;
+    for (size_t i = 0; i < theData.size(); i++)
+    {
+        aHash ^= (uchar)theData[i];
+        aHash *= 16777619U;
+    }
+    return aHash;
+}
+
+static bool ReadFontFile(const std::string& thePath, std::vector<char>& theData)
+{
+    PFILE* aFile = p_fopen(thePath.c_str(), "rb");
+    if (aFile == NULL)
+        return false;
+
+    int aSize = p_size(aFile);
+    theData.resize(aSize > 0 ? aSize : 0);
+    bool aSuccess = theData.empty() || p_fread(&theData[0], 1, aSize, aFile) == (size_t)aSize;
+    p_fclose(aFile);
+    return aSuccess;
+}
+
+static void ColorToInts(const Color& theColor, int32_t* theInts)
+{
+    theInts[0] = theColor.mRed;
+    theInts[1] = theColor.mGreen;
+    theInts[2] = theColor.mBlue;
+    theInts[3] = theColor.mAlpha;
+}
+
+namespace
+{
+
+// Interned strings of a compiled font.
+class CompiledFontStrings
+{
+public:
+    CompiledFontStrings() { Add(""); }
+
+    uint32_t Add(const std::string& theString)
+    {
+        std::map<std::string, uint32_t>::iterator anItr = mIndex.find(theString);
+        if (anItr != mIndex.end())
+            return anItr->second;
+
+        uint32_t anIndex = mOffsets.size();
+        mIndex[theString] = anIndex;
+        mOffsets.push_back(mBytes.size());
+        mBytes.append(theString.c_str(), theString.size() + 1);
+        return anIndex;
+    }
+
+    std::map<std::string, uint32_t> mIndex;
+    std::vector<uint32_t>           mOffsets;
+    std::string                     mBytes;
+};
+
+template <class T>
+bool WriteFontSection(FILE* theFile, const std::vector<T>& theSection)
+{
+    return theSection.empty() || fwrite(&theSection[0], sizeof(T), theSection.size(), theFile) == theSection.size();
+}
+
+}
+
+bool FontData::LoadLayerImage(FontLayer* theLayer)
+{
+    std::string aFileName = GetPathFrom(theLayer->mImagePath, GetFileDir(mSourceFile));
+    TLOG(mLogFacil, 1, Logger::format("LayerSetImage: mSourceFile='%s'", mSourceFile.c_str()));
+    TLOG(mLogFacil, 1, Logger::format("LayerSetImage: aFileName='%s'", aFileName.c_str()));
+
+    if (mDecoding)
+    {
+        // FinishLoad() makes it into an Image
+        if (mDecodedImages.find(aFileName) == mDecodedImages.end())
+        {
+            ImageLib::Image* aDecoded = ImageLib::GetImage(gSexyAppBase->GetAppResourceFileName(aFileName), true);
+            if (aDecoded == NULL)
+                return false;
+            mDecodedImages[aFileName] = aDecoded;
+        }
+        return true;
+    }
+
+    Image* anImage = mApp->GetImage(aFileName, true, true);
+    if (anImage == NULL)
+        return false;
+
+    anImage->Palletize();
+    theLayer->mImage = anImage;
+    return true;
+}
+
+bool FontData::Compile(const std::string& theFontDescFileName, const std::string& theCompiledPath)
+{
+    std::vector<char> aSource;
+    if (mInitialized || !ReadFontFile(theFontDescFileName, aSource))
+        return false;
+
+    // No app, so the layer images are left alone
+    mApp = NULL;
+    mCurrentLine = "";
+    mSourceFile = theFontDescFileName;
+    if (!LoadDescriptor(theFontDescFileName))
+        return false;
+
+    CompiledFontStrings aStrings;
+    std::vector<CompiledFontLayer> aLayers;
+    std::vector<CompiledFontChar> aChars;
+    std::vector<FontKerningPair> aKerningPairs;
+    std::vector<uint32_t> aTags;
+    std::vector<uint32_t> aDefines;
+
+    for (FontLayerList::iterator anItr = mFontLayerList.begin(); anItr != mFontLayerList.end(); ++anItr)
+    {
+        FontLayer* aFontLayer = &*anItr;
+
+        CompiledFontLayer aLayer;
+        memset(&aLayer, 0, sizeof(aLayer));
+        for (FontLayerMap::iterator aMapItr = mFontLayerMap.begin(); aMapItr != mFontLayerMap.end(); ++aMapItr)
+            if (aMapItr->second == aFontLayer)
+                aLayer.mName = aStrings.Add(aMapItr->first);
+        aLayer.mImagePath = aStrings.Add(aFontLayer->mImagePath);
+
+        aLayer.mFirstTag = aTags.size();
+        aLayer.mNumRequiredTags = aFontLayer->mRequiredTags.size();
+        aLayer.mNumExcludedTags = aFontLayer->mExcludedTags.size();
+        for (uint32_t i = 0; i < aFontLayer->mRequiredTags.size(); i++)
+            aTags.push_back(aStrings.Add(aFontLayer->mRequiredTags[i]));
+        for (uint32_t i = 0; i < aFontLayer->mExcludedTags.size(); i++)
+            aTags.push_back(aStrings.Add(aFontLayer->mExcludedTags[i]));
+
+        aLayer.mFirstKerningPair = aKerningPairs.size();
+        aLayer.mNumKerningPairs = aFontLayer->mKerningPairs.size();
+        aKerningPairs.insert(aKerningPairs.end(), aFontLayer->mKerningPairs.begin(), aFontLayer->mKerningPairs.end());
+
+        ColorToInts(aFontLayer->mColorMult, aLayer.mColorMult);
+        ColorToInts(aFontLayer->mColorAdd, aLayer.mColorAdd);
+        aLayer.mDrawMode = aFontLayer->mDrawMode;
+        aLayer.mOffsetX = aFontLayer->mOffset.mX;
+        aLayer.mOffsetY = aFontLayer->mOffset.mY;
+        aLayer.mSpacing = aFontLayer->mSpacing;
+        aLayer.mMinPointSize = aFontLayer->mMinPointSize;
+        aLayer.mMaxPointSize = aFontLayer->mMaxPointSize;
+        aLayer.mPointSize = aFontLayer->mPointSize;
+        aLayer.mAscent = aFontLayer->mAscent;
+        aLayer.mAscentPadding = aFontLayer->mAscentPadding;
+        aLayer.mHeight = aFontLayer->mHeight;
+        aLayer.mDefaultHeight = aFontLayer->mDefaultHeight;
+        aLayer.mLineSpacingOffset = aFontLayer->mLineSpacingOffset;
+        aLayer.mBaseOrder = aFontLayer->mBaseOrder;
+        aLayers.push_back(aLayer);
+
+        for (int aCharNum = 0; aCharNum < 256; aCharNum++)
+        {
+            const CharData& aCharData = aFontLayer->mCharData[aCharNum];
+
+            CompiledFontChar aChar;
+            aChar.mX = aCharData.mImageRect.mX;
+            aChar.mY = aCharData.mImageRect.mY;
+            aChar.mWidth = aCharData.mImageRect.mWidth;
+            aChar.mHeight = aCharData.mImageRect.mHeight;
+            aChar.mOffsetX = aCharData.mOffset.mX;
+            aChar.mOffsetY = aCharData.mOffset.mY;
+            aChar.mCharWidth = aCharData.mWidth;
+            aChar.mOrder = aCharData.mOrder;
+
+            // Font images are nowhere near 32k, but don't write garbage if one is
+            if (aChar.mX != aCharData.mImageRect.mX || aChar.mY != aCharData.mImageRect.mY ||
+                aChar.mWidth != aCharData.mImageRect.mWidth || aChar.mHeight != aCharData.mImageRect.mHeight ||
+                aChar.mOffsetX != aCharData.mOffset.mX || aChar.mOffsetY != aCharData.mOffset.mY ||
+                aChar.mCharWidth != aCharData.mWidth || aChar.mOrder != aCharData.mOrder)
+                return false;
+
+            aChars.push_back(aChar);
+        }
+    }
+
+    // Only ImageFont::GetDefine() looks at them once the descriptor is parsed
+    for (DataElementMap::iterator anItr = mDefineMap.begin(); anItr != mDefineMap.end(); ++anItr)
+    {
+        aDefines.push_back(aStrings.Add(anItr->first));
+        aDefines.push_back(aStrings.Add(DataElementToString(anItr->second)));
+    }
+
+    CompiledFontHeader aHeader;
+    memset(&aHeader, 0, sizeof(aHeader));
+    aHeader.mMagic = COMPILED_FONT_MAGIC;
+    aHeader.mVersion = COMPILED_FONT_VERSION;
+    aHeader.mSourceSize = aSource.size();
+    aHeader.mSourceHash = HashFontSource(aSource);
+    aHeader.mDefaultPointSize = mDefaultPointSize;
+    memcpy(aHeader.mCharMap, mCharMap, sizeof(aHeader.mCharMap));
+    aHeader.mNumLayers = aLayers.size();
+    aHeader.mNumKerningPairs = aKerningPairs.size();
+    aHeader.mNumTags = aTags.size();
+    aHeader.mNumDefines = aDefines.size() / 2;
+    aHeader.mNumStrings = aStrings.mOffsets.size();
+    aHeader.mStringBytes = aStrings.mBytes.size();
+
+    FILE* aFile = fopen(theCompiledPath.c_str(), "wb");
+    if (aFile == NULL)
+        return false;
+
+    bool aSuccess = fwrite(&aHeader, sizeof(aHeader), 1, aFile) == 1 &&
+        WriteFontSection(aFile, aLayers) &&
+        WriteFontSection(aFile, aChars) &&
+        WriteFontSection(aFile, aKerningPairs) &&
+        WriteFontSection(aFile, aTags) &&
+        WriteFontSection(aFile, aDefines) &&
+        WriteFontSection(aFile, aStrings.mOffsets) &&
+        fwrite(aStrings.mBytes.data(), 1, aStrings.mBytes.size(), aFile) == aStrings.mBytes.size();
+
+    if (fclose(aFile) != 0 || !aSuccess)
+        return false;
+
+    mInitialized = true;
+    return true;
+}
+
+bool FontData::LoadCompiled(const std::string& theCompiledPath, const std::string& theSourcePath)
+{
+    std::vector<char> aData;
+    if (!ReadFontFile(theCompiledPath, aData) || aData.size() < sizeof(CompiledFontHeader))
+        return false;
+
+    const CompiledFontHeader* aHeader = (const CompiledFontHeader*)&aData[0];
+    if (aHeader->mMagic != COMPILED_FONT_MAGIC || aHeader->mVersion != COMPILED_FONT_VERSION)
+        return false;
+
+    // Counted in 64 bits, so a damaged count can't wrap around
+    uint64_t aSize = sizeof(CompiledFontHeader) +
+        (uint64_t)aHeader->mNumLayers * (sizeof(CompiledFontLayer) + 256 * sizeof(CompiledFontChar)) +
+        (uint64_t)aHeader->mNumKerningPairs * sizeof(FontKerningPair) +
+        (uint64_t)aHeader->mNumTags * sizeof(uint32_t) +
+        (uint64_t)aHeader->mNumDefines * 2 * sizeof(uint32_t) +
+        (uint64_t)aHeader->mNumStrings * sizeof(uint32_t) +
+        (uint64_t)aHeader->mStringBytes;
+    if (aSize != aData.size() || aHeader->mNumStrings == 0 || aHeader->mStringBytes == 0)
+        return false;
+
+    const char* aPtr = &aData[sizeof(CompiledFontHeader)];
+    const CompiledFontLayer* aLayers = (const CompiledFontLayer*)aPtr;
+    aPtr += aHeader->mNumLayers * sizeof(CompiledFontLayer);
+    const CompiledFontChar* aChars = (const CompiledFontChar*)aPtr;
+    aPtr += aHeader->mNumLayers * 256 * sizeof(CompiledFontChar);
+    const FontKerningPair* aKerningPairs = (const FontKerningPair*)aPtr;
+    aPtr += aHeader->mNumKerningPairs * sizeof(FontKerningPair);
+    const uint32_t* aTags = (const uint32_t*)aPtr;
+    aPtr += aHeader->mNumTags * sizeof(uint32_t);
+    const uint32_t* aDefines = (const uint32_t*)aPtr;
+    aPtr += aHeader->mNumDefines * 2 * sizeof(uint32_t);
+    const uint32_t* aStringOffsets = (const uint32_t*)aPtr;
+    aPtr += aHeader->mNumStrings * sizeof(uint32_t);
+    const char* aStrings = aPtr;
+
+    // Check every index before anything is loaded
+    uint32_t aNumStrings = aHeader->mNumStrings;
+    if (aStrings[aHeader->mStringBytes - 1] != 0)
+        return false;
+    for (uint32_t i = 0; i < aNumStrings; i++)
+        if (aStringOffsets[i] >= aHeader->mStringBytes)
+            return false;
+
+    for (uint32_t i = 0; i < aHeader->mNumTags; i++)
+        if (aTags[i] >= aNumStrings)
+            return false;
+
+    for (uint32_t i = 0; i < aHeader->mNumDefines * 2; i++)
+        if (aDefines[i] >= aNumStrings)
+            return false;
+
+    for (uint32_t i = 0; i < aHeader->mNumLayers; i++)
+    {
+        const CompiledFontLayer& aLayer = aLayers[i];
+        if (aLayer.mName >= aNumStrings || aLayer.mImagePath >= aNumStrings ||
+            (uint64_t)aLayer.mFirstTag + aLayer.mNumRequiredTags + aLayer.mNumExcludedTags > aHeader->mNumTags ||
+            (uint64_t)aLayer.mFirstKerningPair + aLayer.mNumKerningPairs > aHeader->mNumKerningPairs)
+            return false;
+    }
+
+    // Shipping only the compiled file is fine, but it must match the descriptor if that's there
+    std::vector<char> aSource;
+    if (ReadFontFile(theSourcePath, aSource) &&
+        (aSource.size() != aHeader->mSourceSize || HashFontSource(aSource) != aHeader->mSourceHash))
+    {
+        TLOG(mLogFacil, 1, Logger::format("LoadCompiled: '%s' is out of date", theCompiledPath.c_str()));
+        return false;
+    }
+
+    FontLayerList aFontLayerList;
+    std::map<std::string, Image*> anImageMap;   // Layers made with CreateLayerFrom share theirs
+    bool aSuccess = true;
+
+    for (uint32_t i = 0; i < aHeader->mNumLayers && aSuccess; i++)
+    {
+        const CompiledFontLayer& aLayer = aLayers[i];
+
+        aFontLayerList.push_back(FontLayer(this));
+        FontLayer* aFontLayer = &aFontLayerList.back();
+
+        const uint32_t* aTag = aTags + aLayer.mFirstTag;
+        for (uint32_t j = 0; j < aLayer.mNumRequiredTags; j++)
+            aFontLayer->mRequiredTags.push_back(aStrings + aStringOffsets[*aTag++]);
+        for (uint32_t j = 0; j < aLayer.mNumExcludedTags; j++)
+            aFontLayer->mExcludedTags.push_back(aStrings + aStringOffsets[*aTag++]);
+
+        aFontLayer->mKerningPairs.assign(aKerningPairs + aLayer.mFirstKerningPair,
+            aKerningPairs + aLayer.mFirstKerningPair + aLayer.mNumKerningPairs);
+
+        aFontLayer->mColorMult = Color(aLayer.mColorMult[0], aLayer.mColorMult[1], aLayer.mColorMult[2], aLayer.mColorMult[3]);
+        aFontLayer->mColorAdd = Color(aLayer.mColorAdd[0], aLayer.mColorAdd[1], aLayer.mColorAdd[2], aLayer.mColorAdd[3]);
+        aFontLayer->mDrawMode = aLayer.mDrawMode;
+        aFontLayer->mOffset = Point(aLayer.mOffsetX, aLayer.mOffsetY);
+        aFontLayer->mSpacing = aLayer.mSpacing;
+        aFontLayer->mMinPointSize = aLayer.mMinPointSize;
+        aFontLayer->mMaxPointSize = aLayer.mMaxPointSize;
+        aFontLayer->mPointSize = aLayer.mPointSize;
+        aFontLayer->mAscent = aLayer.mAscent;
+        aFontLayer->mAscentPadding = aLayer.mAscentPadding;
+        aFontLayer->mHeight = aLayer.mHeight;
+        aFontLayer->mDefaultHeight = aLayer.mDefaultHeight;
+        aFontLayer->mLineSpacingOffset = aLayer.mLineSpacingOffset;
+        aFontLayer->mBaseOrder = aLayer.mBaseOrder;
+
+        const CompiledFontChar* aChar = aChars + i * 256;
+        for (int aCharNum = 0; aCharNum < 256; aCharNum++, aChar++)
+        {
+            CharData* aCharData = &aFontLayer->mCharData[aCharNum];
+            aCharData->mImageRect = Rect(aChar->mX, aChar->mY, aChar->mWidth, aChar->mHeight);
+            aCharData->mOffset = Point(aChar->mOffsetX, aChar->mOffsetY);
+            aCharData->mWidth = aChar->mCharWidth;
+            aCharData->mOrder = aChar->mOrder;
+        }
+
+        aFontLayer->mImagePath = aStrings + aStringOffsets[aLayer.mImagePath];
+        if (aFontLayer->mImagePath.empty())
+            continue;
+
+        std::map<std::string, Image*>::iterator anImageItr = anImageMap.find(aFontLayer->mImagePath);
+        if (anImageItr != anImageMap.end())
+            aFontLayer->mImage = anImageItr->second;
+        else if (LoadLayerImage(aFontLayer))
+            anImageMap[aFontLayer->mImagePath] = aFontLayer->mImage;
+        else
+            aSuccess = false;
+
+        // Same check as LayerSetImageMap, which couldn't do it without the
+        // image. When decoding FinishLoad() does it.
+        for (int aCharNum = 0; aCharNum < 256 && aSuccess && !mDecoding; aCharNum++)
+        {
+            const Rect& aRect = aFontLayer->mCharData[aCharNum].mImageRect;
+            if ((aRect.mX < 0) || (aRect.mY < 0) ||
+                (aRect.mX + aRect.mWidth > aFontLayer->mImage->GetWidth()) ||
+                (aRect.mY + aRect.mHeight > aFontLayer->mImage->GetHeight()))
+                aSuccess = false;
+        }
+    }
+
+    if (!aSuccess)
+    {
+        TLOG(mLogFacil, 1, Logger::format("LoadCompiled: '%s' doesn't fit its images", theCompiledPath.c_str()));
+        for (std::map<std::string, Image*>::iterator anItr = anImageMap.begin(); anItr != anImageMap.end(); ++anItr)
+            delete anItr->second;
+        return false;
+    }
+
+    mFontLayerList.swap(aFontLayerList);
+    const CompiledFontLayer* aLayer = aLayers;
+    for (FontLayerList::iterator anItr = mFontLayerList.begin(); anItr != mFontLayerList.end(); ++anItr, ++aLayer)
+        if (aLayer->mName != 0)
+            mFontLayerMap.insert(FontLayerMap::value_type(aStrings + aStringOffsets[aLayer->mName], &*anItr));
+
+    for (uint32_t i = 0; i < aHeader->mNumDefines; i++)
+    {
+        std::string aDefineName = aStrings + aStringOffsets[aDefines[i * 2]];
+        if (mDefineMap.find(aDefineName) == mDefineMap.end())
+            mDefineMap[aDefineName] = new SingleDataElement(aStrings + aStringOffsets[aDefines[i * 2 + 1]]);
+    }
+
+    mDefaultPointSize = aHeader->mDefaultPointSize;
+    memcpy(mCharMap, aHeader->mCharMap, sizeof(mCharMap));
+    return true;
+}
+
 ////
 
 ActiveFontLayer::ActiveFontLayer()
@@ -1141,6 +1726,19 @@ ImageFont::ImageFont(SexyAppBase* theSexyApp, std::string theFontDescFileName)
     mForceScaledImagesWhite = false;
 }
 
+ImageFont::ImageFont(SexyAppBase* theSexyApp, FontData* theFontData)
+{
+    mScale = 1.0;
+    mFontData = theFontData;
+    mFontData->Ref();
+
+    mFontData->FinishLoad(theSexyApp);
+    mPointSize = mFontData->mDefaultPointSize;
+    GenerateActiveFontLayers();
+    mActiveListValid = true;
+    mForceScaledImagesWhite = false;
+}
+
 ImageFont::ImageFont(Image *theFontImage)
 {
     mScale = 1.0;
@@ -1399,7 +1997,7 @@ int ImageFont::CharWidthKern(char theChar, char thePrevChar)
             if (thePrevChar != 0)
             {
                 aSpacing = (int)((anActiveFontLayer->mBaseFontLayer->mSpacing +
-                                            anActiveFontLayer->mBaseFontLayer->mCharData[(uchar) thePrevChar].mKerningOffsets[(uchar) theChar]) * mScale);
+                                            anActiveFontLayer->mBaseFontLayer->GetKerningOffset((uchar) thePrevChar, (uchar) theChar)) * mScale);
             }
             else
                 aSpacing = 0;
@@ -1411,7 +2009,7 @@ int ImageFont::CharWidthKern(char theChar, char thePrevChar)
             if (thePrevChar != 0)
             {
                 aSpacing = (int)((anActiveFontLayer->mBaseFontLayer->mSpacing +
-                                            anActiveFontLayer->mBaseFontLayer->mCharData[(uchar) thePrevChar].mKerningOffsets[(uchar) theChar]) * aPointSize / aLayerPointSize);
+                                            anActiveFontLayer->mBaseFontLayer->GetKerningOffset((uchar) thePrevChar, (uchar) theChar)) * aPointSize / aLayerPointSize);
             }
             else
                 aSpacing = 0;
@@ -1509,7 +2107,7 @@ void ImageFont::DrawStringEx(Graphics* g, int theX, int theY, const SexyString&
                 if (aNextChar != 0)
                 {
                      aSpacing = anActiveFontLayer->mBaseFontLayer->mSpacing +
-                         anActiveFontLayer->mBaseFontLayer->mCharData[(uchar) aChar].mKerningOffsets[(uchar) aNextChar];
+                         anActiveFontLayer->mBaseFontLayer->GetKerningOffset((uchar) aChar, (uchar) aNextChar);
                 }
                 else
                     aSpacing = 0;
@@ -1523,7 +2121,7 @@ void ImageFont::DrawStringEx(Graphics* g, int theX, int theY, const SexyString&
                 if (aNextChar != 0)
                 {
                      aSpacing = (int) ((anActiveFontLayer->mBaseFontLayer->mSpacing +
-                         anActiveFontLayer->mBaseFontLayer->mCharData[(uchar) aChar].mKerningOffsets[(uchar) aNextChar]) * aScale);
+                         anActiveFontLayer->mBaseFontLayer->GetKerningOffset((uchar) aChar, (uchar) aNextChar)) * aScale);
                 }
                 else
                     aSpacing = 0;
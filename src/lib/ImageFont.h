@@ -6,6 +6,11 @@
 #include "Image.h"
 #include "Logging.h"
 
+namespace ImageLib
+{
+class Image;
+}
+
 namespace Sexy
 {
 
@@ -17,7 +22,6 @@ class CharData
 public:
     Rect                    mImageRect;
     Point                   mOffset;
-    char                    mKerningOffsets[256];
     int                     mWidth;
     int                     mOrder;
 
@@ -25,6 +29,17 @@ public:
     CharData();
 };
 
+// Only a few pairs of a font have kerning, so only those are kept
+struct FontKerningPair
+{
+    ushort                  mPair;          // First char << 8 | second char
+    short                   mOffset;
+
+    bool                    operator<(const FontKerningPair& theOther) const { return mPair < theOther.mPair; }
+};
+
+typedef std::vector<FontKerningPair> FontKerningPairVector;
+
 class FontData;
 
 class FontLayer
@@ -34,9 +49,11 @@ public:
     StringVector            mRequiredTags;
     StringVector            mExcludedTags;
     CharData                mCharData[256];
+    FontKerningPairVector   mKerningPairs;  // Sorted
     Color                   mColorMult;
     Color                   mColorAdd;
     Image*                  mImage;
+    std::string             mImagePath;     // As given in the descriptor
     int                     mDrawMode;
     Point                   mOffset;
     int                     mSpacing;
@@ -53,6 +70,9 @@ public:
 public:
     FontLayer(FontData* theFontData);
     FontLayer(const FontLayer& theFontLayer);
+
+    int                     GetKerningOffset(uchar theChar, uchar theNextChar) const;
+    void                    SetKerningOffset(uchar theChar, uchar theNextChar, int theOffset);
 };
 
 typedef std::list<FontLayer> FontLayerList;
@@ -91,8 +111,27 @@ public:
     bool                    Load(SexyAppBase* theSexyApp, const std::string& theFontDescFileName);
     bool                    LoadLegacy(Image* theFontImage, const std::string& theFontDescFileName);
 
+    // Load() in two halves, for loading in the background. Decode() reads
+    // the descriptor and decodes the layer images without the app, so it
+    // may run on any thread. FinishLoad() makes the images, on the main
+    // thread like Load().
+    bool                    Decode(const std::string& theFontDescFileName);
+    bool                    FinishLoad(SexyAppBase* theSexyApp);
+
+    // Writes the binary form of a font descriptor, which Load() picks up
+    // instead of parsing the descriptor as long as that doesn't change.
+    // Layer images aren't loaded for this. See tuxres.
+    bool                    Compile(const std::string& theFontDescFileName, const std::string& theCompiledPath);
+    static std::string      GetCompiledFileName(const std::string& thePath) { return thePath + ".bin"; }
+
+protected:
+    bool                    LoadCompiled(const std::string& theCompiledPath, const std::string& theSourcePath);
+    bool                    LoadLayerImage(FontLayer* theLayer);
+
 private:
     LoggerFacil *           mLogFacil;
+    bool                    mDecoding;
+    std::map<std::string, ImageLib::Image*> mDecodedImages;  // By the layer image path
 };
 
 class ActiveFontLayer
@@ -143,6 +182,7 @@ public:
 
 public:
     ImageFont(SexyAppBase* theSexyApp, std::string theFontDescFileName);
+    ImageFont(SexyAppBase* theSexyApp, FontData* theFontData); // Takes over a FontData that was Decode()d
     ImageFont(Image *theFontImage); // for constructing your own image font without a file descriptor
     ImageFont(const ImageFont& theImageFont);
     virtual ~ImageFont();
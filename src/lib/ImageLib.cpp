@@ -8,6 +8,14 @@
 #include "PakInterface.h"
 #include "Logging.h"
 
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <utime.h>
+#include <algorithm>
+#include <vector>
+
 using namespace ImageLib;
 
 ImageLib::Image::Image()
@@ -133,33 +141,243 @@ static ImageLib::Image* loadImageFromSDLSurface(SDL_Surface* surface)
     return anImage;
 }
 
-static SDL_Surface * read_pakfile(const std::string & theFilename)
+// Image cache entries are a header followed by the raw ARGB pixels, in
+// native byte order, so a hit costs one read straight into the image.
+struct ImageCacheHeader
+{
+    Uint32              mMagic;
+    Uint32              mVersion;
+    Uint32              mKeyLo;
+    Uint32              mKeyHi;
+    Uint32              mWidth;
+    Uint32              mHeight;
+};
+
+static const Uint32 IMAGE_CACHE_MAGIC = 0x43495853;    // "SXIC"
+static const Uint32 IMAGE_CACHE_VERSION = 2;           // Bump when decoding, merging or the keys change
+static const char* const IMAGE_CACHE_MARKER = "cache.ver";
+
+std::string ImageLib::gImageCacheFolder;
+uint64_t ImageLib::gImageCacheBudget = 64 * 1024 * 1024;
+std::string ImageLib::gPrebuiltImageCacheFolder = "imagecache/";
+
+static Uint64 hash_bytes(Uint64 theHash, const void* theData, size_t theSize)
 {
-    // Read a file into image object
+    // 64 bit FNV-1a
+    const Uint8* p = (const Uint8*) theData;
+    for (size_t i = 0; i < theSize; i++) {
+        theHash ^= p[i];
+        theHash *= 0x100000001B3ULL;
+    }
+    return theHash;
+}
 
-    PFILE* file = p_fopen(theFilename.c_str(), "r");
-    if (file == NULL)
+static PFILE* open_source(const std::string& theFilename, std::string& theType)
+{
+    size_t aLastDotPos = theFilename.rfind('.');
+    size_t aLastSlashPos = theFilename.rfind('/');
+
+    // Goes through the pak if one is loaded, the file system otherwise
+    if (aLastDotPos != std::string::npos && (aLastSlashPos == std::string::npos || aLastDotPos > aLastSlashPos)) {
+        theType = theFilename.substr(aLastDotPos + 1);
+        return p_fopen(theFilename.c_str(), "rb");
+    }
+
+    // No extension given, try a couple
+    static const char* const coders[] = { "png", "jpg", "gif" };
+    for (size_t i = 0; i < sizeof(coders) / sizeof(coders[0]); i++) {
+        PFILE* file = p_fopen((theFilename + "." + coders[i]).c_str(), "rb");
+        if (file != NULL) {
+            theType = coders[i];
+            return file;
+        }
+    }
+    return NULL;
+}
+
+// Reads and closes theFile
+static bool read_source(PFILE* theFile, std::vector<Uint8>& theData)
+{
+    int size = p_size(theFile);
+    bool ok = size >= 0;
+    if (ok) {
+        theData.resize(size);
+        ok = size == 0 || p_fread(&theData[0], 1, size, theFile) == (size_t) size;
+    }
+    p_fclose(theFile);
+    return ok;
+}
+
+// Where a source is, its size and its time, without reading it
+static Uint64 stamp_source(Uint64 theHash, const std::string& theType, PFILE* theFile)
+{
+    Uint64 aSize = 0;
+    Uint64 aTime = 0;
+    if (theFile->mRecord != NULL) {
+        aSize = theFile->mRecord->mSize;
+        theHash = hash_bytes(theHash, theFile->mRecord->mFileName.c_str(), theFile->mRecord->mFileName.length() + 1);
+        theHash = hash_bytes(theHash, &theFile->mRecord->mFileTime, sizeof(theFile->mRecord->mFileTime));
+    } else {
+        struct stat aStat;
+        if (fstat(fileno(theFile->mFP), &aStat) == 0) {
+            aSize = aStat.st_size;
+            aTime = aStat.st_mtime;
+            theHash = hash_bytes(theHash, &aStat.st_dev, sizeof(aStat.st_dev));
+            theHash = hash_bytes(theHash, &aStat.st_ino, sizeof(aStat.st_ino));
+        }
+    }
+    theHash = hash_bytes(theHash, &aSize, sizeof(aSize));
+    theHash = hash_bytes(theHash, &aTime, sizeof(aTime));
+    return hash_bytes(theHash, theType.c_str(), theType.length() + 1);
+}
+
+static ImageLib::Image* decode_source(std::vector<Uint8>& theData, const std::string& theType)
+{
+    if (theData.empty())
         return NULL;
 
-    int size = file->mRecord->mSize - file->mPos;
-    Uint8* buffer = new Uint8[size];
-    int res = p_fread((void*)buffer, sizeof(Uint8), size * sizeof(Uint8), file);
+    // The type is only a hint for formats that can't be detected, like TGA
+    SDL_RWops* rw = SDL_RWFromConstMem(&theData[0], theData.size());
+    SDL_Surface* surface = IMG_LoadTyped_RW(rw, 1, theType.c_str());
+    if (surface == NULL)
+        return NULL;
 
-    if (size != res) {
-        delete[] buffer;
+    ImageLib::Image* anImage = loadImageFromSDLSurface(surface);
+    SDL_FreeSurface(surface);
+    return anImage;
+}
+
+static std::string cache_entry_name(const std::string& theFolder, Uint64 theKey)
+{
+    return theFolder + Sexy::StrFormat("%08x%08x.img", (Uint32) (theKey >> 32), (Uint32) theKey);
+}
+
+static ImageLib::Image* read_cached_image(const std::string& theFilename, Uint64 theKey)
+{
+    PFILE* file = p_fopen(theFilename.c_str(), "rb");
+    if (file == NULL)
         return NULL;
-    }
 
-    SDL_RWops* rw = SDL_RWFromMem(buffer, size);
-    SDL_Surface* surface = IMG_Load_RW(rw, 0);
-    SDL_FreeRW(rw);
-    delete[] buffer;
+    ImageLib::Image* anImage = NULL;
+    ImageCacheHeader aHeader;
+    if (p_fread(&aHeader, sizeof(aHeader), 1, file) == 1 &&
+            aHeader.mMagic == IMAGE_CACHE_MAGIC && aHeader.mVersion == IMAGE_CACHE_VERSION &&
+            aHeader.mKeyLo == (Uint32) theKey && aHeader.mKeyHi == (Uint32) (theKey >> 32) &&
+            aHeader.mWidth > 0 && aHeader.mHeight > 0 && aHeader.mWidth <= 32768 && aHeader.mHeight <= 32768) {
+        int aSize = aHeader.mWidth * aHeader.mHeight;
+        anImage = new ImageLib::Image(aHeader.mWidth, aHeader.mHeight);
+        if (p_fread(anImage->mBits, sizeof(Uint32), aSize, file) != (size_t) aSize) {
+            delete anImage;
+            anImage = NULL;
+        }
+    }
     p_fclose(file);
+    return anImage;
+}
+
+static bool write_cache_file(const std::string& theFolder, const std::string& theFilename, const void* theData, size_t theSize, const void* theMoreData, size_t theMoreSize)
+{
+    // Write under a temporary name first, a half written entry must never be found
+    std::string aTmpFilename = theFilename + ".tmp";
+
+    FILE* fp = fopen(aTmpFilename.c_str(), "wb");
+    if (fp == NULL) {
+        Sexy::MkDir(theFolder);
+        fp = fopen(aTmpFilename.c_str(), "wb");
+        if (fp == NULL)
+            return false;
+    }
+
+    bool ok = fwrite(theData, 1, theSize, fp) == theSize &&
+        (theMoreSize == 0 || fwrite(theMoreData, 1, theMoreSize, fp) == theMoreSize);
+    ok = fclose(fp) == 0 && ok;
 
-    return surface;
+    if (ok) {
+        remove(theFilename.c_str());    // rename() won't replace on Windows
+        ok = rename(aTmpFilename.c_str(), theFilename.c_str()) == 0;
+    }
+    if (!ok)
+        remove(aTmpFilename.c_str());
+    return ok;
 }
 
-ImageLib::Image* ImageLib::GetImage(std::string theFilename, bool lookForAlphaImage)
+static void write_cached_image(const std::string& theFolder, Uint64 theKey, ImageLib::Image* theImage)
+{
+    ImageCacheHeader aHeader;
+    aHeader.mMagic = IMAGE_CACHE_MAGIC;
+    aHeader.mVersion = IMAGE_CACHE_VERSION;
+    aHeader.mKeyLo = (Uint32) theKey;
+    aHeader.mKeyHi = (Uint32) (theKey >> 32);
+    aHeader.mWidth = theImage->mWidth;
+    aHeader.mHeight = theImage->mHeight;
+
+    write_cache_file(theFolder, cache_entry_name(theFolder, theKey), &aHeader, sizeof(aHeader),
+            theImage->mBits, theImage->mWidth * theImage->mHeight * sizeof(Uint32));
+}
+
+struct ImageCacheEntry
+{
+    std::string         mFilename;
+    time_t              mTime;
+    Uint64              mSize;
+
+    bool operator<(const ImageCacheEntry& theEntry) const { return mTime < theEntry.mTime; }
+};
+
+// Hits touch their entry, so the entries that go are the least recently used
+static void trim_image_cache()
+{
+    DIR* dir = opendir(gImageCacheFolder.c_str());
+    if (dir == NULL)
+        return;
+
+    std::vector<ImageCacheEntry> anEntries;
+    Uint64 aTotal = 0;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        std::string aName = entry->d_name;
+        if (aName.length() < 4 || aName.compare(aName.length() - 4, 4, ".img") != 0)
+            continue;
+
+        ImageCacheEntry anEntry;
+        anEntry.mFilename = gImageCacheFolder + aName;
+        struct stat aStat;
+        if (stat(anEntry.mFilename.c_str(), &aStat) != 0)
+            continue;
+        anEntry.mTime = aStat.st_mtime;
+        anEntry.mSize = aStat.st_size;
+        aTotal += anEntry.mSize;
+        anEntries.push_back(anEntry);
+    }
+    closedir(dir);
+
+    if (aTotal <= (Uint64) gImageCacheBudget)
+        return;
+
+    std::sort(anEntries.begin(), anEntries.end());
+    for (size_t i = 0; i < anEntries.size() && aTotal > (Uint64) gImageCacheBudget; i++) {
+        if (remove(anEntries[i].mFilename.c_str()) == 0)
+            aTotal -= anEntries[i].mSize;
+    }
+}
+
+// Only looked in when it was made for this version
+static bool has_prebuilt_image_cache()
+{
+    std::string aName = gPrebuiltImageCacheFolder + IMAGE_CACHE_MARKER;
+    if (Sexy::gSexyAppBase != NULL)
+        aName = Sexy::gSexyAppBase->GetAppResourceFileName(aName);
+
+    PFILE* file = p_fopen(aName.c_str(), "rb");
+    if (file == NULL)
+        return false;
+    Uint32 aVersion = 0;
+    bool ok = p_fread(&aVersion, sizeof(aVersion), 1, file) == 1 && aVersion == IMAGE_CACHE_VERSION;
+    p_fclose(file);
+    return ok;
+}
+
+static ImageLib::Image* load_image(std::string theFilename, bool lookForAlphaImage, const std::string& thePrebuildFolder)
 {
     if (!gAutoLoadAlpha)
         lookForAlphaImage = false;
@@ -169,77 +387,111 @@ ImageLib::Image* ImageLib::GetImage(std::string theFilename, bool lookForAlphaIm
     size_t aLastDotPos = theFilename.rfind('.');
     size_t aLastSlashPos = theFilename.rfind('/');
 
-    std::string anExt;
+    bool hasExt = false;
     std::string aFilename;
 
     if (aLastDotPos != std::string::npos && (aLastSlashPos == std::string::npos || aLastDotPos > aLastSlashPos)) {
-        anExt = theFilename.substr(aLastDotPos);
+        hasExt = true;
         aFilename = theFilename.substr(0, aLastDotPos);
     } else {
         aFilename = theFilename;
     }
 
-    SDL_Surface* surface = NULL;
-    bool ok = false;
-
-    bool pak = GetPakPtr()->isLoaded();
-
-    if (anExt.length() == 0) {
-        // No extension given, try a couple
-        std::list<std::string> coderList;
-        coderList.push_back("png");
-        coderList.push_back("jpg");
-        coderList.push_back("gif");
-        for (std::list<std::string>::const_iterator entry = coderList.begin(); entry != coderList.end(); entry++) {
-            if (pak) {
-                // Read a file into image object
-                surface = read_pakfile(theFilename + "." + *entry);
-            } else {
-                std::string myFilename = theFilename + "." + *entry;
-                if (Sexy::gSexyAppBase->FileExists(myFilename)) {
-                    surface = IMG_Load(myFilename.c_str());
-                }
-            }
+    // Only open the source files here, they are not read unless the image
+    // cache misses.
+    std::string aType;
+    PFILE* aFile = open_source(theFilename, aType);
+    if (aFile == NULL && hasExt)
+        return NULL;
 
-            if (surface) {
-                ok = true;
-                break;
-            }
+    std::string anAlphaType;
+    PFILE* anAlphaFile = NULL;
+    if (lookForAlphaImage) {
+        // Check for alpha images. Use the filename WITHOUT the extension!
+        // Check FileName_
+        anAlphaFile = open_source(aFilename + "_", anAlphaType);
+
+        if (anAlphaFile == NULL) {
+            // Check <dirname> / _<basename>
+            anAlphaFile = open_source(aFilename.substr(0, aLastSlashPos + 1) + "_" + aFilename.substr(aLastSlashPos + 1), anAlphaType);
         }
-    } else {
+    }
 
-        // Filename with extension
-        if (pak) {
-            surface = read_pakfile(theFilename);
-        } else {
-            if (Sexy::gSexyAppBase->FileExists(theFilename)) {
-                surface = IMG_Load(theFilename.c_str());
-            }
+    if (aFile == NULL && anAlphaFile == NULL)
+        return NULL;
+
+    // Our own entries are keyed on where the sources are, their size and
+    // their time, a hit doesn't read them at all
+    bool useCache = thePrebuildFolder.empty() && !gImageCacheFolder.empty();
+    Uint64 aStamp = 0;
+    std::string aCacheName;
+    if (useCache) {
+        Uint32 aVersion = IMAGE_CACHE_VERSION;
+        aStamp = hash_bytes(0xCBF29CE484222325ULL, &aVersion, sizeof(aVersion));
+        if (aFile != NULL)
+            aStamp = stamp_source(aStamp, aType, aFile);
+        if (anAlphaFile != NULL) {
+            aStamp = hash_bytes(aStamp, "_", 2);
+            aStamp = stamp_source(aStamp, anAlphaType, anAlphaFile);
+            if (aFile == NULL)
+                aStamp = hash_bytes(aStamp, &gAlphaComposeColor, sizeof(gAlphaComposeColor));
         }
 
-        if (!surface)
-            return NULL;
-        ok = true;
+        aCacheName = cache_entry_name(gImageCacheFolder, aStamp);
+        ImageLib::Image* aCachedImage = read_cached_image(aCacheName, aStamp);
+        if (aCachedImage != NULL) {
+            if (aFile != NULL)
+                p_fclose(aFile);
+            if (anAlphaFile != NULL)
+                p_fclose(anAlphaFile);
+            utime(aCacheName.c_str(), NULL);
+            return aCachedImage;
+        }
     }
 
-    Image* anAlphaImage = NULL;
-    if (lookForAlphaImage) {
-        // Check for alpha images. Use the filename WITHOUT the extension!
-        // Check FileName_
-        anAlphaImage = GetImage(aFilename + "_", false);
+    std::vector<Uint8> aData;
+    bool ok = aFile != NULL && read_source(aFile, aData);
+    std::vector<Uint8> anAlphaData;
+    bool hasAlpha = anAlphaFile != NULL && read_source(anAlphaFile, anAlphaData);
+    if ((!ok && hasExt) || (!ok && !hasAlpha))
+        return NULL;
 
-        if (anAlphaImage == NULL) {
-            // Check <dirname> / _<basename>
-            anAlphaImage = GetImage(aFilename.substr(0, aLastSlashPos + 1) + "_" + aFilename.substr(aLastSlashPos + 1), false);
+    // The prebuilt entries are shipped with the resources, keyed on what is
+    // in the sources
+    bool usePrebuilt = !thePrebuildFolder.empty() || (!gPrebuiltImageCacheFolder.empty() && has_prebuilt_image_cache());
+    Uint64 aKey = 0;
+    if (usePrebuilt) {
+        Uint32 aSizes[3] = { IMAGE_CACHE_VERSION, (Uint32) aData.size(), (Uint32) anAlphaData.size() };
+        aKey = hash_bytes(0xCBF29CE484222325ULL, aSizes, sizeof(aSizes));
+        aKey = hash_bytes(aKey, aType.c_str(), aType.length() + 1);
+        if (!aData.empty())
+            aKey = hash_bytes(aKey, &aData[0], aData.size());
+        if (hasAlpha) {
+            aKey = hash_bytes(aKey, anAlphaType.c_str(), anAlphaType.length() + 1);
+            if (!anAlphaData.empty())
+                aKey = hash_bytes(aKey, &anAlphaData[0], anAlphaData.size());
+            if (!ok)
+                aKey = hash_bytes(aKey, &gAlphaComposeColor, sizeof(gAlphaComposeColor));
+        }
+
+        if (thePrebuildFolder.empty()) {
+            std::string aName = cache_entry_name(gPrebuiltImageCacheFolder, aKey);
+            if (Sexy::gSexyAppBase != NULL)
+                aName = Sexy::gSexyAppBase->GetAppResourceFileName(aName);
+            ImageLib::Image* aCachedImage = read_cached_image(aName, aKey);
+            if (aCachedImage != NULL)
+                return aCachedImage;
         }
     }
 
+    ImageLib::Image* anAlphaImage = hasAlpha ? decode_source(anAlphaData, anAlphaType) : NULL;
+
     ImageLib::Image* anImage = NULL;
     // Compose alpha channel with image
     if (anAlphaImage != NULL) {
 
-        if (surface != NULL) {
-            anImage = loadImageFromSDLSurface(surface);
+        if (ok) {
+            anImage = decode_source(aData, aType);
         }
 
         if (anImage != NULL) {
@@ -284,11 +536,31 @@ ImageLib::Image* ImageLib::GetImage(std::string theFilename, bool lookForAlphaIm
     }
 
     if (anImage == NULL && ok) {
-        anImage = loadImageFromSDLSurface(surface);
+        anImage = decode_source(aData, aType);
     }
 
-    if (surface != NULL)
-        SDL_FreeSurface(surface);
+    if (anImage != NULL && !thePrebuildFolder.empty()) {
+        write_cached_image(thePrebuildFolder, aKey, anImage);
+    } else if (anImage != NULL && useCache) {
+        write_cached_image(gImageCacheFolder, aStamp, anImage);
+        trim_image_cache();
+    }
 
     return anImage;
 }
+
+ImageLib::Image* ImageLib::GetImage(std::string theFilename, bool lookForAlphaImage)
+{
+    return load_image(theFilename, lookForAlphaImage, "");
+}
+
+bool ImageLib::PrebuildCachedImage(const std::string& theFilename, bool lookForAlphaImage, const std::string& theFolder)
+{
+    Image* anImage = load_image(theFilename, lookForAlphaImage, theFolder);
+    if (anImage == NULL)
+        return false;
+    delete anImage;
+
+    Uint32 aVersion = IMAGE_CACHE_VERSION;
+    return write_cache_file(theFolder, theFolder + IMAGE_CACHE_MARKER, &aVersion, sizeof(aVersion), NULL, 0);
+}
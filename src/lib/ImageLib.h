@@ -38,7 +38,25 @@ extern int gAlphaComposeColor;
 extern bool gAutoLoadAlpha;
 extern bool gIgnoreJPEG2000Alpha;  // I've noticed alpha in jpeg2000's that shouldn't have alpha so this defaults to true
 
+// GetImage() can keep the decoded and alpha merged pixels of the images it
+// loads, so they don't have to be decoded again on the next run.
+//
+// gImageCacheFolder is off unless set, SexyAppBase sets it when the app
+// asks for it with mImageCacheSize. Its entries are keyed on where the
+// source files are, their size and their time, so a hit doesn't read the
+// sources. It is kept under gImageCacheBudget bytes, the least recently
+// used entries go first.
+//
+// gPrebuiltImageCacheFolder is relative to the resources, may be in the
+// pak and is never written to. tuxres builds it with PrebuildCachedImage(),
+// keyed on a hash of the source files. It is only looked in when the
+// writable cache misses. Set it to "" to do without.
+extern std::string gImageCacheFolder;
+extern uint64_t gImageCacheBudget;
+extern std::string gPrebuiltImageCacheFolder;
+
 Image* GetImage(std::string theFileName, bool lookForAlphaImage = true);
+bool PrebuildCachedImage(const std::string& theFileName, bool lookForAlphaImage, const std::string& theFolder);
 
 void InitJPEG2000();
 void CloseJPEG2000();
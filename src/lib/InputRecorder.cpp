@@ -0,0 +1,420 @@
+#include "InputRecorder.h"
+#include "SexyAppBase.h"
+
+#include <algorithm>
+
+using namespace Sexy;
+
+// File layout, host byte order like the pak files:
+//   uint32 magic, uint32 version, uint16 width, uint16 height
+//   then entries of: uchar type, varint updates since the previous entry
+//   and the data of the type. Coordinates and buttons are zigzag varints.
+#define INPUTREC_MAGIC      0x52495854      // "TXIR"
+#define INPUTREC_VERSION    1
+
+InputRecorder* InputRecorder::sActive = NULL;
+
+static void WriteVarInt(std::string& theData, uint32_t theValue)
+{
+    while (theValue >= 0x80) {
+        theData += (char) (theValue | 0x80);
+        theValue >>= 7;
+    }
+    theData += (char) theValue;
+}
+
+static void WriteSignedVarInt(std::string& theData, int theValue)
+{
+    WriteVarInt(theData, ((uint32_t) theValue << 1) ^ (uint32_t) (theValue >> 31));
+}
+
+static bool ReadVarInt(const std::string& theData, size_t& thePos, uint32_t& theValue)
+{
+    theValue = 0;
+    for (int aShift = 0; aShift < 35 && thePos < theData.size(); aShift += 7) {
+        uchar aByte = theData[thePos++];
+        theValue |= (uint32_t) (aByte & 0x7F) << aShift;
+        if (!(aByte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+static bool ReadSignedVarInt(const std::string& theData, size_t& thePos, int& theValue)
+{
+    uint32_t aValue;
+    if (!ReadVarInt(theData, thePos, aValue))
+        return false;
+    theValue = (int) (aValue >> 1) ^ -(int) (aValue & 1);
+    return true;
+}
+
+InputRecorder::InputRecorder(SexyAppBase* theApp)
+{
+    mLogFacil = NULL;
+#ifdef DEBUG
+    mLogFacil = LoggerFacil::find("inputrecorder");
+#endif
+
+    mApp = theApp;
+    mMutex = SDL_CreateMutex();
+    mFP = NULL;
+    mLastUpdate = 0;
+    mReplaying = false;
+    mNextInput = 0;
+    mNextSeed = 0;
+    mLoadedUpdate = -1;
+    mEndUpdate = 0;
+    mFinished = false;
+}
+
+InputRecorder::~InputRecorder()
+{
+    Finish();
+    if (sActive == this)
+        sActive = NULL;
+    SDL_DestroyMutex(mMutex);
+}
+
+bool InputRecorder::StartRecording(const std::string& theFileName)
+{
+    mFP = fopen(theFileName.c_str(), "wb");
+    if (mFP == NULL) {
+        LOG(mLogFacil, 1, Logger::format("can't create recording '%s'", theFileName.c_str()));
+        return false;
+    }
+
+    uint32_t aHeader[2] = { INPUTREC_MAGIC, INPUTREC_VERSION };
+    uint16_t aSize[2] = { (uint16_t) mApp->mWidth, (uint16_t) mApp->mHeight };
+    fwrite(aHeader, sizeof(aHeader), 1, mFP);
+    fwrite(aSize, sizeof(aSize), 1, mFP);
+    mLastUpdate = 0;
+    sActive = this;
+    return true;
+}
+
+bool InputRecorder::StartReplay(const std::string& theFileName)
+{
+    FILE* aFP = fopen(theFileName.c_str(), "rb");
+    if (aFP == NULL) {
+        LOG(mLogFacil, 1, Logger::format("can't open recording '%s'", theFileName.c_str()));
+        return false;
+    }
+    std::string aData;
+    char aBuffer[4096];
+    size_t aRead;
+    while ((aRead = fread(aBuffer, 1, sizeof(aBuffer), aFP)) > 0)
+        aData.append(aBuffer, aRead);
+    fclose(aFP);
+
+    if (!Read(aData)) {
+        LOG(mLogFacil, 1, Logger::format("'%s' is not a recording", theFileName.c_str()));
+        return false;
+    }
+
+    mReplayFile = theFileName;
+    mReplaying = true;
+    sActive = this;
+    return true;
+}
+
+bool InputRecorder::Read(const std::string& theData)
+{
+    uint32_t aHeader[2];
+    uint16_t aSize[2];
+    if (theData.size() < sizeof(aHeader) + sizeof(aSize))
+        return false;
+    memcpy(aHeader, theData.data(), sizeof(aHeader));
+    memcpy(aSize, theData.data() + sizeof(aHeader), sizeof(aSize));
+    if (aHeader[0] != INPUTREC_MAGIC || aHeader[1] != INPUTREC_VERSION)
+        return false;
+    if (aSize[0] != mApp->mWidth || aSize[1] != mApp->mHeight)
+        LOG(mLogFacil, 1, Logger::format("recorded at %dx%d, the game is %dx%d", aSize[0], aSize[1], mApp->mWidth, mApp->mHeight));
+
+    size_t aPos = sizeof(aHeader) + sizeof(aSize);
+    int anUpdate = 0;
+    mEndUpdate = -1;
+    while (aPos < theData.size()) {
+        InputRecord aRecord;
+        aRecord.mType = (uchar) theData[aPos++];
+        aRecord.mX = 0;
+        aRecord.mY = 0;
+        aRecord.mValue = 0;
+
+        uint32_t aDelta;
+        if (!ReadVarInt(theData, aPos, aDelta))
+            break;
+        anUpdate += aDelta;
+        aRecord.mUpdate = anUpdate;
+
+        bool ok = true;
+        switch (aRecord.mType) {
+        case InputRecord_MouseMove:
+            ok = ReadSignedVarInt(theData, aPos, aRecord.mX) && ReadSignedVarInt(theData, aPos, aRecord.mY);
+            break;
+        case InputRecord_MouseDown:
+        case InputRecord_MouseUp:
+        {
+            int aButton = 0;
+            ok = ReadSignedVarInt(theData, aPos, aRecord.mX) && ReadSignedVarInt(theData, aPos, aRecord.mY) &&
+                ReadSignedVarInt(theData, aPos, aButton);
+            aRecord.mValue = (uint32_t) aButton;
+            break;
+        }
+        case InputRecord_KeyDown:
+        case InputRecord_KeyUp:
+        case InputRecord_Focus:
+            ok = ReadVarInt(theData, aPos, aRecord.mValue);
+            break;
+        case InputRecord_Seed:
+            ok = aPos + 4 <= theData.size();
+            if (ok)
+                memcpy(&aRecord.mValue, theData.data() + aPos, 4);
+            aPos += 4;
+            break;
+        case InputRecord_Quit:
+        case InputRecord_Loaded:
+        case InputRecord_End:
+            break;
+        default:
+            ok = false;
+            break;
+        }
+        if (!ok)
+            break;
+
+        if (aRecord.mType == InputRecord_Seed)
+            mSeeds.push_back(aRecord.mValue);
+        else if (aRecord.mType == InputRecord_Loaded)
+            mLoadedUpdate = aRecord.mUpdate;
+        else if (aRecord.mType == InputRecord_End)
+            mEndUpdate = aRecord.mUpdate;
+        else
+            mInput.push_back(aRecord);
+    }
+
+    // Cut short, the game probably crashed. Play what is there.
+    if (mEndUpdate < 0) {
+        LOG(mLogFacil, 1, "recording has no end");
+        mEndUpdate = anUpdate;
+    }
+    return true;
+}
+
+void InputRecorder::Write(const InputRecord& theRecord)
+{
+    std::string aData;
+    aData += (char) theRecord.mType;
+    WriteVarInt(aData, std::max(theRecord.mUpdate - mLastUpdate, 0));
+    mLastUpdate = std::max(theRecord.mUpdate, mLastUpdate);
+
+    switch (theRecord.mType) {
+    case InputRecord_MouseMove:
+        WriteSignedVarInt(aData, theRecord.mX);
+        WriteSignedVarInt(aData, theRecord.mY);
+        break;
+    case InputRecord_MouseDown:
+    case InputRecord_MouseUp:
+        WriteSignedVarInt(aData, theRecord.mX);
+        WriteSignedVarInt(aData, theRecord.mY);
+        WriteSignedVarInt(aData, (int) theRecord.mValue);
+        break;
+    case InputRecord_KeyDown:
+    case InputRecord_KeyUp:
+    case InputRecord_Focus:
+        WriteVarInt(aData, theRecord.mValue);
+        break;
+    case InputRecord_Seed:
+        aData.append((const char*) &theRecord.mValue, 4);
+        break;
+    }
+
+    fwrite(aData.data(), 1, aData.size(), mFP);
+}
+
+void InputRecorder::Record(InputRecordType theType, int theX, int theY, uint32_t theValue)
+{
+    if (mFP == NULL)
+        return;
+
+    InputRecord aRecord;
+    aRecord.mType = theType;
+    aRecord.mUpdate = mApp->mUpdateCount;
+    aRecord.mX = theX;
+    aRecord.mY = theY;
+    aRecord.mValue = theValue;
+
+    SDL_LockMutex(mMutex);
+    if (mFP != NULL)
+        Write(aRecord);
+    SDL_UnlockMutex(mMutex);
+}
+
+uint32_t InputRecorder::FilterSeed(uint32_t theSeed)
+{
+    InputRecorder* aRecorder = sActive;
+    if (aRecorder == NULL)
+        return theSeed;
+
+    if (aRecorder->mReplaying) {
+        SDL_LockMutex(aRecorder->mMutex);
+        if (aRecorder->mNextSeed < aRecorder->mSeeds.size())
+            theSeed = aRecorder->mSeeds[aRecorder->mNextSeed++];
+        else
+            LOG(aRecorder->mLogFacil, 1, "more seeds than recorded, the replay went its own way");
+        SDL_UnlockMutex(aRecorder->mMutex);
+    }
+    else
+        aRecorder->Record(InputRecord_Seed, 0, 0, theSeed);
+    return theSeed;
+}
+
+void InputRecorder::ReplayInput()
+{
+    while (mReplaying && mNextInput < mInput.size() && !mApp->mShutdown) {
+        const InputRecord& aRecord = mInput[mNextInput];
+        if (aRecord.mUpdate > mApp->mUpdateCount)
+            break;
+        mNextInput++;
+
+        switch (aRecord.mType) {
+        case InputRecord_MouseMove:
+            mApp->HandleMouseMove(aRecord.mX, aRecord.mY);
+            break;
+        case InputRecord_MouseDown:
+            mApp->HandleMouseButton(aRecord.mX, aRecord.mY, (int) aRecord.mValue, false);
+            break;
+        case InputRecord_MouseUp:
+            mApp->HandleMouseButton(aRecord.mX, aRecord.mY, (int) aRecord.mValue, true);
+            break;
+        case InputRecord_KeyDown:
+            mApp->HandleKey((SDL_Keycode) aRecord.mValue, false);
+            break;
+        case InputRecord_KeyUp:
+            mApp->HandleKey((SDL_Keycode) aRecord.mValue, true);
+            break;
+        case InputRecord_Focus:
+            mApp->HandleFocus(aRecord.mValue != 0);
+            break;
+        case InputRecord_Quit:
+            mApp->Shutdown();
+            break;
+        }
+    }
+}
+
+bool InputRecorder::ReplayLoaded()
+{
+    if (mLoadedUpdate < 0 || mApp->mUpdateCount < mLoadedUpdate)
+        return false;
+
+    // Loading took longer than when it was recorded
+    mApp->WaitForLoadingThread();
+    return true;
+}
+
+bool InputRecorder::IsReplayDone() const
+{
+    return mReplaying && mApp->mUpdateCount >= mEndUpdate;
+}
+
+void InputRecorder::StartTiming()
+{
+    mTimer.start();
+}
+
+// An update is counted for the update it did, the draw after it for that
+// same update
+void InputRecorder::AddUpdateTime()
+{
+    mTimer.stop();
+    size_t anIdx = std::max(mApp->mUpdateCount - 1, 0);
+    if (mUpdateTimes.size() <= anIdx)
+        mUpdateTimes.resize(anIdx + 1, 0.0f);
+    mUpdateTimes[anIdx] += (float) mTimer.getElapsedTimeInMilliSec();
+}
+
+void InputRecorder::AddDrawTime()
+{
+    mTimer.stop();
+    size_t anIdx = std::max(mApp->mUpdateCount - 1, 0);
+    if (mDrawTimes.size() <= anIdx)
+        mDrawTimes.resize(anIdx + 1, 0.0f);
+    mDrawTimes[anIdx] += (float) mTimer.getElapsedTimeInMilliSec();
+}
+
+static void WriteStats(FILE* theFP, const char* theName, std::vector<float> theTimes, bool last)
+{
+    double aSum = 0.0;
+    for (size_t i = 0; i < theTimes.size(); i++)
+        aSum += theTimes[i];
+    std::sort(theTimes.begin(), theTimes.end());
+
+    fprintf(theFP, "  \"%s\": {", theName);
+    if (!theTimes.empty()) {
+        size_t aCount = theTimes.size();
+        fprintf(theFP, "\"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f",
+                aSum / aCount, theTimes[aCount / 2], theTimes[aCount * 95 / 100], theTimes[aCount * 99 / 100], theTimes[aCount - 1]);
+    }
+    fprintf(theFP, "}%s\n", last ? "" : ",");
+}
+
+void InputRecorder::WriteTimings()
+{
+    size_t aFrames = std::max(mUpdateTimes.size(), mDrawTimes.size());
+    mUpdateTimes.resize(aFrames, 0.0f);
+    mDrawTimes.resize(aFrames, 0.0f);
+    std::vector<float> aFrameTimes(aFrames);
+    for (size_t i = 0; i < aFrames; i++)
+        aFrameTimes[i] = mUpdateTimes[i] + mDrawTimes[i];
+
+    double aTotal = 0.0;
+    float aWorst = 0.0f;
+    for (size_t i = 0; i < aFrames; i++) {
+        aTotal += aFrameTimes[i];
+        aWorst = std::max(aWorst, aFrameTimes[i]);
+    }
+    printf("replay of %s: %d updates, %.3f ms per frame, worst %.3f ms\n", mReplayFile.c_str(), (int) aFrames,
+           aFrames > 0 ? aTotal / aFrames : 0.0, aWorst);
+
+    if (mTimingsFile.empty())
+        return;
+    FILE* aFP = mTimingsFile == "-" ? stdout : fopen(mTimingsFile.c_str(), "w");
+    if (aFP == NULL) {
+        LOG(mLogFacil, 1, Logger::format("can't create '%s'", mTimingsFile.c_str()));
+        return;
+    }
+
+    // Same spirit as the tuxcap_bench JSON, easy to diff between builds
+    fprintf(aFP, "{\n");
+    fprintf(aFP, "  \"recording\": \"%s\",\n", mReplayFile.c_str());
+    fprintf(aFP, "  \"frames\": %d,\n", (int) aFrames);
+    WriteStats(aFP, "update_ms", mUpdateTimes, false);
+    WriteStats(aFP, "draw_ms", mDrawTimes, false);
+    WriteStats(aFP, "frame_ms", aFrameTimes, false);
+    fprintf(aFP, "  \"per_frame\": [");
+    for (size_t i = 0; i < aFrames; i++)
+        fprintf(aFP, "%s[%.4f, %.4f]", i > 0 ? ", " : "", mUpdateTimes[i], mDrawTimes[i]);
+    fprintf(aFP, "]\n}\n");
+    if (aFP != stdout)
+        fclose(aFP);
+}
+
+void InputRecorder::Finish()
+{
+    if (mFinished)
+        return;
+
+    if (mFP != NULL) {
+        Record(InputRecord_End);
+        SDL_LockMutex(mMutex);
+        fclose(mFP);
+        mFP = NULL;
+        SDL_UnlockMutex(mMutex);
+        mFinished = true;
+    }
+    else if (mReplaying) {
+        WriteTimings();
+        mFinished = true;
+    }
+}
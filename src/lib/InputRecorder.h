@@ -0,0 +1,125 @@
+#ifndef __INPUTRECORDER_H__
+#define __INPUTRECORDER_H__
+
+#include <SDL.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "Logging.h"
+#include "Timer.h"
+
+namespace Sexy
+{
+
+class SexyAppBase;
+
+// What a recording is made of. Every entry is stamped with the update
+// (SexyAppBase::mUpdateCount) before which it happened.
+enum InputRecordType
+{
+    InputRecord_MouseMove,      // x, y in game coordinates
+    InputRecord_MouseDown,      // x, y, button as passed to WidgetManager
+    InputRecord_MouseUp,
+    InputRecord_KeyDown,        // SDL key
+    InputRecord_KeyUp,
+    InputRecord_Focus,          // 1 gained, 0 lost
+    InputRecord_Quit,
+    InputRecord_Seed,           // A seed given to MTRand or HGE::Random_Seed
+    InputRecord_Loaded,         // The update that saw the loading thread done
+    InputRecord_End,
+    NUM_INPUT_RECORD_TYPES
+};
+
+struct InputRecord
+{
+    int                     mType;
+    int                     mUpdate;
+    int                     mX;
+    int                     mY;
+    uint32_t                mValue;
+};
+
+// Records the input of a session as it is dispatched by
+// SexyAppBase::UpdateAppStep(), with the random seeds and the update in
+// which loading finished, and replays it.
+//
+// A replay feeds the recorded input to the same update numbers and runs at a
+// fixed timestep, one update and one draw after the other and as fast as
+// possible. Real input is ignored. Per frame update and draw times are kept
+// and written as JSON at the end. Games replay the same as long as their
+// logic depends on updates and the framework's random numbers, not on the
+// clock.
+//
+// Use --record FILE and --replay FILE [--replay-timings FILE] on the
+// command line. --replay runs headless, with SDL's dummy video and audio
+// drivers and the software renderer, unless told otherwise.
+class InputRecorder
+{
+public:
+    InputRecorder(SexyAppBase* theApp);
+    ~InputRecorder();
+
+    bool                    StartRecording(const std::string& theFileName);
+    bool                    StartReplay(const std::string& theFileName);
+    void                    SetTimingsFile(const std::string& theFileName) { mTimingsFile = theFileName; }
+    // Ends the recording, or writes the timings of the replay
+    void                    Finish();
+
+    bool                    IsRecording() const { return mFP != NULL; }
+    bool                    IsReplaying() const { return mReplaying; }
+    // The replay has reached the end of the recording
+    bool                    IsReplayDone() const;
+
+    // Does nothing unless recording
+    void                    Record(InputRecordType theType, int theX = 0, int theY = 0, uint32_t theValue = 0);
+
+    // Dispatches the input that is due before the next update
+    void                    ReplayInput();
+    // Whether DoUpdateFrames() should see the loading thread done now
+    bool                    ReplayLoaded();
+
+    void                    StartTiming();
+    void                    AddUpdateTime();
+    void                    AddDrawTime();
+
+    // All seeds for MTRand and HGE::Random_Seed go through here. Recorded,
+    // or replaced by the recorded ones in the same order during a replay.
+    static uint32_t         FilterSeed(uint32_t theSeed);
+
+private:
+    void                    Write(const InputRecord& theRecord);
+    bool                    Read(const std::string& theData);
+    void                    WriteTimings();
+
+    SexyAppBase*            mApp;
+    SDL_mutex*              mMutex;         // Seeds may come from the loading thread
+
+    // Recording
+    FILE*                   mFP;
+    int                     mLastUpdate;
+
+    // Replay
+    bool                    mReplaying;
+    std::string             mReplayFile;
+    std::vector<InputRecord> mInput;
+    size_t                  mNextInput;
+    std::vector<uint32_t>   mSeeds;
+    size_t                  mNextSeed;
+    int                     mLoadedUpdate;
+    int                     mEndUpdate;
+
+    // Timings of the replay, in ms per update
+    std::string             mTimingsFile;
+    Timer                   mTimer;
+    std::vector<float>      mUpdateTimes;
+    std::vector<float>      mDrawTimes;
+    bool                    mFinished;
+
+    static InputRecorder*   sActive;
+    LoggerFacil *           mLogFacil;
+};
+
+}
+
+#endif //__INPUTRECORDER_H__
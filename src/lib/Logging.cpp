@@ -8,12 +8,114 @@
 #include <cstdarg>
 #include <cstring>
 #include <string>
+#include <vector>
+#include <algorithm>
+#include <SDL.h>
 
 #include "Logging.h"
 #include "Timer.h"
 
 using namespace std;
 
+#if SDL_VERSION_ATLEAST(2,0,0)
+#define LOGGER_ASYNC
+#endif
+
+#ifdef LOGGER_ASYNC
+namespace
+{
+
+#define LOG_RECORD_TEXT     224
+#define LOG_RING_SIZE       256     // Records, a power of two
+#define LOG_ENTRY_RECORDS   64      // Longer entries are cut off
+
+// An entry as the calling thread leaves it, or a piece of a long one. The
+// time stamp and the facility name are only put in front by the writer.
+struct LogRecord
+{
+    Uint32          mSeq;           // Orders the entries of all threads
+    LoggerFacil *   mFacil;
+    double          mTime;          // Negative without a time stamp
+    unsigned short  mLength;
+    bool            mContinued;     // The next record has more of the text
+    char            mText[LOG_RECORD_TEXT];
+};
+
+// Filled by one thread, emptied by the writer
+struct LogRing
+{
+    LogRecord       mRecords[LOG_RING_SIZE];
+    SDL_atomic_t    mRead;
+    SDL_atomic_t    mWrite;
+    SDL_atomic_t    mOrphaned;      // Its thread ended, reused once empty
+};
+
+bool                    gLogAsync = true;
+SDL_Thread *            gLogThread;
+SDL_sem *               gLogWake;
+SDL_mutex *             gLogRingsMutex;
+vector<LogRing *>       gLogRings;
+SDL_TLSID               gLogRingTLS;
+SDL_atomic_t            gLogSeq;
+SDL_atomic_t            gLogWritten;
+SDL_atomic_t            gLogQuit;
+
+bool LogRecordBefore(const LogRecord & a, const LogRecord & b)
+{
+    return (Sint32) (a.mSeq - b.mSeq) < 0;
+}
+
+void OrphanLogRing(void * ring)
+{
+    SDL_AtomicSet(&((LogRing *) ring)->mOrphaned, 1);
+}
+
+LogRing * GetLogRing()
+{
+    LogRing * ring = (LogRing *) SDL_TLSGet(gLogRingTLS);
+    if (ring != NULL) {
+        return ring;
+    }
+
+    SDL_LockMutex(gLogRingsMutex);
+    for (size_t i = 0; i < gLogRings.size() && ring == NULL; i++) {
+        LogRing * old = gLogRings[i];
+        if (SDL_AtomicGet(&old->mOrphaned) && SDL_AtomicGet(&old->mRead) == SDL_AtomicGet(&old->mWrite)) {
+            SDL_AtomicSet(&old->mOrphaned, 0);
+            ring = old;
+        }
+    }
+    if (ring == NULL) {
+        ring = new LogRing();
+        SDL_AtomicSet(&ring->mRead, 0);
+        SDL_AtomicSet(&ring->mWrite, 0);
+        SDL_AtomicSet(&ring->mOrphaned, 0);
+        gLogRings.push_back(ring);
+    }
+    SDL_UnlockMutex(gLogRingsMutex);
+
+    SDL_TLSSet(gLogRingTLS, ring, OrphanLogRing);
+    return ring;
+}
+
+void StopLogWriter()
+{
+    SDL_Thread * thread = gLogThread;
+    if (thread == NULL) {
+        return;
+    }
+
+    // New entries are written at once from here on, the writer does the rest
+    gLogThread = NULL;
+    SDL_AtomicSet(&gLogQuit, 1);
+    SDL_SemPost(gLogWake);
+    SDL_WaitThread(thread, NULL);
+    SDL_AtomicSet(&gLogQuit, 0);
+}
+
+}
+#endif
+
 // TODO. Make this a vector, and write the log entries to all of
 // them. And then add special loggers for really important (error) messages,
 Logger * Logger::_logger;
@@ -31,6 +133,39 @@ Logger::Logger()
 
     // Create a few essential logging facilities
     // TODO
+
+#ifdef LOGGER_ASYNC
+    if (gLogAsync && gLogThread == NULL) {
+        if (gLogWake == NULL) {
+            gLogWake = SDL_CreateSemaphore(0);
+            gLogRingsMutex = SDL_CreateMutex();
+            gLogRingTLS = SDL_TLSCreate();
+            atexit(StopLogWriter);
+        }
+        gLogThread = SDL_CreateThread(writer_proc, "Logger", NULL);
+    }
+#endif
+}
+
+void Logger::set_async(bool async)
+{
+#ifdef LOGGER_ASYNC
+    gLogAsync = async;
+    if (!async) {
+        StopLogWriter();
+    }
+#endif
+}
+
+void Logger::flush()
+{
+#ifdef LOGGER_ASYNC
+    Uint32 seq = SDL_AtomicGet(&gLogSeq);
+    while (gLogThread != NULL && (Sint32) (SDL_AtomicGet(&gLogWritten) - seq) < 0) {
+        SDL_SemPost(gLogWake);
+        SDL_Delay(1);
+    }
+#endif
 }
 
 bool Logger::set_log_level(const string & txt)
@@ -83,14 +218,11 @@ bool Logger::set_log_level(const string & txt)
 
 void Logger::log(LoggerFacil * facil, int lvl, const char * txt)
 {
-    if (_logger == NULL || facil == NULL) {
-        return;
-    }
-    if (lvl > facil->getLevel()) {
+    if (!wants(facil, lvl)) {
         // The detail level of this log entry is higher than the max requested level.
         return;
     }
-    _logger->write_str(facil->getName() + ": " + txt);
+    put(facil, -1.0, txt);
 }
 
 void Logger::log(LoggerFacil * facil, int lvl, const string & txt)
@@ -100,21 +232,135 @@ void Logger::log(LoggerFacil * facil, int lvl, const string & txt)
 
 void Logger::tlog(LoggerFacil * facil, int lvl, const char * txt)
 {
-    if (_logger == NULL || facil == NULL) {
+    if (!wants(facil, lvl)) {
+        // The level of this log entry is higher than the maximum and thus not wanted.
         return;
     }
-    if (lvl > facil->getLevel()) {
-        // The level of this log entry is higher than the maximum and thus not wanted.
+    put(facil, _timer->getElapsedTimeInSec() - _start_time, txt);
+}
+
+void Logger::tlog(LoggerFacil * facil, int lvl, const string & txt)
+{
+    tlog(facil, lvl, txt.c_str());
+}
+
+void Logger::put(LoggerFacil * facil, double time, const char * txt)
+{
+#ifdef LOGGER_ASYNC
+    if (gLogThread != NULL) {
+        LogRing * ring = GetLogRing();
+
+        size_t len = strlen(txt);
+        int count = len / LOG_RECORD_TEXT + 1;
+        if (count > LOG_ENTRY_RECORDS) {
+            count = LOG_ENTRY_RECORDS;
+            len = count * LOG_RECORD_TEXT;
+        }
+        Uint32 seq = SDL_AtomicAdd(&gLogSeq, 1) + 1;
+
+        // Only this thread writes to the ring, the writer only makes room
+        int write = SDL_AtomicGet(&ring->mWrite);
+        while (((write - SDL_AtomicGet(&ring->mRead)) & (LOG_RING_SIZE - 1)) + count > LOG_RING_SIZE - 1) {
+            SDL_SemPost(gLogWake);
+            SDL_Delay(1);
+        }
+        bool wasEmpty = SDL_AtomicGet(&ring->mRead) == write;
+
+        for (int i = 0; i < count; i++) {
+            LogRecord & record = ring->mRecords[(write + i) & (LOG_RING_SIZE - 1)];
+            size_t pos = i * LOG_RECORD_TEXT;
+            record.mSeq = seq;
+            record.mFacil = facil;
+            record.mTime = time;
+            record.mLength = min(len - pos, (size_t) LOG_RECORD_TEXT);
+            record.mContinued = i + 1 < count;
+            memcpy(record.mText, txt + pos, record.mLength);
+        }
+
+        SDL_MemoryBarrierRelease();
+        SDL_AtomicSet(&ring->mWrite, (write + count) & (LOG_RING_SIZE - 1));
+
+        // Otherwise the writer is busy with this ring anyway
+        if (wasEmpty) {
+            SDL_SemPost(gLogWake);
+        }
+        return;
+    }
+#endif
+
+    write_entry(facil, time, txt);
+    _logger->flush_str();
+}
+
+void Logger::write_entry(LoggerFacil * facil, double time, const char * txt)
+{
+    if (time < 0) {
+        _logger->write_str(facil->getName() + ": " + txt);
         return;
     }
     char tmp[20];
-    sprintf(tmp, "%8.3f ", _timer->getElapsedTimeInSec() - _start_time);
+    sprintf(tmp, "%8.3f ", time);
     _logger->write_str(string(tmp) + facil->getName() + ": " + txt);
 }
 
-void Logger::tlog(LoggerFacil * facil, int lvl, const string & txt)
+int Logger::writer_proc(void * data)
 {
-    tlog(facil, lvl, txt.c_str());
+#ifdef LOGGER_ASYNC
+    vector<LogRecord> batch;
+    string entry;
+
+    for (;;) {
+        bool quit = SDL_AtomicGet(&gLogQuit) != 0;
+
+        batch.clear();
+        SDL_LockMutex(gLogRingsMutex);
+        for (size_t i = 0; i < gLogRings.size(); i++) {
+            LogRing * ring = gLogRings[i];
+            int read = SDL_AtomicGet(&ring->mRead);
+            int write = SDL_AtomicGet(&ring->mWrite);
+            SDL_MemoryBarrierAcquire();
+
+            for (; read != write; read = (read + 1) & (LOG_RING_SIZE - 1)) {
+                batch.push_back(ring->mRecords[read]);
+            }
+
+            SDL_MemoryBarrierRelease();
+            SDL_AtomicSet(&ring->mRead, read);
+        }
+        SDL_UnlockMutex(gLogRingsMutex);
+
+        if (batch.empty()) {
+            if (quit) {
+                break;
+            }
+            SDL_SemWaitTimeout(gLogWake, 100);
+            continue;
+        }
+
+        // The pieces of an entry are next to each other and keep their order
+        stable_sort(batch.begin(), batch.end(), LogRecordBefore);
+        for (size_t i = 0; i < batch.size(); i++) {
+            entry.append(batch[i].mText, batch[i].mLength);
+            if (!batch[i].mContinued) {
+                write_entry(batch[i].mFacil, batch[i].mTime, entry.c_str());
+                entry.clear();
+            }
+        }
+        _logger->flush_str();
+
+        // A thread that waited for room in its ring can come with an older
+        // seq than what was written already, gLogWritten never goes back
+        Uint32 seq = batch.back().mSeq;
+        int written;
+        do {
+            written = SDL_AtomicGet(&gLogWritten);
+            if ((Sint32) (seq - (Uint32) written) <= 0) {
+                break;
+            }
+        } while (!SDL_AtomicCAS(&gLogWritten, written, (int) seq));
+    }
+#endif
+    return 0;
 }
 
 // Utility function to quote a text
@@ -207,7 +453,6 @@ void StdoutLogger::write_str(const char * txt) const
     if (txt[len-1] != '\n') {
         fputc('\n', stdout);
     }
-    fflush(stdout);
 }
 
 void StdoutLogger::write_str(const string & txt) const
@@ -215,6 +460,11 @@ void StdoutLogger::write_str(const string & txt) const
     write_str(txt.c_str());
 }
 
+void StdoutLogger::flush_str() const
+{
+    fflush(stdout);
+}
+
 FileLogger::FileLogger(const char * fname) : Logger()
 {
     _fp = fopen(fname, "a");
@@ -257,7 +507,6 @@ void FileLogger::write_str(const char * txt) const
     if (txt[len-1] != '\n') {
         fputc('\n', _fp);
     }
-     fflush(_fp);
 }
 
 void FileLogger::write_str(const string & txt) const
@@ -265,6 +514,13 @@ void FileLogger::write_str(const string & txt) const
     write_str(txt.c_str());
 }
 
+void FileLogger::flush_str() const
+{
+    if (_fp != NULL) {
+        fflush(_fp);
+    }
+}
+
 std::map<const std::string, LoggerFacil *>  LoggerFacil::_all_facils;
 LoggerFacil * LoggerFacil::find(const std::string& name)
 {
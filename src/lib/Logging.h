@@ -15,8 +15,10 @@
 #include "Timer.h"
 
 #ifdef DEBUG
-#define LOG(facil, lvl, txt)    Logger::log(facil, lvl, txt)
-#define TLOG(facil, lvl, txt)   Logger::tlog(facil, lvl, txt)
+// The level is checked before txt is evaluated, so an entry nobody asked
+// for doesn't cost a Logger::format()
+#define LOG(facil, lvl, txt)    do { if (Logger::wants(facil, lvl)) Logger::log(facil, lvl, txt); } while (0)
+#define TLOG(facil, lvl, txt)   do { if (Logger::wants(facil, lvl)) Logger::tlog(facil, lvl, txt); } while (0)
 #else
 #define LOG(facil, lvl, txt)
 #define TLOG(facil, lvl, txt)
@@ -58,6 +60,12 @@ public:
     virtual ~Logger() {}
 
     static bool set_log_level(const std::string & txt);
+    static bool wants(LoggerFacil * facil, int lvl) { return _logger != NULL && facil != NULL && lvl <= facil->getLevel(); }
+    // By default entries are handed to a thread that writes them, so the
+    // caller doesn't wait for the file. Call before create_logger().
+    static void set_async(bool async);
+    // Waits until everything logged so far is written
+    static void flush();
     static void log(LoggerFacil * facil, int lvl, const char * txt);
     static void log(LoggerFacil * facil, int lvl, const std::string & txt);
     // tlog also writes the timer value
@@ -68,7 +76,11 @@ public:
 private:
     virtual void write_str(const char * txt) const = 0;
     virtual void write_str(const std::string & txt) const = 0;
+    virtual void flush_str() const = 0;
     static std::string vformat(const char* fmt, va_list argPtr);
+    static void put(LoggerFacil * facil, double time, const char * txt);
+    static void write_entry(LoggerFacil * facil, double time, const char * txt);
+    static int writer_proc(void * data);
 
 protected:
     static Timer *  _timer;
@@ -84,6 +96,7 @@ private:
     StdoutLogger();
     void write_str(const char * txt) const;
     void write_str(const std::string & txt) const;
+    void flush_str() const;
 };
 
 class FileLogger : Logger
@@ -96,6 +109,7 @@ private:
     FileLogger(const std::string & fname);
     void write_str(const char * txt) const;
     void write_str(const std::string & txt) const;
+    void flush_str() const;
 
     const char *    _fname;
     FILE *          _fp;
@@ -36,6 +36,7 @@ email: m-mat @ math.sci.hiroshima-u.ac.jp (remove space)
 */
 
 #include "MTRand.h"
+#include "InputRecorder.h"
 #if 0
 #include "Debug.h"
 #endif
@@ -73,7 +74,7 @@ MTRand::MTRand(uint32_t seed)
 
 MTRand::MTRand()
 {
-    SRand(4357);
+    Seed(4357);
 }
 
 static int gRandAllowed = 0;
@@ -97,10 +98,15 @@ void MTRand::SRand(const std::string& theSerialData)
         memcpy(mt, theSerialData.c_str(), MTRAND_N*4);
     }
     else
-        SRand(4357);
+        Seed(4357);
 }
 
 void MTRand::SRand(uint32_t seed)
+{
+    Seed(InputRecorder::FilterSeed(seed));
+}
+
+void MTRand::Seed(uint32_t seed)
 {
     if (seed == 0)
         seed = 4357;
@@ -20,7 +20,7 @@ public:
     MTRand();
 
     void SRand(const std::string& theSerialData);
-    void SRand(uint32_t seed);
+    void SRand(uint32_t seed);          // Recorded or replayed by InputRecorder
     uint32_t NextNoAssert();
     uint32_t Next();
     uint32_t NextNoAssert(uint32_t range);
@@ -31,6 +31,10 @@ public:
     std::string Serialize();
 
     static void SetRandAllowed(bool allowed);
+
+private:
+    // SRand() without going through InputRecorder::FilterSeed()
+    void Seed(uint32_t seed);
 };
 
 struct MTAutoDisallowRand
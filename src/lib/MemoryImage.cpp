@@ -7,6 +7,7 @@
 #include "NativeDisplay.h"
 #include "IMG_savepng.h"
 #include "GLState.h"
+#include "FrameCounters.h"
 
 #if 0
 #include "PerfTimer.h"
@@ -14,6 +15,7 @@
 #endif
 
 #include "Quantize.h"
+#include "ResourceManager.h"
 #include "SWTri.h"
 
 #include <math.h>
@@ -26,6 +28,19 @@
 
 using namespace Sexy;
 
+// The image buffers, counted in FrameCounter_BytesAllocated
+static uint32_t* NewBits(int theCount)
+{
+    FrameCounters::Add(FrameCounter_BytesAllocated, theCount * sizeof(uint32_t));
+    return new uint32_t[theCount];
+}
+
+static uchar* NewBytes(int theCount)
+{
+    FrameCounters::Add(FrameCounter_BytesAllocated, theCount);
+    return new uchar[theCount];
+}
+
 MemoryImage::MemoryImage()
 {
     TLOG(mLogFacil, 1, "new MemoryImage()");
@@ -55,7 +70,8 @@ MemoryImage::MemoryImage(const MemoryImage& theMemoryImage) :
     mOptimizeSoftwareDrawing(false),
 
     mPurgeBits(theMemoryImage.mPurgeBits),
-    mBitsChangedCount(theMemoryImage.mBitsChangedCount)
+    mBitsChangedCount(theMemoryImage.mBitsChangedCount),
+    mReloadable(false)
 
 //    uint32_t*               mNativeAlphaData;
 //    uchar*                  mRLAlphaData;
@@ -80,7 +96,7 @@ MemoryImage::MemoryImage(const MemoryImage& theMemoryImage) :
 
     if (theMemoryImage.mBits != NULL)
     {
-        mBits = new uint32_t[mWidth*mHeight + 1];
+        mBits = NewBits(mWidth*mHeight + 1);
         mBits[mWidth*mHeight] = MEMORYCHECK_ID;
         memcpy(mBits, theMemoryImage.mBits, (mWidth*mHeight + 1)*sizeof(uint32_t));
     }
@@ -96,7 +112,7 @@ MemoryImage::MemoryImage(const MemoryImage& theMemoryImage) :
 
     if (theMemoryImage.mColorTable != NULL)
     {
-        mColorTable = new uint32_t[256];
+        mColorTable = NewBits(256);
         memcpy(mColorTable, theMemoryImage.mColorTable, 256*sizeof(uint32_t));
     }
     else
@@ -104,7 +120,7 @@ MemoryImage::MemoryImage(const MemoryImage& theMemoryImage) :
 
     if (theMemoryImage.mColorIndices != NULL)
     {
-        mColorIndices = new uchar[mWidth*mHeight];
+        mColorIndices = NewBytes(mWidth*mHeight);
         memcpy(mColorIndices, theMemoryImage.mColorIndices, mWidth*mHeight*sizeof(uchar));
     }
     else
@@ -114,12 +130,12 @@ MemoryImage::MemoryImage(const MemoryImage& theMemoryImage) :
     {
         if (theMemoryImage.mColorTable == NULL)
         {
-            mNativeAlphaData = new uint32_t[mWidth*mHeight];
+            mNativeAlphaData = NewBits(mWidth*mHeight);
             memcpy(mNativeAlphaData, theMemoryImage.mNativeAlphaData, mWidth*mHeight*sizeof(uint32_t));
         }
         else
         {
-            mNativeAlphaData = new uint32_t[256];
+            mNativeAlphaData = NewBits(256);
             memcpy(mNativeAlphaData, theMemoryImage.mNativeAlphaData, 256*sizeof(uint32_t));
         }
     }
@@ -128,7 +144,7 @@ MemoryImage::MemoryImage(const MemoryImage& theMemoryImage) :
 
     if (theMemoryImage.mRLAlphaData != NULL)
     {
-        mRLAlphaData = new uchar[mWidth*mHeight];
+        mRLAlphaData = NewBytes(mWidth*mHeight);
         memcpy(mRLAlphaData, theMemoryImage.mRLAlphaData, mWidth*mHeight);
     }
     else
@@ -136,7 +152,7 @@ MemoryImage::MemoryImage(const MemoryImage& theMemoryImage) :
 
     if (theMemoryImage.mRLAdditiveData != NULL)
     {
-        mRLAdditiveData = new uchar[mWidth*mHeight];
+        mRLAdditiveData = NewBytes(mWidth*mHeight);
         memcpy(mRLAdditiveData, theMemoryImage.mRLAdditiveData, mWidth*mHeight);
     }
     else
@@ -174,6 +190,7 @@ void MemoryImage::Init()
     mBitsChangedCount = 0;
 
     mPurgeBits = false;
+    mReloadable = false;
     mWantPal = false;
 
     mApp->AddImage(this);
@@ -930,7 +947,7 @@ void* MemoryImage::GetNativeAlphaData(NativeDisplay *theDisplay)
     {
         uint32_t* aSrcPtr = GetBits();
 
-        uint32_t* anAlphaData = new uint32_t[mWidth*mHeight];
+        uint32_t* anAlphaData = NewBits(mWidth*mHeight);
 
         uint32_t* aDestPtr = anAlphaData;
         int aSize = mWidth*mHeight;
@@ -957,7 +974,7 @@ void* MemoryImage::GetNativeAlphaData(NativeDisplay *theDisplay)
     {
         uint32_t* aSrcPtr = mColorTable;
 
-        uint32_t* anAlphaData = new uint32_t[256];
+        uint32_t* anAlphaData = NewBits(256);
 
         for (int i = 0; i < 256; i++)
         {
@@ -990,7 +1007,7 @@ uchar* MemoryImage::GetRLAlphaData()
 
     if (mRLAlphaData == NULL)
     {
-        mRLAlphaData = new uchar[mWidth*mHeight];
+        mRLAlphaData = NewBytes(mWidth*mHeight);
 
         if (mColorTable == NULL)
         {
@@ -1030,7 +1047,7 @@ uchar* MemoryImage::GetRLAdditiveData(NativeDisplay *theNative)
         {
             uint32_t* aBits = (uint32_t*) GetNativeAlphaData(theNative);
 
-            mRLAdditiveData = new uchar[mWidth*mHeight];
+            mRLAdditiveData = NewBytes(mWidth*mHeight);
 
             uchar* aWPtr = mRLAdditiveData;
             uint32_t* aRPtr = aBits;
@@ -1085,7 +1102,7 @@ uchar* MemoryImage::GetRLAdditiveData(NativeDisplay *theNative)
         {
             uint32_t* aNativeColorTable = (uint32_t*) GetNativeAlphaData(theNative);
 
-            mRLAdditiveData = new uchar[mWidth*mHeight];
+            mRLAdditiveData = NewBytes(mWidth*mHeight);
 
             uchar* aWPtr = mRLAdditiveData;
             uchar* aRPtr = mColorIndices;
@@ -1198,6 +1215,46 @@ void MemoryImage::DeleteNativeData()
     mRLAdditiveData = NULL;
 }
 
+// Frees every CPU side copy of the pixels. Only for images that
+// RecoverBits() can get back, that is ones loaded by the ResourceManager.
+void MemoryImage::EvictBits()
+{
+    delete [] mBits;
+    mBits = NULL;
+
+    delete [] mColorIndices;
+    mColorIndices = NULL;
+
+    delete [] mColorTable;
+    mColorTable = NULL;
+
+    delete [] mNativeAlphaData;
+    mNativeAlphaData = NULL;
+
+    delete [] mRLAlphaData;
+    mRLAlphaData = NULL;
+
+    delete [] mRLAdditiveData;
+    mRLAdditiveData = NULL;
+}
+
+size_t MemoryImage::GetBitsMemSize() const
+{
+    size_t aSize = (size_t) mWidth * mHeight;
+    size_t aMemSize = 0;
+    if (mBits != NULL)
+        aMemSize += aSize * sizeof(uint32_t);
+    if (mColorIndices != NULL)
+        aMemSize += aSize + 256 * sizeof(uint32_t);
+    if (mNativeAlphaData != NULL)
+        aMemSize += aSize * sizeof(uint32_t);
+    if (mRLAlphaData != NULL)
+        aMemSize += aSize;
+    if (mRLAdditiveData != NULL)
+        aMemSize += aSize;
+    return aMemSize;
+}
+
 void MemoryImage::ReInit()
 {
     // Fix any un-palletizing
@@ -1221,7 +1278,7 @@ void MemoryImage::SetBits(uint32_t* theBits, int theWidth, int theHeight, bool c
         if (theWidth != mWidth || theHeight != mHeight)
         {
             delete [] mBits;
-            mBits = new uint32_t[theWidth*theHeight + 1];
+            mBits = NewBits(theWidth*theHeight + 1);
             mWidth = theWidth;
             mHeight = theHeight;
         }
@@ -1255,7 +1312,7 @@ uint32_t* MemoryImage::GetBits()
     {
         int aSize = mWidth*mHeight;
 
-        mBits = new uint32_t[aSize+1];
+        mBits = NewBits(aSize+1);
         mBits[aSize] = MEMORYCHECK_ID;
 
         if (mColorTable != NULL)
@@ -1306,9 +1363,11 @@ uint32_t* MemoryImage::GetBits()
                 *(aDestPtr++) = (anAlpha << 24) | (r << 16) | (g << 8) | (b);
             }
         }
-        else if (!HasTextureData())
+        else if (!mReloadable)
         {
-            TLOG(mLogFacil, 1, "no texture data");
+            // Textures can't be read back, only images the ResourceManager
+            // loaded are recovered, with or without a texture.
+            TLOG(mLogFacil, 1, "no bits to recover");
             memset(mBits, 0, aSize*sizeof(uint32_t));
         }
         else if (!RecoverBits())
@@ -1323,6 +1382,10 @@ uint32_t* MemoryImage::GetBits()
 
 bool MemoryImage::RecoverBits()
 {
+    // Images loaded by the ResourceManager are read from their file again
+    if (mApp != NULL && mApp->mResourceManager != NULL && mApp->mResourceManager->ReloadImageBits(this))
+        return true;
+
     // Please notice that this function was moved here from D3DInterface.
     // Also notice that the commented out code was incomplete to begin with (missing switch ...).
 #if 0
@@ -1963,8 +2026,8 @@ bool MemoryImage::Palletize()
     if (mBits == NULL)
         return false;
 
-    mColorIndices = new uchar[mWidth*mHeight];
-    mColorTable = new uint32_t[256];
+    mColorIndices = NewBytes(mWidth*mHeight);
+    mColorTable = NewBits(256);
 
     if (!Quantize8Bit(mBits, mWidth, mHeight, mColorIndices, mColorTable))
     {
@@ -2171,7 +2234,72 @@ void MemoryImage::SaveImageToPNG(const std::string& filename, const std::string&
 }
 
 /* original taken from a post by Sam Lantinga, thanks Sam for this and for SDL :-)*/
-GLuint MemoryImage::CreateTexture(int x, int y, int w, int h)
+// 4x4 ordered dither thresholds
+static const int gBayer4x4[4][4] = {
+    {  0,  8,  2, 10 },
+    { 12,  4, 14,  6 },
+    {  3, 11,  1,  9 },
+    { 15,  7, 13,  5 }
+};
+
+static inline Uint32 ReduceChannel(Uint32 theValue, int theBits, int theThreshold)
+{
+    if (theThreshold < 0)
+        return (theValue * ((1 << theBits) - 1) + 127) / 255;
+
+    theValue += (theThreshold * (256 >> theBits)) >> 4;
+    if (theValue > 255)
+        theValue = 255;
+    return theValue >> (8 - theBits);
+}
+
+// Converts an area of the image into one of the reduced texture formats.
+// Like CopyImageToSurface() the row and column past the image repeat its edge.
+static void CopyImageToReducedFormat(MemoryImage* theImage, void* theDest, PixelFormat theFormat, bool dither,
+                                     int offx, int offy, int theWidth, int theHeight)
+{
+    int aWidth = std::min(theWidth, theImage->GetWidth() - offx);
+    int aHeight = std::min(theHeight, theImage->GetHeight() - offy);
+    if (aWidth <= 0 || aHeight <= 0)
+        return;
+
+    uint32_t* aBits = theImage->mColorTable == NULL ? theImage->GetBits() : NULL;
+    int aPitch = theImage->GetWidth();
+
+    for (int y = 0; y < std::min(theHeight, aHeight + 1); y++) {
+        int sy = offy + std::min(y, aHeight - 1);
+        Uint16* aDest16 = (Uint16*) theDest + y * theWidth;
+        Uint8* aDest8 = (Uint8*) theDest + y * theWidth;
+
+        for (int x = 0; x < std::min(theWidth, aWidth + 1); x++) {
+            int sx = offx + std::min(x, aWidth - 1);
+            uint32_t aPixel = aBits != NULL ? aBits[sy * aPitch + sx] :
+                theImage->mColorTable[theImage->mColorIndices[sy * aPitch + sx]];
+
+            int aThreshold = dither ? gBayer4x4[y & 3][x & 3] : -1;
+            Uint32 a = aPixel >> 24;
+            Uint32 r = (aPixel >> 16) & 0xFF;
+            Uint32 g = (aPixel >> 8) & 0xFF;
+            Uint32 b = aPixel & 0xFF;
+
+            switch (theFormat) {
+            case PixelFormat_A4R4G4B4:
+                aDest16[x] = (ReduceChannel(r, 4, aThreshold) << 12) | (ReduceChannel(g, 4, aThreshold) << 8) |
+                    (ReduceChannel(b, 4, aThreshold) << 4) | ReduceChannel(a, 4, aThreshold);
+                break;
+            case PixelFormat_R5G6B5:
+                aDest16[x] = (ReduceChannel(r, 5, aThreshold) << 11) | (ReduceChannel(g, 6, aThreshold) << 5) |
+                    ReduceChannel(b, 5, aThreshold);
+                break;
+            default:
+                aDest8[x] = a;
+                break;
+            }
+        }
+    }
+}
+
+GLuint MemoryImage::CreateTexture(int x, int y, int w, int h, PixelFormat theFormat, bool dither)
 {
     static SDL_Surface *image = NULL;
 
@@ -2205,6 +2333,26 @@ GLuint MemoryImage::CreateTexture(int x, int y, int w, int h)
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     //glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_PRIORITY, 1);
 
+    if (theFormat == PixelFormat_A4R4G4B4 || theFormat == PixelFormat_R5G6B5 || theFormat == PixelFormat_A8) {
+        static std::vector<Uint8> aBuffer;
+        int aPixelSize = theFormat == PixelFormat_A8 ? 1 : 2;
+        aBuffer.assign(w * h * aPixelSize, 0);
+        CopyImageToReducedFormat(this, &aBuffer[0], theFormat, dither, x, y, w, h);
+
+        // Rows of 8 and 16 bit pixels needn't be 4 byte aligned
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        if (theFormat == PixelFormat_A8)
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, w, h, 0, GL_ALPHA, GL_UNSIGNED_BYTE, &aBuffer[0]);
+        else if (theFormat == PixelFormat_A4R4G4B4)
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_SHORT_4_4_4_4, &aBuffer[0]);
+        else
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, w, h, 0, GL_RGB, GL_UNSIGNED_SHORT_5_6_5, &aBuffer[0]);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        FrameCounters::Add(FrameCounter_TextureUploads);
+        FrameCounters::Add(FrameCounter_TextureUploadBytes, aBuffer.size());
+        return texture;
+    }
+
 #if SDL_VERSION_ATLEAST(2,0,0)
     // In the pre SDL2 era we used to call SDL_CreateRGBSurface(SDL_HWSURFACE, ...
     // But in SDL2 a hardware surface is a SDL_Texture. Please be aware that
@@ -2278,5 +2426,7 @@ GLuint MemoryImage::CreateTexture(int x, int y, int w, int h)
             GL_UNSIGNED_BYTE,
             image->pixels);
 #endif
+    FrameCounters::Add(FrameCounter_TextureUploads);
+    FrameCounters::Add(FrameCounter_TextureUploadBytes, w * h * 4);
     return texture;
 }
@@ -49,6 +49,7 @@ protected:
 private:
     bool                    mPurgeBits;
     int                     mBitsChangedCount;
+    bool                    mReloadable;
     void                    Init();
 
 public:
@@ -58,9 +59,14 @@ public:
     virtual void            DoPurgeBits();
     virtual void            SetPurgeBits(bool x) { mPurgeBits = x; }
     virtual bool            GetPurgeBits() const { return mPurgeBits; }
+    // Set by the ResourceManager, GetBits() reads such an image from its file again
+    void                    SetReloadable(bool x) { mReloadable = x; }
+    bool                    IsReloadable() const { return mReloadable; }
     virtual void            DeleteSWBuffers();
     virtual void            DeleteNativeData();
     virtual void            ReInit();
+    virtual void            EvictBits();
+    size_t                  GetBitsMemSize() const;
 
     void                    NormalBlt(Image* theImage, int theX, int theY, const Rect& theSrcRect, const Color& theColor);
     void                    AdditiveBlt(Image* theImage, int theX, int theY, const Rect& theSrcRect, const Color& theColor);
@@ -122,7 +128,7 @@ public:
     virtual void            SaveImageToBMP(const std::string& filename, const std::string& path);
     virtual void            SaveImageToPNG(const std::string& filename, const std::string& path);
 
-    virtual GLuint          CreateTexture(int x, int y, int w, int h);
+    virtual GLuint          CreateTexture(int x, int y, int w, int h, PixelFormat theFormat = PixelFormat_A8R8G8B8, bool dither = false);
 };
 
 }
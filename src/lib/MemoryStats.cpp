@@ -0,0 +1,305 @@
+#include "MemoryStats.h"
+#include "Common.h"
+#include "DDImage.h"
+#include "ImageFont.h"
+#include "SexyAppBase.h"
+#include "TextureData.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+#include "chipmunk.h"
+
+using namespace Sexy;
+
+SDL_SpinLock MemoryStats::sLock = 0;
+size_t MemoryStats::sTracked[NUM_MEMORY_TAGS];
+size_t MemoryStats::sPeak[NUM_MEMORY_TAGS];
+int MemoryStats::sAllocs[NUM_MEMORY_TAGS];
+bool MemoryStats::sTrackingChipmunk = false;
+
+void MemoryStats::Alloc(MemoryTag theTag, size_t theBytes)
+{
+    SDL_AtomicLock(&sLock);
+    sTracked[theTag] += theBytes;
+    if (sTracked[theTag] > sPeak[theTag])
+        sPeak[theTag] = sTracked[theTag];
+    sAllocs[theTag]++;
+    SDL_AtomicUnlock(&sLock);
+}
+
+void MemoryStats::Free(MemoryTag theTag, size_t theBytes)
+{
+    SDL_AtomicLock(&sLock);
+    sTracked[theTag] -= theBytes;
+    sAllocs[theTag]--;
+    SDL_AtomicUnlock(&sLock);
+}
+
+size_t MemoryStats::GetTracked(MemoryTag theTag)
+{
+    SDL_AtomicLock(&sLock);
+    size_t aBytes = sTracked[theTag];
+    SDL_AtomicUnlock(&sLock);
+    return aBytes;
+}
+
+size_t MemoryStats::GetPeak(MemoryTag theTag)
+{
+    SDL_AtomicLock(&sLock);
+    size_t aBytes = sPeak[theTag];
+    SDL_AtomicUnlock(&sLock);
+    return aBytes;
+}
+
+int MemoryStats::GetAllocs(MemoryTag theTag)
+{
+    SDL_AtomicLock(&sLock);
+    int aCount = sAllocs[theTag];
+    SDL_AtomicUnlock(&sLock);
+    return aCount;
+}
+
+const char* MemoryStats::GetTagName(int theTag)
+{
+    static const char* aNames[NUM_MEMORY_TAGS] = {
+        "images", "textures", "fonts", "sounds", "physics", "particles", "other"
+    };
+    if (theTag < 0 || theTag >= NUM_MEMORY_TAGS)
+        return "?";
+    return aNames[theTag];
+}
+
+// The chipmunk allocator. Blocks start with their size, padded to keep the
+// alignment malloc() gives.
+#define CP_HEADER_SIZE  16
+
+static void* TrackedMalloc(size_t theSize)
+{
+    unsigned char* aBlock = (unsigned char*) malloc(CP_HEADER_SIZE + theSize);
+    if (aBlock == NULL)
+        return NULL;
+    *(size_t*) aBlock = theSize;
+    MemoryStats::Alloc(MemoryTag_Physics, theSize);
+    return aBlock + CP_HEADER_SIZE;
+}
+
+static void* TrackedCalloc(size_t theCount, size_t theSize)
+{
+    if (theSize != 0 && theCount > ((size_t) -1 - CP_HEADER_SIZE) / theSize)
+        return NULL;
+    void* aPtr = TrackedMalloc(theCount * theSize);
+    if (aPtr != NULL)
+        memset(aPtr, 0, theCount * theSize);
+    return aPtr;
+}
+
+static void TrackedFree(void* thePtr)
+{
+    if (thePtr == NULL)
+        return;
+    unsigned char* aBlock = (unsigned char*) thePtr - CP_HEADER_SIZE;
+    MemoryStats::Free(MemoryTag_Physics, *(size_t*) aBlock);
+    free(aBlock);
+}
+
+static void* TrackedRealloc(void* thePtr, size_t theSize)
+{
+    if (thePtr == NULL)
+        return TrackedMalloc(theSize);
+    if (theSize == 0) {
+        TrackedFree(thePtr);
+        return NULL;
+    }
+
+    unsigned char* aBlock = (unsigned char*) thePtr - CP_HEADER_SIZE;
+    size_t anOldSize = *(size_t*) aBlock;
+    aBlock = (unsigned char*) realloc(aBlock, CP_HEADER_SIZE + theSize);
+    if (aBlock == NULL)
+        return NULL;
+    *(size_t*) aBlock = theSize;
+    MemoryStats::Free(MemoryTag_Physics, anOldSize);
+    MemoryStats::Alloc(MemoryTag_Physics, theSize);
+    return aBlock + CP_HEADER_SIZE;
+}
+
+bool MemoryStats::TrackChipmunk()
+{
+    if (sTrackingChipmunk)
+        return true;
+    sTrackingChipmunk = cpSetAllocator(TrackedMalloc, TrackedCalloc, TrackedRealloc, TrackedFree) != 0;
+    return sTrackingChipmunk;
+}
+
+void MemoryEntry::AddBuffer(const char* theName, MemoryTag theTag, size_t theBytes)
+{
+    if (theBytes == 0)
+        return;
+    MemoryBuffer aBuffer;
+    aBuffer.mName = theName;
+    aBuffer.mTag = theTag;
+    aBuffer.mBytes = theBytes;
+    mBuffers.push_back(aBuffer);
+    mBytes += theBytes;
+}
+
+MemoryReport::MemoryReport()
+{
+    for (int i = 0; i < NUM_MEMORY_TAGS; i++)
+        mTagBytes[i] = 0;
+}
+
+void MemoryReport::Add(const MemoryEntry& theEntry)
+{
+    for (size_t i = 0; i < theEntry.mBuffers.size(); i++)
+        mTagBytes[theEntry.mBuffers[i].mTag] += theEntry.mBuffers[i].mBytes;
+    mGroupBytes[theEntry.mGroup] += theEntry.mBytes;
+    mEntries.push_back(theEntry);
+}
+
+bool MemoryReport::AddImageBuffers(MemoryEntry& theEntry, Image* theImage, MemoryTag theTag)
+{
+    if (theImage == NULL || !mCounted.insert(theImage).second)
+        return false;
+
+    MemoryImage* anImage = dynamic_cast<MemoryImage*>(theImage);
+    if (anImage == NULL)
+        return true;
+
+    size_t aSize = (size_t) anImage->GetWidth() * anImage->GetHeight();
+    if (anImage->mBits != NULL)
+        theEntry.AddBuffer("bits", theTag, aSize * sizeof(uint32_t));
+    if (anImage->mColorIndices != NULL)
+        theEntry.AddBuffer("color indices", theTag, aSize + 256 * sizeof(uint32_t));
+    if (anImage->mNativeAlphaData != NULL)
+        theEntry.AddBuffer("native alpha", theTag, aSize * sizeof(uint32_t));
+    if (anImage->mRLAlphaData != NULL)
+        theEntry.AddBuffer("RL alpha", theTag, aSize);
+    if (anImage->mRLAdditiveData != NULL)
+        theEntry.AddBuffer("RL additive", theTag, aSize);
+
+    DDImage* aDDImage = dynamic_cast<DDImage*>(anImage);
+    if (aDDImage != NULL && aDDImage->mSurface != NULL && aDDImage->mSurface != gSexyAppBase->GetGameSurface())
+        theEntry.AddBuffer("surface", theTag, (size_t) aDDImage->mSurface->h * aDDImage->mSurface->pitch);
+
+    if (anImage->HasTextureData())
+        theEntry.AddBuffer("texture", MemoryTag_Textures, anImage->GetTextureData()->GetTexMemSize());
+    return true;
+}
+
+// A font's images are summed up, like its layers
+void MemoryReport::AddFontBuffers(MemoryEntry& theEntry, Font* theFont)
+{
+    ImageFont* aFont = dynamic_cast<ImageFont*>(theFont);
+    if (aFont == NULL)
+        return;
+
+    MemoryEntry aLayerImages;
+    FontData* aFontData = aFont->mFontData;
+    if (aFontData != NULL && mCounted.insert(aFontData).second) {
+        size_t aLayerSize = 0;
+        FontLayerList::iterator anItr = aFontData->mFontLayerList.begin();
+        for (; anItr != aFontData->mFontLayerList.end(); ++anItr) {
+            aLayerSize += sizeof(FontLayer) + anItr->mKerningPairs.capacity() * sizeof(FontKerningPair);
+            AddImageBuffers(aLayerImages, anItr->mImage, MemoryTag_Fonts);
+        }
+        theEntry.AddBuffer("layers", MemoryTag_Fonts, aLayerSize);
+    }
+
+    MemoryEntry aScaledImages;
+    ActiveFontLayerList::iterator anItr = aFont->mActiveLayerList.begin();
+    for (; anItr != aFont->mActiveLayerList.end(); ++anItr) {
+        if (anItr->mOwnsImage)
+            AddImageBuffers(aScaledImages, anItr->mScaledImage, MemoryTag_Fonts);
+    }
+    theEntry.AddBuffer("active layers", MemoryTag_Fonts, aFont->mActiveLayerList.size() * sizeof(ActiveFontLayer));
+
+    const MemoryEntry* anImageEntries[2] = { &aLayerImages, &aScaledImages };
+    const char* aNames[2] = { "layer images", "scaled images" };
+    size_t aTextureSize = 0;
+    for (int i = 0; i < 2; i++) {
+        size_t aSize = 0;
+        for (size_t j = 0; j < anImageEntries[i]->mBuffers.size(); j++) {
+            const MemoryBuffer& aBuffer = anImageEntries[i]->mBuffers[j];
+            if (aBuffer.mTag == MemoryTag_Textures)
+                aTextureSize += aBuffer.mBytes;
+            else
+                aSize += aBuffer.mBytes;
+        }
+        theEntry.AddBuffer(aNames[i], MemoryTag_Fonts, aSize);
+    }
+    theEntry.AddBuffer("texture", MemoryTag_Textures, aTextureSize);
+}
+
+void MemoryReport::AddTracked()
+{
+    for (int i = 0; i < NUM_MEMORY_TAGS; i++) {
+        size_t aBytes = MemoryStats::GetTracked((MemoryTag) i);
+        if (aBytes == 0)
+            continue;
+
+        MemoryEntry anEntry;
+        anEntry.mName = MemoryStats::GetTagName(i);
+        anEntry.mGroup = "tracked";
+        anEntry.AddBuffer("allocations", (MemoryTag) i, aBytes);
+        Add(anEntry);
+    }
+}
+
+size_t MemoryReport::GetTotal() const
+{
+    size_t aTotal = 0;
+    for (int i = 0; i < NUM_MEMORY_TAGS; i++)
+        aTotal += mTagBytes[i];
+    return aTotal;
+}
+
+static bool EntryIsLarger(const MemoryEntry* theEntry1, const MemoryEntry* theEntry2)
+{
+    return theEntry1->mBytes > theEntry2->mBytes;
+}
+
+void MemoryReport::Dump(std::string& theDestStr, int theMaxEntries) const
+{
+    theDestStr = StrFormat("Memory: %s in %d entries\n", MemorySizeString(GetTotal()).c_str(), (int) mEntries.size());
+
+    theDestStr += "By tag:\n";
+    for (int i = 0; i < NUM_MEMORY_TAGS; i++) {
+        if (mTagBytes[i] == 0)
+            continue;
+        theDestStr += StrFormat("  %-16s %10s", MemoryStats::GetTagName(i), MemorySizeString(mTagBytes[i]).c_str());
+        if (MemoryStats::GetPeak((MemoryTag) i) != 0)
+            theDestStr += StrFormat("  tracked peak %s", MemorySizeString(MemoryStats::GetPeak((MemoryTag) i)).c_str());
+        theDestStr += "\n";
+    }
+
+    theDestStr += "By group:\n";
+    std::map<std::string, size_t>::const_iterator aGroupItr = mGroupBytes.begin();
+    for (; aGroupItr != mGroupBytes.end(); ++aGroupItr)
+        theDestStr += StrFormat("  %-16s %10s\n", aGroupItr->first.empty() ? "(none)" : aGroupItr->first.c_str(), MemorySizeString(aGroupItr->second).c_str());
+
+    std::vector<const MemoryEntry*> aLargest;
+    for (size_t i = 0; i < mEntries.size(); i++)
+        aLargest.push_back(&mEntries[i]);
+    std::sort(aLargest.begin(), aLargest.end(), EntryIsLarger);
+    if ((int) aLargest.size() > theMaxEntries)
+        aLargest.resize(theMaxEntries);
+
+    theDestStr += StrFormat("Largest %d:\n", (int) aLargest.size());
+    for (size_t i = 0; i < aLargest.size(); i++) {
+        const MemoryEntry* anEntry = aLargest[i];
+        theDestStr += StrFormat("  %10s  %s (%s)\n", MemorySizeString(anEntry->mBytes).c_str(), anEntry->mName.c_str(), anEntry->mGroup.c_str());
+        for (size_t j = 0; j < anEntry->mBuffers.size(); j++)
+            theDestStr += StrFormat("  %10s      %s\n", MemorySizeString(anEntry->mBuffers[j].mBytes).c_str(), anEntry->mBuffers[j].mName);
+    }
+}
+
+std::string Sexy::MemorySizeString(size_t theBytes)
+{
+    if (theBytes >= 1024 * 1024)
+        return StrFormat("%.1f MB", theBytes / (1024.0 * 1024.0));
+    if (theBytes >= 1024)
+        return StrFormat("%.1f KB", theBytes / 1024.0);
+    return StrFormat("%d B", (int) theBytes);
+}
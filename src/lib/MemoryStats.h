@@ -0,0 +1,108 @@
+#ifndef __MEMORYSTATS_H__
+#define __MEMORYSTATS_H__
+
+#include <SDL.h>
+#include <stddef.h>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace Sexy
+{
+
+enum MemoryTag
+{
+    MemoryTag_Images,           // Pixel buffers of MemoryImage
+    MemoryTag_Textures,         // GL texture memory, estimated
+    MemoryTag_Fonts,
+    MemoryTag_Sounds,
+    MemoryTag_Physics,          // chipmunk, with TrackChipmunk()
+    MemoryTag_Particles,        // hgeParticleSystem and the .psi cache
+    MemoryTag_Other,
+    NUM_MEMORY_TAGS
+};
+
+// Bytes allocated per subsystem. Subsystems that don't own their allocator
+// report through Alloc() and Free(), from any thread. Resources are walked
+// instead, see ResourceManager::GetMemoryUsage() and
+// SexyAppBase::GetMemoryUsage(), which add these counts to what they find.
+//
+// chipmunk is only tracked after TrackChipmunk(), every allocation then
+// carries a small header with its size.
+class MemoryStats
+{
+public:
+    static void             Alloc(MemoryTag theTag, size_t theBytes);
+    static void             Free(MemoryTag theTag, size_t theBytes);
+
+    static size_t           GetTracked(MemoryTag theTag);
+    static size_t           GetPeak(MemoryTag theTag);
+    // Allocations alive
+    static int              GetAllocs(MemoryTag theTag);
+    static const char*      GetTagName(int theTag);
+
+    // Must come before the first Physics, false after
+    static bool             TrackChipmunk();
+    static bool             IsTrackingChipmunk() { return sTrackingChipmunk; }
+
+private:
+    static SDL_SpinLock     sLock;
+    static size_t           sTracked[NUM_MEMORY_TAGS];
+    static size_t           sPeak[NUM_MEMORY_TAGS];
+    static int              sAllocs[NUM_MEMORY_TAGS];
+    static bool             sTrackingChipmunk;
+};
+
+class Image;
+class Font;
+
+struct MemoryBuffer
+{
+    const char*             mName;      // Like "bits" or "texture"
+    MemoryTag               mTag;
+    size_t                  mBytes;
+};
+
+// A resource, or an image no resource owns, with its buffers
+struct MemoryEntry
+{
+    std::string             mName;
+    std::string             mGroup;
+    size_t                  mBytes;
+    std::vector<MemoryBuffer> mBuffers;
+
+    MemoryEntry() : mBytes(0) {}
+    void                    AddBuffer(const char* theName, MemoryTag theTag, size_t theBytes);
+};
+
+// What ResourceManager::GetMemoryUsage() and SexyAppBase::GetMemoryUsage()
+// find, per tag, per resource group and per resource.
+class MemoryReport
+{
+public:
+    size_t                  mTagBytes[NUM_MEMORY_TAGS];
+    std::map<std::string, size_t> mGroupBytes;
+    std::vector<MemoryEntry> mEntries;
+    std::set<const void*>   mCounted;   // Images and font data, fonts share them with resources
+
+    MemoryReport();
+
+    void                    Add(const MemoryEntry& theEntry);
+    // Returns false if theImage was counted before
+    bool                    AddImageBuffers(MemoryEntry& theEntry, Image* theImage, MemoryTag theTag = MemoryTag_Images);
+    void                    AddFontBuffers(MemoryEntry& theEntry, Font* theFont);
+    // Adds what MemoryStats tracks, as entries of the group "tracked"
+    void                    AddTracked();
+
+    size_t                  GetTotal() const;
+    // Totals per tag and group, then theMaxEntries largest entries
+    void                    Dump(std::string& theDestStr, int theMaxEntries) const;
+};
+
+// The size of a memory figure for logs and dumps, like "1.5 MB"
+std::string MemorySizeString(size_t theBytes);
+
+}
+
+#endif //__MEMORYSTATS_H__
@@ -16,6 +16,24 @@ bool MusicInterface::LoadMusic(int theSongId, const std::string& theFileName)
     return false;
 }
 
+// Without a split of its own an interface loads it all in LoadPreparedMusic()
+PreparedMusic* MusicInterface::PrepareMusic(const std::string& theFileName)
+{
+    PreparedMusic* aPrepared = new PreparedMusic();
+    aPrepared->mFileName = theFileName;
+    return aPrepared;
+}
+
+bool MusicInterface::LoadPreparedMusic(int theSongId, PreparedMusic* thePrepared)
+{
+    if (thePrepared == NULL)
+        return false;
+
+    bool aSuccess = LoadMusic(theSongId, thePrepared->mFileName);
+    delete thePrepared;
+    return aSuccess;
+}
+
 void MusicInterface::PlayMusic(int theSongId, int theOffset, bool noLoop)
 {
 }
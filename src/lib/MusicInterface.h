@@ -6,6 +6,16 @@
 namespace Sexy
 {
 
+// A song MusicInterface::PrepareMusic() has done the file work for
+class PreparedMusic
+{
+public:
+    std::string             mFileName;
+
+public:
+    virtual ~PreparedMusic() {}
+};
+
 class MusicInterface
 {
 public:
@@ -15,6 +25,13 @@ public:
     virtual ~MusicInterface();
 
     virtual bool            LoadMusic(int theSongId, const std::string& theFileName);
+
+    // LoadMusic() in two halves, for loading in the background.
+    // PrepareMusic() doesn't touch the interface, so it may run on any
+    // thread. LoadPreparedMusic() finishes on the main thread and deletes
+    // thePrepared, which may be NULL when preparing failed.
+    virtual PreparedMusic*  PrepareMusic(const std::string& theFileName);
+    virtual bool            LoadPreparedMusic(int theSongId, PreparedMusic* thePrepared);
     virtual void            PlayMusic(int theSongId, int theOffset = 0, bool noLoop = false);
     virtual void            StopMusic(int theSongId);
     virtual void            PauseMusic(int theSongId);
@@ -212,7 +212,7 @@ static uint8_t * get_rect_2(uint8_t * data, int width, int height, int x, int y,
     return dst;
 }
 
-GLuint PVRTexture::CreateTexture(int x, int y, int w, int h)
+GLuint PVRTexture::CreateTexture(int x, int y, int w, int h, PixelFormat theFormat, bool dither)
 {
     // We only account for the first data image in the PVR (no MIPmaps)
     if (mImageData.size() == 0) {
@@ -286,6 +286,9 @@ GLuint PVRTexture::CreateTexture(int x, int y, int w, int h)
         assert(0);
         break;
     }
+    FrameCounters::Add(FrameCounter_TextureUploads);
+    FrameCounters::Add(FrameCounter_TextureUploadBytes, mPVRTextureFlagType == kPVRTextureFlagTypePVRTC_4 ||
+            mPVRTextureFlagType == kPVRTextureFlagTypePVRTC_2 ? datalength : w * h * 2);
     glerr = glGetError();
     // TODO. Check error code.
 
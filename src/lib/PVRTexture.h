@@ -30,7 +30,7 @@ public:
     ~PVRTexture();
 
     bool            initWithContentsOfFile(const std::string & fname);
-    GLuint          CreateTexture(int x, int y, int w, int h);
+    GLuint          CreateTexture(int x, int y, int w, int h, PixelFormat theFormat = PixelFormat_A8R8G8B8, bool dither = false);
 
 private:
     bool            unpackPVRData(uint8_t * data);
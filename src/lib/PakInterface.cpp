@@ -7,6 +7,20 @@
 #include "PakInterface.h"
 #include "Common.h"
 #include "Logging.h"
+#include <SDL.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#define PAK_AVX2
+#include <immintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+#define PAK_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define PAK_NEON
+#include <arm_neon.h>
+#endif
 
 #ifdef WIN32
 #include <windows.h>
@@ -30,8 +44,11 @@ typedef unsigned short ushort;
 typedef unsigned int uint;
 typedef unsigned long ulong;
 
+// Version 1 paks, written by tuxpak, have the hash of the contents in every
+// entry, and entries sharing the contents of an earlier one
 enum
 {
+    FILEFLAGS_SHARED = 0x01,        // contents are at the position that follows
     FILEFLAGS_END = 0x80,           // indicates end of header
 };
 
@@ -44,6 +61,59 @@ public:
     PakRecordMap::const_iterator mLastFind;
 };
 
+// The XOR of every byte of pak data, and what '\n' and '\r' look like with it
+#define PAK_XOR_KEY     0xF7
+#define PAK_XOR_LF      ('\n' ^ PAK_XOR_KEY)
+#define PAK_XOR_CR      ('\r' ^ PAK_XOR_KEY)
+
+// Every read from a pak goes through here, so it does 32 or 16 bytes at a
+// time where it can, then a word at a time
+void PakXorCopy(void* theDest, const void* theSrc, size_t theSize)
+{
+    uchar* aDest = (uchar*) theDest;
+    const uchar* aSrc = (const uchar*) theSrc;
+    size_t i = 0;
+
+#ifdef PAK_AVX2
+    const __m256i aKey256 = _mm256_set1_epi8((char) PAK_XOR_KEY);
+    for (; i + 64 <= theSize; i += 64) {
+        __m256i a = _mm256_loadu_si256((const __m256i*) (aSrc + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*) (aSrc + i + 32));
+        _mm256_storeu_si256((__m256i*) (aDest + i), _mm256_xor_si256(a, aKey256));
+        _mm256_storeu_si256((__m256i*) (aDest + i + 32), _mm256_xor_si256(b, aKey256));
+    }
+#endif
+#if defined(PAK_SSE2)
+    const __m128i aKey128 = _mm_set1_epi8((char) PAK_XOR_KEY);
+    for (; i + 64 <= theSize; i += 64) {
+        __m128i a = _mm_loadu_si128((const __m128i*) (aSrc + i));
+        __m128i b = _mm_loadu_si128((const __m128i*) (aSrc + i + 16));
+        __m128i c = _mm_loadu_si128((const __m128i*) (aSrc + i + 32));
+        __m128i d = _mm_loadu_si128((const __m128i*) (aSrc + i + 48));
+        _mm_storeu_si128((__m128i*) (aDest + i), _mm_xor_si128(a, aKey128));
+        _mm_storeu_si128((__m128i*) (aDest + i + 16), _mm_xor_si128(b, aKey128));
+        _mm_storeu_si128((__m128i*) (aDest + i + 32), _mm_xor_si128(c, aKey128));
+        _mm_storeu_si128((__m128i*) (aDest + i + 48), _mm_xor_si128(d, aKey128));
+    }
+    for (; i + 16 <= theSize; i += 16)
+        _mm_storeu_si128((__m128i*) (aDest + i), _mm_xor_si128(_mm_loadu_si128((const __m128i*) (aSrc + i)), aKey128));
+#elif defined(PAK_NEON)
+    const uint8x16_t aKey128 = vdupq_n_u8(PAK_XOR_KEY);
+    for (; i + 16 <= theSize; i += 16)
+        vst1q_u8(aDest + i, veorq_u8(vld1q_u8(aSrc + i), aKey128));
+#endif
+
+    const uint64_t aKey64 = 0x0101010101010101ULL * PAK_XOR_KEY;
+    for (; i + 8 <= theSize; i += 8) {
+        uint64_t aWord;
+        memcpy(&aWord, aSrc + i, sizeof(aWord));
+        aWord ^= aKey64;
+        memcpy(aDest + i, &aWord, sizeof(aWord));
+    }
+    for (; i < theSize; i++)
+        aDest[i] = aSrc[i] ^ PAK_XOR_KEY;
+}
+
 static PakInterfaceBase* gPakInterfaceP;
 PakInterfaceBase* GetPakPtr()
 {
@@ -110,7 +180,7 @@ bool PakInterface::AddPakFile(const std::string& theFileName)
 #if __BIG_ENDIAN__
     aVersion = Sexy::SwapFourBytes(aVersion);
 #endif
-    if (aVersion != 0) {
+    if (aVersion != 0 && aVersion != 1) {
         FClose(aFP);
         return false;
     }
@@ -142,15 +212,29 @@ bool PakInterface::AddPakFile(const std::string& theFileName)
         PakFileTime aFileTime;
         FRead(&aFileTime, sizeof(aFileTime), 1, aFP);
 
+        if (aVersion >= 1) {
+            uint64_t aHash;
+            FRead(&aHash, sizeof(aHash), 1, aFP);
+        }
+
+        int32_t aStartPos = aPos;
+        if (aFlags & FILEFLAGS_SHARED) {
+            FRead(&aStartPos, sizeof(aStartPos), 1, aFP);
+#if __BIG_ENDIAN__
+            aStartPos = Sexy::SwapFourBytes(aStartPos);
+#endif
+        }
+
         PakRecordMap::iterator aRecordItr = mPakRecordMap.insert(PakRecordMap::value_type(aName, PakRecord())).first;
         PakRecord* aPakRecord = &(aRecordItr->second);
         aPakRecord->mCollection = aPakCollection;
         aPakRecord->mFileName = aName;
-        aPakRecord->mStartPos = aPos;
+        aPakRecord->mStartPos = aStartPos;
         aPakRecord->mSize = aSrcSize;
         aPakRecord->mFileTime = aFileTime;
 
-        aPos += aSrcSize;
+        if (!(aFlags & FILEFLAGS_SHARED))
+            aPos += aSrcSize;
     }
 
     // Now fix file starts. The file position is now at the start of the data.
@@ -324,7 +408,7 @@ int PakInterface::FSeek(PFILE* theFile, long theOffset, int theOrigin)
         if (theOrigin == SEEK_SET)
             theFile->mPos = theOffset;
         else if (theOrigin == SEEK_END)
-            theFile->mPos = theFile->mRecord->mSize - theOffset;
+            theFile->mPos = theFile->mRecord->mSize + theOffset;
         else if (theOrigin == SEEK_CUR)
             theFile->mPos += theOffset;
 
@@ -365,9 +449,7 @@ size_t PakInterface::FRead(void* thePtr, int theElemSize, int theCount, PFILE* t
         int aSizeBytes = std::min(theElemSize*theCount, theFile->mRecord->mSize - theFile->mPos);
 
         uchar* src = (uchar*) theFile->mRecord->mCollection->mDataPtr + theFile->mRecord->mStartPos + theFile->mPos;
-        uchar* dest = (uchar*) thePtr;
-        for (int i = 0; i < aSizeBytes; i++)
-            *(dest++) = (*src++) ^ 0xF7; // 'Decrypt'
+        PakXorCopy(thePtr, src, aSizeBytes); // 'Decrypt'
         theFile->mPos += aSizeBytes;
         return aSizeBytes / theElemSize;
     }
@@ -379,14 +461,14 @@ int PakInterface::FGetC(PFILE* theFile)
 {
     if (theFile->mRecord != NULL)
     {
-        for (;;)
+        const uchar* aData = (const uchar*) theFile->mRecord->mCollection->mDataPtr + theFile->mRecord->mStartPos;
+        while (theFile->mPos < theFile->mRecord->mSize)
         {
-            if (theFile->mPos >= theFile->mRecord->mSize)
-                return EOF;
-            char aChar = *((char*) theFile->mRecord->mCollection->mDataPtr + theFile->mRecord->mStartPos + theFile->mPos++) ^ 0xF7;
+            uchar aChar = aData[theFile->mPos++] ^ PAK_XOR_KEY;
             if (aChar != '\r')
-                return (uchar) aChar;
+                return aChar;
         }
+        return EOF;
     }
 
     return fgetc(theFile->mFP);
@@ -408,21 +490,46 @@ char* PakInterface::FGetS(char* thePtr, int theSize, PFILE* theFile)
 {
     if (theFile->mRecord != NULL)
     {
+        // Like fgets, at most theSize - 1 chars and the 0. The line end is
+        // found in the pak data itself, where it's PAK_XOR_LF, then the line
+        // is copied in one go and its '\r's dropped.
+        if (theSize <= 0 || theFile->mPos >= theFile->mRecord->mSize)
+            return NULL;
+
+        const uchar* aData = (const uchar*) theFile->mRecord->mCollection->mDataPtr + theFile->mRecord->mStartPos;
         int anIdx = 0;
-        while (anIdx < theSize)
+        bool aLineDone = false;
+        while (!aLineDone && anIdx < theSize - 1 && theFile->mPos < theFile->mRecord->mSize)
         {
-            if (theFile->mPos >= theFile->mRecord->mSize)
+            const uchar* aSrc = aData + theFile->mPos;
+            int aLen = std::min(theSize - 1 - anIdx, theFile->mRecord->mSize - theFile->mPos);
+            const uchar* anEnd = (const uchar*) memchr(aSrc, PAK_XOR_LF, aLen);
+            if (anEnd != NULL)
             {
-                if (anIdx == 0)
-                    return NULL;
-                break;
+                aLen = anEnd - aSrc + 1;
+                aLineDone = true;
             }
-            char aChar = *((char*) theFile->mRecord->mCollection->mDataPtr + theFile->mRecord->mStartPos + theFile->mPos++) ^ 0xF7;
-            if (aChar != '\r')
-                thePtr[anIdx++] = aChar;
-            if (aChar == '\n')
-                break;
+            theFile->mPos += aLen;
+
+            char* aDest = thePtr + anIdx;
+            PakXorCopy(aDest, aSrc, aLen);
+            char* aCR = (char*) memchr(aDest, '\r', aLen);
+            if (aCR == NULL)
+            {
+                anIdx += aLen;
+                continue;
+            }
+            char* anOut = aCR;
+            for (char* anIn = aCR; anIn < aDest + aLen; anIn++)
+            {
+                if (*anIn != '\r')
+                    *anOut++ = *anIn;
+            }
+            anIdx += anOut - aDest;
         }
+        // Nothing but '\r's up to the end
+        if (anIdx == 0 && !aLineDone && theSize > 1)
+            return NULL;
         thePtr[anIdx] = 0;
         return thePtr;
     }
@@ -640,3 +747,76 @@ const PakRecord * PakInterface::FindPakRecord(const std::string & fname) const
     }
     return NULL;
 }
+
+static Sint64 SDLCALL PakRWSize(SDL_RWops* theRW)
+{
+    PFILE* aFile = (PFILE*) theRW->hidden.unknown.data1;
+    if (aFile->mRecord != NULL)
+        return aFile->mRecord->mSize;
+
+    long aPos = ftell(aFile->mFP);
+    if (aPos < 0 || fseek(aFile->mFP, 0, SEEK_END) != 0)
+        return -1;
+    long aSize = ftell(aFile->mFP);
+    fseek(aFile->mFP, aPos, SEEK_SET);
+    return aSize;
+}
+
+static Sint64 SDLCALL PakRWSeek(SDL_RWops* theRW, Sint64 theOffset, int theWhence)
+{
+    PFILE* aFile = (PFILE*) theRW->hidden.unknown.data1;
+    int anOrigin = SEEK_SET;
+    if (theWhence == RW_SEEK_CUR)
+        anOrigin = SEEK_CUR;
+    else if (theWhence == RW_SEEK_END)
+        anOrigin = SEEK_END;
+
+    if (p_fseek(aFile, (long) theOffset, anOrigin) != 0)
+        return SDL_SetError("Error seeking in pak file");
+    return p_ftell(aFile);
+}
+
+static size_t SDLCALL PakRWRead(SDL_RWops* theRW, void* thePtr, size_t theSize, size_t theMaxNum)
+{
+    PFILE* aFile = (PFILE*) theRW->hidden.unknown.data1;
+    return p_fread(thePtr, (int) theSize, (int) theMaxNum, aFile);
+}
+
+static size_t SDLCALL PakRWWrite(SDL_RWops* theRW, const void* thePtr, size_t theSize, size_t theNum)
+{
+    SDL_SetError("Pak files are read only");
+    return 0;
+}
+
+static int SDLCALL PakRWClose(SDL_RWops* theRW)
+{
+    if (theRW != NULL)
+    {
+        p_fclose((PFILE*) theRW->hidden.unknown.data1);
+        SDL_FreeRW(theRW);
+    }
+    return 0;
+}
+
+SDL_RWops* p_rwopen(const char* theFileName)
+{
+    PFILE* aFile = p_fopen(theFileName, "rb");
+    if (aFile == NULL)
+        return NULL;
+
+    SDL_RWops* aRW = SDL_AllocRW();
+    if (aRW == NULL)
+    {
+        p_fclose(aFile);
+        return NULL;
+    }
+
+    aRW->size = PakRWSize;
+    aRW->seek = PakRWSeek;
+    aRW->read = PakRWRead;
+    aRW->write = PakRWWrite;
+    aRW->close = PakRWClose;
+    aRW->type = SDL_RWOPS_UNKNOWN;
+    aRW->hidden.unknown.data1 = aFile;
+    return aRW;
+}
@@ -16,6 +16,11 @@
 #endif
 
 class PakCollection;
+struct SDL_RWops;
+
+// Copies theSize bytes of pak data, undoing its 0xF7 XOR on the way.
+// theDest may be theSrc.
+void PakXorCopy(void* theDest, const void* theSrc, size_t theSize);
 
 #ifdef WIN32
 typedef FILETIME PakFileTime;
@@ -291,4 +296,9 @@ static inline int p_feof(PFILE* theFile)
     return feof(theFile->mFP);
 }
 
+// Opens a file the same way p_fopen() does, as an SDL_RWops that reads
+// through the pak instead of a copy of the whole file. Closing it closes
+// the file. Returns NULL when the file can't be opened.
+SDL_RWops* p_rwopen(const char* theFileName);
+
 #endif //__PAKINTERFACE_H__
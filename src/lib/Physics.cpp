@@ -27,7 +27,9 @@
 #include <map>
 #include <algorithm>
 #include <utility>
+#include <new>
 #include "Graphics.h"
+#include "FrameCounters.h"
 
 /* TODO
  * inline
@@ -41,9 +43,12 @@ Physics::Physics()
       steps(1),
       delta(0.0f),
       objects(),
-      body_to_object(),
+      slots(),
+      free_slot(-1),
       joints(),
-      listener(NULL)
+      listener(NULL),
+      collision_events_enabled(false),
+      collision_events_registered_only(true)
 {
     cpInitChipmunk();
 }
@@ -54,6 +59,10 @@ Physics::~Physics()
     cpSpaceFreeChildren(space);
     cpSpaceFree(space);
     space = NULL;
+
+    for (size_t i = 0; i < slots.size(); ++i) {
+        delete slots[i].object;
+    }
 }
 
 void Physics::Init()
@@ -83,6 +92,10 @@ int Physics::CollFunc(cpShape *a, cpShape *b, cpContact *contacts, int numContac
 
     TypedData* t_data = reinterpret_cast<TypedData*> (data);
 
+    // Batched collisions are reported after the step.
+    if (t_data->physics->collision_events_enabled)
+        return 1;
+
     PhysicsObject* obj1 = t_data->physics->FindObject(a->body, a);
     PhysicsObject* obj2 = t_data->physics->FindObject(b->body, b);
 
@@ -147,12 +160,112 @@ void Physics::Update()
 {
     {
         assert(listener != NULL);
+        if (collision_events_enabled) {
+            collision_events.clear();
+            collision_points.clear();
+            collision_events.swap(ended_collisions);
+        }
+
         for (int i = 0; i < steps; i++) {
             listener->BeforePhysicsStep();
             cpSpaceStep(space, delta);
             listener->AfterPhysicsStep();
 
-            cpArrayEach(space->arbiters, &AllCollisions, this);
+            if (collision_events_enabled)
+                CollectCollisionEvents(i);
+            else
+                cpArrayEach(space->arbiters, &AllCollisions, this);
+        }
+
+        FrameCounters::Set(FrameCounter_PhysicsBodies, space->bodies->num);
+        FrameCounters::Set(FrameCounter_PhysicsArbiters, space->arbiters->num);
+    }
+}
+
+void Physics::EnableCollisionEvents(bool enable, bool registered_types_only)
+{
+    collision_events_enabled = enable;
+    collision_events_registered_only = registered_types_only;
+    collision_events.clear();
+    collision_points.clear();
+    active_collisions.clear();
+    ended_collisions.clear();
+}
+
+bool Physics::IsCollisionEventType(const cpArbiter* arb) const
+{
+    if (!collision_events_registered_only)
+        return true;
+
+    unsigned int ids[] = {arb->a->collision_type, arb->b->collision_type};
+    unsigned int hash = CP_HASH_PAIR(ids[0], ids[1]);
+    cpCollPairFunc* pair = static_cast<cpCollPairFunc*> (cpHashSetFind(space->collFuncSet, hash, ids));
+    return pair->func == (cpCollFunc) & CollFunc;
+}
+
+void Physics::CollectCollisionEvents(int step)
+{
+    assert(sizeof (CollisionPoint) == sizeof (cpContact));
+
+    // Arbiters of this step carry the stamp from before cpSpaceStep() incremented it.
+    int stamp = space->stamp - 1;
+    cpArray* arbiters = space->arbiters;
+
+    current_collisions.clear();
+    for (int i = 0; i < arbiters->num; i++) {
+        cpArbiter* arb = reinterpret_cast<cpArbiter*> (arbiters->arr[i]);
+        if (!IsCollisionEventType(arb))
+            continue;
+
+        PhysicsObject* obj1 = reinterpret_cast<PhysicsObject*> (arb->a->body->data);
+        PhysicsObject* obj2 = reinterpret_cast<PhysicsObject*> (arb->b->body->data);
+        assert(obj1 != NULL && obj2 != NULL);
+
+        CollisionEvent event(arb->firstColl ? CollisionEvent::BEGIN : CollisionEvent::PERSIST, step, obj1, obj2,
+                             (int) (intptr_t) arb->a->data, (int) (intptr_t) arb->b->data);
+        cpVect impulse = cpContactsSumImpulsesWithFriction(arb->contacts, arb->numContacts);
+        event.impulse = SexyVector2(impulse.x, impulse.y);
+        event.first_point = collision_points.size();
+        event.num_points = arb->numContacts;
+
+        const CollisionPoint* points = reinterpret_cast<const CollisionPoint*> (arb->contacts);
+        collision_points.insert(collision_points.end(), points, points + arb->numContacts);
+        collision_events.push_back(event);
+
+        ActiveCollision active = {arb, arb->a, arb->b, obj1, obj2};
+        current_collisions.push_back(active);
+    }
+
+    // Collisions of the last step that weren't reported again have ended.
+    // Arbiters are pooled, so also check that it still belongs to the same shapes.
+    std::vector<ActiveCollision>::const_iterator it = active_collisions.begin();
+    while (it != active_collisions.end()) {
+        const cpArbiter* arb = it->arbiter;
+        bool touching = arb->stamp == stamp && arb->a == it->shape1 && arb->b == it->shape2 && IsCollisionEventType(arb);
+        if (!touching) {
+            collision_events.push_back(CollisionEvent(CollisionEvent::END, step, it->object1, it->object2,
+                                                      (int) (intptr_t) it->shape1->data, (int) (intptr_t) it->shape2->data));
+        }
+        ++it;
+    }
+
+    active_collisions.swap(current_collisions);
+}
+
+// Ends the tracked collisions of a shape that is going away, or of all the
+// shapes of obj if shape is NULL. The next Update() reports the END events.
+void Physics::ForgetCollisions(const PhysicsObject* obj, const cpShape* shape)
+{
+    std::vector<ActiveCollision>::iterator it = active_collisions.begin();
+    while (it != active_collisions.end()) {
+        bool forget = shape != NULL ? (it->shape1 == shape || it->shape2 == shape)
+                                    : (it->object1 == obj || it->object2 == obj);
+        if (forget) {
+            ended_collisions.push_back(CollisionEvent(CollisionEvent::END, 0, it->object1, it->object2,
+                                                      (int) (intptr_t) it->shape1->data, (int) (intptr_t) it->shape2->data));
+            it = active_collisions.erase(it);
+        } else {
+            ++it;
         }
     }
 }
@@ -163,8 +276,8 @@ void Physics::Draw(Graphics* g)
     data.graphics = g;
     data.physics = this;
 
-    cpSpaceHashEach(space->activeShapes, &HashQuery, reinterpret_cast<void*> (&data));
-    cpSpaceHashEach(space->staticShapes, &HashQuery, reinterpret_cast<void*> (&data));
+    cpSpatialIndexEach(space->activeShapes, &HashQuery, reinterpret_cast<void*> (&data));
+    cpSpatialIndexEach(space->staticShapes, &HashQuery, reinterpret_cast<void*> (&data));
 }
 
 void Physics::SetGravity(const SexyVector2& gravity)
@@ -185,6 +298,28 @@ void Physics::SetIterations(int iter)
     space->iterations = iter;
 }
 
+// Number of threads used for broadphase, narrow-phase and the constraint solver.
+// Collision callbacks are always made from the thread calling Update().
+void Physics::SetThreads(int threads)
+{
+    assert(space != NULL);
+    cpSpaceSetThreads(space, threads);
+}
+
+void Physics::SetSpatialIndex(cpSpatialIndexType type)
+{
+    assert(space != NULL);
+    cpSpaceSetSpatialIndex(space, type);
+}
+
+// Makes the simulation independent of the number of threads, at the cost
+// of using the (slightly slower) colored solver on a single thread too.
+void Physics::SetDeterministic(bool deterministic)
+{
+    assert(space != NULL);
+    space->deterministic = deterministic ? 1 : 0;
+}
+
 void Physics::ResizeStaticHash(float dimension, int count)
 {
     assert(space != NULL);
@@ -199,47 +334,71 @@ void Physics::ResizeActiveHash(float dimension, int count)
 
 void Physics::Clear()
 {
-    std::vector<PhysicsObject*>::iterator it = objects.begin();
-    while (it != objects.end()) {
-        // The false means it won't be removed from the vector. It would mess up our iteratiom, I guess.
-        DestroyObject(*it, false);
-        ++it;
+    while (!objects.empty()) {
+        DestroyObject(objects.back());
     }
 
-    body_to_object.clear();
-    objects.clear();
     joints.clear();
+    collision_events.clear();
+    collision_points.clear();
+    active_collisions.clear();
+    ended_collisions.clear();
 }
 
-PhysicsObject* Physics::CreateObject(cpFloat mass, cpFloat inertia)
+PhysicsObject* Physics::NewObject(cpFloat mass, cpFloat inertia, bool is_static)
 {
-    assert(IsInitialized());
-    PhysicsObject* obj = new PhysicsObject(mass, inertia, this);
+    PhysicsObject* obj;
+    int slot = free_slot;
+    if (slot >= 0) {
+        free_slot = slots[slot].next_free;
+        obj = slots[slot].object;
+        obj->~PhysicsObject();
+        new (obj) PhysicsObject(mass, inertia, this, is_static);
+    } else {
+        slot = slots.size();
+        obj = new PhysicsObject(mass, inertia, this, is_static);
+        ObjectSlot s = { obj, 0, -1 };
+        slots.push_back(s);
+    }
+    slots[slot].next_free = -1;
+    obj->slot = slot;
+    obj->generation = slots[slot].generation;
+
+    obj->object_index = objects.size();
     objects.push_back(obj);
     cpBody* body = obj->GetBody();
     if (body) {
-        assert(!findObjectByBody(body));
-        body_to_object[body] = obj;
+        assert(body->data == NULL);
+        body->data = obj;
     }
     return obj;
 }
 
+PhysicsObject* Physics::CreateObject(cpFloat mass, cpFloat inertia)
+{
+    assert(IsInitialized());
+    return NewObject(mass, inertia, false);
+}
+
 PhysicsObject* Physics::CreateStaticObject()
 {
-    PhysicsObject* obj = new PhysicsObject(INFINITY, INFINITY, this, true);
-    objects.push_back(obj);
-    cpBody* body = obj->GetBody();
-    if (body) {
-        assert(!findObjectByBody(body));
-        body_to_object[body] = obj;
+    return NewObject(INFINITY, INFINITY, true);
+}
+
+void Physics::DestroyObject(const PhysicsHandle& handle)
+{
+    PhysicsObject* object = GetObject(handle);
+    if (object != NULL) {
+        DestroyObject(object);
     }
-    return obj;
 }
 
-void Physics::DestroyObject(PhysicsObject* object, bool erase)
+void Physics::DestroyObject(PhysicsObject* object)
 {
     assert(IsValidObject(object));
 
+    ForgetCollisions(object);
+
     if (!object->shapes.empty()) {
         if (object->is_static) {
             std::vector<cpShape*>::iterator it = object->shapes.begin();
@@ -256,14 +415,6 @@ void Physics::DestroyObject(PhysicsObject* object, bool erase)
         }
     }
 
-    if (erase) {
-        // Let's assume the body_to_object will be deleted soon, by the caller.
-        std::map<cpBody*, PhysicsObject*>::iterator it = body_to_object.find(object->body);
-        if (it != body_to_object.end()) {
-            body_to_object.erase(it);
-        }
-    }
-
     if (!object->is_static) {
         cpSpaceRemoveBody(space, object->body);
     } else {
@@ -284,21 +435,44 @@ void Physics::DestroyObject(PhysicsObject* object, bool erase)
         ++sit;
     }
 
-    if (erase) {
-        // If it is part of the "objects", delete and remove it.
-        std::vector<PhysicsObject*>::iterator pit = std::find(objects.begin(), objects.end(), object);
-        if (pit != objects.end()) {
-            delete (*pit);
-            objects.erase(pit);
-        }
-    }
+    object->shapes.clear();
+    object->shape_data.clear();
+
+    // The last object takes its place
+    size_t index = object->object_index;
+    objects[index] = objects.back();
+    objects[index]->object_index = index;
+    objects.pop_back();
+
+    // The memory stays for IsValidObject(), until NewObject() reuses it
+    ObjectSlot& s = slots[object->slot];
+    s.generation++;
+    s.next_free = free_slot;
+    free_slot = object->slot;
     // ???? Doing this will cause a crash in ~WP_Sprite() object->body = NULL;
 }
 
-bool Physics::IsValidObject(PhysicsObject* object) const
+bool Physics::IsValidObject(const PhysicsObject* object) const
+{
+    if (object == NULL || object->physics != this || object->slot < 0 || object->slot >= (int) slots.size()) {
+        return false;
+    }
+    const ObjectSlot& s = slots[object->slot];
+    return s.object == object && s.generation == object->generation;
+}
+
+bool Physics::IsValidObject(const PhysicsHandle& handle) const
+{
+    return GetObject(handle) != NULL;
+}
+
+PhysicsObject* Physics::GetObject(const PhysicsHandle& handle) const
 {
-    std::vector<PhysicsObject*>::const_iterator it = std::find(objects.begin(), objects.end(), object);
-    return (it != objects.end());
+    if (handle.slot < 0 || handle.slot >= (int) slots.size()) {
+        return NULL;
+    }
+    const ObjectSlot& s = slots[handle.slot];
+    return s.generation == handle.generation ? s.object : NULL;
 }
 
 void Physics::RegisterCollisionType(uint32_t type_a, uint32_t type_b)
@@ -612,11 +786,7 @@ PhysicsObject* Physics::findObjectByBody(cpBody* body) const
     if (!body) {
         return NULL;
     }
-    std::map<cpBody*, PhysicsObject*>::const_iterator it = body_to_object.find(body);
-    if (it != body_to_object.end()) {
-        return it->second;
-    }
-    return NULL;
+    return reinterpret_cast<PhysicsObject*> (body->data);
 }
 
 // Find object with this body and this shape
@@ -624,15 +794,10 @@ PhysicsObject* Physics::FindObject(cpBody* body, cpShape* shape)
 {
     PhysicsObject* obj = findObjectByBody(body);
     if (obj) {
-        std::vector<cpShape*>::const_iterator sit = obj->shapes.begin();
-        int count = 0;
-        while (sit != obj->shapes.end()) {
-            if (*sit == shape) {
-                obj->colliding_shape_index = count;
-                return obj;
-            }
-            ++count;
-            ++sit;
+        int index = (int) reinterpret_cast<intptr_t> (shape->data);
+        if (index < (int) obj->shapes.size() && obj->shapes[index] == shape) {
+            obj->colliding_shape_index = index;
+            return obj;
         }
     }
     return NULL;
@@ -641,22 +806,7 @@ PhysicsObject* Physics::FindObject(cpBody* body, cpShape* shape)
 // Find object with this shape
 PhysicsObject* Physics::FindObject(cpShape* shape)
 {
-    // TODO. Use shape_to_obj map, if at all possible
-    std::vector<PhysicsObject*>::const_iterator it = objects.begin();
-    while (it != objects.end()) {
-        std::vector<cpShape*>::const_iterator sit = (*it)->shapes.begin();
-        int count = 0;
-        while (sit != (*it)->shapes.end()) {
-            if (*sit == shape) {
-                (*it)->colliding_shape_index = count;
-                return *it;
-            }
-            ++count;
-            ++sit;
-        }
-        ++it;
-    }
-    return NULL;
+    return FindObject(shape->body, shape);
 }
 
 std::set<PhysicsObject*> Physics::GetJoinedPhysicsObjects(const PhysicsObject* obj1) const
@@ -687,6 +837,9 @@ std::set<PhysicsObject*> Physics::GetJoinedPhysicsObjects(const PhysicsObject* o
 PhysicsObject::PhysicsObject(cpFloat mass, cpFloat inertia, Physics* physics, bool is_static)
     : physics(physics),
       colliding_shape_index(0),
+      object_index(0),
+      slot(-1),
+      generation(0),
       is_static(is_static)
 {
     assert(physics != NULL);
@@ -696,19 +849,15 @@ PhysicsObject::PhysicsObject(cpFloat mass, cpFloat inertia, Physics* physics, bo
         cpSpaceAddBody(physics->space, body);
     }
     shapes.clear();
+    shape_data.clear();
 }
 
-PhysicsObject::~PhysicsObject()
+void PhysicsObject::AddShape(cpShape* shape, cpFloat elasticity, cpFloat friction)
 {
-}
-
-void PhysicsObject::AddCircleShape(cpFloat radius, const SexyVector2& offset, cpFloat elasticity, cpFloat friction)
-{
-    assert(body != NULL);
-    cpShape* shape = cpCircleShapeNew(body, radius, cpv(offset.x, offset.y));
     assert(shape != NULL);
     shape->e = elasticity;
     shape->u = friction;
+    shape->data = reinterpret_cast<void*> ((intptr_t) shapes.size());
     if (physics->space != NULL) {
         if (is_static)
             cpSpaceAddStaticShape(physics->space, shape);
@@ -716,22 +865,23 @@ void PhysicsObject::AddCircleShape(cpFloat radius, const SexyVector2& offset, cp
             cpSpaceAddShape(physics->space, shape);
     }
     shapes.push_back(shape);
+    shape_data.push_back(NULL);
+}
+
+PhysicsObject::~PhysicsObject()
+{
+}
+
+void PhysicsObject::AddCircleShape(cpFloat radius, const SexyVector2& offset, cpFloat elasticity, cpFloat friction)
+{
+    assert(body != NULL);
+    AddShape(cpCircleShapeNew(body, radius, cpv(offset.x, offset.y)), elasticity, friction);
 }
 
 void PhysicsObject::AddSegmentShape(const SexyVector2& begin, const SexyVector2& end, cpFloat radius, cpFloat elasticity, cpFloat friction)
 {
     assert(body != NULL);
-    cpShape* shape = cpSegmentShapeNew(body, cpv(begin.x, begin.y), cpv(end.x, end.y), radius);
-    assert(shape != NULL);
-    shape->e = elasticity;
-    shape->u = friction;
-    if (physics->space != NULL) {
-        if (is_static)
-            cpSpaceAddStaticShape(physics->space, shape);
-        else
-            cpSpaceAddShape(physics->space, shape);
-    }
-    shapes.push_back(shape);
+    AddShape(cpSegmentShapeNew(body, cpv(begin.x, begin.y), cpv(end.x, end.y), radius), elasticity, friction);
 }
 
 void PhysicsObject::AddPolyShape(int numVerts, SexyVector2* vectors, const SexyVector2& offset, cpFloat elasticity, cpFloat friction)
@@ -739,22 +889,14 @@ void PhysicsObject::AddPolyShape(int numVerts, SexyVector2* vectors, const SexyV
     assert(body != NULL);
     assert(sizeof (SexyVector2) == sizeof (cpVect));
 
-    cpShape* shape = cpPolyShapeNew(body, numVerts, (cpVect*) vectors, cpv(offset.x, offset.y));
-    assert(shape != NULL);
-    shape->e = elasticity;
-    shape->u = friction;
-    if (physics->space != NULL) {
-        if (is_static)
-            cpSpaceAddStaticShape(physics->space, shape);
-        else
-            cpSpaceAddShape(physics->space, shape);
-    }
-    shapes.push_back(shape);
+    AddShape(cpPolyShapeNew(body, numVerts, (cpVect*) vectors, cpv(offset.x, offset.y)), elasticity, friction);
 }
 
 void PhysicsObject::RemoveShape(int shape_index) 
 {
     assert((int)shapes.size() > shape_index);
+
+    physics->ForgetCollisions(this, shapes[shape_index]);
     
     std::vector<cpShape*>::iterator it = shapes.begin();
     int count = 0;
@@ -766,9 +908,15 @@ void PhysicsObject::RemoveShape(int shape_index)
             }
             else {
                 cpSpaceRemoveShape(physics->space, *it);
-                cpSpaceHashRehash(physics->space->activeShapes);
+                cpSpatialIndexRehash(physics->space->activeShapes);
             }
+            cpShapeFree(*it);
             shapes.erase(it);
+            shape_data.erase(shape_data.begin() + shape_index);
+            // Renumber the shapes that moved down.
+            for (size_t i = shape_index; i < shapes.size(); ++i) {
+                shapes[i]->data = reinterpret_cast<void*> ((intptr_t) i);
+            }
             return;
         }
         count++;
@@ -821,7 +969,7 @@ void PhysicsObject::SetLayers(unsigned int layers, int shape_index)
 void PhysicsObject::SetData(void* data, int shape_index)
 {
     assert((int)shapes.size() > shape_index);
-    shapes[shape_index]->data = data;
+    shape_data[shape_index] = data;
 }
 
 unsigned int PhysicsObject::GetCollisionType(int shape_index) const
@@ -845,7 +993,7 @@ unsigned int PhysicsObject::GetLayers(int shape_index) const
 void* PhysicsObject::GetData(int shape_index) const
 {
     assert((int)shapes.size() > shape_index);
-    return shapes[shape_index]->data;
+    return shape_data[shape_index];
 }
 
 int PhysicsObject::GetShapeType(int shape_index) const
@@ -36,9 +36,21 @@
 namespace Sexy
 {
 class CollisionPoint;
+class CollisionEvent;
 class PhysicsObject;
 class Joint;
 
+// Refers to a PhysicsObject without keeping it alive. A handle stays invalid
+// once its object is destroyed, also after a new object took over its slot.
+struct PhysicsHandle
+{
+    int         slot;
+    uint32_t    generation;
+
+    PhysicsHandle() : slot(-1), generation(0) {}
+    PhysicsHandle(int slot, uint32_t generation) : slot(slot), generation(generation) {}
+};
+
 class Physics
 {
     friend class PhysicsObject;
@@ -58,11 +70,22 @@ public:
     void SetGravity(const SexyVector2& gravity);
     void SetDamping(cpFloat damping);
     void SetIterations(int iter);
+    void SetThreads(int threads);
+    void SetDeterministic(bool deterministic);
+    // CP_SPACE_HASH (default) or CP_BB_TREE. The tree needs no Resize*Hash() tuning
+    // and handles levels that mix small and huge objects better.
+    void SetSpatialIndex(cpSpatialIndexType type);
     void ResizeStaticHash(float dimension, int count);
     void ResizeActiveHash(float dimension, int count);
 
     void Update();
     void Draw(Graphics* g);
+
+    // Allocation statistics of the last physics step.
+    const cpSpaceStepStats& GetStepStats() const
+    {
+        return space->stepStats;
+    }
     void Clear();
 
     void SetSteps(int steps);
@@ -74,8 +97,15 @@ public:
 
     PhysicsObject* CreateObject(cpFloat mass, cpFloat inertia);
     PhysicsObject* CreateStaticObject();
-    void DestroyObject(PhysicsObject* object, bool erase = true);
-    bool IsValidObject(PhysicsObject* object) const;
+    void DestroyObject(PhysicsObject* object);
+    void DestroyObject(const PhysicsHandle& handle);
+    // Destroyed objects keep their memory until the Physics is deleted, so
+    // this is safe on them too. A new object may reuse a destroyed one's
+    // memory though, hold a PhysicsHandle to tell them apart.
+    bool IsValidObject(const PhysicsObject* object) const;
+    bool IsValidObject(const PhysicsHandle& handle) const;
+    // NULL if the object was destroyed
+    PhysicsObject* GetObject(const PhysicsHandle& handle) const;
 
     void SetPhysicsListener(PhysicsListener* p)
     {
@@ -85,6 +115,25 @@ public:
     void RegisterCollisionType(uint32_t type_a, uint32_t type_b = 0);
     void UnregisterCollisionType(uint32_t type_a, uint32_t type_b = 0);
 
+    // Collect the collisions of each Update() in a buffer instead of calling
+    // HandleCollision() and HandleTypedCollision() for every one of them.
+    // Registered collision types are then always accepted. Only collisions
+    // between registered types are collected, unless registered_types_only is false.
+    void EnableCollisionEvents(bool enable, bool registered_types_only = true);
+
+    // The collisions of the last Update(), valid until the next one.
+    const std::vector<CollisionEvent>& GetCollisionEvents() const
+    {
+        return collision_events;
+    }
+
+    // Contact points of the events, see CollisionEvent::first_point.
+    const std::vector<CollisionPoint>& GetCollisionPoints() const
+    {
+        return collision_points;
+    }
+
+    // Destroying an object moves the last one into its place.
     std::vector<PhysicsObject*>& GetPhysicsObjects() { return objects; }
 
     //help functions
@@ -129,10 +178,39 @@ private:
     int                 steps;
     cpFloat             delta;
     std::vector<PhysicsObject*> objects;
-    std::map<cpBody*, PhysicsObject*> body_to_object;
+
+    // Every object ever created has a slot. The generation is bumped when
+    // the object is destroyed, the slot then goes on the free list and its
+    // PhysicsObject is constructed again for the next object.
+    typedef struct object_slot {
+        PhysicsObject*  object;
+        uint32_t        generation;
+        int             next_free;
+    } ObjectSlot;
+
+    std::vector<ObjectSlot> slots;
+    int                 free_slot;
     std::vector<cpJoint*> joints;
     PhysicsListener*    listener;
 
+    // A collision reported by the last step, to find out when it ends.
+    typedef struct active_collision {
+        cpArbiter*      arbiter;
+        cpShape*        shape1;
+        cpShape*        shape2;
+        PhysicsObject*  object1;
+        PhysicsObject*  object2;
+    } ActiveCollision;
+
+    bool                collision_events_enabled;
+    bool                collision_events_registered_only;
+    std::vector<CollisionEvent> collision_events;
+    std::vector<CollisionPoint> collision_points;
+    std::vector<ActiveCollision> active_collisions;
+    std::vector<ActiveCollision> current_collisions;
+    // END events of shapes removed between updates, reported by the next one
+    std::vector<CollisionEvent> ended_collisions;
+
     void AddUniqueJoint(std::vector<std::pair<SexyVector2, SexyVector2> >* v, const SexyVector2& start, const SexyVector2& end) const;
     const std::vector<cpJoint*> GetJointsOfObject(const PhysicsObject* obj) const;
     void RemoveJoint(const cpJoint* joint);
@@ -140,6 +218,10 @@ private:
     static void AllCollisions(void* ptr, void* data);
     static void HashQuery(void* ptr, void* data);
     static int CollFunc(cpShape *a, cpShape *b, cpContact *contacts, int numContacts, cpFloat normal_coef, void *data);
+    PhysicsObject* NewObject(cpFloat mass, cpFloat inertia, bool is_static);
+    bool IsCollisionEventType(const cpArbiter* arb) const;
+    void CollectCollisionEvents(int step);
+    void ForgetCollisions(const PhysicsObject* obj, const cpShape* shape = NULL);
     PhysicsObject* findObjectByBody(cpBody* body) const;
     PhysicsObject* FindObject(cpBody* body, cpShape* shape);
     PhysicsObject* FindObject(cpShape* shape);
@@ -160,10 +242,22 @@ private:
     friend class Physics;
     friend class CollisionObject;
 
+    // body->data points back to this object and shape->data holds the index
+    // of the shape in shapes, so collisions map back to objects in O(1).
     cpBody*                     body;
     std::vector<cpShape*>       shapes;
+    // User data of the shapes, see SetData().
+    std::vector<void*>          shape_data;
     Physics*                    physics;
     int                         colliding_shape_index;
+    // Position in Physics::objects.
+    size_t                      object_index;
+    // See Physics::ObjectSlot. The object is alive while its generation
+    // matches the slot's.
+    int                         slot;
+    uint32_t                    generation;
+
+    void AddShape(cpShape* shape, cpFloat elasticity, cpFloat friction);
 
 public:
 
@@ -209,6 +303,7 @@ public:
     {
         cpBodyApplyForce(body, cpv(f.x, f.y), cpv(r.x, r.y));
     }
+    PhysicsHandle GetHandle() const { return PhysicsHandle(slot, generation); }
     cpBody* GetBody() const { return body; }
     float GetAngle() const { return (float) body->a; }
     SexyVector2 GetRotation() const { return SexyVector2(body->rot.x, body->rot.y); }
@@ -302,6 +397,37 @@ public:
     float               normal_coef;
 };
 
+class CollisionEvent
+{
+public:
+
+    enum Phase {
+        BEGIN,          // first step the objects touch
+        PERSIST,        // the objects touched in the step before too
+        END             // the objects stopped touching, there are no points. Also sent
+                        // when a shape is removed, the object may be destroyed by then.
+    };
+
+    CollisionEvent(Phase phase, int step, PhysicsObject* object1, PhysicsObject* object2, int shape_index1, int shape_index2) :
+    phase(phase), step(step), object1(object1), object2(object2), shape_index1(shape_index1), shape_index2(shape_index2),
+    impulse(0.0f, 0.0f), first_point(0), num_points(0)
+    {
+    }
+
+    Phase               phase;
+    // Physics step within Update(), see Physics::SetSteps().
+    int                 step;
+    PhysicsObject*      object1;
+    PhysicsObject*      object2;
+    int                 shape_index1;
+    int                 shape_index2;
+    // Summed impulse (with friction) applied to object2, object1 got the opposite.
+    SexyVector2         impulse;
+    // Index of the first point in Physics::GetCollisionPoints(). Normals point from object1 to object2.
+    int                 first_point;
+    int                 num_points;
+};
+
 class Joint
 {
 private:
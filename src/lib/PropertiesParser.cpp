@@ -248,7 +248,7 @@ bool PropertiesParser::ParsePropertiesBuffer(const Buffer& theBuffer)
 {
     mXMLParser = new XMLParser();
 
-    mXMLParser->SetStringSource(theBuffer.UTF8ToWideString());
+    mXMLParser->SetUTF8Source((const char*)theBuffer.GetDataPtr(), theBuffer.GetDataLen());
     return DoParseProperties();
 }
 
@@ -4,8 +4,8 @@
 #include "SoundManager.h"
 #include "DDImage.h"
 #include "Timer.h"
-#if 0
 #include "D3DInterface.h"
+#if 0
 #include "SysFont.h"
 //#define SEXY_PERF_ENABLED
 #include "PerfTimer.h"
@@ -13,11 +13,155 @@
 
 #include "ImageFont.h"
 #include "ImageLib.h"
+#include "PakInterface.h"
+#include "MemoryStats.h"
 
 #include <memory>
+#include <algorithm>
 
 using namespace Sexy;
 
+///////////////////////////////////////////////////////////////////////////////
+// Compiled resources file, written by CompileResourcesFile().
+//
+// A header, then the sections in this order: resources, attributes (pairs of
+// string indices), ints (animation tables), groups, group entries (resource
+// indices in load order), string offsets and the strings. String 0 is "".
+// Numbers are in host byte order, a file from the other byte order has the
+// wrong magic and the XML is parsed instead.
+///////////////////////////////////////////////////////////////////////////////
+#define COMPILED_RES_MAGIC      (0x53455254)        // "TRES"
+#define COMPILED_RES_VERSION    (3)
+
+enum
+{
+    COMPILED_FROM_PROGRAM       = 0x0001,
+    COMPILED_HAS_ALPHA          = 0x0002,
+    COMPILED_NO_ALPHA           = 0x0004,
+    COMPILED_NO_ALPHA_SET       = 0x0008,
+    COMPILED_PALLETIZE          = 0x0010,
+    COMPILED_A4R4G4B4           = 0x0020,
+    COMPILED_A8R8G8B8           = 0x0040,
+    COMPILED_DDSURFACE          = 0x0080,
+    COMPILED_NO_BITS            = 0x0100,
+    COMPILED_NO_BITS_2D         = 0x0200,
+    COMPILED_NO_BITS_3D         = 0x0400,
+    COMPILED_MIN_SUBDIVIDE      = 0x0800,
+    COMPILED_SYSFONT            = 0x1000,
+    COMPILED_BOLD               = 0x2000,
+    COMPILED_ITALIC             = 0x4000,
+    COMPILED_UNDERLINE          = 0x8000,
+    COMPILED_SHADOW             = 0x10000,
+    COMPILED_R5G6B5             = 0x20000,
+    COMPILED_A8                 = 0x40000,
+    COMPILED_DITHER             = 0x80000
+};
+
+struct CompiledHeader
+{
+    uint32_t mMagic;
+    uint32_t mVersion;
+    uint32_t mSourceSize;           // resources.xml it was compiled from
+    uint32_t mSourceHash;
+    uint32_t mNumResources;
+    uint32_t mNumAttributes;
+    uint32_t mNumInts;
+    uint32_t mNumGroups;
+    uint32_t mNumGroupEntries;
+    uint32_t mNumStrings;
+    uint32_t mStringBytes;
+    uint32_t mReserved;
+};
+
+// One record for every kind of resource, the defaults are already applied.
+struct CompiledRes
+{
+    uint32_t mType;
+    uint32_t mFlags;
+    uint32_t mGroup;
+    uint32_t mId;
+    uint32_t mPath;
+    uint32_t mFirstAttribute;
+    uint32_t mNumAttributes;
+
+    // Images
+    uint32_t mAlphaImage;
+    uint32_t mAlphaGridImage;
+    uint32_t mAlphaColor;
+    int32_t  mRows;
+    int32_t  mCols;
+    int32_t  mAnimType;
+    int32_t  mFrameDelay;
+    int32_t  mNumCels;
+    int32_t  mTotalAnimTime;
+    uint32_t mFirstPerFrameDelay;
+    uint32_t mNumPerFrameDelays;
+    uint32_t mFirstFrameMap;
+    uint32_t mNumFrameMaps;
+
+    // Sounds
+    double   mVolume;
+    int32_t  mPanning;
+    int32_t  mPriority;
+    int32_t  mMaxInstances;
+
+    // Fonts
+    uint32_t mImagePath;
+    uint32_t mTags;
+    int32_t  mSize;
+};
+
+struct CompiledGroup
+{
+    uint32_t mName;
+    uint32_t mFirstEntry;
+    uint32_t mNumEntries;
+};
+
+struct ResourceManager::CompiledManifest
+{
+    std::vector<char>       mData;
+    const CompiledHeader*   mHeader;
+    const CompiledRes*      mResources;
+    const uint32_t*         mAttributes;
+    const int32_t*          mInts;
+    const CompiledGroup*    mGroups;
+    const uint32_t*         mGroupEntries;
+    const uint32_t*         mStringOffsets;
+    const char*             mStrings;
+
+    bool                    Load(const std::string& thePath);
+
+    const char*             GetString(uint32_t theIndex) const { return mStrings + mStringOffsets[theIndex]; }
+    void                    GetAttributes(int theIndex, XMLParamMap& theAttributes) const;
+    void                    GetInts(uint32_t theFirst, uint32_t theCount, std::vector<int>& theInts) const;
+};
+
+// FNV-1a, tells whether resources.xml changed since it was compiled.
+static uint32_t HashResourcesSource(const std::vector<char>& theData)
+{
+    uint32_t aHash = 2166136261U;
+    for (size_t i = 0; i < theData.size(); i++)
+    {
+        aHash ^= (uchar)theData[i];
+        aHash *= 16777619U;
+    }
+    return aHash;
+}
+
+static bool ReadResourcesFile(const std::string& thePath, std::vector<char>& theData)
+{
+    PFILE* aFile = p_fopen(thePath.c_str(), "rb");
+    if (aFile == NULL)
+        return false;
+
+    int aSize = p_size(aFile);
+    theData.resize(aSize > 0 ? aSize : 0);
+    bool aSuccess = theData.empty() || p_fread(&theData[0], 1, aSize, aFile) == (size_t)aSize;
+    p_fclose(aFile);
+    return aSuccess;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 void ResourceManager::ImageRes::DeleteResource()
@@ -25,6 +169,7 @@ void ResourceManager::ImageRes::DeleteResource()
     LOG(mParent->mLogFacil, 2, Logger::format("ImageRes::DeleteResource: '%s'", mPath.c_str()));
     delete mImage;
     mImage = NULL;
+    mLoadedBitsChangedCount = -1;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -69,6 +214,12 @@ ResourceManager::ResourceManager(SexyAppBase *theApp)
     mLoadingResourcesCompleted = false;
     mThreadCompleteCallBack = NULL;
     mThreadCompleteCallBackArg = NULL;
+
+    mImageCPUBudget = 0;
+    mImageTextureBudget = 0;
+    mImageCPUUsage = 0;
+    mImageTextureUsage = 0;
+    mImageFrame = 0;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -81,6 +232,12 @@ ResourceManager::~ResourceManager()
     DeleteMap(mImageMap);
     DeleteMap(mSoundMap);
     DeleteMap(mFontMap);
+
+    while (!mCompiledManifests.empty())
+    {
+        delete mCompiledManifests.front();
+        mCompiledManifests.pop_front();
+    }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -143,6 +300,177 @@ void ResourceManager::DeleteExtraImageBuffers(const std::string &theGroup)
     }
 }
 
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+void ResourceManager::SetImageMemoryBudget(size_t theCPUBytes, size_t theTextureBytes)
+{
+    mImageCPUBudget = theCPUBytes;
+    mImageTextureBudget = theTextureBytes;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+void ResourceManager::GetImageMemoryUsage(size_t* theCPUBytes, size_t* theTextureBytes)
+{
+    // As of the last UpdateImageMemory()
+    if (theCPUBytes != NULL)
+        *theCPUBytes = mImageCPUUsage;
+    if (theTextureBytes != NULL)
+        *theTextureBytes = mImageTextureUsage;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+void ResourceManager::UpdateImageMemory()
+{
+    if (mImageCPUBudget == 0 && mImageTextureBudget == 0)
+        return;
+
+    // The loading thread may be busy with any of the images
+    if (mLoadingResourcesStarted && !mLoadingResourcesCompleted)
+        return;
+
+    mImageFrame++;
+    mImageCPUUsage = 0;
+    mImageTextureUsage = 0;
+
+    std::vector<std::pair<int, ImageRes*> > anEvictable;
+    for (ResMap::iterator anItr = mImageMap.begin(); anItr != mImageMap.end(); ++anItr)
+    {
+        ImageRes *aRes = (ImageRes*)anItr->second;
+        MemoryImage *anImage = dynamic_cast<MemoryImage*>(aRes->mImage);
+        if (anImage == NULL)
+            continue;
+
+        if (anImage->mDrawn)
+        {
+            aRes->mLastDrawnFrame = mImageFrame;
+            anImage->mDrawn = false;
+        }
+
+        mImageCPUUsage += anImage->GetBitsMemSize();
+        if (anImage->HasTextureData())
+            mImageTextureUsage += anImage->GetTextureData()->GetTexMemSize();
+
+        // Images that were changed after loading can't be read back
+        if (aRes->mLastDrawnFrame != mImageFrame && aRes->mLoadedBitsChangedCount == anImage->GetBitsChangedCount())
+            anEvictable.push_back(std::make_pair(aRes->mLastDrawnFrame, aRes));
+    }
+
+    bool overCPU = mImageCPUBudget != 0 && mImageCPUUsage > mImageCPUBudget;
+    bool overTexture = mImageTextureBudget != 0 && mImageTextureUsage > mImageTextureBudget;
+    if (!overCPU && !overTexture)
+        return;
+
+    // Least recently drawn first
+    std::sort(anEvictable.begin(), anEvictable.end());
+    for (size_t i = 0; i < anEvictable.size() && (overCPU || overTexture); i++)
+    {
+        ImageRes *aRes = anEvictable[i].second;
+        MemoryImage *anImage = (MemoryImage*)aRes->mImage;
+
+        size_t aSize = anImage->GetBitsMemSize();
+        if (overCPU && aSize != 0)
+        {
+            TLOG(mLogFacil, 1, Logger::format("UpdateImageMemory: evict bits '%s' %d", aRes->mPath.c_str(), (int)aSize));
+            anImage->EvictBits();
+            mImageCPUUsage -= aSize;
+            overCPU = mImageCPUUsage > mImageCPUBudget;
+        }
+
+        if (overTexture && anImage->HasTextureData())
+        {
+            aSize = anImage->GetTextureData()->GetTexMemSize();
+            TLOG(mLogFacil, 1, Logger::format("UpdateImageMemory: evict texture '%s' %d", aRes->mPath.c_str(), (int)aSize));
+            mApp->Remove3DData(anImage);
+            mImageTextureUsage -= aSize;
+            overTexture = mImageTextureUsage > mImageTextureBudget;
+        }
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+bool ResourceManager::GetMemoryUsage(MemoryReport& theReport, const std::string& theGroup)
+{
+    if (mLoadingResourcesStarted && !mLoadingResourcesCompleted)
+        return false;
+
+    // Images before fonts, a font's images may be image resources
+    ResMap::iterator anItr;
+    for (anItr = mImageMap.begin(); anItr != mImageMap.end(); ++anItr)
+    {
+        ImageRes *aRes = (ImageRes*)anItr->second;
+        if (!theGroup.empty() && aRes->mResGroup != theGroup)
+            continue;
+
+        MemoryEntry anEntry;
+        anEntry.mName = aRes->mId;
+        anEntry.mGroup = aRes->mResGroup;
+        if (theReport.AddImageBuffers(anEntry, aRes->mImage))
+            theReport.Add(anEntry);
+    }
+
+    for (anItr = mFontMap.begin(); anItr != mFontMap.end(); ++anItr)
+    {
+        FontRes *aRes = (FontRes*)anItr->second;
+        if (aRes->mFont == NULL || (!theGroup.empty() && aRes->mResGroup != theGroup))
+            continue;
+
+        MemoryEntry anEntry;
+        anEntry.mName = aRes->mId;
+        anEntry.mGroup = aRes->mResGroup;
+        theReport.AddFontBuffers(anEntry, aRes->mFont);
+        theReport.AddImageBuffers(anEntry, aRes->mImage, MemoryTag_Fonts);
+        theReport.Add(anEntry);
+    }
+
+    for (anItr = mSoundMap.begin(); anItr != mSoundMap.end(); ++anItr)
+    {
+        SoundRes *aRes = (SoundRes*)anItr->second;
+        if (aRes->mSoundId < 0 || mApp->mSoundManager == NULL || (!theGroup.empty() && aRes->mResGroup != theGroup))
+            continue;
+
+        MemoryEntry anEntry;
+        anEntry.mName = aRes->mId;
+        anEntry.mGroup = aRes->mResGroup;
+        anEntry.AddBuffer("samples", MemoryTag_Sounds, mApp->mSoundManager->GetSoundMemSize(aRes->mSoundId));
+        theReport.Add(anEntry);
+    }
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+bool ResourceManager::ReloadImageBits(MemoryImage* theImage)
+{
+    for (ResMap::iterator anItr = mImageMap.begin(); anItr != mImageMap.end(); ++anItr)
+    {
+        ImageRes *aRes = (ImageRes*)anItr->second;
+        if (aRes->mImage != theImage)
+            continue;
+
+        if (aRes->mLoadedBitsChangedCount != theImage->GetBitsChangedCount() || theImage->mBits == NULL)
+            return false;
+
+        bool lookForAlpha = aRes->mAlphaImage.empty() && aRes->mAlphaGridImage.empty() && !aRes->mNoAlpha;
+        ImageLib::Image* aLoadedImage = ImageLib::GetImage(mApp->GetAppResourceFileName(aRes->mPath), lookForAlpha);
+        if (aLoadedImage == NULL)
+            return false;
+
+        bool ok = aLoadedImage->GetWidth() == theImage->GetWidth() && aLoadedImage->GetHeight() == theImage->GetHeight();
+        if (ok)
+        {
+            // The pixels are what they were, so textures and the like stay valid
+            TLOG(mLogFacil, 1, Logger::format("ReloadImageBits: '%s'", aRes->mPath.c_str()));
+            memcpy(theImage->mBits, aLoadedImage->GetBits(), theImage->GetWidth() * theImage->GetHeight() * sizeof(uint32_t));
+        }
+        delete aLoadedImage;
+        return ok;
+    }
+    return false;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 std::string ResourceManager::GetErrorText()
@@ -252,6 +580,8 @@ bool ResourceManager::ParseSoundResource(XMLElement &theElement)
     aRes->mSoundId = -1;
     aRes->mVolume = -1;
     aRes->mPanning = 0;
+    aRes->mPriority = 0;
+    aRes->mMaxInstances = 0;
 
     if (!ParseCommonResource(theElement, aRes, mSoundMap))
     {
@@ -269,6 +599,14 @@ bool ResourceManager::ParseSoundResource(XMLElement &theElement)
     if (anItr != theElement.mAttributes.end())
         sexysscanf(anItr->second.c_str(),_S("%d"),&aRes->mPanning);
 
+    anItr = theElement.mAttributes.find(_S("priority"));
+    if (anItr != theElement.mAttributes.end())
+        sexysscanf(anItr->second.c_str(),_S("%d"),&aRes->mPriority);
+
+    anItr = theElement.mAttributes.find(_S("maxinstances"));
+    if (anItr != theElement.mAttributes.end())
+        sexysscanf(anItr->second.c_str(),_S("%d"),&aRes->mMaxInstances);
+
     return true;
 }
 
@@ -304,12 +642,18 @@ bool ResourceManager::ParseImageResource(XMLElement &theElement)
     aRes->mPalletize = !theElement.attrBoolValue(_S("nopal"), true);
     aRes->mA4R4G4B4 = theElement.attrBoolValue(_S("a4r4g4b4"), false);
     aRes->mDDSurface = theElement.attrBoolValue(_S("ddsurface"), false);
-    aRes->mPurgeBits = theElement.attrBoolValue(_S("nobits"), false) ||
-        (mApp->Is3DAccelerated() && theElement.attrBoolValue(_S("nobits3d"), true)) ||
-        (!mApp->Is3DAccelerated() && theElement.attrBoolValue(_S("nobits2d"), true));
+    // mPurgeBits and the default of mNoAlpha depend on the app, DoLoadImage() sets them
+    aRes->mNoBits = theElement.attrBoolValue(_S("nobits"), false);
+    aRes->mNoBits3D = theElement.attrBoolValue(_S("nobits3d"), true);
+    aRes->mNoBits2D = theElement.attrBoolValue(_S("nobits2d"), true);
+    aRes->mPurgeBits = aRes->mNoBits;
     aRes->mA8R8G8B8 = theElement.attrBoolValue(_S("a8r8g8b8"), false);
+    aRes->mR5G6B5 = theElement.attrBoolValue(_S("r5g6b5"), false);
+    aRes->mA8 = theElement.attrBoolValue(_S("a8"), false);
+    aRes->mDither = theElement.attrBoolValue(_S("dither"), false);
     aRes->mMinimizeSubdivisions = theElement.attrBoolValue(_S("minsubdivide"), false);
-    aRes->mNoAlpha = theElement.attrBoolValue(_S("noalpha"), !gSexyAppBase->mLookForAlpha);
+    aRes->mNoAlpha = theElement.attrBoolValue(_S("noalpha"), false);
+    aRes->mNoAlphaSet = aRes->mNoAlpha == theElement.attrBoolValue(_S("noalpha"), true);
     aRes->mHasAlpha = theElement.attrBoolValue(_S("hasalpha"), true);
 
     XMLParamMap::iterator anItr;
@@ -565,10 +909,21 @@ bool ResourceManager::DoParseResources(XMLParser* parser)
 ///////////////////////////////////////////////////////////////////////////////
 bool ResourceManager::ParseResourcesFile(const std::string& theFilename)
 {
-    mXMLParser = new XMLParser();
     // TODO. We shouldn't prefix with ResourceFolder here.
     // Better to leave that to XMLParser.
     std::string fname = gSexyAppBase->GetAppResourceFileName(theFilename);
+    if (LoadCompiledResources(GetCompiledResourcesFileName(fname), fname))
+        return !mHasFailed;
+
+    return DoParseResourcesFile(fname);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+bool ResourceManager::DoParseResourcesFile(const std::string& fname)
+{
+    delete mXMLParser;
+    mXMLParser = new XMLParser();
     if (!mXMLParser->OpenFile(fname))
         Fail(NULL, "Resource file not found: " + fname);
 
@@ -594,6 +949,428 @@ bool ResourceManager::ParseResourcesFile(const std::string& theFilename)
     return !mHasFailed;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+bool ResourceManager::CompiledManifest::Load(const std::string& thePath)
+{
+    if (!ReadResourcesFile(thePath, mData) || mData.size() < sizeof(CompiledHeader))
+        return false;
+
+    mHeader = (const CompiledHeader*)&mData[0];
+    if (mHeader->mMagic != COMPILED_RES_MAGIC || mHeader->mVersion != COMPILED_RES_VERSION)
+        return false;
+
+    // Counted in 64 bits, so a damaged count can't wrap around
+    uint64_t aSize = sizeof(CompiledHeader) +
+        (uint64_t)mHeader->mNumResources * sizeof(CompiledRes) +
+        (uint64_t)mHeader->mNumAttributes * 2 * sizeof(uint32_t) +
+        (uint64_t)mHeader->mNumInts * sizeof(int32_t) +
+        (uint64_t)mHeader->mNumGroups * sizeof(CompiledGroup) +
+        (uint64_t)mHeader->mNumGroupEntries * sizeof(uint32_t) +
+        (uint64_t)mHeader->mNumStrings * sizeof(uint32_t) +
+        (uint64_t)mHeader->mStringBytes;
+    if (aSize != mData.size() || mHeader->mNumStrings == 0 || mHeader->mStringBytes == 0)
+        return false;
+
+    const char* aPtr = &mData[sizeof(CompiledHeader)];
+    mResources = (const CompiledRes*)aPtr;
+    aPtr += mHeader->mNumResources * sizeof(CompiledRes);
+    mAttributes = (const uint32_t*)aPtr;
+    aPtr += mHeader->mNumAttributes * 2 * sizeof(uint32_t);
+    mInts = (const int32_t*)aPtr;
+    aPtr += mHeader->mNumInts * sizeof(int32_t);
+    mGroups = (const CompiledGroup*)aPtr;
+    aPtr += mHeader->mNumGroups * sizeof(CompiledGroup);
+    mGroupEntries = (const uint32_t*)aPtr;
+    aPtr += mHeader->mNumGroupEntries * sizeof(uint32_t);
+    mStringOffsets = (const uint32_t*)aPtr;
+    aPtr += mHeader->mNumStrings * sizeof(uint32_t);
+    mStrings = aPtr;
+
+    // Check every index once here, the loader trusts them
+    uint32_t aNumStrings = mHeader->mNumStrings;
+    if (mStrings[mHeader->mStringBytes - 1] != 0)
+        return false;
+    for (uint32_t i = 0; i < aNumStrings; i++)
+        if (mStringOffsets[i] >= mHeader->mStringBytes)
+            return false;
+
+    for (uint32_t i = 0; i < mHeader->mNumAttributes * 2; i++)
+        if (mAttributes[i] >= aNumStrings)
+            return false;
+
+    for (uint32_t i = 0; i < mHeader->mNumResources; i++)
+    {
+        const CompiledRes& aRes = mResources[i];
+        if (aRes.mType > ResType_Font ||
+            aRes.mGroup >= aNumStrings || aRes.mId >= aNumStrings || aRes.mPath >= aNumStrings ||
+            aRes.mAlphaImage >= aNumStrings || aRes.mAlphaGridImage >= aNumStrings ||
+            aRes.mImagePath >= aNumStrings || aRes.mTags >= aNumStrings ||
+            (uint64_t)aRes.mFirstAttribute + aRes.mNumAttributes > mHeader->mNumAttributes ||
+            (uint64_t)aRes.mFirstPerFrameDelay + aRes.mNumPerFrameDelays > mHeader->mNumInts ||
+            (uint64_t)aRes.mFirstFrameMap + aRes.mNumFrameMaps > mHeader->mNumInts)
+            return false;
+    }
+
+    for (uint32_t i = 0; i < mHeader->mNumGroups; i++)
+    {
+        const CompiledGroup& aGroup = mGroups[i];
+        if (aGroup.mName >= aNumStrings || (uint64_t)aGroup.mFirstEntry + aGroup.mNumEntries > mHeader->mNumGroupEntries)
+            return false;
+    }
+
+    for (uint32_t i = 0; i < mHeader->mNumGroupEntries; i++)
+        if (mGroupEntries[i] >= mHeader->mNumResources)
+            return false;
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+void ResourceManager::CompiledManifest::GetAttributes(int theIndex, XMLParamMap& theAttributes) const
+{
+    const CompiledRes& aRes = mResources[theIndex];
+    const uint32_t* anAttribute = mAttributes + aRes.mFirstAttribute * 2;
+    for (uint32_t i = 0; i < aRes.mNumAttributes; i++, anAttribute += 2)
+        theAttributes[StringToSexyStringFast(GetString(anAttribute[0]))] = StringToSexyStringFast(GetString(anAttribute[1]));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+void ResourceManager::CompiledManifest::GetInts(uint32_t theFirst, uint32_t theCount, std::vector<int>& theInts) const
+{
+    theInts.assign(mInts + theFirst, mInts + theFirst + theCount);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+bool ResourceManager::LoadCompiledResources(const std::string& theCompiledPath, const std::string& theSourcePath)
+{
+    CompiledManifest* aManifest = new CompiledManifest();
+    if (!aManifest->Load(theCompiledPath))
+    {
+        delete aManifest;
+        return false;
+    }
+
+    // Shipping only the compiled file is fine, but it must match the XML if that's there
+    const CompiledHeader* aHeader = aManifest->mHeader;
+    std::vector<char> aSource;
+    if (ReadResourcesFile(theSourcePath, aSource) &&
+        (aSource.size() != aHeader->mSourceSize || HashResourcesSource(aSource) != aHeader->mSourceHash))
+    {
+        TLOG(mLogFacil, 1, Logger::format("LoadCompiledResources: '%s' is out of date", theCompiledPath.c_str()));
+        delete aManifest;
+        return false;
+    }
+
+    std::vector<BaseRes*> aResources(aHeader->mNumResources, (BaseRes*)NULL);
+    for (uint32_t i = 0; i < aHeader->mNumResources; i++)
+    {
+        const CompiledRes& aCompiled = aManifest->mResources[i];
+        BaseRes* aBaseRes;
+        ResMap* aMap;
+
+        if (aCompiled.mType == ResType_Image)
+        {
+            ImageRes* aRes = new ImageRes(this);
+            aRes->mAlphaImage = aManifest->GetString(aCompiled.mAlphaImage);
+            aRes->mAlphaGridImage = aManifest->GetString(aCompiled.mAlphaGridImage);
+            aRes->mHasAlpha = (aCompiled.mFlags & COMPILED_HAS_ALPHA) != 0;
+            aRes->mNoAlpha = (aCompiled.mFlags & COMPILED_NO_ALPHA) != 0;
+            aRes->mNoAlphaSet = (aCompiled.mFlags & COMPILED_NO_ALPHA_SET) != 0;
+            aRes->mPalletize = (aCompiled.mFlags & COMPILED_PALLETIZE) != 0;
+            aRes->mA4R4G4B4 = (aCompiled.mFlags & COMPILED_A4R4G4B4) != 0;
+            aRes->mA8R8G8B8 = (aCompiled.mFlags & COMPILED_A8R8G8B8) != 0;
+            aRes->mR5G6B5 = (aCompiled.mFlags & COMPILED_R5G6B5) != 0;
+            aRes->mA8 = (aCompiled.mFlags & COMPILED_A8) != 0;
+            aRes->mDither = (aCompiled.mFlags & COMPILED_DITHER) != 0;
+            aRes->mDDSurface = (aCompiled.mFlags & COMPILED_DDSURFACE) != 0;
+            aRes->mNoBits = (aCompiled.mFlags & COMPILED_NO_BITS) != 0;
+            aRes->mNoBits2D = (aCompiled.mFlags & COMPILED_NO_BITS_2D) != 0;
+            aRes->mNoBits3D = (aCompiled.mFlags & COMPILED_NO_BITS_3D) != 0;
+            aRes->mPurgeBits = aRes->mNoBits;
+            aRes->mMinimizeSubdivisions = (aCompiled.mFlags & COMPILED_MIN_SUBDIVIDE) != 0;
+            aRes->mRows = aCompiled.mRows;
+            aRes->mCols = aCompiled.mCols;
+            aRes->mAlphaColor = aCompiled.mAlphaColor;
+            if (aCompiled.mAnimType != AnimType_None)
+            {
+                aRes->mAnimInfo.mAnimType = (AnimType)aCompiled.mAnimType;
+                aRes->mAnimInfo.mFrameDelay = aCompiled.mFrameDelay;
+                aRes->mAnimInfo.mNumCels = aCompiled.mNumCels;
+                aRes->mAnimInfo.mTotalAnimTime = aCompiled.mTotalAnimTime;
+                aManifest->GetInts(aCompiled.mFirstPerFrameDelay, aCompiled.mNumPerFrameDelays, aRes->mAnimInfo.mPerFrameDelay);
+                aManifest->GetInts(aCompiled.mFirstFrameMap, aCompiled.mNumFrameMaps, aRes->mAnimInfo.mFrameMap);
+            }
+            aBaseRes = aRes;
+            aMap = &mImageMap;
+        }
+        else if (aCompiled.mType == ResType_Sound)
+        {
+            SoundRes* aRes = new SoundRes(this);
+            aRes->mSoundId = -1;
+            aRes->mVolume = aCompiled.mVolume;
+            aRes->mPanning = aCompiled.mPanning;
+            aRes->mPriority = aCompiled.mPriority;
+            aRes->mMaxInstances = aCompiled.mMaxInstances;
+            aBaseRes = aRes;
+            aMap = &mSoundMap;
+        }
+        else
+        {
+            FontRes* aRes = new FontRes(this);
+            aRes->mImagePath = aManifest->GetString(aCompiled.mImagePath);
+            aRes->mTags = aManifest->GetString(aCompiled.mTags);
+            aRes->mSysFont = (aCompiled.mFlags & COMPILED_SYSFONT) != 0;
+            aRes->mBold = (aCompiled.mFlags & COMPILED_BOLD) != 0;
+            aRes->mItalic = (aCompiled.mFlags & COMPILED_ITALIC) != 0;
+            aRes->mUnderline = (aCompiled.mFlags & COMPILED_UNDERLINE) != 0;
+            aRes->mShadow = (aCompiled.mFlags & COMPILED_SHADOW) != 0;
+            aRes->mSize = aCompiled.mSize;
+            aBaseRes = aRes;
+            aMap = &mFontMap;
+        }
+
+        aBaseRes->mResGroup = aManifest->GetString(aCompiled.mGroup);
+        aBaseRes->mId = aManifest->GetString(aCompiled.mId);
+        aBaseRes->mPath = aManifest->GetString(aCompiled.mPath);
+        aBaseRes->mFromProgram = (aCompiled.mFlags & COMPILED_FROM_PROGRAM) != 0;
+        aBaseRes->mManifest = aManifest;
+        aBaseRes->mManifestIndex = i;
+
+        // Do not add duplicates <id>/<group>
+        if (HasEntryResMap(*aMap, aBaseRes->mId, aBaseRes->mResGroup))
+        {
+            delete aBaseRes;
+            continue;
+        }
+
+        aMap->insert(ResMap::value_type(aBaseRes->mId, aBaseRes));
+        aResources[i] = aBaseRes;
+    }
+
+    for (uint32_t i = 0; i < aHeader->mNumGroups; i++)
+    {
+        const CompiledGroup& aGroup = aManifest->mGroups[i];
+        ResList& aList = mResGroupMap[aManifest->GetString(aGroup.mName)];
+        for (uint32_t j = 0; j < aGroup.mNumEntries; j++)
+        {
+            BaseRes* aRes = aResources[aManifest->mGroupEntries[aGroup.mFirstEntry + j]];
+            if (aRes != NULL)
+                aList.push_back(aRes);
+        }
+    }
+
+    mCompiledManifests.push_back(aManifest);
+    TLOG(mLogFacil, 1, Logger::format("LoadCompiledResources: %d resources from '%s'", aHeader->mNumResources, theCompiledPath.c_str()));
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+namespace
+{
+
+// Interned strings of a compiled resources file.
+class CompiledStrings
+{
+public:
+    CompiledStrings() { Add(""); }
+
+    uint32_t Add(const std::string& theString)
+    {
+        std::map<std::string, uint32_t>::iterator anItr = mIndex.find(theString);
+        if (anItr != mIndex.end())
+            return anItr->second;
+
+        uint32_t anIndex = mOffsets.size();
+        mIndex[theString] = anIndex;
+        mOffsets.push_back(mBytes.size());
+        mBytes.append(theString.c_str(), theString.size() + 1);
+        return anIndex;
+    }
+
+    std::map<std::string, uint32_t> mIndex;
+    std::vector<uint32_t>           mOffsets;
+    std::string                     mBytes;
+};
+
+template <class T>
+bool WriteSection(FILE* theFile, const std::vector<T>& theSection)
+{
+    return theSection.empty() || fwrite(&theSection[0], sizeof(T), theSection.size(), theFile) == theSection.size();
+}
+
+}
+
+bool ResourceManager::WriteCompiledResources(const std::string& theCompiledPath, const std::vector<char>& theSource)
+{
+    CompiledStrings aStrings;
+    std::vector<CompiledRes> aResources;
+    std::vector<uint32_t> anAttributes;
+    std::vector<int32_t> anInts;
+    std::vector<CompiledGroup> aGroups;
+    std::vector<uint32_t> aGroupEntries;
+    std::map<const BaseRes*, uint32_t> aResIndex;
+
+    // Kept in map order, resources with the same id are found in the same order after loading
+    ResMap* aMaps[] = { &mImageMap, &mSoundMap, &mFontMap };
+    for (int aMapIdx = 0; aMapIdx < 3; aMapIdx++)
+    {
+        for (ResMap::iterator anItr = aMaps[aMapIdx]->begin(); anItr != aMaps[aMapIdx]->end(); ++anItr)
+        {
+            BaseRes* aBaseRes = anItr->second;
+            if (aBaseRes->mManifest != NULL && aBaseRes->mXMLAttributes.empty())
+                aBaseRes->mManifest->GetAttributes(aBaseRes->mManifestIndex, aBaseRes->mXMLAttributes);
+
+            CompiledRes aCompiled;
+            memset(&aCompiled, 0, sizeof(aCompiled));
+            aCompiled.mType = aBaseRes->mType;
+            aCompiled.mFlags = aBaseRes->mFromProgram ? COMPILED_FROM_PROGRAM : 0;
+            aCompiled.mGroup = aStrings.Add(aBaseRes->mResGroup);
+            aCompiled.mId = aStrings.Add(aBaseRes->mId);
+            aCompiled.mPath = aStrings.Add(aBaseRes->mPath);
+
+            aCompiled.mFirstAttribute = anAttributes.size() / 2;
+            aCompiled.mNumAttributes = aBaseRes->mXMLAttributes.size();
+            for (XMLParamMap::iterator anAttrItr = aBaseRes->mXMLAttributes.begin(); anAttrItr != aBaseRes->mXMLAttributes.end(); ++anAttrItr)
+            {
+                anAttributes.push_back(aStrings.Add(SexyStringToStringFast(anAttrItr->first)));
+                anAttributes.push_back(aStrings.Add(SexyStringToStringFast(anAttrItr->second)));
+            }
+
+            if (aBaseRes->mType == ResType_Image)
+            {
+                ImageRes* aRes = (ImageRes*)aBaseRes;
+                if (aRes->mHasAlpha) aCompiled.mFlags |= COMPILED_HAS_ALPHA;
+                if (aRes->mNoAlpha) aCompiled.mFlags |= COMPILED_NO_ALPHA;
+                if (aRes->mNoAlphaSet) aCompiled.mFlags |= COMPILED_NO_ALPHA_SET;
+                if (aRes->mPalletize) aCompiled.mFlags |= COMPILED_PALLETIZE;
+                if (aRes->mA4R4G4B4) aCompiled.mFlags |= COMPILED_A4R4G4B4;
+                if (aRes->mA8R8G8B8) aCompiled.mFlags |= COMPILED_A8R8G8B8;
+                if (aRes->mR5G6B5) aCompiled.mFlags |= COMPILED_R5G6B5;
+                if (aRes->mA8) aCompiled.mFlags |= COMPILED_A8;
+                if (aRes->mDither) aCompiled.mFlags |= COMPILED_DITHER;
+                if (aRes->mDDSurface) aCompiled.mFlags |= COMPILED_DDSURFACE;
+                if (aRes->mNoBits) aCompiled.mFlags |= COMPILED_NO_BITS;
+                if (aRes->mNoBits2D) aCompiled.mFlags |= COMPILED_NO_BITS_2D;
+                if (aRes->mNoBits3D) aCompiled.mFlags |= COMPILED_NO_BITS_3D;
+                if (aRes->mMinimizeSubdivisions) aCompiled.mFlags |= COMPILED_MIN_SUBDIVIDE;
+
+                aCompiled.mAlphaImage = aStrings.Add(aRes->mAlphaImage);
+                aCompiled.mAlphaGridImage = aStrings.Add(aRes->mAlphaGridImage);
+                aCompiled.mAlphaColor = aRes->mAlphaColor;
+                aCompiled.mRows = aRes->mRows;
+                aCompiled.mCols = aRes->mCols;
+
+                // Only animations went through AnimInfo::Compute()
+                const AnimInfo& anAnimInfo = aRes->mAnimInfo;
+                aCompiled.mAnimType = anAnimInfo.mAnimType;
+                if (anAnimInfo.mAnimType != AnimType_None)
+                {
+                    aCompiled.mFrameDelay = anAnimInfo.mFrameDelay;
+                    aCompiled.mNumCels = anAnimInfo.mNumCels;
+                    aCompiled.mTotalAnimTime = anAnimInfo.mTotalAnimTime;
+                    aCompiled.mFirstPerFrameDelay = anInts.size();
+                    aCompiled.mNumPerFrameDelays = anAnimInfo.mPerFrameDelay.size();
+                    anInts.insert(anInts.end(), anAnimInfo.mPerFrameDelay.begin(), anAnimInfo.mPerFrameDelay.end());
+                    aCompiled.mFirstFrameMap = anInts.size();
+                    aCompiled.mNumFrameMaps = anAnimInfo.mFrameMap.size();
+                    anInts.insert(anInts.end(), anAnimInfo.mFrameMap.begin(), anAnimInfo.mFrameMap.end());
+                }
+            }
+            else if (aBaseRes->mType == ResType_Sound)
+            {
+                SoundRes* aRes = (SoundRes*)aBaseRes;
+                aCompiled.mVolume = aRes->mVolume;
+                aCompiled.mPanning = aRes->mPanning;
+                aCompiled.mPriority = aRes->mPriority;
+                aCompiled.mMaxInstances = aRes->mMaxInstances;
+            }
+            else
+            {
+                FontRes* aRes = (FontRes*)aBaseRes;
+                aCompiled.mImagePath = aStrings.Add(aRes->mImagePath);
+                aCompiled.mTags = aStrings.Add(aRes->mTags);
+                if (aRes->mSysFont)
+                {
+                    aCompiled.mFlags |= COMPILED_SYSFONT;
+                    if (aRes->mBold) aCompiled.mFlags |= COMPILED_BOLD;
+                    if (aRes->mItalic) aCompiled.mFlags |= COMPILED_ITALIC;
+                    if (aRes->mUnderline) aCompiled.mFlags |= COMPILED_UNDERLINE;
+                    if (aRes->mShadow) aCompiled.mFlags |= COMPILED_SHADOW;
+                    aCompiled.mSize = aRes->mSize;
+                }
+            }
+
+            aResIndex[aBaseRes] = aResources.size();
+            aResources.push_back(aCompiled);
+        }
+    }
+
+    for (ResGroupMap::iterator anItr = mResGroupMap.begin(); anItr != mResGroupMap.end(); ++anItr)
+    {
+        if (anItr->second.empty())
+            continue;
+
+        CompiledGroup aGroup;
+        aGroup.mName = aStrings.Add(anItr->first);
+        aGroup.mFirstEntry = aGroupEntries.size();
+        for (ResList::iterator aResItr = anItr->second.begin(); aResItr != anItr->second.end(); ++aResItr)
+            aGroupEntries.push_back(aResIndex[*aResItr]);
+        aGroup.mNumEntries = aGroupEntries.size() - aGroup.mFirstEntry;
+        aGroups.push_back(aGroup);
+    }
+
+    CompiledHeader aHeader;
+    memset(&aHeader, 0, sizeof(aHeader));
+    aHeader.mMagic = COMPILED_RES_MAGIC;
+    aHeader.mVersion = COMPILED_RES_VERSION;
+    aHeader.mSourceSize = theSource.size();
+    aHeader.mSourceHash = HashResourcesSource(theSource);
+    aHeader.mNumResources = aResources.size();
+    aHeader.mNumAttributes = anAttributes.size() / 2;
+    aHeader.mNumInts = anInts.size();
+    aHeader.mNumGroups = aGroups.size();
+    aHeader.mNumGroupEntries = aGroupEntries.size();
+    aHeader.mNumStrings = aStrings.mOffsets.size();
+    aHeader.mStringBytes = aStrings.mBytes.size();
+
+    FILE* aFile = fopen(theCompiledPath.c_str(), "wb");
+    if (aFile == NULL)
+        return Fail(NULL, "Can't write compiled resources file: " + theCompiledPath);
+
+    bool aSuccess = fwrite(&aHeader, sizeof(aHeader), 1, aFile) == 1 &&
+        WriteSection(aFile, aResources) &&
+        WriteSection(aFile, anAttributes) &&
+        WriteSection(aFile, anInts) &&
+        WriteSection(aFile, aGroups) &&
+        WriteSection(aFile, aGroupEntries) &&
+        WriteSection(aFile, aStrings.mOffsets) &&
+        fwrite(aStrings.mBytes.data(), 1, aStrings.mBytes.size(), aFile) == aStrings.mBytes.size();
+
+    if (fclose(aFile) != 0 || !aSuccess)
+        return Fail(NULL, "Can't write compiled resources file: " + theCompiledPath);
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+bool ResourceManager::CompileResourcesFile(const std::string& thePath, const std::string& theCompiledPath)
+{
+    std::vector<char> aSource;
+    if (!ReadResourcesFile(thePath, aSource))
+        return Fail(NULL, "Resource file not found: " + thePath);
+
+    if (!DoParseResourcesFile(thePath))
+        return false;
+
+    return WriteCompiledResources(theCompiledPath, aSource);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 bool ResourceManager::ReparseResourcesFile(const std::string& theFilename)
@@ -691,6 +1468,10 @@ bool ResourceManager::LoadAlphaImage(ImageRes *theRes, DDImage *theImage)
 ///////////////////////////////////////////////////////////////////////////////
 bool ResourceManager::DoLoadImage(ImageRes *theRes)
 {
+    theRes->mPurgeBits = theRes->mNoBits || (mApp->Is3DAccelerated() ? theRes->mNoBits3D : theRes->mNoBits2D);
+    if (!theRes->mNoAlphaSet)
+        theRes->mNoAlpha = !gSexyAppBase->mLookForAlpha;
+
     bool lookForAlpha = theRes->mAlphaImage.empty() && theRes->mAlphaGridImage.empty() && !theRes->mNoAlpha;
     MemoryImage* anImage = dynamic_cast<MemoryImage*>(mApp->GetImage(theRes->mPath, false, lookForAlpha));
     assert(anImage != NULL);
@@ -718,6 +1499,22 @@ bool ResourceManager::DoLoadImage(ImageRes *theRes)
 
     anImage->SetHasAlpha(theRes->mHasAlpha);
 
+    uint32_t aD3DFlags = 0;
+    if (theRes->mA4R4G4B4)
+        aD3DFlags |= D3DImageFlag_UseA4R4G4B4;
+    if (theRes->mA8R8G8B8)
+        aD3DFlags |= D3DImageFlag_UseA8R8G8B8;
+    if (theRes->mR5G6B5)
+        aD3DFlags |= D3DImageFlag_UseR5G6B5;
+    if (theRes->mA8)
+        aD3DFlags |= D3DImageFlag_UseA8;
+    if (theRes->mDither)
+        aD3DFlags |= D3DImageFlag_Dither;
+    anImage->SetD3DFlags(aD3DFlags);
+
+    theRes->mLoadedBitsChangedCount = anImage->GetBitsChangedCount();
+    anImage->SetReloadable(true);
+
     ResourceLoadedHook(theRes);
     return true;
 }
@@ -763,12 +1560,15 @@ bool ResourceManager::DoLoadSound(SoundRes* theRes)
 #if 0
     SEXY_PERF_BEGIN("ResourceManager:LoadSound");
 #endif
-    int aSoundId = mApp->mSoundManager->GetFreeSoundId();
-    if (aSoundId<0)
-        return Fail("Out of free sound ids");
-
-    if(!mApp->mSoundManager->LoadSound(aSoundId, aRes->mPath))
+    // The sound is decoded in the background, SoundLoadedStub finishes up.
+    // The sound manager picks the id and takes it in one go, so another
+    // loading thread can't get the same one.
+    if(!mApp->mSoundManager->LoadSoundAsync(aRes->mPath, &aRes->mSoundId, SoundLoadedStub, aRes))
+    {
+        aRes->mSoundId = -1;
         return Fail(StrFormat("Failed to load sound: %s", aRes->mPath.c_str()));
+    }
+    int aSoundId = aRes->mSoundId;
 #if 0
     SEXY_PERF_END("ResourceManager:LoadSound");
 #endif
@@ -779,12 +1579,27 @@ bool ResourceManager::DoLoadSound(SoundRes* theRes)
     if (aRes->mPanning != 0)
         mApp->mSoundManager->SetBasePan(aSoundId, aRes->mPanning);
 
-    aRes->mSoundId = aSoundId;
+    mApp->mSoundManager->SetPriority(aSoundId, aRes->mPriority);
+    mApp->mSoundManager->SetMaxInstances(aSoundId, aRes->mMaxInstances);
 
-    ResourceLoadedHook(theRes);
     return true;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+void ResourceManager::SoundLoadedStub(void* theArg, unsigned int theSfxID, bool theSuccess)
+{
+    SoundRes* aRes = (SoundRes*) theArg;
+    if (!theSuccess)
+    {
+        aRes->mSoundId = -1;
+        aRes->mParent->Fail(StrFormat("Failed to load sound: %s", aRes->mPath.c_str()));
+        return;
+    }
+
+    aRes->mParent->ResourceLoadedHook(aRes);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 bool ResourceManager::DoLoadFont(FontRes* theRes)
@@ -902,6 +1717,9 @@ void ResourceManager::DeleteFont(const std::string &theName)
 
 bool ResourceManager::LoadNextResource()
 {
+    if (mApp && mApp->mSoundManager)
+        mApp->mSoundManager->FinishLoads(false);
+
     if (HadError())
         return false;
 
@@ -966,6 +1784,10 @@ bool ResourceManager::LoadNextResource()
         }
     }
 
+    // The group isn't loaded until its sounds are
+    if (!done_one && mApp && mApp->mSoundManager)
+        mApp->mSoundManager->FinishLoads(true);
+
 #ifdef DEBUG
     timer->stop();
     TLOG(mLogFacil, 1, Logger::format("LoadNextResource - done in %8.3f", timer->getElapsedTimeInSec() - start_time));
@@ -1265,7 +2087,7 @@ bool ResourceManager::ReplaceImage(const std::string &theId, Image *theImage)
     if (anItr != mImageMap.end())
     {
         anItr->second->DeleteResource();
-        ((ImageRes*)anItr->second)->mImage = dynamic_cast<MemoryImage*>(theImage);
+        ((ImageRes*)anItr->second)->mImage = dynamic_cast<MemoryImage*>(theImage);    // Not ours to reload
         return true;
     }
     else
@@ -1310,9 +2132,13 @@ const XMLParamMap& ResourceManager::GetImageAttributes(const std::string &theId)
     static XMLParamMap aStrMap;
 
     ResMap::iterator anItr = mImageMap.find(theId);
-    if (anItr != mImageMap.end())
-        return anItr->second->mXMLAttributes;
-    else
+    if (anItr == mImageMap.end())
         return aStrMap;
+
+    BaseRes *aRes = anItr->second;
+    if (aRes->mManifest != NULL && aRes->mXMLAttributes.empty())
+        aRes->mManifest->GetAttributes(aRes->mManifestIndex, aRes->mXMLAttributes);
+
+    return aRes->mXMLAttributes;
 }
 
@@ -19,9 +19,11 @@ namespace Sexy
 class XMLParser;
 class XMLElement;
 class Image;
+class MemoryImage;
 class SoundInstance;
 class SexyAppBase;
 class Font;
+class MemoryReport;
 
 typedef std::map<std::string, std::string>  StringToStringMap;
 typedef std::map<SexyString, SexyString>    XMLParamMap;
@@ -38,6 +40,8 @@ protected:
         ResType_Font
     };
 
+    struct CompiledManifest;
+
 
     struct BaseRes
     {
@@ -48,8 +52,10 @@ protected:
         XMLParamMap mXMLAttributes;
         bool mFromProgram;
         ResourceManager * mParent;          // For debugging
+        const CompiledManifest * mManifest; // Holds mXMLAttributes until they're asked for
+        int mManifestIndex;
 
-        BaseRes(ResType t, ResourceManager * resman) : mType(t), mParent(resman) {}
+        BaseRes(ResType t, ResourceManager * resman) : mType(t), mParent(resman), mManifest(NULL), mManifestIndex(-1) {}
         virtual ~BaseRes() {}
         virtual void DeleteResource() { }
     };
@@ -64,15 +70,26 @@ protected:
         bool mPalletize;
         bool mA4R4G4B4;
         bool mA8R8G8B8;
+        bool mR5G6B5;
+        bool mA8;
+        bool mDither;
         bool mDDSurface;
         bool mPurgeBits;
+        bool mNoBits;
+        bool mNoBits2D;
+        bool mNoBits3D;
+        bool mNoAlphaSet;
         bool mMinimizeSubdivisions;
         int mRows;
         int mCols;
         uint32_t mAlphaColor;
         AnimInfo mAnimInfo;
 
-        ImageRes(ResourceManager * resman) : BaseRes(ResType_Image, resman) { mImage = NULL; }
+        // For the image memory budget
+        int mLastDrawnFrame;
+        int mLoadedBitsChangedCount;    // -1 unless mImage still holds what was loaded from mPath
+
+        ImageRes(ResourceManager * resman) : BaseRes(ResType_Image, resman) { mImage = NULL; mLastDrawnFrame = 0; mLoadedBitsChangedCount = -1; }
         virtual void DeleteResource();
     };
 
@@ -81,6 +98,8 @@ protected:
         int mSoundId;
         double mVolume;
         int mPanning;
+        int mPriority;
+        int mMaxInstances;
 
         SoundRes(ResourceManager * resman) : BaseRes(ResType_Sound, resman) {}
         virtual void DeleteResource();
@@ -131,6 +150,14 @@ protected:
 
     LoggerFacil *           mLogFacil;
 
+    std::list<CompiledManifest*> mCompiledManifests;
+
+    size_t                  mImageCPUBudget;
+    size_t                  mImageTextureBudget;
+    size_t                  mImageCPUUsage;
+    size_t                  mImageTextureUsage;
+    int                     mImageFrame;
+
     bool                    Fail(const std::string& theErrorText);
     bool                    Fail(XMLParser * parser, const std::string& theErrorText);
 
@@ -140,6 +167,10 @@ protected:
     virtual bool            ParseFontResource(XMLElement &theElement);
     virtual bool            ParseSetDefaults(XMLElement &theElement);
     virtual bool            ParseResources(XMLParser* parser);
+    bool                    DoParseResourcesFile(const std::string& thePath);
+
+    bool                    LoadCompiledResources(const std::string& theCompiledPath, const std::string& theSourcePath);
+    bool                    WriteCompiledResources(const std::string& theCompiledPath, const std::vector<char>& theSource);
 
     void                    DeleteMap(ResMap &theMap);
     virtual void            DeleteResources(ResMap &theMap, const std::string &theGroup);
@@ -149,6 +180,7 @@ protected:
     virtual bool            DoLoadImage(ImageRes *theRes);
     virtual bool            DoLoadFont(FontRes* theRes);
     virtual bool            DoLoadSound(SoundRes* theRes);
+    static void             SoundLoadedStub(void* theArg, unsigned int theSfxID, bool theSuccess);
 
     int                     GetNumResources(const std::string &theGroup, ResMap &theMap);
 
@@ -166,6 +198,11 @@ public:
     bool                    ReparseResourcesFile(const std::string& theFilename);
     bool                    DoParseResources(XMLParser* parser);
 
+    // Writes the binary form of a resources file that ParseResourcesFile() picks up
+    // instead of the XML as long as the XML doesn't change. See tuxres.
+    bool                    CompileResourcesFile(const std::string& thePath, const std::string& theCompiledPath);
+    static std::string      GetCompiledResourcesFileName(const std::string& thePath) { return thePath + ".bin"; }
+
     std::string             GetErrorText();
     bool                    HadError();
     bool                    IsGroupLoaded(const std::string &theGroup);
@@ -218,6 +255,18 @@ public:
     virtual void            DeleteResources(const std::string &theGroup);
     void                    DeleteExtraImageBuffers(const std::string &theGroup);
 
+    // Keeps the memory used by loaded images within a budget, 0 means no
+    // limit. Over budget, UpdateImageMemory() drops the CPU copies or
+    // textures of the least recently drawn images. Their pixels are read
+    // from the image file again when they are needed.
+    void                    SetImageMemoryBudget(size_t theCPUBytes, size_t theTextureBytes);
+    void                    GetImageMemoryUsage(size_t* theCPUBytes, size_t* theTextureBytes);
+    virtual void            UpdateImageMemory();    // SexyAppBase calls it after every draw
+    bool                    ReloadImageBits(MemoryImage* theImage);
+    // Adds the loaded images, fonts and sounds of theGroup, or of all groups,
+    // to theReport. False while the loading thread runs.
+    bool                    GetMemoryUsage(MemoryReport& theReport, const std::string& theGroup = "");
+
     const ResList*          GetCurResGroupList()    {return mCurResGroupList;}
     std::string             GetCurResGroup()        {return mCurResGroup;}
     void                    DumpCurResGroup(std::string& theDestStr);
@@ -39,7 +39,19 @@ SDLMixerMusicInfo::SDLMixerMusicInfo()
     mRepeats = false;
     mPosition = 0;
     mIsActive = false;
-    mBuffer = NULL;
+    mRW = NULL;
+    mData = NULL;
+}
+
+SDLMixerPreparedMusic::SDLMixerPreparedMusic()
+{
+    mData = NULL;
+    mSize = 0;
+}
+
+SDLMixerPreparedMusic::~SDLMixerPreparedMusic()
+{
+    delete[] mData;
 }
 
 SDLMixerMusicInterface::SDLMixerMusicInterface(HWND theHWnd)
@@ -63,11 +75,14 @@ SDLMixerMusicInterface::~SDLMixerMusicInterface()
             aMusicInfo->music = NULL;
         }
 
-        if (aMusicInfo->mBuffer != NULL) {
-            delete[] aMusicInfo->mBuffer;
-            aMusicInfo->mBuffer = NULL;
+        if (aMusicInfo->mRW != NULL) {
+            SDL_RWclose(aMusicInfo->mRW);
+            aMusicInfo->mRW = NULL;
         }
 
+        delete[] aMusicInfo->mData;
+        aMusicInfo->mData = NULL;
+
         ++anItr;
     }
 
@@ -82,8 +97,9 @@ bool SDLMixerMusicInterface::LoadMusic(int theSongId, const string& theFileName)
 {
     SDLMixerMusicInfo aMusicInfo;
 
-    // If the resources are in a PAK file then we need to read in the
-    // whole music file at once and then use SDL_RWFromMem() plus Mix_LoadMUS_RW
+    // If the resources are in a PAK file then we stream the music out of
+    // the pak with p_rwopen() plus Mix_LoadMUS_RW. The SDL_RWops is kept
+    // open for as long as the music is loaded.
 
     // Otherwise we use Mix_LoadMUS
 
@@ -109,32 +125,31 @@ bool SDLMixerMusicInterface::LoadMusic(int theSongId, const string& theFileName)
     };
     if (pak) {
 
-        PFILE* file = NULL;
+        SDL_RWops* rw = NULL;
         if (aLastDotPos > aLastSlashPos) {
             // The filename has an extension
-            file = p_fopen(myFileName.c_str(), "r");
+            rw = p_rwopen(myFileName.c_str());
         }
         else {
             // Try to append a bunch of extensions.
             // TODO. Perhaps remove the extension first?
             // TODO. On Linux try upper case too.
-            for (size_t i = 0; file == NULL && i < (sizeof(try_exts)/sizeof(try_exts[0])); i++) {
-                file = p_fopen((myFileName + try_exts[i]).c_str(), "r");
+            for (size_t i = 0; rw == NULL && i < (sizeof(try_exts)/sizeof(try_exts[0])); i++) {
+                rw = p_rwopen((myFileName + try_exts[i]).c_str());
             }
         }
-        if (file == NULL)
+        if (rw == NULL)
             return false;
 
-        int size = GetPakPtr()->FSize(file);
-        aMusicInfo.mBuffer = new Uint8[size];
-        int res = p_fread((void*) aMusicInfo.mBuffer, sizeof (Uint8), size * sizeof (Uint8), file);
-        if (size != res)
-            // TODO. Throw exception
-            return false;
-
-        SDL_RWops* rw = SDL_RWFromMem(aMusicInfo.mBuffer, size);
+#if SDL_MIXER_MAJOR_VERSION >= 2
+        m = Mix_LoadMUS_RW(rw, 0);
+#else
         m = Mix_LoadMUS_RW(rw);
-        p_fclose(file);
+#endif
+        if (m == NULL)
+            SDL_RWclose(rw);
+        else
+            aMusicInfo.mRW = rw;
     } else {
         if (aLastDotPos > aLastSlashPos) {
             // The filename has an extension
@@ -155,6 +170,89 @@ bool SDLMixerMusicInterface::LoadMusic(int theSongId, const string& theFileName)
     return true;
 }
 
+// Only reads the file, SDL_mixer is left to the main thread
+PreparedMusic* SDLMixerMusicInterface::PrepareMusic(const string& theFileName)
+{
+    string myFileName;
+    if (GetPakPtr()->isLoaded())
+        myFileName = ReplaceBackSlashes(theFileName);
+    else
+        myFileName = gSexyAppBase->GetAppResourceFileName(theFileName);
+
+    int aLastDotPos = myFileName.rfind('.');
+    int aLastSlashPos = myFileName.rfind('/');
+    string try_exts[] = {
+        ".ogg",
+        ".mp3",
+        ".mid",
+        ".mod",
+    };
+    PFILE* aFile = NULL;
+    if (aLastDotPos > aLastSlashPos) {
+        // The filename has an extension
+        aFile = p_fopen(myFileName.c_str(), "rb");
+    } else {
+        // There is no filename extension. Try a couple
+        for (size_t i = 0; aFile == NULL && i < (sizeof(try_exts)/sizeof(try_exts[0])); i++) {
+            aFile = p_fopen((myFileName + try_exts[i]).c_str(), "rb");
+        }
+    }
+    if (aFile == NULL)
+        return NULL;
+
+    SDLMixerPreparedMusic* aPrepared = new SDLMixerPreparedMusic();
+    aPrepared->mFileName = theFileName;
+    aPrepared->mSize = p_size(aFile);
+    if (aPrepared->mSize > 0) {
+        aPrepared->mData = new Uint8[aPrepared->mSize];
+        if (p_fread(aPrepared->mData, 1, aPrepared->mSize, aFile) != (size_t) aPrepared->mSize)
+            aPrepared->mSize = 0;
+    }
+    p_fclose(aFile);
+
+    if (aPrepared->mSize <= 0) {
+        delete aPrepared;
+        return NULL;
+    }
+    return aPrepared;
+}
+
+bool SDLMixerMusicInterface::LoadPreparedMusic(int theSongId, PreparedMusic* thePrepared)
+{
+    UnloadMusic(theSongId);
+
+    SDLMixerPreparedMusic* aPrepared = static_cast<SDLMixerPreparedMusic*>(thePrepared);
+    if (aPrepared == NULL)
+        return false;
+
+    SDL_RWops* rw = SDL_RWFromConstMem(aPrepared->mData, aPrepared->mSize);
+    Mix_Music* m = NULL;
+    if (rw != NULL) {
+#if SDL_MIXER_MAJOR_VERSION >= 2
+        m = Mix_LoadMUS_RW(rw, 0);
+#else
+        m = Mix_LoadMUS_RW(rw);
+#endif
+    }
+    if (m == NULL) {
+        if (rw != NULL)
+            SDL_RWclose(rw);
+        delete aPrepared;
+        return false;
+    }
+
+    // The music streams from the data, so the info keeps it
+    SDLMixerMusicInfo aMusicInfo;
+    aMusicInfo.music = m;
+    aMusicInfo.mRW = rw;
+    aMusicInfo.mData = aPrepared->mData;
+    aPrepared->mData = NULL;
+    delete aPrepared;
+
+    mMusicMap.insert(SDLMixerMusicMap::value_type(theSongId, aMusicInfo));
+    return true;
+}
+
 void SDLMixerMusicInterface::UnloadMusic(int theSongId)
 {
     SDLMixerMusicMap::iterator anItr = mMusicMap.find(theSongId);
@@ -165,11 +263,14 @@ void SDLMixerMusicInterface::UnloadMusic(int theSongId)
             aMusicInfo->music = NULL;
         }
 
-        if (aMusicInfo->mBuffer != NULL) {
-            delete[] aMusicInfo->mBuffer;
-            aMusicInfo->mBuffer = NULL;
+        if (aMusicInfo->mRW != NULL) {
+            SDL_RWclose(aMusicInfo->mRW);
+            aMusicInfo->mRW = NULL;
         }
 
+        delete[] aMusicInfo->mData;
+        aMusicInfo->mData = NULL;
+
         mMusicMap.erase(anItr);
     }
 }
@@ -184,11 +285,14 @@ void SDLMixerMusicInterface::UnloadAllMusic()
             aMusicInfo->music = NULL;
         }
 
-        if (aMusicInfo->mBuffer != NULL) {
-            delete[] aMusicInfo->mBuffer;
-            aMusicInfo->mBuffer = NULL;
+        if (aMusicInfo->mRW != NULL) {
+            SDL_RWclose(aMusicInfo->mRW);
+            aMusicInfo->mRW = NULL;
         }
 
+        delete[] aMusicInfo->mData;
+        aMusicInfo->mData = NULL;
+
         ++anItr;
     }
     mMusicMap.clear();
@@ -43,7 +43,8 @@ public:
     bool                    mRepeats;
     int                     mPosition;
     bool                    mIsActive;
-    Uint8*                  mBuffer; //needed because ogg and mp3 are streamed from buffer and not read in at once
+    SDL_RWops*              mRW; //needed because ogg and mp3 are streamed from the pak and not read in at once
+    Uint8*                  mData; // what mRW reads from, for songs loaded by LoadPreparedMusic
 
 public:
     SDLMixerMusicInfo();
@@ -51,6 +52,17 @@ public:
 
 typedef std::map<int, SDLMixerMusicInfo> SDLMixerMusicMap;
 
+// The song's file read into memory, SDL_mixer streams it from there
+class SDLMixerPreparedMusic : public PreparedMusic {
+public:
+    Uint8*                  mData;
+    int                     mSize;
+
+public:
+    SDLMixerPreparedMusic();
+    virtual ~SDLMixerPreparedMusic();
+};
+
 class SDLMixerMusicInterface : public MusicInterface {
 public:
     SDLMixerMusicMap        mMusicMap;
@@ -62,6 +74,8 @@ public:
     virtual ~SDLMixerMusicInterface();
 
     virtual bool            LoadMusic(int theSongId, const std::string& theFileName);
+    virtual PreparedMusic*  PrepareMusic(const std::string& theFileName);
+    virtual bool            LoadPreparedMusic(int theSongId, PreparedMusic* thePrepared);
 
     virtual void            PlayMusic(int theSongId, int theOffset = 0, bool noLoop = false);
     virtual void            StopMusic(int theSongId);
@@ -25,17 +25,24 @@
 
 using namespace Sexy;
 
-SDLMixerSoundInstance::SDLMixerSoundInstance(SDLMixerSoundManager* theSoundManager, int channel, Mix_Chunk* theSourceSound)
+SDLMixerSoundInstance::SDLMixerSoundInstance(SDLMixerSoundManager* theSoundManager, int channel, Mix_Chunk* theSourceSound, unsigned int theSfxID)
 {
     mSDLMixerSoundManagerP = theSoundManager;
+    Reset(channel, theSourceSound, theSfxID);
+}
 
+// Instances are pooled by the sound manager, this readies one for a new sound
+void SDLMixerSoundInstance::Reset(int theChannel, Mix_Chunk* theSourceSound, unsigned int theSfxID)
+{
     if (mSDLMixerSoundManagerP) {
         mSample = theSourceSound;
-        mChannel = channel;
+        mChannel = theChannel;
     } else {
         mSample = NULL;
         mChannel = -1;
     }
+    mSfxID = theSfxID;
+    mPlayOrder = 0;
 
     mReleased = false;
     mAutoRelease = false;
@@ -43,13 +50,12 @@ SDLMixerSoundInstance::SDLMixerSoundInstance(SDLMixerSoundManager* theSoundManag
 
     mBaseVolume = 1.0;
     mBasePan = 0.0;
+    mBasePitch = 1.0;
 
     mVolume = 1.0;
     mPan = 0.0;
     mPitch = 1.0;
 
-    mHasPlayed = false;
-
     RehupVolume();
 }
 
@@ -92,10 +98,16 @@ void SDLMixerSoundInstance::RehupPitch()
 }
 
 void SDLMixerSoundInstance::Release()
+{
+    Detach();
+    mReleased = true;
+}
+
+void SDLMixerSoundInstance::Detach()
 {
     Stop();
     mSample = NULL;
-    mReleased = true;
+    mChannel = -1;
 }
 
 void SDLMixerSoundInstance::SetVolume(double theVolume) // 0.0 to 1.0
@@ -143,9 +155,17 @@ bool SDLMixerSoundInstance::Play(bool looping, bool autoRelease)
     if (!mSample)
         return false;
 
+    // Too quiet to be worth a channel
+    if (mBaseVolume * mVolume < mSDLMixerSoundManagerP->mCullVolume) {
+        if (autoRelease)
+            Release();
+        return false;
+    }
+
     Mix_PlayChannel(mChannel, mSample, looping ? -1 : 0);
 
     mHasPlayed = true;
+    mPlayOrder = ++mSDLMixerSoundManagerP->mPlayCount;
     return true;
 }
 
@@ -159,7 +179,7 @@ void SDLMixerSoundInstance::Stop()
 
 bool SDLMixerSoundInstance::IsPlaying()
 {
-    return Mix_Playing(mChannel);
+    return mChannel >= 0 && Mix_Playing(mChannel);
 }
 
 bool SDLMixerSoundInstance::IsReleased()
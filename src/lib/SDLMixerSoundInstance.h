@@ -23,13 +23,13 @@
 #define __SDLMixerSoundINSTANCE_H__
 
 
-#include "SoundInstance.h"
+#include "ChannelSoundManager.h"
 
 namespace Sexy {
 
 class SDLMixerSoundManager;
 
-class SDLMixerSoundInstance : public SoundInstance {
+class SDLMixerSoundInstance : public ChannelSoundInstance {
     friend class SDLMixerSoundManager;
 
 protected:
@@ -37,29 +37,19 @@ protected:
 
     Mix_Chunk*              mSample;
     int                     mChannel;
-    bool                    mAutoRelease;
-    bool                    mReleased;
-
-    float                   mBasePan;
-    float                   mBaseVolume;
-    float                   mBasePitch;
-
-    float                   mPan;
-    float                   mVolume;
-    float                   mPitch;
-
-    bool                    mHasPlayed;
 
 protected:
+    void                    Reset(int theChannel, Mix_Chunk* theSourceSound, unsigned int theSfxID);
     void                    RehupVolume();
     void                    RehupPan();
     void                    RehupPitch();
 
 public:
-    SDLMixerSoundInstance(SDLMixerSoundManager* theSoundManager, int channel, Mix_Chunk* theSourceSound);
+    SDLMixerSoundInstance(SDLMixerSoundManager* theSoundManager, int channel, Mix_Chunk* theSourceSound, unsigned int theSfxID = 0);
     virtual ~SDLMixerSoundInstance();
 
     virtual void            Release();
+    virtual void            Detach();
 
     virtual void            SetBaseVolume(double theBaseVolume); //0.0 to 1.0
     virtual void            SetBasePan(int theBasePan); //-100 to +100
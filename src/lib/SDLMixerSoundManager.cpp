@@ -36,27 +36,31 @@ SDLMixerSoundManager::SDLMixerSoundManager()
         printf("Mix_OpenAudio failed: %s\n", Mix_GetError());
     }
     Mix_AllocateChannels(MAX_CHANNELS);
+    mPlayingSounds.resize(MAX_CHANNELS, NULL);
 
-    for (int i = 0; i < MAX_SOURCE_SOUNDS; i++) {
-        mSourceSounds[i] = NULL;
-        mBaseVolumes[i] = 1;
-        mBasePans[i] = 0;
-        mBasePitches[i] = 1;
-    }
-
-    for (int i = 0; i < MAX_CHANNELS; i++)
-        mPlayingSounds[i] = NULL;
+    GrowSoundTable(MAX_SOURCE_SOUNDS);
 
     mMasterVolume = 1.0;
-    mLastReleaseTick = SDL_GetTicks();
+
+    mLoadMutex = SDL_CreateMutex();
+    mLoadCond = SDL_CreateCond();
+    mLoadDoneCond = SDL_CreateCond();
+    mNumDecoding = 0;
+    mLoadThreadsQuit = false;
 }
 
 SDLMixerSoundManager::~SDLMixerSoundManager()
 {
+    StopLoadThreads();
+
     StopAllSounds();
     ReleaseChannels();
     ReleaseSounds();
 
+    SDL_DestroyCond(mLoadDoneCond);
+    SDL_DestroyCond(mLoadCond);
+    SDL_DestroyMutex(mLoadMutex);
+
     int numtimesopened, frequency, channels;
     Uint16 format;
     numtimesopened = Mix_QuerySpec(&frequency, &format, &channels);
@@ -64,28 +68,6 @@ SDLMixerSoundManager::~SDLMixerSoundManager()
         Mix_CloseAudio();
 }
 
-int SDLMixerSoundManager::FindFreeChannel()
-{
-    Uint32 aTick = SDL_GetTicks();
-    if (aTick - mLastReleaseTick > 1000) {
-        ReleaseFreeChannels();
-        mLastReleaseTick = aTick;
-    }
-
-    for (int i = 0; i < MAX_CHANNELS; i++) {
-        if (mPlayingSounds[i] == NULL)
-            return i;
-
-        if (mPlayingSounds[i]->IsReleased()) {
-            delete mPlayingSounds[i];
-            mPlayingSounds[i] = NULL;
-            return i;
-        }
-    }
-
-    return -1;
-}
-
 bool SDLMixerSoundManager::Initialized()
 {
     int numtimesopened, frequency, channels;
@@ -98,48 +80,37 @@ bool SDLMixerSoundManager::Initialized()
 
 void SDLMixerSoundManager::SetVolume(double theVolume)
 {
+    AutoMutex aLock(mMutex);
     mMasterVolume = (float) theVolume;
 
-    for (int i = 0; i < MAX_CHANNELS; i++)
+    for (size_t i = 0; i < mPlayingSounds.size(); i++)
         if (mPlayingSounds[i] != NULL)
-            mPlayingSounds[i]->RehupVolume();
+            static_cast<SDLMixerSoundInstance*>(mPlayingSounds[i])->RehupVolume();
 }
 
-int SDLMixerSoundManager::LoadSound(const string& theFilename)
+void SDLMixerSoundManager::GrowSoundTable(unsigned int theSize)
 {
-    int id = GetFreeSoundId();
+    ChannelSoundManager::GrowSoundTable(theSize);
+    if (theSize <= mSourceSounds.size())
+        return;
 
-    if (id != -1) {
-        if (LoadSound(id, theFilename)) {
-            return id;
-        }
-    }
-    return -1;
+    mSourceSounds.resize(theSize, NULL);
+    mSourceFiles.resize(theSize);
 }
 
-bool SDLMixerSoundManager::LoadSound(unsigned int theSfxID, const string& theFilename)
+bool SDLMixerSoundManager::IsSoundIdUsed(unsigned int theSfxID)
 {
-    if ((theSfxID < 0) || (theSfxID >= MAX_SOURCE_SOUNDS))
-        return false;
-
-    ReleaseSound(theSfxID);
-
-    if (!Initialized())
-        return true; // sounds just won't play, but this is not treated as a failure condition
+    return !mSourceFiles[theSfxID].empty();
+}
 
+// Called from the load threads, so it mustn't touch the sound manager
+Mix_Chunk* SDLMixerSoundManager::DecodeSound(const string& theFilename)
+{
     // See the note in SDLMixerMusicInterface::LoadMusic about splitting
     // the code in lower level / higher level with loop for extensions.
 
-    string aFilename;
-    bool pak = GetPakPtr()->isLoaded();
-    if (pak)
-        aFilename = ReplaceBackSlashes(theFilename);
-    else
-        // Use relative path to AppResource if name does not start with slash
-        aFilename = gSexyAppBase->GetAppResourceFileName(theFilename);
-
-    int aLastDotPos = aFilename.rfind('.');
-    int aLastSlashPos = aFilename.rfind('/');
+    int aLastDotPos = theFilename.rfind('.');
+    int aLastSlashPos = theFilename.rfind('/');
     string try_exts[] = {
         ".wav",
         ".ogg",
@@ -148,166 +119,462 @@ bool SDLMixerSoundManager::LoadSound(unsigned int theSfxID, const string& theFil
         //".mod",
     };
     Mix_Chunk* sample = NULL;
-    if (pak) {
-        // Read a file into image object
-        PFILE* file = NULL;
+    if (GetPakPtr()->isLoaded()) {
+        // The sample is decoded straight out of the pak
+        SDL_RWops* rw = NULL;
         if (aLastDotPos > aLastSlashPos) {
             // The filename has an extension
-            file = p_fopen(aFilename.c_str(), "r");
+            rw = p_rwopen(theFilename.c_str());
         }
         else {
-            for (size_t i = 0; file == NULL && i < (sizeof(try_exts)/sizeof(try_exts[0])); i++) {
-                file = p_fopen((aFilename + try_exts[i]).c_str(), "r");
+            for (size_t i = 0; rw == NULL && i < (sizeof(try_exts)/sizeof(try_exts[0])); i++) {
+                rw = p_rwopen((theFilename + try_exts[i]).c_str());
             }
         }
-        if (file == NULL)
+        if (rw == NULL)
             return NULL;
 
-        // TODO. Solve memory leak.
-        int size = GetPakPtr()->FSize(file);
-        Uint8* buffer = new Uint8[size];
-        int res = p_fread((void*) buffer, sizeof (Uint8), size * sizeof (Uint8), file);
-        if (size != res)
-            return NULL;
-
-        SDL_RWops* rw = SDL_RWFromMem(buffer, size);
-        sample = Mix_LoadWAV_RW(rw, 0);
-        SDL_FreeRW(rw);
-        delete[] buffer;
-        p_fclose(file);
+        sample = Mix_LoadWAV_RW(rw, 1);
     } else {
         if (aLastDotPos > aLastSlashPos) {
             // The filename has an extension
-            sample = Mix_LoadWAV(aFilename.c_str());
+            sample = Mix_LoadWAV(theFilename.c_str());
         }
         else {
             for (size_t i = 0; sample == NULL && i < (sizeof(try_exts)/sizeof(try_exts[0])); i++) {
-                sample = Mix_LoadWAV((aFilename + try_exts[i]).c_str());
+                sample = Mix_LoadWAV((theFilename + try_exts[i]).c_str());
             }
         }
     }
 
-    mSourceSounds[theSfxID] = sample;
-    return sample != NULL;
+    return sample;
 }
 
-void SDLMixerSoundManager::ReleaseSound(unsigned int theSfxID)
+// Points theSfxID at the already loaded theFile, or at theChunk when
+// that isn't NULL. Returns false if there is nothing to share.
+bool SDLMixerSoundManager::AddSharedSound(unsigned int theSfxID, const string& theFile, Mix_Chunk* theChunk)
 {
-    if (mSourceSounds[theSfxID] != NULL) {
-
-        for (int i = 0; i < MAX_CHANNELS; i++)
-            if (mPlayingSounds[i] != NULL && mPlayingSounds[i]->mSample == mSourceSounds[theSfxID]) {
-                mPlayingSounds[i]->Release();
-                break;
-            }
-        Mix_FreeChunk(mSourceSounds[theSfxID]);
-        mSourceSounds[theSfxID] = NULL;
+    SharedSoundMap::iterator anItr = mSharedSounds.find(theFile);
+    if (anItr == mSharedSounds.end()) {
+        if (theChunk == NULL)
+            return false;
+
+        SharedSound aSharedSound;
+        aSharedSound.mChunk = theChunk;
+        aSharedSound.mRefCount = 0;
+        anItr = mSharedSounds.insert(SharedSoundMap::value_type(theFile, aSharedSound)).first;
     }
+
+    anItr->second.mRefCount++;
+    mSourceSounds[theSfxID] = anItr->second.mChunk;
+    mSourceFiles[theSfxID] = theFile;
+    return true;
 }
 
-bool SDLMixerSoundManager::SetBaseVolume(unsigned int theSfxID, double theBaseVolume)
+bool SDLMixerSoundManager::LoadSound(unsigned int theSfxID, const string& theFilename)
 {
-    if ((theSfxID < 0) || (theSfxID >= MAX_SOURCE_SOUNDS))
+    AutoMutex aLock(mMutex);
+    GrowSoundTable(theSfxID + 1);
+
+    ReleaseSound(theSfxID);
+
+    if (!Initialized())
+        return true; // sounds just won't play, but this is not treated as a failure condition
+
+    string aFilename = GetSoundFileName(theFilename);
+    if (AddSharedSound(theSfxID, aFilename, NULL))
+        return true;
+
+    // Somebody else is already loading it
+    SoundLoadMap::iterator anItr = mPendingLoads.find(aFilename);
+    if (anItr != mPendingLoads.end()) {
+        SoundLoadRequest aRequest;
+        aRequest.mSfxID = theSfxID;
+        aRequest.mCallBack = NULL;
+        aRequest.mArg = NULL;
+        aRequest.mSuccess = false;
+        anItr->second->mRequests.push_back(aRequest);
+        mSourceFiles[theSfxID] = aFilename;
+
+        WaitForSound(theSfxID);
+        return mSourceSounds[theSfxID] != NULL;
+    }
+
+    Mix_Chunk* sample = DecodeSound(aFilename);
+    if (sample == NULL)
         return false;
 
-    mBaseVolumes[theSfxID] = (float) theBaseVolume;
+    return AddSharedSound(theSfxID, aFilename, sample);
+}
+
+bool SDLMixerSoundManager::LoadSoundAsync(unsigned int theSfxID, const string& theFilename, SoundLoadedCallBack theCallBack, void* theArg)
+{
+    {
+        AutoMutex aLock(mMutex);
+        GrowSoundTable(theSfxID + 1);
+
+        ReleaseSound(theSfxID);
+
+        if (StartLoad(theSfxID, theFilename, theCallBack, theArg))
+            return true;
+    }
+
+    // Nothing to wait for
+    if (theCallBack != NULL)
+        theCallBack(theArg, theSfxID, true);
     return true;
 }
 
-bool SDLMixerSoundManager::SetBasePan(unsigned int theSfxID, int theBasePan)
+bool SDLMixerSoundManager::LoadSoundAsync(const string& theFilename, int* theSfxID, SoundLoadedCallBack theCallBack, void* theArg)
 {
-    if ((theSfxID < 0) || (theSfxID >= MAX_SOURCE_SOUNDS))
-        return false;
+    {
+        // The id is used as soon as StartLoad() gives it a file, so it's
+        // picked under the same lock. FinishLoads() needs the lock too, so
+        // *theSfxID is set before the callback runs.
+        AutoMutex aLock(mMutex);
+        *theSfxID = GetFreeSoundId();
+        if (*theSfxID < 0)
+            return false;
+
+        if (StartLoad(*theSfxID, theFilename, theCallBack, theArg))
+            return true;
+    }
 
-    mBasePans[theSfxID] = theBasePan;
+    // Nothing to wait for
+    if (theCallBack != NULL)
+        theCallBack(theArg, *theSfxID, true);
     return true;
 }
 
-bool SDLMixerSoundManager::SetBasePitch(unsigned int theSfxID, float theBasePitch)
+// With mMutex held: shares the sound if it's loaded already, or queues it.
+// Returns true when theCallBack is left to FinishLoads().
+bool SDLMixerSoundManager::StartLoad(unsigned int theSfxID, const string& theFilename, SoundLoadedCallBack theCallBack, void* theArg)
 {
-    if ((theSfxID < 0) || (theSfxID >= MAX_SOURCE_SOUNDS))
+    if (!Initialized())
         return false;
 
-    mBasePitches[theSfxID] = theBasePitch;
+    string aFilename = GetSoundFileName(theFilename);
+    if (AddSharedSound(theSfxID, aFilename, NULL))
+        return false;
+
+    QueueLoad(theSfxID, aFilename, theCallBack, theArg);
     return true;
 }
 
-SoundInstance* SDLMixerSoundManager::GetSoundInstance(unsigned int theSfxID)
+// Hands theFile to the load threads, or decodes it right here if there are
+// none. Either way FinishLoads() completes it.
+void SDLMixerSoundManager::QueueLoad(unsigned int theSfxID, const string& theFile, SoundLoadedCallBack theCallBack, void* theArg)
 {
-    if (theSfxID > MAX_SOURCE_SOUNDS)
-        return NULL;
+    SoundLoadRequest aRequest;
+    aRequest.mSfxID = theSfxID;
+    aRequest.mCallBack = theCallBack;
+    aRequest.mArg = theArg;
+    aRequest.mSuccess = false;
+    mSourceFiles[theSfxID] = theFile;
+
+    SoundLoadMap::iterator anItr = mPendingLoads.find(theFile);
+    if (anItr != mPendingLoads.end()) {
+        anItr->second->mRequests.push_back(aRequest);
+        return;
+    }
 
-    int aFreeChannel = FindFreeChannel();
-    if (aFreeChannel < 0)
-        return NULL;
+    SoundLoad* aLoad = new SoundLoad();
+    aLoad->mFilename = theFile;
+    aLoad->mChunk = NULL;
+    aLoad->mRequests.push_back(aRequest);
+    mPendingLoads[theFile] = aLoad;
 
-    if (!Initialized()) {
-        mPlayingSounds[aFreeChannel] = new SDLMixerSoundInstance(this, aFreeChannel, NULL);
+    StartLoadThreads();
+    if (mLoadThreads.empty())
+        aLoad->mChunk = DecodeSound(theFile);
+
+    SDL_LockMutex(mLoadMutex);
+    if (mLoadThreads.empty()) {
+        mFinishedLoads.push_back(aLoad);
     } else {
-        if (!mSourceSounds[theSfxID])
-            return NULL;
-        mPlayingSounds[aFreeChannel] = new SDLMixerSoundInstance(this, aFreeChannel, mSourceSounds[theSfxID]);
+        mLoadQueue.push_back(aLoad);
+        mNumDecoding++;
+        SDL_CondSignal(mLoadCond);
     }
+    SDL_UnlockMutex(mLoadMutex);
+}
 
-    mPlayingSounds[aFreeChannel]->SetBasePan(mBasePans[theSfxID]);
-    mPlayingSounds[aFreeChannel]->SetBaseVolume(mBaseVolumes[theSfxID]);
-    mPlayingSounds[aFreeChannel]->AdjustBasePitch(mBasePitches[theSfxID]);
+void SDLMixerSoundManager::StartLoadThreads()
+{
+    if (!mLoadThreads.empty())
+        return;
+
+    int aNumThreads = std::max(1, std::min(4, SDL_GetCPUCount() - 1));
+    for (int i = 0; i < aNumThreads; i++) {
+#if SDL_VERSION_ATLEAST(2,0,0)
+        SDL_Thread* aThread = SDL_CreateThread(LoadThreadProc, "LoadSounds", this);
+#else
+        SDL_Thread* aThread = SDL_CreateThread(LoadThreadProc, this);
+#endif
+        if (aThread != NULL)
+            mLoadThreads.push_back(aThread);
+    }
+}
 
-    return mPlayingSounds[aFreeChannel];
+void SDLMixerSoundManager::StopLoadThreads()
+{
+    SDL_LockMutex(mLoadMutex);
+    mLoadThreadsQuit = true;
+    SDL_CondBroadcast(mLoadCond);
+    SDL_UnlockMutex(mLoadMutex);
+
+    for (size_t i = 0; i < mLoadThreads.size(); i++)
+        SDL_WaitThread(mLoadThreads[i], NULL);
+    mLoadThreads.clear();
+
+    // Whatever didn't get decoded is dropped
+    AutoMutex aLock(mMutex);
+    SoundLoadMap::iterator anItr;
+    for (anItr = mPendingLoads.begin(); anItr != mPendingLoads.end(); ++anItr) {
+        SoundLoad* aLoad = anItr->second;
+        std::list<SoundLoadRequest>::iterator aReqItr;
+        for (aReqItr = aLoad->mRequests.begin(); aReqItr != aLoad->mRequests.end(); ++aReqItr)
+            mSourceFiles[aReqItr->mSfxID].clear();
+        if (aLoad->mChunk != NULL)
+            Mix_FreeChunk(aLoad->mChunk);
+        delete aLoad;
+    }
+    mPendingLoads.clear();
+    mLoadQueue.clear();
+    mFinishedLoads.clear();
+    mNumDecoding = 0;
+    mLoadedCallBacks.clear();
 }
 
-SoundInstance* SDLMixerSoundManager::GetOriginalSoundInstance(unsigned int theSfxID)
+int SDLMixerSoundManager::LoadThreadProc(void* theArg)
 {
-    if (theSfxID > MAX_SOURCE_SOUNDS)
-        return NULL;
+    SDLMixerSoundManager* aManager = (SDLMixerSoundManager*) theArg;
 
-    if (mSourceSounds[theSfxID] != NULL) {
+    SDL_LockMutex(aManager->mLoadMutex);
+    for (;;) {
+        while (aManager->mLoadQueue.empty() && !aManager->mLoadThreadsQuit)
+            SDL_CondWait(aManager->mLoadCond, aManager->mLoadMutex);
+        if (aManager->mLoadThreadsQuit)
+            break;
 
-        for (int i = 0; i < MAX_CHANNELS; i++) {
-            if (mPlayingSounds[i] != NULL && mPlayingSounds[i]->mSample == mSourceSounds[theSfxID]) {
-                return mPlayingSounds[i];
-            }
+        SoundLoad* aLoad = aManager->mLoadQueue.front();
+        aManager->mLoadQueue.pop_front();
+        SDL_UnlockMutex(aManager->mLoadMutex);
+
+        aLoad->mChunk = DecodeSound(aLoad->mFilename);
+
+        SDL_LockMutex(aManager->mLoadMutex);
+        aManager->mFinishedLoads.push_back(aLoad);
+        aManager->mNumDecoding--;
+        SDL_CondBroadcast(aManager->mLoadDoneCond);
+    }
+    SDL_UnlockMutex(aManager->mLoadMutex);
+    return 0;
+}
+
+// With mMutex held, the callbacks are left for RunLoadedCallBacks()
+void SDLMixerSoundManager::CompleteLoad(SoundLoad* theLoad)
+{
+    mPendingLoads.erase(theLoad->mFilename);
+
+    std::list<SoundLoadRequest>::iterator anItr;
+    for (anItr = theLoad->mRequests.begin(); anItr != theLoad->mRequests.end(); ++anItr) {
+        if (!AddSharedSound(anItr->mSfxID, theLoad->mFilename, theLoad->mChunk))
+            mSourceFiles[anItr->mSfxID].clear();
+    }
+
+    // Every sound id that wanted it was released in the meantime
+    if (theLoad->mRequests.empty() && theLoad->mChunk != NULL)
+        Mix_FreeChunk(theLoad->mChunk);
+
+    for (anItr = theLoad->mRequests.begin(); anItr != theLoad->mRequests.end(); ++anItr) {
+        if (anItr->mCallBack != NULL) {
+            anItr->mSuccess = theLoad->mChunk != NULL;
+            mLoadedCallBacks.push_back(*anItr);
         }
     }
 
-    return GetSoundInstance(theSfxID);
+    delete theLoad;
+}
+
+// With mMutex held. Returns false if no load had finished.
+bool SDLMixerSoundManager::CompleteFinishedLoads()
+{
+    std::list<SoundLoad*> aFinishedLoads;
+
+    SDL_LockMutex(mLoadMutex);
+    aFinishedLoads.swap(mFinishedLoads);
+    SDL_UnlockMutex(mLoadMutex);
+
+    std::list<SoundLoad*>::iterator anItr;
+    for (anItr = aFinishedLoads.begin(); anItr != aFinishedLoads.end(); ++anItr)
+        CompleteLoad(*anItr);
+    return !aFinishedLoads.empty();
 }
 
-void SDLMixerSoundManager::ReleaseSounds()
+// Without mMutex, a callback may use the sound manager or take locks of its own
+void SDLMixerSoundManager::RunLoadedCallBacks()
 {
-    for (int i = 0; i < MAX_SOURCE_SOUNDS; i++)
-        ReleaseSound(i);
+    std::list<SoundLoadRequest> aCallBacks;
+    {
+        AutoMutex aLock(mMutex);
+        aCallBacks.swap(mLoadedCallBacks);
+    }
+
+    std::list<SoundLoadRequest>::iterator anItr;
+    for (anItr = aCallBacks.begin(); anItr != aCallBacks.end(); ++anItr)
+        anItr->mCallBack(anItr->mArg, anItr->mSfxID, anItr->mSuccess);
 }
 
-void SDLMixerSoundManager::ReleaseChannels()
+void SDLMixerSoundManager::FinishLoads(bool wait)
 {
-    for (int i = 0; i < MAX_CHANNELS; i++)
-        if (mPlayingSounds[i]) {
-            mPlayingSounds[i]->Release();
-            mPlayingSounds[i] = NULL;
+    for (;;) {
+        bool isPending;
+        {
+            AutoMutex aLock(mMutex);
+            CompleteFinishedLoads();
+            isPending = !mPendingLoads.empty();
         }
+        RunLoadedCallBacks();
+
+        if (!wait || !isPending)
+            break;
+
+        // Not holding mMutex, the main thread keeps playing sounds meanwhile
+        SDL_LockMutex(mLoadMutex);
+        while (mFinishedLoads.empty() && mNumDecoding > 0)
+            SDL_CondWait(mLoadDoneCond, mLoadMutex);
+        SDL_UnlockMutex(mLoadMutex);
+    }
 }
 
-void SDLMixerSoundManager::ReleaseFreeChannels()
+bool SDLMixerSoundManager::IsSoundLoading(unsigned int theSfxID)
 {
-    for (int i = 0; i < MAX_CHANNELS; i++)
-        if (mPlayingSounds[i] && mPlayingSounds[i]->IsReleased())
-            mPlayingSounds[i] = NULL;
+    return theSfxID < mSourceSounds.size() && mSourceSounds[theSfxID] == NULL && !mSourceFiles[theSfxID].empty();
 }
 
-void SDLMixerSoundManager::StopSound(int SfxID)
+// With mMutex held. The load threads don't need it, so they can still
+// finish the sound.
+void SDLMixerSoundManager::WaitForSound(unsigned int theSfxID)
 {
-    //FIXME TODO
+    while (IsSoundLoading(theSfxID)) {
+        SDL_LockMutex(mLoadMutex);
+        while (mFinishedLoads.empty() && mNumDecoding > 0)
+            SDL_CondWait(mLoadDoneCond, mLoadMutex);
+        SDL_UnlockMutex(mLoadMutex);
+
+        // Nothing left that could finish it
+        if (!CompleteFinishedLoads())
+            break;
+    }
 }
 
-void SDLMixerSoundManager::StopAllSounds()
+void SDLMixerSoundManager::ReleaseSound(unsigned int theSfxID)
 {
-    for (int i = 0; i < MAX_CHANNELS; i++)
-        if (mPlayingSounds[i] != NULL) {
-            bool isAutoRelease = mPlayingSounds[i]->mAutoRelease;
-            mPlayingSounds[i]->Stop();
-            mPlayingSounds[i]->mAutoRelease = isAutoRelease;
+    AutoMutex aLock(mMutex);
+
+    // A callback FinishLoads() hasn't called yet won't be
+    std::list<SoundLoadRequest>::iterator aCallBackItr = mLoadedCallBacks.begin();
+    while (aCallBackItr != mLoadedCallBacks.end()) {
+        if (aCallBackItr->mSfxID == theSfxID)
+            aCallBackItr = mLoadedCallBacks.erase(aCallBackItr);
+        else
+            ++aCallBackItr;
+    }
+
+    if (theSfxID >= mSourceSounds.size() || mSourceFiles[theSfxID].empty())
+        return;
+
+    std::string aFilename = mSourceFiles[theSfxID];
+    mSourceFiles[theSfxID].clear();
+
+    if (mSourceSounds[theSfxID] == NULL) {
+        // Still loading, the load just won't be handed to this id
+        SoundLoadMap::iterator anItr = mPendingLoads.find(aFilename);
+        if (anItr != mPendingLoads.end()) {
+            std::list<SoundLoadRequest>& aRequests = anItr->second->mRequests;
+            std::list<SoundLoadRequest>::iterator aReqItr = aRequests.begin();
+            while (aReqItr != aRequests.end()) {
+                if (aReqItr->mSfxID == theSfxID)
+                    aReqItr = aRequests.erase(aReqItr);
+                else
+                    ++aReqItr;
+            }
         }
+        return;
+    }
+
+    Mix_Chunk* aChunk = mSourceSounds[theSfxID];
+    mSourceSounds[theSfxID] = NULL;
+
+    SharedSoundMap::iterator anItr = mSharedSounds.find(aFilename);
+    if (anItr != mSharedSounds.end() && --anItr->second.mRefCount > 0)
+        return;
+    mSharedSounds.erase(aFilename);
+
+    for (size_t i = 0; i < mPlayingSounds.size(); i++)
+        if (mPlayingSounds[i] != NULL && static_cast<SDLMixerSoundInstance*>(mPlayingSounds[i])->mSample == aChunk)
+            FreeChannel(i);
+    Mix_FreeChunk(aChunk);
+}
+
+void SDLMixerSoundManager::SetNumChannels(int theNumChannels)
+{
+    AutoMutex aLock(mMutex);
+    if (theNumChannels < 1)
+        theNumChannels = 1;
+
+    for (int i = theNumChannels; i < (int) mPlayingSounds.size(); i++)
+        FreeChannel(i);
+
+    mPlayingSounds.resize(theNumChannels, NULL);
+    Mix_AllocateChannels(theNumChannels);
+}
+
+SoundInstance* SDLMixerSoundManager::GetSoundInstance(unsigned int theSfxID)
+{
+    AutoMutex aLock(mMutex);
+    if (theSfxID >= mSourceSounds.size())
+        return NULL;
+
+    WaitForSound(theSfxID);
+
+    Mix_Chunk* aSample = NULL;
+    if (Initialized()) {
+        aSample = mSourceSounds[theSfxID];
+        if (aSample == NULL)
+            return NULL;
+    }
+
+    int aFreeChannel = FindFreeChannel(theSfxID);
+    if (aFreeChannel < 0)
+        return NULL;
+
+    SDLMixerSoundInstance* anInstance = static_cast<SDLMixerSoundInstance*>(TakeFreeInstance());
+    if (anInstance == NULL)
+        anInstance = new SDLMixerSoundInstance(this, aFreeChannel, aSample, theSfxID);
+    else
+        anInstance->Reset(aFreeChannel, aSample, theSfxID);
+    StartInstance(aFreeChannel, anInstance);
+
+    return anInstance;
+}
+
+SoundInstance* SDLMixerSoundManager::GetOriginalSoundInstance(unsigned int theSfxID)
+{
+    AutoMutex aLock(mMutex);
+    if (theSfxID >= mSourceSounds.size())
+        return NULL;
+
+    WaitForSound(theSfxID);
+
+    if (mSourceSounds[theSfxID] != NULL) {
+        SoundInstance* anInstance = FindPlayingInstance(theSfxID);
+        if (anInstance != NULL)
+            return anInstance;
+    }
+
+    return GetSoundInstance(theSfxID);
 }
 
 double SDLMixerSoundManager::GetMasterVolume()
@@ -327,21 +594,12 @@ void SDLMixerSoundManager::SetCooperativeWindow(HWND theHWnd, bool isWindowed)
 {
 }
 
-int SDLMixerSoundManager::GetFreeSoundId()
-{
-    for (int i = 0; i < MAX_SOURCE_SOUNDS; ++i) {
-        if (!mSourceSounds[i]) {
-            return i;
-        }
-    }
-    return -1;
-}
-
 int SDLMixerSoundManager::GetNumSounds()
 {
+    AutoMutex aLock(mMutex);
     int nr_sounds = 0;
 
-    for (int i = 0; i < MAX_SOURCE_SOUNDS; ++i) {
+    for (unsigned int i = 0; i < mSourceSounds.size(); ++i) {
         if (mSourceSounds[i]) {
             ++nr_sounds;
         }
@@ -349,4 +607,18 @@ int SDLMixerSoundManager::GetNumSounds()
     return nr_sounds;
 }
 
+// A chunk shared by several ids is split between them
+size_t SDLMixerSoundManager::GetSoundMemSize(unsigned int theSfxID)
+{
+    AutoMutex aLock(mMutex);
+    if (theSfxID >= mSourceSounds.size() || mSourceSounds[theSfxID] == NULL)
+        return 0;
+
+    size_t aSize = mSourceSounds[theSfxID]->alen;
+    SharedSoundMap::iterator anItr = mSharedSounds.find(mSourceFiles[theSfxID]);
+    if (anItr != mSharedSounds.end() && anItr->second.mRefCount > 1)
+        aSize /= anItr->second.mRefCount;
+    return aSize;
+}
+
 #undef SOUND_FLAGS
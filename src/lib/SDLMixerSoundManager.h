@@ -22,8 +22,12 @@
 #ifndef __SDLMixerSoundMANAGER_H__
 #define __SDLMixerSoundMANAGER_H__
 
-#include "SoundManager.h"
+#include "ChannelSoundManager.h"
 #include <SDL_mixer.h>
+#include <SDL_thread.h>
+#include <vector>
+#include <list>
+#include <map>
 
 #ifndef WIN32
 #define HWND void*
@@ -34,22 +38,73 @@ namespace Sexy
 
 class SDLMixerSoundInstance;
 
-class SDLMixerSoundManager : public SoundManager
+class SDLMixerSoundManager : public ChannelSoundManager
 {
     friend class SDLMixerSoundInstance;
 
 protected:
-    Mix_Chunk*              mSourceSounds[MAX_SOURCE_SOUNDS];
-    float                   mBaseVolumes[MAX_SOURCE_SOUNDS];
-    int                     mBasePans[MAX_SOURCE_SOUNDS];
-    float                   mBasePitches[MAX_SOURCE_SOUNDS];
-    SDLMixerSoundInstance*  mPlayingSounds[MAX_CHANNELS];
+    struct SoundLoadRequest
+    {
+        unsigned int        mSfxID;
+        SoundLoadedCallBack mCallBack;
+        void*               mArg;
+        bool                mSuccess;           // Once the load completed
+    };
+
+    // One file being decoded by the load threads, for every sound id
+    // that asked for it
+    struct SoundLoad
+    {
+        std::string         mFilename;
+        Mix_Chunk*          mChunk;
+        std::list<SoundLoadRequest> mRequests;
+    };
+
+    // Sound ids loading the same file share its Mix_Chunk
+    struct SharedSound
+    {
+        Mix_Chunk*          mChunk;
+        int                 mRefCount;
+    };
+
+    typedef std::map<std::string, SoundLoad*> SoundLoadMap;
+    typedef std::map<std::string, SharedSound> SharedSoundMap;
+
+    // mMutex guards these up to the load threads, it is taken before
+    // mLoadMutex. The load threads only take mLoadMutex.
+    std::vector<Mix_Chunk*> mSourceSounds;
+    std::vector<std::string> mSourceFiles;      // Set while the sound is loaded or loading
     float                   mMasterVolume;
-    Uint32                  mLastReleaseTick;
+
+    SharedSoundMap          mSharedSounds;
+    SoundLoadMap            mPendingLoads;
+    std::list<SoundLoadRequest> mLoadedCallBacks;   // For FinishLoads() to call
+
+    std::vector<SDL_Thread*> mLoadThreads;
+    SDL_mutex*              mLoadMutex;
+    SDL_cond*               mLoadCond;
+    SDL_cond*               mLoadDoneCond;
+    std::list<SoundLoad*>   mLoadQueue;         // Guarded by mLoadMutex
+    std::list<SoundLoad*>   mFinishedLoads;     // Guarded by mLoadMutex
+    int                     mNumDecoding;       // Queued or being decoded, guarded by mLoadMutex
+    bool                    mLoadThreadsQuit;
 
 protected:
-    int                     FindFreeChannel();
-    void                    ReleaseFreeChannels();
+    virtual void            GrowSoundTable(unsigned int theSize);
+    virtual bool            IsSoundIdUsed(unsigned int theSfxID);
+    bool                    AddSharedSound(unsigned int theSfxID, const std::string& theFile, Mix_Chunk* theChunk);
+    bool                    IsSoundLoading(unsigned int theSfxID);
+    void                    WaitForSound(unsigned int theSfxID);
+    void                    QueueLoad(unsigned int theSfxID, const std::string& theFile, SoundLoadedCallBack theCallBack, void* theArg);
+    void                    CompleteLoad(SoundLoad* theLoad);
+    bool                    CompleteFinishedLoads();
+    void                    RunLoadedCallBacks();
+    bool                    StartLoad(unsigned int theSfxID, const std::string& theFilename, SoundLoadedCallBack theCallBack, void* theArg);
+    void                    StartLoadThreads();
+    void                    StopLoadThreads();
+
+    static Mix_Chunk*       DecodeSound(const std::string& theFilename);
+    static int              LoadThreadProc(void* theArg);
 
 public:
     SDLMixerSoundManager();
@@ -57,32 +112,27 @@ public:
 
     virtual bool            Initialized();
 
+    using ChannelSoundManager::LoadSound;
     virtual bool            LoadSound(unsigned int theSfxID, const std::string& theFilename);
-    virtual int             LoadSound(const std::string& theFilename);
     virtual void            ReleaseSound(unsigned int theSfxID);
-    virtual int             GetFreeSoundId();
+    virtual bool            LoadSoundAsync(unsigned int theSfxID, const std::string& theFilename, SoundLoadedCallBack theCallBack = NULL, void* theArg = NULL);
+    virtual bool            LoadSoundAsync(const std::string& theFilename, int* theSfxID, SoundLoadedCallBack theCallBack = NULL, void* theArg = NULL);
+    virtual void            FinishLoads(bool wait);
     virtual int             GetNumSounds();
+    virtual size_t          GetSoundMemSize(unsigned int theSfxID);
 
     virtual void            SetVolume(double theVolume);
-    virtual bool            SetBaseVolume(unsigned int theSfxID, double theBaseVolume);
-    virtual bool            SetBasePan(unsigned int theSfxID, int theBasePan);
-    virtual bool            SetBasePitch(unsigned int theSfxID, float theBasePitch);
+    virtual void            SetNumChannels(int theNumChannels);
 
     virtual SoundInstance*  GetSoundInstance(unsigned int theSfxID);
     virtual SoundInstance*  GetOriginalSoundInstance(unsigned int theSfxID);
 
-    virtual void            ReleaseSounds();
-    virtual void            ReleaseChannels();
-
     virtual double          GetMasterVolume();
     virtual void            SetMasterVolume(double theVolume);
 
     virtual void            Flush();
 
     virtual void            SetCooperativeWindow(HWND theHWnd, bool isWindowed);
-    virtual void            StopAllSounds();
-    virtual void            StopSound(int theSfxID); //FIXME, TODO
-    virtual bool            IsSoundPlaying(int theSfxID){ return false; } //FIXME, TODO
 };
 
 }
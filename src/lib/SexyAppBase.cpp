@@ -39,6 +39,9 @@
 #include <SDL_mixer.h>
 #include "SDLMixerMusicInterface.h"
 #include "SDLMixerSoundManager.h"
+#elif defined(USE_SOFTMIXER)
+#include "SoftMixerMusicInterface.h"
+#include "SoftMixerSoundManager.h"
 #endif
 
 #include "DDInterface.h"
@@ -56,6 +59,10 @@
 #include "anyoption.h"
 #include "Logging.h"
 #include "Timer.h"
+#include "InputRecorder.h"
+#include "FrameCounters.h"
+#include "StatsWidget.h"
+#include "MemoryStats.h"
 
 using namespace Sexy;
 
@@ -195,7 +202,7 @@ SexyAppBase::SexyAppBase()
     }
 
     // TODO. Move this code somewhere else.
-#if defined(USE_SDLMIXER)
+#if defined(USE_SDLMIXER) || defined(USE_SOFTMIXER)
     if (SDL_InitSubSystem(SDL_INIT_AUDIO) == -1) {
         std::string msg = SDL_GetError();
         msg = std::string("Audio initialization failed: ") + msg;
@@ -263,6 +270,7 @@ SexyAppBase::SexyAppBase()
     mTabletPC = false;
     mAlphaDisabled = false;
     mLookForAlpha = true;
+    mImageCacheSize = 0;
 
     mReadFromRegistry = false;
     mIsOpeningURL = false;
@@ -335,6 +343,9 @@ SexyAppBase::SexyAppBase()
     mDemoCmdBitPos = 0;
     mDemoLoadingComplete = false;
 
+    mInputRecorder = NULL;
+    mStatsWidget = NULL;
+
     mCurHandleNum = 0;
 
     mDemoMarkerList.clear();
@@ -442,13 +453,18 @@ SexyAppBase::~SexyAppBase()
 
     delete mWidgetManager;
     delete mResourceManager;
+    delete mStatsWidget;
 
     delete mDDInterface;
     mDDInterface = NULL;
-    delete mSoundManager;
-    mSoundManager = NULL;
+    // The music may play through the sound manager's mixer, it goes first
     delete mMusicInterface;
     mMusicInterface = NULL;
+    delete mSoundManager;
+    mSoundManager = NULL;
+
+    delete mInputRecorder;
+    mInputRecorder = NULL;
 
     SDL_FreeCursor(mHandCursor);
     SDL_FreeCursor(mDraggingCursor);
@@ -1012,6 +1028,11 @@ void SexyAppBase::Init()
     SetAppDataFolder(std::string(getenv("HOME")) + "/." + mRegKey + "/");
 #endif
 
+    if (mImageCacheSize > 0) {
+        ImageLib::gImageCacheFolder = mAppDataFolder + "imagecache/";
+        ImageLib::gImageCacheBudget = (uint64_t) mImageCacheSize * 1024 * 1024;
+    }
+
     if (GetAppResourceFolder() == "" && mArgv0 != "") {
         // ResourceFolder not set.
         // Use the directory of the program instead.
@@ -1045,8 +1066,21 @@ void SexyAppBase::Init()
         HandleGameAlreadyRunning();
     mMutex = SDL_CreateMutex();
 
+    // Before the first seed, so that it is recorded or replaced
+    if (!mRecordFile.empty() || !mReplayFile.empty()) {
+        mInputRecorder = new InputRecorder(this);
+        if (!mReplayFile.empty()) {
+            if (mInputRecorder->StartReplay(mReplayFile))
+                mInputRecorder->SetTimingsFile(mReplayTimingsFile);
+            else
+                Shutdown();
+        }
+        else
+            mInputRecorder->StartRecording(mRecordFile);
+    }
+
     SRand(SDL_GetTicks());
-    srand(SDL_GetTicks());
+    srand(InputRecorder::FilterSeed(SDL_GetTicks()));
 
     mArrowCursor = SDL_GetCursor();
 
@@ -1314,6 +1348,8 @@ void SexyAppBase::Shutdown()
     {
         mExitToTop = true;
         mShutdown = true;
+        if (mInputRecorder != NULL)
+            mInputRecorder->Finish();
         ShutdownHook();
     }
 }
@@ -1401,7 +1437,22 @@ void SexyAppBase::UpdateAppStep(bool* updated)
 
     // We update in two stages to avoid doing a Process if our loop termination
     //  condition has already been met by processing windows messages
-    if (mUpdateAppState == UPDATESTATE_MESSAGES)
+    if (mUpdateAppState == UPDATESTATE_MESSAGES && mInputRecorder != NULL && mInputRecorder->IsReplaying())
+    {
+        // Only the recorded input counts, but let the replay be stopped
+        SDL_Event test_event;
+        while (SDL_PollEvent(&test_event)) {
+            if (test_event.type == SDL_QUIT)
+                Shutdown();
+        }
+
+        mInputRecorder->ReplayInput();
+        if (mInputRecorder->IsReplayDone())
+            Shutdown();
+
+        mUpdateAppState = UPDATESTATE_PROCESS_1;
+    }
+    else if (mUpdateAppState == UPDATESTATE_MESSAGES)
     {
         SDL_Event test_event;
 
@@ -1419,24 +1470,7 @@ void SexyAppBase::UpdateAppStep(bool* updated)
                 TLOG(mLogFacil, 2, Logger::format("UpdateAppStep: mouse motion: x=%d, y=%d, xrel=%d, yrel=%d", event->x, event->y, event->xrel, event->yrel));
                 TLOG(mLogFacil, 1, Logger::format("UpdateAppStep: x=%d, y=%d", x, y));
 
-                //FIXME
-                if (/*(!gInAssert) &&*/ (!mSEHOccured))
-                {
-
-                    mDDInterface->mCursorX = x;
-                    mDDInterface->mCursorY = y;
-                    mWidgetManager->RemapMouse(mDDInterface->mCursorX, mDDInterface->mCursorY);
-
-                    mLastUserInputTick = mLastTimerTime;
-
-                    mWidgetManager->MouseMove(mDDInterface->mCursorX, mDDInterface->mCursorY);
-
-                    if (!mMouseIn) {
-                        mMouseIn = true;
-
-                        EnforceCursor();
-                    }
-                }
+                HandleMouseMove(x, y);
 #endif
                 break;
             }
@@ -1454,29 +1488,24 @@ void SexyAppBase::UpdateAppStep(bool* updated)
                 TLOG(mLogFacil, 2, Logger::format("UpdateAppStep: button %s: x=%d, y=%d", (isUp ? "up" : "down"), event->x, event->y));
                 TLOG(mLogFacil, 1, Logger::format("UpdateAppStep: x=%d, y=%d", x, y));
 
-                if (isUp) {
-                    if (event->button == SDL_BUTTON_LEFT && event->state == SDL_RELEASED)
-                        mWidgetManager->MouseUp(x, y, 1);
-                    else if (event->button == SDL_BUTTON_RIGHT && event->state == SDL_RELEASED)
-                        mWidgetManager->MouseUp(x, y, -1);
-                    else if (event->button == SDL_BUTTON_MIDDLE && event->state == SDL_RELEASED)
-                        mWidgetManager->MouseUp(x, y, 3);
+                int aButton = 0;
+                if (event->button == SDL_BUTTON_LEFT)
+                    aButton = 1;
+                else if (event->button == SDL_BUTTON_RIGHT)
+                    aButton = -1;
+                else if (event->button == SDL_BUTTON_MIDDLE)
+                    aButton = 3;
+
+                if (aButton != 0 && event->state == (isUp ? SDL_RELEASED : SDL_PRESSED))
+                    HandleMouseButton(x, y, aButton, isUp);
 #if SDL_VERSION_ATLEAST(2,0,0)
-                    // TODO. Find out how to do this with SDL2
+                // TODO. Find out how to do the wheel with SDL2
 #else
-                    else if (event->button == SDL_BUTTON_WHEELUP && event->state == SDL_RELEASED)
-                        mWidgetManager->MouseWheel(1);
-                    else if (event->button == SDL_BUTTON_WHEELDOWN && event->state == SDL_RELEASED)
-                        mWidgetManager->MouseWheel(-1);
+                else if (isUp && event->button == SDL_BUTTON_WHEELUP && event->state == SDL_RELEASED)
+                    mWidgetManager->MouseWheel(1);
+                else if (isUp && event->button == SDL_BUTTON_WHEELDOWN && event->state == SDL_RELEASED)
+                    mWidgetManager->MouseWheel(-1);
 #endif
-                } else {
-                    if (event->button == SDL_BUTTON_LEFT && event->state == SDL_PRESSED)
-                        mWidgetManager->MouseDown(x, y, 1);
-                    else if (event->button == SDL_BUTTON_RIGHT && event->state == SDL_PRESSED)
-                        mWidgetManager->MouseDown(x, y, -1);
-                    else if (event->button == SDL_BUTTON_MIDDLE && event->state == SDL_PRESSED)
-                        mWidgetManager->MouseDown(x, y, 3);
-                }
 
                 mUpdateAppState = UPDATESTATE_PROCESS_1;
 
@@ -1527,26 +1556,15 @@ void SexyAppBase::UpdateAppStep(bool* updated)
 
                     mUpdateAppState = UPDATESTATE_PROCESS_1;
 
+                    // A finger is the left mouse button, and recorded as such
                     if (isMotion) {
-                        mDDInterface->mCursorX = x;
-                        mDDInterface->mCursorY = y;
-                        mWidgetManager->RemapMouse(x, y);
-
-                        mLastUserInputTick = mLastTimerTime;
-
-                        mWidgetManager->MouseMove(x, y);
-
-                        if (!mMouseIn) {
-                            mMouseIn = true;
-
-                            EnforceCursor();
-                        }
+                        HandleMouseMove(x, y);
                     }
                     else if (isUp) {
-                        mWidgetManager->MouseUp(x, y, 1);
+                        HandleMouseButton(x, y, 1, true);
                     }
                     else if (isDown) {
-                        mWidgetManager->MouseDown(x, y, 1);
+                        HandleMouseButton(x, y, 1, false);
                     }
                 }
 #endif
@@ -1558,15 +1576,7 @@ void SexyAppBase::UpdateAppStep(bool* updated)
             {
                 bool isUp = test_event.type == SDL_KEYUP;
                 SDL_KeyboardEvent* event = &test_event.key;
-                mLastUserInputTick = mLastTimerTime;
-                SDLKey k = event->keysym.sym;
-                if (isUp) {
-                    mWidgetManager->KeyUp(GetKeyCodeFromSDLKey(k));
-                } else {
-                    mWidgetManager->KeyDown(GetKeyCodeFromSDLKey(k));
-                    if (k >= SDLK_a && k <= SDLK_z)
-                        mWidgetManager->KeyChar((SexyChar)*SDL_GetKeyName(k));
-                }
+                HandleKey(event->keysym.sym, isUp);
 
                 mUpdateAppState = UPDATESTATE_PROCESS_1;
 
@@ -1575,52 +1585,20 @@ void SexyAppBase::UpdateAppStep(bool* updated)
 
 #if SDL_VERSION_ATLEAST(2,0,0)
             case SDL_WINDOWEVENT:
-		if (test_event.window.event & SDL_WINDOWEVENT_FOCUS_GAINED) {
-                    mHasFocus = true;
-                    GotFocus();
-
-                    if (mMuteOnLostFocus)
-                        Unmute(true);
-
-                    mWidgetManager->MouseMove(mDDInterface->mCursorX, mDDInterface->mCursorY);
-		}
-		else if ((test_event.window.event & SDL_WINDOWEVENT_FOCUS_LOST) && mHasFocus) {
-                    mHasFocus = false;
-                    LostFocus();
-
-                    mWidgetManager->MouseExit(mDDInterface->mCursorX, mDDInterface->mCursorY);
-
-                    if (mMuteOnLostFocus)
-                        Mute(true);
-		}
+		if (test_event.window.event & SDL_WINDOWEVENT_FOCUS_GAINED)
+                    HandleFocus(true);
+		else if (test_event.window.event & SDL_WINDOWEVENT_FOCUS_LOST)
+                    HandleFocus(false);
 		break;
 #else
             case SDL_ACTIVEEVENT:
-                if (test_event.active.gain == 1) {
-
-                    mHasFocus = true;
-                    GotFocus();
-
-                    if (mMuteOnLostFocus)
-                        Unmute(true);
-
-                    mWidgetManager->MouseMove(mDDInterface->mCursorX, mDDInterface->mCursorY);
-
-                }
-                else if (mHasFocus){
-
-                    mHasFocus = false;
-                    LostFocus();
-
-                    mWidgetManager->MouseExit(mDDInterface->mCursorX, mDDInterface->mCursorY);
-
-                    if (mMuteOnLostFocus)
-                        Mute(true);
-                }
+                HandleFocus(test_event.active.gain == 1);
                 break;
 #endif
 
             case SDL_QUIT:
+                if (mInputRecorder != NULL)
+                    mInputRecorder->Record(InputRecord_Quit);
                 Shutdown();
                 break;
 
@@ -1655,6 +1633,96 @@ void SexyAppBase::UpdateAppStep(bool* updated)
 }
 
 
+void SexyAppBase::HandleMouseMove(int x, int y)
+{
+    if (mInputRecorder != NULL)
+        mInputRecorder->Record(InputRecord_MouseMove, x, y);
+
+    //FIXME
+    if (/*(!gInAssert) &&*/ (!mSEHOccured))
+    {
+
+        mDDInterface->mCursorX = x;
+        mDDInterface->mCursorY = y;
+        mWidgetManager->RemapMouse(mDDInterface->mCursorX, mDDInterface->mCursorY);
+
+        mLastUserInputTick = mLastTimerTime;
+
+        mWidgetManager->MouseMove(mDDInterface->mCursorX, mDDInterface->mCursorY);
+
+        if (!mMouseIn) {
+            mMouseIn = true;
+
+            EnforceCursor();
+        }
+    }
+}
+
+// theButton is 1 for left, -1 for right and 3 for the middle button
+void SexyAppBase::HandleMouseButton(int x, int y, int theButton, bool isUp)
+{
+    if (mInputRecorder != NULL)
+        mInputRecorder->Record(isUp ? InputRecord_MouseUp : InputRecord_MouseDown, x, y, (uint32_t) theButton);
+
+    if (isUp)
+        mWidgetManager->MouseUp(x, y, theButton);
+    else
+        mWidgetManager->MouseDown(x, y, theButton);
+}
+
+void SexyAppBase::HandleKey(SDL_Keycode theKey, bool isUp)
+{
+    if (mInputRecorder != NULL)
+        mInputRecorder->Record(isUp ? InputRecord_KeyUp : InputRecord_KeyDown, 0, 0, (uint32_t) theKey);
+
+    mLastUserInputTick = mLastTimerTime;
+    if (theKey == SDLK_F3 && (SDL_GetModState() & KMOD_CTRL)) {
+        if (!isUp)
+            ShowStats(!IsShowingStats());
+        return;
+    }
+    if (theKey == SDLK_F4 && (SDL_GetModState() & KMOD_CTRL)) {
+        if (!isUp) {
+            std::string aDump;
+            DumpMemoryUsage(aDump);
+            fputs(aDump.c_str(), stdout);
+        }
+        return;
+    }
+    if (isUp) {
+        mWidgetManager->KeyUp(GetKeyCodeFromSDLKey(theKey));
+    } else {
+        mWidgetManager->KeyDown(GetKeyCodeFromSDLKey(theKey));
+        if (theKey >= SDLK_a && theKey <= SDLK_z)
+            mWidgetManager->KeyChar((SexyChar)*SDL_GetKeyName(theKey));
+    }
+}
+
+void SexyAppBase::HandleFocus(bool hasFocus)
+{
+    if (mInputRecorder != NULL)
+        mInputRecorder->Record(InputRecord_Focus, 0, 0, hasFocus ? 1 : 0);
+
+    if (hasFocus) {
+        mHasFocus = true;
+        GotFocus();
+
+        if (mMuteOnLostFocus)
+            Unmute(true);
+
+        mWidgetManager->MouseMove(mDDInterface->mCursorX, mDDInterface->mCursorY);
+    }
+    else if (mHasFocus) {
+        mHasFocus = false;
+        LostFocus();
+
+        mWidgetManager->MouseExit(mDDInterface->mCursorX, mDDInterface->mCursorY);
+
+        if (mMuteOnLostFocus)
+            Mute(true);
+    }
+}
+
 void SexyAppBase::DoUpdateFramesF(float theFrac)
 {
     if ((!mMinimized))
@@ -1663,8 +1731,15 @@ void SexyAppBase::DoUpdateFramesF(float theFrac)
 
 bool SexyAppBase::DoUpdateFrames()
 {
-    if (mLoadingThreadCompleted && !mLoaded)
+    // A replay sees loading done in the same update as the recording did
+    bool isLoaded = mLoadingThreadCompleted;
+    if (mInputRecorder != NULL && mInputRecorder->IsReplaying())
+        isLoaded = mInputRecorder->ReplayLoaded();
+
+    if (isLoaded && !mLoaded)
     {
+        if (mInputRecorder != NULL)
+            mInputRecorder->Record(InputRecord_Loaded);
         mLoaded = true;
         mYieldMainThread = false;
         LoadingThreadCompleted();
@@ -1703,6 +1778,8 @@ bool SexyAppBase::DrawDirtyStuff()
     bool drewScreen = mWidgetManager->DrawScreen();
     mIsDrawing = false;
 
+    mResourceManager->UpdateImageMemory();
+
 	//custom mouse pointers need page flipping
     if ((drewScreen || mCustomCursorsEnabled || (mCustomCursorDirty))
 )
@@ -1722,12 +1799,14 @@ bool SexyAppBase::DrawDirtyStuff()
 
         mHasPendingDraw = false;
         mCustomCursorDirty = false;
+        FrameCounters::EndFrame();
         return true;
     }
     else
     {
         mHasPendingDraw = false;
         mLastDrawWasEmpty = true;
+        FrameCounters::EndFrame();
         return false;
     }
     return false;
@@ -1739,6 +1818,10 @@ void SexyAppBase::LoadingThreadCompleted()
 
 void SexyAppBase::UpdateFTimeAcc()
 {
+    // A replay runs at a fixed timestep, see Process()
+    if (mInputRecorder != NULL && mInputRecorder->IsReplaying())
+        return;
+
     Uint32 aCurTime = SDL_GetTicks();
 
     if (mLastTimeCheck != 0)
@@ -1765,6 +1848,8 @@ bool SexyAppBase::Process(bool allowSleep)
     aFrameFTime1 = 10.0f;
     aFrameFTime = 10;
     anUpdatesPerUpdateF = 1.0;
+
+    InputRecorder* aReplay = mInputRecorder != NULL && mInputRecorder->IsReplaying() ? mInputRecorder : NULL;
     // Make sure we're not paused
     if ((!mPaused))
     {
@@ -1791,7 +1876,11 @@ bool SexyAppBase::Process(bool allowSleep)
 
                 if (doUpdate)
                 {
+                    if (aReplay != NULL)
+                        aReplay->StartTiming();
 					bool hadRealUpdate = DoUpdateFrames();
+                    if (aReplay != NULL)
+                        aReplay->AddUpdateTime();
 					if (hadRealUpdate)
 						mUpdateAppState = UPDATESTATE_PROCESS_2;
 					mHasPendingDraw = true;
@@ -1802,6 +1891,8 @@ bool SexyAppBase::Process(bool allowSleep)
         else if (mUpdateAppState == UPDATESTATE_PROCESS_2)
         {
             mUpdateAppState = UPDATESTATE_PROCESS_DONE;
+            if (aReplay != NULL)
+                aReplay->StartTiming();
 
             mPendingUpdatesAcc += anUpdatesPerUpdateF;
             mPendingUpdatesAcc -= 1.0f;
@@ -1827,6 +1918,8 @@ bool SexyAppBase::Process(bool allowSleep)
             ProcessSafeDeleteList();
 
             mUpdateFTimeAcc -= aFrameFTime;
+            if (aReplay != NULL)
+                aReplay->AddUpdateTime();
 
             didUpdate = true;
         }
@@ -1837,7 +1930,18 @@ bool SexyAppBase::Process(bool allowSleep)
 
             mNonDrawCount = 0;
 
-            if (mHasPendingDraw)
+            if (aReplay != NULL)
+            {
+                // No waiting, the next update is due right away
+                if (mHasPendingDraw)
+                {
+                    aReplay->StartTiming();
+                    DrawDirtyStuff();
+                    aReplay->AddDrawTime();
+                }
+                mUpdateFTimeAcc += aFrameFTime;
+            }
+            else if (mHasPendingDraw)
             {
 				DrawDirtyStuff();
             }
@@ -2171,6 +2275,8 @@ SoundManager* SexyAppBase::CreateSoundManager()
     return new AudiereSoundManager;
 #elif defined(USE_SDLMIXER)
     return new SDLMixerSoundManager;
+#elif defined(USE_SOFTMIXER)
+    return new SoftMixerSoundManager;
 #endif
     return NULL;
 }
@@ -2188,6 +2294,12 @@ MusicInterface* SexyAppBase::CreateMusicInterface()
     return new AudiereMusicInterface(mInvisHWnd);
 #elif defined(USE_SDLMIXER)
     return new SDLMixerMusicInterface(NULL);
+#elif defined(USE_SOFTMIXER)
+    // The music is mixed by the sound manager's mixer
+    SoftMixerSoundManager* aSoundManager = dynamic_cast<SoftMixerSoundManager*>(mSoundManager);
+    if (aSoundManager != NULL)
+        return new SoftMixerMusicInterface(aSoundManager->GetMixer());
+    return new MusicInterface;
 #endif
     return NULL;
 }
@@ -3355,6 +3467,49 @@ void SexyAppBase::EnforceCursor()
     }
 }
 
+void SexyAppBase::ShowStats(bool show, Font* theFont)
+{
+    if (mStatsWidget == NULL) {
+        if (!show)
+            return;
+        mStatsWidget = new StatsWidget();
+    }
+    if (theFont != NULL)
+        mStatsWidget->mFont = theFont;
+
+    mWidgetManager->SetOverlayWidget(show ? mStatsWidget : NULL);
+}
+
+bool SexyAppBase::IsShowingStats()
+{
+    return mStatsWidget != NULL && mWidgetManager->mOverlayWidget == mStatsWidget;
+}
+
+void SexyAppBase::GetMemoryUsage(MemoryReport& theReport)
+{
+    if (mResourceManager != NULL)
+        mResourceManager->GetMemoryUsage(theReport);
+
+    // Images loaded by the program, or by resources that didn't say
+    ImageSet::iterator anItr = mImageSet.begin();
+    for (; anItr != mImageSet.end(); ++anItr) {
+        MemoryEntry anEntry;
+        anEntry.mName = (*anItr)->GetFilePath().empty() ? StrFormat("image %p", (void*) *anItr) : (*anItr)->GetFilePath();
+        anEntry.mGroup = "images";
+        if (theReport.AddImageBuffers(anEntry, *anItr))
+            theReport.Add(anEntry);
+    }
+
+    theReport.AddTracked();
+}
+
+void SexyAppBase::DumpMemoryUsage(std::string& theDestStr, int theMaxEntries)
+{
+    MemoryReport aReport;
+    GetMemoryUsage(aReport);
+    aReport.Dump(theDestStr, theMaxEntries);
+}
+
 void SexyAppBase::SetCursorImage(int theCursorNum, Image* theImage)
 {
     if ((theCursorNum >= 0) && (theCursorNum < NUM_CURSORS))
@@ -3561,12 +3716,34 @@ int SexyAppBase::ParseCommandLine(int argc, char** argv)
     if (opt->getFlag("software") || opt->getFlag('s')) {
         mUseSoftwareRenderer = true;
     }
+    if (opt->getFlag("stats")) {
+        ShowStats(true);
+    }
+    if (opt->getFlag("track-memory") && !MemoryStats::TrackChipmunk()) {
+        fprintf(stderr, "--track-memory: chipmunk is in use already\n");
+    }
 
     if (opt->getValue("resource-dir") != NULL) {
         std::string rsc_dir = opt->getValue("resource-dir");
         SetAppResourceFolder(rsc_dir);
     }
 
+    if (opt->getValue("record") != NULL) {
+        mRecordFile = opt->getValue("record");
+    }
+    if (opt->getValue("replay") != NULL) {
+        // A replay doesn't record
+        mRecordFile = "";
+        mReplayFile = opt->getValue("replay");
+        if (opt->getValue("replay-timings") != NULL)
+            mReplayTimingsFile = opt->getValue("replay-timings");
+        // Headless, CmdLine::ParseCommandLine picked SDL's dummy drivers
+        mWindowedMode = true;
+        mFullScreenMode = false;
+        if (!mUseOpenGL)
+            mUseSoftwareRenderer = true;
+    }
+
     /* 8. DONE */
     return 0;
 }
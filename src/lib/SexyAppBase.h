@@ -57,6 +57,10 @@ class DDInterface;
 class D3DInterface;
 
 class ResourceManager;
+class InputRecorder;
+class StatsWidget;
+class MemoryReport;
+class Font;
 class Dialog;
 typedef std::map<int, Dialog*> DialogMap;
 typedef std::list<Dialog*> DialogList;
@@ -222,6 +226,7 @@ public:
     bool                    mTabletPC;
     bool                    mAlphaDisabled;
     bool                    mLookForAlpha;
+    int                     mImageCacheSize;        // MB of decoded images kept in the app data folder, 0 for none
 
     bool                    mReadFromRegistry;
     bool                    mIsOpeningURL;
@@ -296,6 +301,13 @@ public:
     int                     mDemoCmdBitPos;
     bool                    mDemoLoadingComplete;
 
+    InputRecorder*          mInputRecorder;
+    std::string             mRecordFile;
+    std::string             mReplayFile;
+    std::string             mReplayTimingsFile;
+
+    StatsWidget*            mStatsWidget;
+
     int                     mCurHandleNum;
 
     typedef std::pair<std::string, int> DemoMarker;
@@ -472,6 +484,14 @@ public:
     void                    SetCursorImage(int theCursorNum, Image* theImage);
     int                     GetCursor();
     void                    EnableCustomCursors(bool enabled);
+    // The FrameCounters overlay, Ctrl+F3 toggles it too. Without a font,
+    // from now or before, it only has bars.
+    void                    ShowStats(bool show, Font* theFont = NULL);
+    bool                    IsShowingStats();
+    // The resources of mResourceManager, the other images and what
+    // MemoryStats tracks. Ctrl+F4 prints the dump.
+    void                    GetMemoryUsage(MemoryReport& theReport);
+    void                    DumpMemoryUsage(std::string& theDestStr, int theMaxEntries = 20);
 
     // Registry access methods
     bool                    RegistryGetSubKeys(const std::string& theKeyName, StringVector* theSubKeys);
@@ -515,6 +535,13 @@ public:
 
     int                     ParseCommandLine(int argc, char** argv);
 
+    // Input as dispatched to the widgets, in game coordinates. Real events
+    // and InputRecorder replays go through here, and it is recorded here.
+    void                    HandleMouseMove(int x, int y);
+    void                    HandleMouseButton(int x, int y, int theButton, bool isUp);
+    void                    HandleKey(SDL_Keycode theKey, bool isUp);
+    void                    HandleFocus(bool hasFocus);
+
     std::string             GetAppDataFolder() const              { return mAppDataFolder; }
     void                    SetAppDataFolder(const std::string & thePath);
     std::string             GetAppResourceFolder() const          { return mAppResourceFolder; }
@@ -0,0 +1,893 @@
+#include "SoftMixer.h"
+#include "Common.h"
+
+#include <string.h>
+#include <math.h>
+
+#ifdef HAVE_VORBISFILE
+#include <vorbis/vorbisfile.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define SOFTMIXER_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace Sexy;
+
+#define MIX_BLOCK_FRAMES        256     // Voices are mixed in blocks of this many frames
+#define COMMAND_QUEUE_SIZE      4096
+#define STREAM_BUFFER_FRAMES    8192
+#define MAX_STEP                8.0     // Fastest a voice may play through its source
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
+// theDest += theSrc * gain, stereo into stereo, with the gain of each side
+// going up by theGainStep every frame.
+static void MixStereo(float* theDest, const float* theSrc, int theFrames, const float* theGain, const float* theGainStep)
+{
+    int i = 0;
+#ifdef SOFTMIXER_SSE2
+    __m128 aGain = _mm_setr_ps(theGain[0], theGain[1], theGain[0] + theGainStep[0], theGain[1] + theGainStep[1]);
+    __m128 aGainStep = _mm_setr_ps(2 * theGainStep[0], 2 * theGainStep[1], 2 * theGainStep[0], 2 * theGainStep[1]);
+    for (; i + 2 <= theFrames; i += 2)
+    {
+        __m128 aSrc = _mm_loadu_ps(theSrc + i * 2);
+        __m128 aDest = _mm_loadu_ps(theDest + i * 2);
+        _mm_storeu_ps(theDest + i * 2, _mm_add_ps(aDest, _mm_mul_ps(aSrc, aGain)));
+        aGain = _mm_add_ps(aGain, aGainStep);
+    }
+#endif
+    for (; i < theFrames; i++)
+    {
+        theDest[i * 2] += theSrc[i * 2] * (theGain[0] + i * theGainStep[0]);
+        theDest[i * 2 + 1] += theSrc[i * 2 + 1] * (theGain[1] + i * theGainStep[1]);
+    }
+}
+
+// The same for a mono source
+static void MixMono(float* theDest, const float* theSrc, int theFrames, const float* theGain, const float* theGainStep)
+{
+    int i = 0;
+#ifdef SOFTMIXER_SSE2
+    __m128 aGain = _mm_setr_ps(theGain[0], theGain[1], theGain[0] + theGainStep[0], theGain[1] + theGainStep[1]);
+    __m128 aGainStep = _mm_setr_ps(2 * theGainStep[0], 2 * theGainStep[1], 2 * theGainStep[0], 2 * theGainStep[1]);
+    for (; i + 2 <= theFrames; i += 2)
+    {
+        __m128 aPair = _mm_castpd_ps(_mm_load_sd((const double*) (theSrc + i)));
+        __m128 aSrc = _mm_unpacklo_ps(aPair, aPair);
+        __m128 aDest = _mm_loadu_ps(theDest + i * 2);
+        _mm_storeu_ps(theDest + i * 2, _mm_add_ps(aDest, _mm_mul_ps(aSrc, aGain)));
+        aGain = _mm_add_ps(aGain, aGainStep);
+    }
+#endif
+    for (; i < theFrames; i++)
+    {
+        theDest[i * 2] += theSrc[i] * (theGain[0] + i * theGainStep[0]);
+        theDest[i * 2 + 1] += theSrc[i] * (theGain[1] + i * theGainStep[1]);
+    }
+}
+
+// Linear interpolation for voices that don't play at the output rate
+static void MixResampled(float* theDest, const float* theSrc, int theChannels, int theSrcFrames, double* thePos, double theStep,
+                         int theFrames, const float* theGain, const float* theGainStep)
+{
+    double aPos = *thePos;
+    float aGainL = theGain[0];
+    float aGainR = theGain[1];
+    int aLast = theSrcFrames - 1;
+
+    for (int i = 0; i < theFrames; i++)
+    {
+        int anIndex = (int) aPos;
+        int aNext = anIndex < aLast ? anIndex + 1 : aLast;
+        float aFrac = (float) (aPos - anIndex);
+
+        float aLeft, aRight;
+        if (theChannels == 1)
+        {
+            aLeft = theSrc[anIndex] + (theSrc[aNext] - theSrc[anIndex]) * aFrac;
+            aRight = aLeft;
+        }
+        else
+        {
+            aLeft = theSrc[anIndex * 2] + (theSrc[aNext * 2] - theSrc[anIndex * 2]) * aFrac;
+            aRight = theSrc[anIndex * 2 + 1] + (theSrc[aNext * 2 + 1] - theSrc[anIndex * 2 + 1]) * aFrac;
+        }
+
+        theDest[i * 2] += aLeft * aGainL;
+        theDest[i * 2 + 1] += aRight * aGainR;
+
+        aGainL += theGainStep[0];
+        aGainR += theGainStep[1];
+        aPos += theStep;
+    }
+
+    *thePos = aPos;
+}
+
+// theDest += theSrc * gain for interleaved stereo, the same gain on both sides
+static void MixBus(float* theDest, const float* theSrc, int theFrames, float theGain, float theGainStep)
+{
+    float aGain[2] = { theGain, theGain };
+    float aGainStep[2] = { theGainStep, theGainStep };
+    MixStereo(theDest, theSrc, theFrames, aGain, aGainStep);
+}
+
+static void ClampSamples(float* theSamples, int theCount)
+{
+    int i = 0;
+#ifdef SOFTMIXER_SSE2
+    __m128 aMin = _mm_set1_ps(-1.0f);
+    __m128 aMax = _mm_set1_ps(1.0f);
+    for (; i + 4 <= theCount; i += 4)
+        _mm_storeu_ps(theSamples + i, _mm_max_ps(aMin, _mm_min_ps(aMax, _mm_loadu_ps(theSamples + i))));
+#endif
+    for (; i < theCount; i++)
+        theSamples[i] = std::max(-1.0f, std::min(1.0f, theSamples[i]));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+SoftMixer::SoftMixer(int theNumVoices, int theRate, int theBufferFrames, bool openDevice)
+{
+    mDevice = 0;
+    mRate = theRate;
+    mBufferFrames = theBufferFrames;
+
+    Voice anIdleVoice;
+    memset(&anIdleVoice, 0, sizeof(anIdleVoice));
+    mVoices.resize(theNumVoices, anIdleVoice);
+    mVoiceUsed.resize(theNumVoices, false);
+    mVoiceSerials.resize(theNumVoices, 0);
+    mVoiceStopped.resize(theNumVoices, true);
+    mVoiceDone = new SDL_atomic_t[theNumVoices];
+    for (int i = 0; i < theNumVoices; i++)
+        SDL_AtomicSet(&mVoiceDone[i], 0);
+
+    mLock = SDL_CreateMutex();
+    mCommands.resize(COMMAND_QUEUE_SIZE);
+    SDL_AtomicSet(&mCommandRead, 0);
+    SDL_AtomicSet(&mCommandWrite, 0);
+
+    for (int i = 0; i < NUM_MIXER_BUSES; i++)
+    {
+        mBusVolumes[i] = 1.0f;
+        mMixBusVolumes[i] = 1.0f;
+        mBusGains[i] = 1.0f;
+        mBusBuffers[i] = new float[MIX_BLOCK_FRAMES * 2];
+    }
+    mMasterVolume = 1.0f;
+    mMixMasterVolume = 1.0f;
+
+    if (!openDevice)
+        return;
+
+    SDL_AudioSpec aWanted;
+    SDL_AudioSpec anObtained;
+    memset(&aWanted, 0, sizeof(aWanted));
+    aWanted.freq = theRate;
+    aWanted.format = AUDIO_F32SYS;
+    aWanted.channels = 2;
+    aWanted.samples = theBufferFrames;
+    aWanted.callback = AudioCallback;
+    aWanted.userdata = this;
+
+    // SDL converts to whatever the device really wants
+    mDevice = SDL_OpenAudioDevice(NULL, 0, &aWanted, &anObtained, 0);
+    if (mDevice == 0)
+    {
+        printf("SDL_OpenAudioDevice failed: %s\n", SDL_GetError());
+        return;
+    }
+
+    mBufferFrames = anObtained.samples;
+    SDL_PauseAudioDevice(mDevice, 0);
+}
+
+SoftMixer::~SoftMixer()
+{
+    if (mDevice != 0)
+        SDL_CloseAudioDevice(mDevice);
+
+    for (int i = 0; i < NUM_MIXER_BUSES; i++)
+        delete [] mBusBuffers[i];
+    delete [] mVoiceDone;
+    SDL_DestroyMutex(mLock);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+int SoftMixer::AllocVoice()
+{
+    AutoMutex aLock(mLock);
+    for (size_t i = 0; i < mVoiceUsed.size(); i++)
+    {
+        if (!mVoiceUsed[i])
+        {
+            mVoiceUsed[i] = true;
+            return i;
+        }
+    }
+    return -1;
+}
+
+void SoftMixer::FreeVoice(int theVoice)
+{
+    AutoMutex aLock(mLock);
+    Stop(theVoice, 0);
+    mVoiceUsed[theVoice] = false;
+}
+
+int SoftMixer::MsToFrames(int theMs)
+{
+    return (int) ((Sint64) theMs * mRate / 1000);
+}
+
+void SoftMixer::PushCommand(const Command& theCommand)
+{
+    // One writer at a time
+    AutoMutex aLock(mLock);
+    int aWrite = SDL_AtomicGet(&mCommandWrite);
+    int aNext = (aWrite + 1) % COMMAND_QUEUE_SIZE;
+
+    while (aNext == SDL_AtomicGet(&mCommandRead))
+    {
+        // Full. Without a device nobody else is going to empty it.
+        if (mDevice == 0)
+            RunCommands();
+        else
+            SDL_Delay(1);
+    }
+
+    mCommands[aWrite] = theCommand;
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&mCommandWrite, aNext);
+}
+
+void SoftMixer::Play(int theVoice, const MixerSample* theSample, int theBus, bool looping, float theVolume, float thePan, float thePitch)
+{
+    AutoMutex aLock(mLock);
+    Command aCommand;
+    memset(&aCommand, 0, sizeof(aCommand));
+    aCommand.mType = CMD_PLAY;
+    aCommand.mVoice = theVoice;
+    aCommand.mSerial = ++mVoiceSerials[theVoice];
+    mVoiceStopped[theVoice] = false;
+    aCommand.mSample = theSample;
+    aCommand.mVolume = theVolume;
+    aCommand.mPan = thePan;
+    aCommand.mPitch = thePitch;
+    aCommand.mFlag = looping;
+    aCommand.mBus = theBus;
+    PushCommand(aCommand);
+}
+
+void SoftMixer::PlayStream(int theVoice, MixerStream* theStream, int theBus, bool looping, float theVolume, float thePan)
+{
+    AutoMutex aLock(mLock);
+    // Done here so the audio thread never allocates
+    theStream->mBuffer.resize(STREAM_BUFFER_FRAMES * theStream->mChannels);
+
+    Command aCommand;
+    memset(&aCommand, 0, sizeof(aCommand));
+    aCommand.mType = CMD_PLAY_STREAM;
+    aCommand.mVoice = theVoice;
+    aCommand.mSerial = ++mVoiceSerials[theVoice];
+    mVoiceStopped[theVoice] = false;
+    aCommand.mStream = theStream;
+    aCommand.mVolume = theVolume;
+    aCommand.mPan = thePan;
+    aCommand.mPitch = 1.0f;
+    aCommand.mFlag = looping;
+    aCommand.mBus = theBus;
+    PushCommand(aCommand);
+}
+
+void SoftMixer::Stop(int theVoice, int theFadeMs)
+{
+    AutoMutex aLock(mLock);
+    // From here on IsPlaying() is false
+    mVoiceStopped[theVoice] = true;
+
+    Command aCommand;
+    memset(&aCommand, 0, sizeof(aCommand));
+    aCommand.mType = CMD_STOP;
+    aCommand.mVoice = theVoice;
+    aCommand.mRampFrames = MsToFrames(theFadeMs);
+    PushCommand(aCommand);
+}
+
+void SoftMixer::SetPaused(int theVoice, bool paused)
+{
+    Command aCommand;
+    memset(&aCommand, 0, sizeof(aCommand));
+    aCommand.mType = CMD_PAUSE;
+    aCommand.mVoice = theVoice;
+    aCommand.mFlag = paused;
+    PushCommand(aCommand);
+}
+
+void SoftMixer::SetGain(int theVoice, float theVolume, float thePan, int theRampMs)
+{
+    Command aCommand;
+    memset(&aCommand, 0, sizeof(aCommand));
+    aCommand.mType = CMD_GAIN;
+    aCommand.mVoice = theVoice;
+    aCommand.mVolume = theVolume;
+    aCommand.mPan = thePan;
+    aCommand.mRampFrames = MsToFrames(theRampMs);
+    PushCommand(aCommand);
+}
+
+void SoftMixer::SetPitch(int theVoice, float thePitch)
+{
+    Command aCommand;
+    memset(&aCommand, 0, sizeof(aCommand));
+    aCommand.mType = CMD_PITCH;
+    aCommand.mVoice = theVoice;
+    aCommand.mPitch = thePitch;
+    PushCommand(aCommand);
+}
+
+bool SoftMixer::IsPlaying(int theVoice)
+{
+    AutoMutex aLock(mLock);
+    return !mVoiceStopped[theVoice] && SDL_AtomicGet(&mVoiceDone[theVoice]) != mVoiceSerials[theVoice];
+}
+
+void SoftMixer::SetBusVolume(int theBus, float theVolume)
+{
+    AutoMutex aLock(mLock);
+    mBusVolumes[theBus] = theVolume;
+
+    Command aCommand;
+    memset(&aCommand, 0, sizeof(aCommand));
+    aCommand.mType = CMD_BUS_VOLUME;
+    aCommand.mVoice = theBus;
+    aCommand.mVolume = theVolume;
+    PushCommand(aCommand);
+}
+
+void SoftMixer::SetMasterVolume(float theVolume)
+{
+    AutoMutex aLock(mLock);
+    mMasterVolume = theVolume;
+
+    Command aCommand;
+    memset(&aCommand, 0, sizeof(aCommand));
+    aCommand.mType = CMD_MASTER_VOLUME;
+    aCommand.mVolume = theVolume;
+    PushCommand(aCommand);
+}
+
+void SoftMixer::Forget(const MixerSample* theSample)
+{
+    AutoMutex aLock(mLock);
+
+    // With the device locked the audio thread is out of the way, so the
+    // queue and the voices can be dealt with from here
+    if (mDevice != 0)
+        SDL_LockAudioDevice(mDevice);
+
+    RunCommands();
+    for (size_t i = 0; i < mVoices.size(); i++)
+    {
+        if (mVoices[i].mSample == theSample)
+            EndVoice(i);
+    }
+
+    if (mDevice != 0)
+        SDL_UnlockAudioDevice(mDevice);
+}
+
+void SoftMixer::Forget(MixerStream* theStream)
+{
+    AutoMutex aLock(mLock);
+    if (mDevice != 0)
+        SDL_LockAudioDevice(mDevice);
+
+    RunCommands();
+    for (size_t i = 0; i < mVoices.size(); i++)
+    {
+        if (mVoices[i].mStream == theStream)
+            EndVoice(i);
+    }
+
+    if (mDevice != 0)
+        SDL_UnlockAudioDevice(mDevice);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Audio thread
+///////////////////////////////////////////////////////////////////////////////
+void SoftMixer::RunCommands()
+{
+    int aRead = SDL_AtomicGet(&mCommandRead);
+    int aWrite = SDL_AtomicGet(&mCommandWrite);
+    SDL_MemoryBarrierAcquire();
+
+    while (aRead != aWrite)
+    {
+        RunCommand(mCommands[aRead]);
+        aRead = (aRead + 1) % COMMAND_QUEUE_SIZE;
+    }
+
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&mCommandRead, aRead);
+}
+
+void SoftMixer::RunCommand(const Command& theCommand)
+{
+    if (theCommand.mType == CMD_BUS_VOLUME)
+    {
+        mMixBusVolumes[theCommand.mVoice] = theCommand.mVolume;
+        return;
+    }
+    if (theCommand.mType == CMD_MASTER_VOLUME)
+    {
+        mMixMasterVolume = theCommand.mVolume;
+        return;
+    }
+
+    Voice* aVoice = &mVoices[theCommand.mVoice];
+    switch (theCommand.mType)
+    {
+    case CMD_PLAY:
+    case CMD_PLAY_STREAM:
+        aVoice->mSample = theCommand.mSample;
+        aVoice->mStream = theCommand.mStream;
+        aVoice->mSerial = theCommand.mSerial;
+        aVoice->mBus = theCommand.mBus;
+        aVoice->mLooping = theCommand.mFlag;
+        aVoice->mPaused = false;
+        aVoice->mStopping = false;
+        aVoice->mPos = 0;
+        aVoice->mPitch = theCommand.mPitch;
+        SetTarget(aVoice, theCommand.mVolume, theCommand.mPan, 0);
+        if (aVoice->mStream != NULL)
+        {
+            aVoice->mStream->mBufferFrames = 0;
+            aVoice->mStream->mEnded = false;
+            aVoice->mStream->Rewind();
+        }
+        break;
+
+    case CMD_STOP:
+        if (theCommand.mRampFrames <= 0 || aVoice->mPaused)
+        {
+            EndVoice(theCommand.mVoice);
+        }
+        else if (aVoice->mSample != NULL || aVoice->mStream != NULL)
+        {
+            aVoice->mStopping = true;
+            SetTarget(aVoice, 0, 0, theCommand.mRampFrames);
+        }
+        break;
+
+    case CMD_PAUSE:
+        aVoice->mPaused = theCommand.mFlag;
+        break;
+
+    case CMD_GAIN:
+        if (!aVoice->mStopping)
+            SetTarget(aVoice, theCommand.mVolume, theCommand.mPan, theCommand.mRampFrames);
+        break;
+
+    case CMD_PITCH:
+        aVoice->mPitch = theCommand.mPitch;
+        break;
+    }
+}
+
+void SoftMixer::SetTarget(Voice* theVoice, float theVolume, float thePan, int theRampFrames)
+{
+    thePan = std::max(-1.0f, std::min(1.0f, thePan));
+    theVoice->mTarget[0] = theVolume * (thePan > 0 ? 1.0f - thePan : 1.0f);
+    theVoice->mTarget[1] = theVolume * (thePan < 0 ? 1.0f + thePan : 1.0f);
+
+    if (theRampFrames <= 0)
+    {
+        theVoice->mGain[0] = theVoice->mTarget[0];
+        theVoice->mGain[1] = theVoice->mTarget[1];
+    }
+    theVoice->mRampFrames = std::max(theRampFrames, 0);
+}
+
+void SoftMixer::EndVoice(int theVoice)
+{
+    Voice* aVoice = &mVoices[theVoice];
+    aVoice->mSample = NULL;
+    aVoice->mStream = NULL;
+    aVoice->mStopping = false;
+    SDL_AtomicSet(&mVoiceDone[theVoice], aVoice->mSerial);
+}
+
+// Makes sure the stream buffer holds theFrames frames from where the voice
+// is at. Returns how many it really holds, fewer once the stream has ended.
+int SoftMixer::FillStream(MixerStream* theStream, bool looping, int theFrames)
+{
+    int aChannels = theStream->mChannels;
+    int aCapacity = theStream->mBuffer.size() / aChannels;
+    float* aBuffer = &theStream->mBuffer[0];
+
+    theFrames = std::min(theFrames, aCapacity);
+    bool rewound = false;
+    while (theStream->mBufferFrames < theFrames && !theStream->mEnded)
+    {
+        int aRead = theStream->Read(aBuffer + theStream->mBufferFrames * aChannels, theFrames - theStream->mBufferFrames);
+        if (aRead > 0)
+        {
+            theStream->mBufferFrames += aRead;
+            rewound = false;
+        }
+        else if (looping && !rewound && theStream->Rewind())
+        {
+            rewound = true;     // An empty stream shouldn't loop forever
+        }
+        else
+        {
+            theStream->mEnded = true;
+        }
+    }
+
+    return theStream->mBufferFrames;
+}
+
+void SoftMixer::MixVoice(int theVoice, int theFrames)
+{
+    Voice* aVoice = &mVoices[theVoice];
+    float* aDest = mBusBuffers[aVoice->mBus];
+
+    int aChannels = aVoice->mSample != NULL ? aVoice->mSample->mChannels : aVoice->mStream->mChannels;
+    int aRate = aVoice->mSample != NULL ? aVoice->mSample->mRate : aVoice->mStream->mRate;
+    double aStep = std::min((double) aRate / mRate * aVoice->mPitch, MAX_STEP);
+    if (aStep <= 0)
+        return;
+
+    int aDone = 0;
+    while (aDone < theFrames)
+    {
+        int aCount = theFrames - aDone;
+        if (aVoice->mRampFrames > 0)
+            aCount = std::min(aCount, aVoice->mRampFrames);
+
+        const float* aData;
+        int aSrcFrames;
+        if (aVoice->mSample != NULL)
+        {
+            aData = aVoice->mSample->mData;
+            aSrcFrames = aVoice->mSample->mFrames;
+        }
+        else
+        {
+            // Drop what has been played, then top up
+            MixerStream* aStream = aVoice->mStream;
+            int aPlayed = std::min((int) aVoice->mPos, aStream->mBufferFrames);
+            if (aPlayed > 0)
+            {
+                memmove(&aStream->mBuffer[0], &aStream->mBuffer[aPlayed * aChannels], (aStream->mBufferFrames - aPlayed) * aChannels * sizeof(float));
+                aStream->mBufferFrames -= aPlayed;
+                aVoice->mPos -= aPlayed;
+            }
+            aData = &aStream->mBuffer[0];
+            aSrcFrames = FillStream(aStream, aVoice->mLooping, (int) ceil(aVoice->mPos + aCount * aStep) + 1);
+        }
+
+        if (aVoice->mPos >= aSrcFrames)
+        {
+            if (aVoice->mSample != NULL && aVoice->mLooping && aSrcFrames > 0)
+            {
+                aVoice->mPos = fmod(aVoice->mPos, (double) aSrcFrames);
+                continue;
+            }
+            EndVoice(theVoice);
+            return;
+        }
+
+        // Stop at the end of the source
+        int anAvailable = (int) ceil((aSrcFrames - aVoice->mPos) / aStep);
+        aCount = std::min(aCount, std::max(anAvailable, 1));
+
+        float aGainStep[2] = { 0, 0 };
+        if (aVoice->mRampFrames > 0)
+        {
+            aGainStep[0] = (aVoice->mTarget[0] - aVoice->mGain[0]) / aVoice->mRampFrames;
+            aGainStep[1] = (aVoice->mTarget[1] - aVoice->mGain[1]) / aVoice->mRampFrames;
+        }
+
+        int anIndex = (int) aVoice->mPos;
+        if (aStep == 1.0 && anIndex == aVoice->mPos)
+        {
+            if (aChannels == 1)
+                MixMono(aDest + aDone * 2, aData + anIndex, aCount, aVoice->mGain, aGainStep);
+            else
+                MixStereo(aDest + aDone * 2, aData + anIndex * 2, aCount, aVoice->mGain, aGainStep);
+            aVoice->mPos += aCount;
+        }
+        else
+        {
+            MixResampled(aDest + aDone * 2, aData, aChannels, aSrcFrames, &aVoice->mPos, aStep, aCount, aVoice->mGain, aGainStep);
+        }
+
+        if (aVoice->mRampFrames > 0)
+        {
+            aVoice->mRampFrames -= aCount;
+            aVoice->mGain[0] += aGainStep[0] * aCount;
+            aVoice->mGain[1] += aGainStep[1] * aCount;
+            if (aVoice->mRampFrames <= 0)
+            {
+                aVoice->mGain[0] = aVoice->mTarget[0];
+                aVoice->mGain[1] = aVoice->mTarget[1];
+                if (aVoice->mStopping)
+                {
+                    EndVoice(theVoice);
+                    return;
+                }
+            }
+        }
+
+        aDone += aCount;
+    }
+}
+
+void SoftMixer::Mix(float* theOutput, int theFrames)
+{
+    RunCommands();
+
+    memset(theOutput, 0, theFrames * 2 * sizeof(float));
+
+    for (int aDone = 0; aDone < theFrames; aDone += MIX_BLOCK_FRAMES)
+    {
+        int aCount = std::min(theFrames - aDone, MIX_BLOCK_FRAMES);
+
+        bool busUsed[NUM_MIXER_BUSES];
+        for (int i = 0; i < NUM_MIXER_BUSES; i++)
+        {
+            memset(mBusBuffers[i], 0, aCount * 2 * sizeof(float));
+            busUsed[i] = false;
+        }
+
+        for (size_t i = 0; i < mVoices.size(); i++)
+        {
+            Voice* aVoice = &mVoices[i];
+            if ((aVoice->mSample == NULL && aVoice->mStream == NULL) || aVoice->mPaused)
+                continue;
+            busUsed[aVoice->mBus] = true;
+            MixVoice(i, aCount);
+        }
+
+        // Bus volume changes are spread over the block
+        for (int i = 0; i < NUM_MIXER_BUSES; i++)
+        {
+            float aTarget = mMixBusVolumes[i] * mMixMasterVolume;
+            float aGainStep = (aTarget - mBusGains[i]) / aCount;
+            if (busUsed[i])
+                MixBus(theOutput + aDone * 2, mBusBuffers[i], aCount, mBusGains[i], aGainStep);
+            mBusGains[i] = aTarget;
+        }
+    }
+
+    ClampSamples(theOutput, theFrames * 2);
+}
+
+void SDLCALL SoftMixer::AudioCallback(void* theArg, Uint8* theStream, int theLen)
+{
+    SoftMixer* aMixer = (SoftMixer*) theArg;
+    aMixer->Mix((float*) theStream, theLen / (2 * sizeof(float)));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Decoding
+///////////////////////////////////////////////////////////////////////////////
+#ifdef HAVE_VORBISFILE
+
+static size_t VorbisRead(void* thePtr, size_t theSize, size_t theCount, void* theSource)
+{
+    return SDL_RWread((SDL_RWops*) theSource, thePtr, theSize, theCount);
+}
+
+static int VorbisSeek(void* theSource, ogg_int64_t theOffset, int theWhence)
+{
+    return SDL_RWseek((SDL_RWops*) theSource, theOffset, theWhence) < 0 ? -1 : 0;
+}
+
+static int VorbisClose(void* theSource)
+{
+    return 0;   // The SDL_RWops is closed by whoever opened the file
+}
+
+static long VorbisTell(void* theSource)
+{
+    return (long) SDL_RWtell((SDL_RWops*) theSource);
+}
+
+static bool VorbisOpen(SDL_RWops* theRW, OggVorbis_File* theFile)
+{
+    ov_callbacks aCallbacks;
+    aCallbacks.read_func = VorbisRead;
+    aCallbacks.seek_func = VorbisSeek;
+    aCallbacks.close_func = VorbisClose;
+    aCallbacks.tell_func = VorbisTell;
+    return ov_open_callbacks(theRW, theFile, NULL, 0, aCallbacks) == 0;
+}
+
+// Reads up to theFrames interleaved frames of at most theChannels channels
+static int VorbisReadFrames(OggVorbis_File* theFile, float* theBuffer, int theFrames, int theChannels)
+{
+    int aDone = 0;
+    while (aDone < theFrames)
+    {
+        float** aPCM;
+        int aSection;
+        long aRead = ov_read_float(theFile, &aPCM, theFrames - aDone, &aSection);
+        if (aRead == OV_HOLE)
+            continue;
+        if (aRead <= 0)
+            break;
+
+        int aSrcChannels = ov_info(theFile, -1)->channels;
+        int aChannels = std::min(aSrcChannels, theChannels);
+        float* aDest = theBuffer + aDone * theChannels;
+        for (long i = 0; i < aRead; i++)
+        {
+            for (int c = 0; c < theChannels; c++)
+                aDest[i * theChannels + c] = aPCM[c < aChannels ? c : 0][i];
+        }
+        aDone += aRead;
+    }
+    return aDone;
+}
+
+class VorbisStream : public MixerStream
+{
+public:
+    SDL_RWops*              mRW;
+    OggVorbis_File          mFile;
+    bool                    mOpen;
+
+public:
+    VorbisStream(SDL_RWops* theRW) : mRW(theRW)
+    {
+        mOpen = VorbisOpen(theRW, &mFile);
+        if (mOpen)
+        {
+            vorbis_info* anInfo = ov_info(&mFile, -1);
+            mChannels = std::min(anInfo->channels, 2);
+            mRate = anInfo->rate;
+        }
+    }
+
+    virtual ~VorbisStream()
+    {
+        if (mOpen)
+            ov_clear(&mFile);
+        SDL_RWclose(mRW);
+    }
+
+    virtual int Read(float* theBuffer, int theFrames)
+    {
+        return VorbisReadFrames(&mFile, theBuffer, theFrames, mChannels);
+    }
+
+    virtual bool Rewind()
+    {
+        return ov_raw_seek(&mFile, 0) == 0;
+    }
+};
+
+static MixerSample* DecodeVorbis(SDL_RWops* theRW, int theMaxChannels)
+{
+    OggVorbis_File aFile;
+    if (!VorbisOpen(theRW, &aFile))
+        return NULL;
+
+    vorbis_info* anInfo = ov_info(&aFile, -1);
+    int aChannels = std::min(anInfo->channels, theMaxChannels);
+    int aRate = anInfo->rate;
+
+    std::vector<float> aData;
+    float aBuffer[4096];
+    int aFrames = 0;
+    for (;;)
+    {
+        int aRead = VorbisReadFrames(&aFile, aBuffer, 4096 / aChannels, aChannels);
+        if (aRead <= 0)
+            break;
+        aData.insert(aData.end(), aBuffer, aBuffer + aRead * aChannels);
+        aFrames += aRead;
+    }
+    ov_clear(&aFile);
+
+    if (aFrames == 0)
+        return NULL;
+
+    MixerSample* aSample = new MixerSample();
+    aSample->mData = new float[aData.size()];
+    memcpy(aSample->mData, &aData[0], aData.size() * sizeof(float));
+    aSample->mFrames = aFrames;
+    aSample->mChannels = aChannels;
+    aSample->mRate = aRate;
+    return aSample;
+}
+
+#endif
+
+static MixerSample* DecodeWav(SDL_RWops* theRW, int theMaxChannels)
+{
+    SDL_AudioSpec aSpec;
+    Uint8* aBuffer;
+    Uint32 aLength;
+    if (SDL_LoadWAV_RW(theRW, 0, &aSpec, &aBuffer, &aLength) == NULL)
+        return NULL;
+
+    // Only the sample format changes, the mixer resamples as it plays
+    int aChannels = std::min((int) aSpec.channels, theMaxChannels);
+    SDL_AudioCVT aCVT;
+    if (SDL_BuildAudioCVT(&aCVT, aSpec.format, aSpec.channels, aSpec.freq, AUDIO_F32SYS, aChannels, aSpec.freq) < 0)
+    {
+        SDL_FreeWAV(aBuffer);
+        return NULL;
+    }
+
+    aCVT.len = aLength;
+    aCVT.buf = (Uint8*) SDL_malloc(aLength * aCVT.len_mult);
+    memcpy(aCVT.buf, aBuffer, aLength);
+    SDL_FreeWAV(aBuffer);
+    if (aCVT.needed && SDL_ConvertAudio(&aCVT) < 0)
+    {
+        SDL_free(aCVT.buf);
+        return NULL;
+    }
+    int aConvertedLength = aCVT.needed ? aCVT.len_cvt : aCVT.len;
+
+    MixerSample* aSample = new MixerSample();
+    aSample->mFrames = aConvertedLength / (aChannels * sizeof(float));
+    aSample->mChannels = aChannels;
+    aSample->mRate = aSpec.freq;
+    aSample->mData = new float[aSample->mFrames * aChannels];
+    memcpy(aSample->mData, aCVT.buf, aSample->mFrames * aChannels * sizeof(float));
+    SDL_free(aCVT.buf);
+
+    if (aSample->mFrames == 0)
+    {
+        delete aSample;
+        return NULL;
+    }
+    return aSample;
+}
+
+MixerSample* Sexy::DecodeMixerSample(SDL_RWops* theRW, int theMaxChannels)
+{
+    if (theRW == NULL)
+        return NULL;
+
+    MixerSample* aSample = NULL;
+#ifdef HAVE_VORBISFILE
+    aSample = DecodeVorbis(theRW, theMaxChannels);
+    if (aSample == NULL)
+        SDL_RWseek(theRW, 0, RW_SEEK_SET);
+#endif
+    if (aSample == NULL)
+        aSample = DecodeWav(theRW, theMaxChannels);
+
+    SDL_RWclose(theRW);
+    return aSample;
+}
+
+MixerStream* Sexy::OpenMixerStream(SDL_RWops* theRW)
+{
+    if (theRW == NULL)
+        return NULL;
+
+#ifdef HAVE_VORBISFILE
+    VorbisStream* aStream = new VorbisStream(theRW);
+    if (aStream->mOpen)
+        return aStream;
+    delete aStream;
+#else
+    SDL_RWclose(theRW);
+#endif
+    return NULL;
+}
@@ -0,0 +1,182 @@
+#ifndef __SOFTMIXER_H__
+#define __SOFTMIXER_H__
+
+#include <SDL.h>
+#include <vector>
+
+namespace Sexy
+{
+
+// A sound decoded to floats, mono or interleaved stereo at its own rate
+struct MixerSample
+{
+    float*                  mData;
+    int                     mFrames;
+    int                     mChannels;
+    int                     mRate;
+
+    MixerSample() : mData(NULL), mFrames(0), mChannels(1), mRate(44100) {}
+    ~MixerSample() { delete [] mData; }
+};
+
+// PCM that is decoded while it plays, for music. Read() and Rewind() are
+// called from the audio thread. A stream plays on one voice at a time.
+class MixerStream
+{
+public:
+    int                     mChannels;
+    int                     mRate;
+
+    // Owned by the mixer: what was read but not played yet
+    std::vector<float>      mBuffer;
+    int                     mBufferFrames;
+    bool                    mEnded;
+
+public:
+    MixerStream() : mChannels(2), mRate(44100), mBufferFrames(0), mEnded(false) {}
+    virtual ~MixerStream() {}
+
+    virtual int             Read(float* theBuffer, int theFrames) = 0;  // Returns 0 at the end
+    virtual bool            Rewind() = 0;
+};
+
+enum MixerBus
+{
+    MixerBus_Sfx,
+    MixerBus_Music,
+    MixerBus_UI,
+    NUM_MIXER_BUSES
+};
+
+// Mixes voices into submix buses and those into the SDL audio device, all
+// in floats. The game thread talks to the audio thread through a lock free
+// queue of commands, so none of the calls below block on the audio thread,
+// except Forget() which makes sure a sample or stream is no longer in use.
+// The calls may come from more than one thread, mLock lets one of them at
+// a time at the game thread state and the write end of the queue. The
+// audio thread never takes it.
+class SoftMixer
+{
+public:
+    SoftMixer(int theNumVoices, int theRate = 44100, int theBufferFrames = 1024, bool openDevice = true);
+    ~SoftMixer();
+
+    bool                    IsOpen() { return mDevice != 0; }
+    int                     GetRate() { return mRate; }
+    int                     GetNumVoices() { return mVoices.size(); }
+
+    int                     AllocVoice();
+    void                    FreeVoice(int theVoice);
+
+    // thePan goes from -1 (left) to 1 (right), thePitch is a playback speed factor
+    void                    Play(int theVoice, const MixerSample* theSample, int theBus, bool looping, float theVolume, float thePan, float thePitch);
+    void                    PlayStream(int theVoice, MixerStream* theStream, int theBus, bool looping, float theVolume, float thePan);
+    void                    Stop(int theVoice, int theFadeMs = 5);
+    void                    SetPaused(int theVoice, bool paused);
+    void                    SetGain(int theVoice, float theVolume, float thePan, int theRampMs = 5);
+    void                    SetPitch(int theVoice, float thePitch);
+    bool                    IsPlaying(int theVoice);
+
+    void                    SetBusVolume(int theBus, float theVolume);
+    float                   GetBusVolume(int theBus) { return mBusVolumes[theBus]; }
+    void                    SetMasterVolume(float theVolume);
+    float                   GetMasterVolume() { return mMasterVolume; }
+
+    void                    Forget(const MixerSample* theSample);
+    void                    Forget(MixerStream* theStream);
+
+    // Renders theFrames of interleaved stereo. This is what the audio
+    // callback does, without a device it can be called directly.
+    void                    Mix(float* theOutput, int theFrames);
+
+protected:
+    enum CommandType
+    {
+        CMD_PLAY,
+        CMD_PLAY_STREAM,
+        CMD_STOP,
+        CMD_PAUSE,
+        CMD_GAIN,
+        CMD_PITCH,
+        CMD_BUS_VOLUME,
+        CMD_MASTER_VOLUME
+    };
+
+    struct Command
+    {
+        int                 mType;
+        int                 mVoice;
+        int                 mSerial;
+        int                 mBus;
+        const MixerSample*  mSample;
+        MixerStream*        mStream;
+        bool                mFlag;
+        float               mVolume;
+        float               mPan;
+        float               mPitch;
+        int                 mRampFrames;
+    };
+
+    // Audio thread state of a voice
+    struct Voice
+    {
+        const MixerSample*  mSample;
+        MixerStream*        mStream;
+        int                 mSerial;
+        int                 mBus;
+        bool                mLooping;
+        bool                mPaused;
+        bool                mStopping;
+        double              mPos;
+        float               mPitch;
+        float               mGain[2];
+        float               mTarget[2];
+        int                 mRampFrames;
+    };
+
+    SDL_AudioDeviceID       mDevice;
+    int                     mRate;
+    int                     mBufferFrames;
+
+    std::vector<Voice>      mVoices;
+    std::vector<bool>       mVoiceUsed;         // Game thread
+    std::vector<int>        mVoiceSerials;      // Game thread, bumped for every play
+    std::vector<bool>       mVoiceStopped;      // Game thread
+    SDL_atomic_t*           mVoiceDone;         // Audio thread, the serial that stopped playing
+
+    SDL_mutex*              mLock;
+
+    std::vector<Command>    mCommands;
+    SDL_atomic_t            mCommandRead;
+    SDL_atomic_t            mCommandWrite;
+
+    float                   mBusVolumes[NUM_MIXER_BUSES];   // Game thread
+    float                   mMasterVolume;
+    float                   mBusGains[NUM_MIXER_BUSES];     // Audio thread, includes the master volume
+    float                   mMixBusVolumes[NUM_MIXER_BUSES];
+    float                   mMixMasterVolume;
+    float*                  mBusBuffers[NUM_MIXER_BUSES];
+
+protected:
+    void                    PushCommand(const Command& theCommand);
+    void                    RunCommands();
+    void                    RunCommand(const Command& theCommand);
+    void                    EndVoice(int theVoice);
+    void                    SetTarget(Voice* theVoice, float theVolume, float thePan, int theRampFrames);
+    int                     MsToFrames(int theMs);
+
+    void                    MixVoice(int theVoice, int theFrames);
+    int                     FillStream(MixerStream* theStream, bool looping, int theFrames);
+
+    static void SDLCALL     AudioCallback(void* theArg, Uint8* theStream, int theLen);
+};
+
+// Decode WAV, and OGG when built with libvorbisfile. Both take theRW over.
+// OpenMixerStream() returns NULL for anything it can't stream, which is
+// everything but OGG.
+MixerSample*                DecodeMixerSample(SDL_RWops* theRW, int theMaxChannels = 2);
+MixerStream*                OpenMixerStream(SDL_RWops* theRW);
+
+}
+
+#endif //__SOFTMIXER_H__
@@ -0,0 +1,268 @@
+#include <string>
+
+#include "SoftMixerMusicInterface.h"
+#include "SexyAppBase.h"
+#include "PakInterface.h"
+
+using namespace Sexy;
+using namespace std;
+
+SoftMixerMusicInfo::SoftMixerMusicInfo()
+{
+    mStream = NULL;
+    mSample = NULL;
+    mVoice = -1;
+    mVolume = 1.0f;
+    mFadeVolume = 1.0f;
+    mPaused = false;
+}
+
+SoftMixerPreparedMusic::SoftMixerPreparedMusic()
+{
+    mStream = NULL;
+    mSample = NULL;
+}
+
+SoftMixerPreparedMusic::~SoftMixerPreparedMusic()
+{
+    delete mStream;
+    delete mSample;
+}
+
+SoftMixerMusicInterface::SoftMixerMusicInterface(SoftMixer* theMixer)
+{
+    mMixer = theMixer;
+}
+
+SoftMixerMusicInterface::~SoftMixerMusicInterface()
+{
+    UnloadAllMusic();
+}
+
+bool SoftMixerMusicInterface::LoadMusic(int theSongId, const string& theFileName)
+{
+    return LoadPreparedMusic(theSongId, PrepareMusic(theFileName));
+}
+
+// Opening and decoding doesn't touch the mixer, only taking a voice does
+PreparedMusic* SoftMixerMusicInterface::PrepareMusic(const string& theFileName)
+{
+    string myFileName;
+    if (GetPakPtr()->isLoaded())
+        myFileName = ReplaceBackSlashes(theFileName);
+    else
+        myFileName = gSexyAppBase->GetAppResourceFileName(theFileName);
+
+    int aLastDotPos = myFileName.rfind('.');
+    int aLastSlashPos = myFileName.rfind('/');
+    string try_exts[] = {
+        ".ogg",
+        ".wav",
+    };
+    if (aLastDotPos < aLastSlashPos || aLastDotPos == (int) string::npos)
+    {
+        // There is no filename extension. Try a couple
+        for (size_t i = 0; i < (sizeof(try_exts)/sizeof(try_exts[0])); i++)
+        {
+            PFILE* aFile = p_fopen((myFileName + try_exts[i]).c_str(), "rb");
+            if (aFile != NULL)
+            {
+                p_fclose(aFile);
+                myFileName += try_exts[i];
+                break;
+            }
+        }
+    }
+
+    SoftMixerPreparedMusic* aPrepared = new SoftMixerPreparedMusic();
+    aPrepared->mFileName = theFileName;
+    aPrepared->mStream = OpenMixerStream(p_rwopen(myFileName.c_str()));
+    if (aPrepared->mStream == NULL)
+        aPrepared->mSample = DecodeMixerSample(p_rwopen(myFileName.c_str()));
+    if (aPrepared->mStream == NULL && aPrepared->mSample == NULL)
+    {
+        delete aPrepared;
+        return NULL;
+    }
+    return aPrepared;
+}
+
+bool SoftMixerMusicInterface::LoadPreparedMusic(int theSongId, PreparedMusic* thePrepared)
+{
+    UnloadMusic(theSongId);
+
+    SoftMixerPreparedMusic* aPrepared = static_cast<SoftMixerPreparedMusic*>(thePrepared);
+    if (aPrepared == NULL)
+        return false;
+
+    SoftMixerMusicInfo aMusicInfo;
+    aMusicInfo.mVoice = mMixer->AllocVoice();
+    if (aMusicInfo.mVoice < 0)
+    {
+        delete aPrepared;
+        return false;
+    }
+
+    aMusicInfo.mStream = aPrepared->mStream;
+    aMusicInfo.mSample = aPrepared->mSample;
+    aPrepared->mStream = NULL;
+    aPrepared->mSample = NULL;
+    delete aPrepared;
+
+    mMusicMap.insert(SoftMixerMusicMap::value_type(theSongId, aMusicInfo));
+    return true;
+}
+
+void SoftMixerMusicInterface::UnloadMusic(int theSongId)
+{
+    SoftMixerMusicMap::iterator anItr = mMusicMap.find(theSongId);
+    if (anItr == mMusicMap.end())
+        return;
+
+    SoftMixerMusicInfo* aMusicInfo = &anItr->second;
+    mMixer->FreeVoice(aMusicInfo->mVoice);
+
+    // Makes sure the audio thread is done with them
+    if (aMusicInfo->mStream != NULL)
+        mMixer->Forget(aMusicInfo->mStream);
+    if (aMusicInfo->mSample != NULL)
+        mMixer->Forget(aMusicInfo->mSample);
+    delete aMusicInfo->mStream;
+    delete aMusicInfo->mSample;
+
+    mMusicMap.erase(anItr);
+}
+
+void SoftMixerMusicInterface::UnloadAllMusic()
+{
+    while (!mMusicMap.empty())
+        UnloadMusic(mMusicMap.begin()->first);
+}
+
+void SoftMixerMusicInterface::StartSong(SoftMixerMusicInfo* theMusicInfo, bool noLoop, float theFadeVolume)
+{
+    theMusicInfo->mFadeVolume = theFadeVolume;
+    theMusicInfo->mPaused = false;
+
+    float aVolume = theMusicInfo->mVolume * theFadeVolume;
+    if (theMusicInfo->mStream != NULL)
+        mMixer->PlayStream(theMusicInfo->mVoice, theMusicInfo->mStream, MixerBus_Music, !noLoop, aVolume, 0);
+    else
+        mMixer->Play(theMusicInfo->mVoice, theMusicInfo->mSample, MixerBus_Music, !noLoop, aVolume, 0, 1.0f);
+}
+
+void SoftMixerMusicInterface::PlayMusic(int theSongId, int theOffset, bool noLoop)
+{
+    SoftMixerMusicMap::iterator anItr = mMusicMap.find(theSongId);
+    if (anItr != mMusicMap.end())
+        StartSong(&anItr->second, noLoop, 1.0f);
+}
+
+void SoftMixerMusicInterface::StopMusic(int theSongId)
+{
+    SoftMixerMusicMap::iterator anItr = mMusicMap.find(theSongId);
+    if (anItr != mMusicMap.end())
+        mMixer->Stop(anItr->second.mVoice);
+}
+
+void SoftMixerMusicInterface::StopAllMusic()
+{
+    SoftMixerMusicMap::iterator anItr;
+    for (anItr = mMusicMap.begin(); anItr != mMusicMap.end(); ++anItr)
+        mMixer->Stop(anItr->second.mVoice);
+}
+
+void SoftMixerMusicInterface::PauseMusic(int theSongId)
+{
+    SoftMixerMusicMap::iterator anItr = mMusicMap.find(theSongId);
+    if (anItr != mMusicMap.end())
+    {
+        anItr->second.mPaused = true;
+        mMixer->SetPaused(anItr->second.mVoice, true);
+    }
+}
+
+void SoftMixerMusicInterface::ResumeMusic(int theSongId)
+{
+    SoftMixerMusicMap::iterator anItr = mMusicMap.find(theSongId);
+    if (anItr != mMusicMap.end())
+    {
+        anItr->second.mPaused = false;
+        mMixer->SetPaused(anItr->second.mVoice, false);
+    }
+}
+
+void SoftMixerMusicInterface::PauseAllMusic()
+{
+    SoftMixerMusicMap::iterator anItr;
+    for (anItr = mMusicMap.begin(); anItr != mMusicMap.end(); ++anItr)
+        PauseMusic(anItr->first);
+}
+
+void SoftMixerMusicInterface::ResumeAllMusic()
+{
+    SoftMixerMusicMap::iterator anItr;
+    for (anItr = mMusicMap.begin(); anItr != mMusicMap.end(); ++anItr)
+        ResumeMusic(anItr->first);
+}
+
+// Like the SDL_mixer music, a fade takes 1/theSpeed milliseconds
+void SoftMixerMusicInterface::FadeIn(int theSongId, int theOffset, double theSpeed, bool noLoop)
+{
+    SoftMixerMusicMap::iterator anItr = mMusicMap.find(theSongId);
+    if (anItr == mMusicMap.end())
+        return;
+
+    SoftMixerMusicInfo* aMusicInfo = &anItr->second;
+    if (!mMixer->IsPlaying(aMusicInfo->mVoice))
+        StartSong(aMusicInfo, noLoop, 0.0f);
+
+    aMusicInfo->mFadeVolume = 1.0f;
+    mMixer->SetGain(aMusicInfo->mVoice, aMusicInfo->mVolume, 0, (int) (1.0 / theSpeed));
+}
+
+void SoftMixerMusicInterface::FadeOut(int theSongId, bool stopSong, double theSpeed)
+{
+    SoftMixerMusicMap::iterator anItr = mMusicMap.find(theSongId);
+    if (anItr == mMusicMap.end())
+        return;
+
+    SoftMixerMusicInfo* aMusicInfo = &anItr->second;
+    aMusicInfo->mFadeVolume = 0.0f;
+    if (stopSong)
+        mMixer->Stop(aMusicInfo->mVoice, (int) (1.0 / theSpeed));
+    else
+        mMixer->SetGain(aMusicInfo->mVoice, 0, 0, (int) (1.0 / theSpeed));
+}
+
+void SoftMixerMusicInterface::FadeOutAll(bool stopSong, double theSpeed)
+{
+    SoftMixerMusicMap::iterator anItr;
+    for (anItr = mMusicMap.begin(); anItr != mMusicMap.end(); ++anItr)
+        FadeOut(anItr->first, stopSong, theSpeed);
+}
+
+void SoftMixerMusicInterface::SetVolume(double theVolume)
+{
+    mMixer->SetBusVolume(MixerBus_Music, (float) theVolume);
+}
+
+void SoftMixerMusicInterface::SetSongVolume(int theSongId, double theVolume)
+{
+    SoftMixerMusicMap::iterator anItr = mMusicMap.find(theSongId);
+    if (anItr == mMusicMap.end())
+        return;
+
+    SoftMixerMusicInfo* aMusicInfo = &anItr->second;
+    aMusicInfo->mVolume = (float) theVolume;
+    mMixer->SetGain(aMusicInfo->mVoice, aMusicInfo->mVolume * aMusicInfo->mFadeVolume, 0);
+}
+
+bool SoftMixerMusicInterface::IsPlaying(int theSongId)
+{
+    SoftMixerMusicMap::iterator anItr = mMusicMap.find(theSongId);
+    if (anItr == mMusicMap.end())
+        return false;
+
+    return !anItr->second.mPaused && mMixer->IsPlaying(anItr->second.mVoice);
+}
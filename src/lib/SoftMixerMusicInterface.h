@@ -0,0 +1,81 @@
+#ifndef __SOFTMIXERMUSICINTERFACE_H__
+#define __SOFTMIXERMUSICINTERFACE_H__
+
+#include "MusicInterface.h"
+#include "SoftMixer.h"
+#include <map>
+
+namespace Sexy
+{
+
+// OGG songs are streamed from the file as they play, anything else is
+// decoded up front like a sound
+class SoftMixerMusicInfo
+{
+public:
+    MixerStream*            mStream;
+    MixerSample*            mSample;
+    int                     mVoice;
+    float                   mVolume;
+    float                   mFadeVolume;    // Where the last fade went
+    bool                    mPaused;
+
+public:
+    SoftMixerMusicInfo();
+};
+
+typedef std::map<int, SoftMixerMusicInfo> SoftMixerMusicMap;
+
+// The opened stream or decoded sample, no voice yet
+class SoftMixerPreparedMusic : public PreparedMusic
+{
+public:
+    MixerStream*            mStream;
+    MixerSample*            mSample;
+
+public:
+    SoftMixerPreparedMusic();
+    virtual ~SoftMixerPreparedMusic();
+};
+
+// Plays music on the music bus of the sound manager's SoftMixer
+class SoftMixerMusicInterface : public MusicInterface
+{
+public:
+    SoftMixer*              mMixer;
+    SoftMixerMusicMap       mMusicMap;
+
+protected:
+    void                    StartSong(SoftMixerMusicInfo* theMusicInfo, bool noLoop, float theFadeVolume);
+
+public:
+    SoftMixerMusicInterface(SoftMixer* theMixer);
+    virtual ~SoftMixerMusicInterface();
+
+    virtual bool            LoadMusic(int theSongId, const std::string& theFileName);
+    virtual PreparedMusic*  PrepareMusic(const std::string& theFileName);
+    virtual bool            LoadPreparedMusic(int theSongId, PreparedMusic* thePrepared);
+
+    virtual void            PlayMusic(int theSongId, int theOffset = 0, bool noLoop = false);
+    virtual void            StopMusic(int theSongId);
+    virtual void            PauseMusic(int theSongId);
+    virtual void            ResumeMusic(int theSongId);
+    virtual void            StopAllMusic();
+
+    virtual void            UnloadMusic(int theSongId);
+    virtual void            UnloadAllMusic();
+    virtual void            PauseAllMusic();
+    virtual void            ResumeAllMusic();
+
+    virtual void            FadeIn(int theSongId, int theOffset = -1, double theSpeed = 0.002, bool noLoop = false);
+    virtual void            FadeOut(int theSongId, bool stopSong = true, double theSpeed = 0.004);
+    virtual void            FadeOutAll(bool stopSong = true, double theSpeed = 0.004);
+    virtual void            SetSongVolume(int theSongId, double theVolume);
+    virtual bool            IsPlaying(int theSongId);
+
+    virtual void            SetVolume(double theVolume);
+};
+
+}
+
+#endif //__SOFTMIXERMUSICINTERFACE_H__
@@ -0,0 +1,153 @@
+#include "SoftMixerSoundInstance.h"
+#include "SoftMixerSoundManager.h"
+
+using namespace Sexy;
+
+SoftMixerSoundInstance::SoftMixerSoundInstance(SoftMixerSoundManager* theSoundManager, int theVoice, const MixerSample* theSample, unsigned int theSfxID, int theBus)
+{
+    mSoundManager = theSoundManager;
+    Reset(theVoice, theSample, theSfxID, theBus);
+}
+
+SoftMixerSoundInstance::~SoftMixerSoundInstance()
+{
+    Release();
+}
+
+// Instances are pooled by the sound manager, this readies one for a new sound
+void SoftMixerSoundInstance::Reset(int theVoice, const MixerSample* theSample, unsigned int theSfxID, int theBus)
+{
+    mSample = theSample;
+    mVoice = theVoice;
+    mSfxID = theSfxID;
+    mBus = theBus;
+    mPlayOrder = 0;
+
+    mReleased = false;
+    mAutoRelease = false;
+    mHasPlayed = false;
+
+    mBaseVolume = 1.0f;
+    mBasePan = 0.0f;
+    mBasePitch = 1.0f;
+
+    mVolume = 1.0f;
+    mPan = 0.0f;
+    mPitch = 1.0f;
+}
+
+float SoftMixerSoundInstance::GetMixerPan()
+{
+    return std::max(-1.0f, std::min(1.0f, mBasePan + mPan));
+}
+
+void SoftMixerSoundInstance::RehupGain()
+{
+    if (mHasPlayed && mSample != NULL)
+        mSoundManager->mMixer->SetGain(mVoice, mBaseVolume * mVolume, GetMixerPan());
+}
+
+void SoftMixerSoundInstance::RehupPitch()
+{
+    if (mHasPlayed && mSample != NULL)
+        mSoundManager->mMixer->SetPitch(mVoice, mBasePitch * mPitch);
+}
+
+void SoftMixerSoundInstance::Release()
+{
+    Detach();
+    mReleased = true;
+}
+
+void SoftMixerSoundInstance::Detach()
+{
+    Stop();
+    mSample = NULL;
+}
+
+void SoftMixerSoundInstance::SetVolume(double theVolume) // 0.0 to 1.0
+{
+    mVolume = (float) theVolume;
+    RehupGain();
+}
+
+void SoftMixerSoundInstance::SetPan(int thePosition) //-100 to +100 = left to right
+{
+    mPan = thePosition / 100.0f;
+    RehupGain();
+}
+
+void SoftMixerSoundInstance::AdjustPitch(double thePitch) //+0.5 to +2.0 = lower to higher
+{
+    mPitch = (float) thePitch;
+    RehupPitch();
+}
+
+void SoftMixerSoundInstance::SetBaseVolume(double theBaseVolume)
+{
+    mBaseVolume = (float) theBaseVolume;
+    RehupGain();
+}
+
+void SoftMixerSoundInstance::SetBasePan(int theBasePan)
+{
+    mBasePan = theBasePan / 100.0f;
+    RehupGain();
+}
+
+void SoftMixerSoundInstance::AdjustBasePitch(float thePitch)
+{
+    mBasePitch = thePitch;
+    RehupPitch();
+}
+
+bool SoftMixerSoundInstance::Play(bool looping, bool autoRelease)
+{
+    Stop();
+
+    mAutoRelease = autoRelease;
+
+    if (mSample == NULL)
+        return false;
+
+    // Too quiet to be worth a voice
+    if (mBaseVolume * mVolume < mSoundManager->mCullVolume)
+    {
+        if (autoRelease)
+            Release();
+        return false;
+    }
+
+    mSoundManager->mMixer->Play(mVoice, mSample, mBus, looping, mBaseVolume * mVolume, GetMixerPan(), mBasePitch * mPitch);
+
+    mHasPlayed = true;
+    mPlayOrder = ++mSoundManager->mPlayCount;
+    return true;
+}
+
+void SoftMixerSoundInstance::Stop()
+{
+    if (mHasPlayed && mSample != NULL)
+    {
+        mSoundManager->mMixer->Stop(mVoice);
+        mAutoRelease = false;
+    }
+}
+
+bool SoftMixerSoundInstance::IsPlaying()
+{
+    return mHasPlayed && mSample != NULL && mSoundManager->mMixer->IsPlaying(mVoice);
+}
+
+bool SoftMixerSoundInstance::IsReleased()
+{
+    if (!mReleased && mAutoRelease && mHasPlayed && !IsPlaying())
+        Release();
+
+    return mReleased;
+}
+
+double SoftMixerSoundInstance::GetVolume()
+{
+    return mVolume;
+}
@@ -0,0 +1,53 @@
+#ifndef __SOFTMIXERSOUNDINSTANCE_H__
+#define __SOFTMIXERSOUNDINSTANCE_H__
+
+#include "ChannelSoundManager.h"
+#include "SoftMixer.h"
+
+namespace Sexy
+{
+
+class SoftMixerSoundManager;
+
+class SoftMixerSoundInstance : public ChannelSoundInstance
+{
+    friend class SoftMixerSoundManager;
+
+protected:
+    SoftMixerSoundManager*  mSoundManager;
+
+    const MixerSample*      mSample;
+    int                     mVoice;
+    int                     mBus;
+
+protected:
+    void                    Reset(int theVoice, const MixerSample* theSample, unsigned int theSfxID, int theBus);
+    void                    RehupGain();
+    void                    RehupPitch();
+    float                   GetMixerPan();
+
+public:
+    SoftMixerSoundInstance(SoftMixerSoundManager* theSoundManager, int theVoice, const MixerSample* theSample, unsigned int theSfxID, int theBus);
+    virtual ~SoftMixerSoundInstance();
+
+    virtual void            Release();
+    virtual void            Detach();
+
+    virtual void            SetBaseVolume(double theBaseVolume); //0.0 to 1.0
+    virtual void            SetBasePan(int theBasePan); //-100 to +100
+    virtual void            AdjustBasePitch(float thePitch); //+0.5 to +2.0 relative to normal playing speed
+
+    virtual void            SetVolume(double theVolume); //0.0 to 1.0
+    virtual void            SetPan(int thePosition); //-100 to +100 = left to right
+    virtual void            AdjustPitch(double thePitch); //+0.5 to +2.0 relative to normal playing speed
+
+    virtual bool            Play(bool looping, bool autoRelease);
+    virtual void            Stop();
+    virtual bool            IsPlaying();
+    virtual bool            IsReleased();
+    virtual double          GetVolume();
+};
+
+}
+
+#endif //__SOFTMIXERSOUNDINSTANCE_H__
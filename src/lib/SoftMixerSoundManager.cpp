@@ -0,0 +1,227 @@
+#include <string>
+
+#include "SoftMixerSoundManager.h"
+#include "SoftMixerSoundInstance.h"
+#include "SexyAppBase.h"
+#include "PakInterface.h"
+
+using namespace Sexy;
+using namespace std;
+
+#define MIXER_VOICES    256     // Shared by the sound channels and the music
+
+SoftMixerSoundManager::SoftMixerSoundManager(bool openDevice)
+{
+    mMixer = new SoftMixer(MIXER_VOICES, 44100, 1024, openDevice);
+
+    GrowSoundTable(MAX_SOURCE_SOUNDS);
+
+    SetNumChannels(MAX_CHANNELS);
+}
+
+SoftMixerSoundManager::~SoftMixerSoundManager()
+{
+    StopAllSounds();
+    ReleaseChannels();
+    ReleaseSounds();
+
+    // The pooled instances are released, deleting them doesn't touch the mixer
+    delete mMixer;
+}
+
+bool SoftMixerSoundManager::Initialized()
+{
+    return mMixer->IsOpen();
+}
+
+void SoftMixerSoundManager::SetVolume(double theVolume)
+{
+    AutoMutex aLock(mMutex);
+    mMixer->SetBusVolume(MixerBus_Sfx, (float) theVolume);
+    mMixer->SetBusVolume(MixerBus_UI, (float) theVolume);
+}
+
+void SoftMixerSoundManager::GrowSoundTable(unsigned int theSize)
+{
+    ChannelSoundManager::GrowSoundTable(theSize);
+
+    if (theSize <= mSourceSounds.size())
+        return;
+
+    mSourceSounds.resize(theSize, NULL);
+    mBuses.resize(theSize, MixerBus_Sfx);
+}
+
+bool SoftMixerSoundManager::IsSoundIdUsed(unsigned int theSfxID)
+{
+    return mSourceSounds[theSfxID] != NULL;
+}
+
+bool SoftMixerSoundManager::LoadSound(unsigned int theSfxID, const string& theFilename)
+{
+    AutoMutex aLock(mMutex);
+    GrowSoundTable(theSfxID + 1);
+
+    ReleaseSound(theSfxID);
+
+    string aFilename = GetSoundFileName(theFilename);
+    SDL_RWops* rw = NULL;
+
+    int aLastDotPos = aFilename.rfind('.');
+    int aLastSlashPos = aFilename.rfind('/');
+    if (aLastDotPos > aLastSlashPos)
+    {
+        // The filename has an extension
+        rw = p_rwopen(aFilename.c_str());
+    }
+    else
+    {
+        string try_exts[] = {
+            ".wav",
+            ".ogg",
+        };
+        for (size_t i = 0; rw == NULL && i < (sizeof(try_exts)/sizeof(try_exts[0])); i++)
+            rw = p_rwopen((aFilename + try_exts[i]).c_str());
+    }
+
+    MixerSample* aSample = DecodeMixerSample(rw);
+    if (aSample == NULL)
+        return false;
+
+    mSourceSounds[theSfxID] = aSample;
+    return true;
+}
+
+void SoftMixerSoundManager::ReleaseSound(unsigned int theSfxID)
+{
+    AutoMutex aLock(mMutex);
+    if (theSfxID >= mSourceSounds.size() || mSourceSounds[theSfxID] == NULL)
+        return;
+
+    MixerSample* aSample = mSourceSounds[theSfxID];
+    mSourceSounds[theSfxID] = NULL;
+
+    for (size_t i = 0; i < mPlayingSounds.size(); i++)
+        if (mPlayingSounds[i] != NULL && static_cast<SoftMixerSoundInstance*>(mPlayingSounds[i])->mSample == aSample)
+            FreeChannel(i);
+
+    // Makes sure the audio thread is done with it
+    mMixer->Forget(aSample);
+    delete aSample;
+}
+
+bool SoftMixerSoundManager::SetBus(unsigned int theSfxID, MixerBus theBus)
+{
+    AutoMutex aLock(mMutex);
+    if (theSfxID >= mSourceSounds.size())
+        return false;
+
+    mBuses[theSfxID] = theBus;
+    return true;
+}
+
+void SoftMixerSoundManager::SetNumChannels(int theNumChannels)
+{
+    AutoMutex aLock(mMutex);
+    if (theNumChannels < 1)
+        theNumChannels = 1;
+
+    while ((int) mChannelVoices.size() > theNumChannels)
+    {
+        FreeChannel(mChannelVoices.size() - 1);
+        mMixer->FreeVoice(mChannelVoices.back());
+        mChannelVoices.pop_back();
+        mPlayingSounds.pop_back();
+    }
+
+    // As many as the mixer has voices left for
+    while ((int) mChannelVoices.size() < theNumChannels)
+    {
+        int aVoice = mMixer->AllocVoice();
+        if (aVoice < 0)
+            break;
+        mChannelVoices.push_back(aVoice);
+        mPlayingSounds.push_back(NULL);
+    }
+}
+
+SoundInstance* SoftMixerSoundManager::GetSoundInstance(unsigned int theSfxID)
+{
+    AutoMutex aLock(mMutex);
+    if (theSfxID >= mSourceSounds.size())
+        return NULL;
+
+    MixerSample* aSample = mSourceSounds[theSfxID];
+    if (aSample == NULL)
+        return NULL;
+
+    int aFreeChannel = FindFreeChannel(theSfxID);
+    if (aFreeChannel < 0)
+        return NULL;
+
+    SoftMixerSoundInstance* anInstance = static_cast<SoftMixerSoundInstance*>(TakeFreeInstance());
+    if (anInstance == NULL)
+        anInstance = new SoftMixerSoundInstance(this, mChannelVoices[aFreeChannel], aSample, theSfxID, mBuses[theSfxID]);
+    else
+        anInstance->Reset(mChannelVoices[aFreeChannel], aSample, theSfxID, mBuses[theSfxID]);
+    StartInstance(aFreeChannel, anInstance);
+
+    return anInstance;
+}
+
+SoundInstance* SoftMixerSoundManager::GetOriginalSoundInstance(unsigned int theSfxID)
+{
+    AutoMutex aLock(mMutex);
+    if (theSfxID >= mSourceSounds.size())
+        return NULL;
+
+    if (mSourceSounds[theSfxID] != NULL)
+    {
+        ChannelSoundInstance* anInstance = FindPlayingInstance(theSfxID);
+        if (anInstance != NULL)
+            return anInstance;
+    }
+
+    return GetSoundInstance(theSfxID);
+}
+
+double SoftMixerSoundManager::GetMasterVolume()
+{
+    return mMixer->GetMasterVolume();
+}
+
+void SoftMixerSoundManager::SetMasterVolume(double theVolume)
+{
+    mMixer->SetMasterVolume((float) theVolume);
+}
+
+void SoftMixerSoundManager::Flush()
+{
+}
+
+void SoftMixerSoundManager::SetCooperativeWindow(HWND theHWnd, bool isWindowed)
+{
+}
+
+int SoftMixerSoundManager::GetNumSounds()
+{
+    AutoMutex aLock(mMutex);
+    int nr_sounds = 0;
+
+    for (unsigned int i = 0; i < mSourceSounds.size(); ++i)
+    {
+        if (mSourceSounds[i])
+            ++nr_sounds;
+    }
+    return nr_sounds;
+}
+
+size_t SoftMixerSoundManager::GetSoundMemSize(unsigned int theSfxID)
+{
+    AutoMutex aLock(mMutex);
+    if (theSfxID >= mSourceSounds.size() || mSourceSounds[theSfxID] == NULL)
+        return 0;
+
+    MixerSample* aSample = mSourceSounds[theSfxID];
+    return (size_t) aSample->mFrames * aSample->mChannels * sizeof(float);
+}
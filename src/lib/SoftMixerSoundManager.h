@@ -0,0 +1,71 @@
+#ifndef __SOFTMIXERSOUNDMANAGER_H__
+#define __SOFTMIXERSOUNDMANAGER_H__
+
+#ifndef WIN32
+#define HWND void*
+#endif
+
+#include "ChannelSoundManager.h"
+#include "SoftMixer.h"
+#include <vector>
+
+namespace Sexy
+{
+
+class SoftMixerSoundInstance;
+
+// A sound manager on top of SoftMixer, which mixes everything itself
+// straight into the SDL audio device. Unlike SDL_mixer it does pitch.
+// Sounds play on the sfx bus unless SetBus() says otherwise, SetVolume()
+// sets the sfx and UI buses and SetMasterVolume() the mixer as a whole.
+// Make the music interface with GetMixer() so music goes through the
+// same device, on the music bus.
+//
+// With SDL_AUDIODRIVER=dummy or disk it runs without a sound card.
+class SoftMixerSoundManager : public ChannelSoundManager
+{
+    friend class SoftMixerSoundInstance;
+
+protected:
+    SoftMixer*              mMixer;
+
+    std::vector<MixerSample*> mSourceSounds;
+    std::vector<int>        mBuses;
+    std::vector<int>        mChannelVoices;                 // The mixer voice of every channel
+
+protected:
+    virtual void            GrowSoundTable(unsigned int theSize);
+    virtual bool            IsSoundIdUsed(unsigned int theSfxID);
+
+public:
+    SoftMixerSoundManager(bool openDevice = true);
+    virtual ~SoftMixerSoundManager();
+
+    SoftMixer*              GetMixer() { return mMixer; }
+
+    virtual bool            Initialized();
+
+    using ChannelSoundManager::LoadSound;
+    virtual bool            LoadSound(unsigned int theSfxID, const std::string& theFilename);
+    virtual void            ReleaseSound(unsigned int theSfxID);
+    virtual int             GetNumSounds();
+    virtual size_t          GetSoundMemSize(unsigned int theSfxID);
+
+    virtual void            SetVolume(double theVolume);
+    bool                    SetBus(unsigned int theSfxID, MixerBus theBus);
+    virtual void            SetNumChannels(int theNumChannels);
+
+    virtual SoundInstance*  GetSoundInstance(unsigned int theSfxID);
+    virtual SoundInstance*  GetOriginalSoundInstance(unsigned int theSfxID);
+
+    virtual double          GetMasterVolume();
+    virtual void            SetMasterVolume(double theVolume);
+
+    virtual void            Flush();
+
+    virtual void            SetCooperativeWindow(HWND theHWnd, bool isWindowed);
+};
+
+}
+
+#endif //__SOFTMIXERSOUNDMANAGER_H__
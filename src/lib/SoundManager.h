@@ -11,6 +11,8 @@ class SoundInstance;
 #define MAX_SOURCE_SOUNDS   256
 #define MAX_CHANNELS        32
 
+typedef void (*SoundLoadedCallBack)(void* theArg, unsigned int theSfxID, bool theSuccess);
+
 class SoundManager
 {
 public:
@@ -23,6 +25,39 @@ public:
     virtual int             LoadSound(const std::string& theFilename) = 0;
     virtual void            ReleaseSound(unsigned int theSfxID) = 0;
 
+    // Loads a sound in the background where the sound manager supports it.
+    // theCallBack is called from FinishLoads(), or straight away when there
+    // is nothing to wait for. FinishLoads(true) waits for all pending loads.
+    virtual bool            LoadSoundAsync(unsigned int theSfxID, const std::string& theFilename, SoundLoadedCallBack theCallBack = NULL, void* theArg = NULL)
+    {
+        bool aSuccess = LoadSound(theSfxID, theFilename);
+        if (theCallBack != NULL)
+            theCallBack(theArg, theSfxID, aSuccess);
+        return true;
+    }
+    // LoadSoundAsync() on a free id, which is taken in the same go so no
+    // other thread can get it too. The id is stored in *theSfxID before
+    // theCallBack can run. Returns false when there's no id to be had.
+    virtual bool            LoadSoundAsync(const std::string& theFilename, int* theSfxID, SoundLoadedCallBack theCallBack = NULL, void* theArg = NULL)
+    {
+        *theSfxID = LoadSound(theFilename);
+        if (*theSfxID < 0)
+            return false;
+        if (theCallBack != NULL)
+            theCallBack(theArg, *theSfxID, true);
+        return true;
+    }
+    virtual void            FinishLoads(bool wait) {}
+
+    // Voice management, where the sound manager supports it. With all the
+    // channels busy, a new sound takes over the channel of a fire and forget
+    // sound with the same or a lower priority. theMaxInstances of 0 means
+    // no limit. Sounds quieter than the cull volume aren't played at all.
+    virtual bool            SetPriority(unsigned int theSfxID, int thePriority) { return false; }
+    virtual bool            SetMaxInstances(unsigned int theSfxID, int theMaxInstances) { return false; }
+    virtual void            SetCullVolume(double theVolume) {}
+    virtual void            SetNumChannels(int theNumChannels) {}
+
     virtual void            SetVolume(double theVolume) = 0;
     virtual bool            SetBaseVolume(unsigned int theSfxID, double theBaseVolume) = 0;
     virtual bool            SetBasePan(unsigned int theSfxID, int theBasePan) = 0;
@@ -43,6 +78,9 @@ public:
     virtual int             GetNumSounds() = 0;
     virtual void            StopSound(int theSfxID) = 0;
     virtual bool            IsSoundPlaying(int theSfxID) = 0;
+
+    // Bytes of decoded samples, 0 if unknown
+    virtual size_t          GetSoundMemSize(unsigned int theSfxID) { return 0; }
 };
 
 
@@ -0,0 +1,75 @@
+#include "StatsWidget.h"
+#include "FrameCounters.h"
+#include "Font.h"
+#include "Graphics.h"
+
+#include <vector>
+
+using namespace Sexy;
+
+#define STATS_BAR_WIDTH     100
+#define STATS_BAR_HEIGHT    6
+
+StatsWidget::StatsWidget(Font* theFont)
+{
+    mFont = theFont;
+    mHideIdle = true;
+    mMouseVisible = false;
+    mHasTransparencies = true;
+}
+
+void StatsWidget::Draw(Graphics* g)
+{
+    std::vector<int> aCounters;
+    for (int i = 0; i < FrameCounters::GetNumCounters(); i++) {
+        if (!mHideIdle || FrameCounters::GetMax(i) > 0)
+            aCounters.push_back(i);
+    }
+
+    int aLineHeight = STATS_BAR_HEIGHT + 2;
+    int aLabelWidth = 0;
+    std::vector<SexyString> aLines;
+    if (mFont != NULL) {
+        aLineHeight = std::max(aLineHeight, mFont->GetHeight());
+        for (size_t i = 0; i < aCounters.size(); i++) {
+            int c = aCounters[i];
+            aLines.push_back(StringToSexyString(StrFormat("%s %d  avg %.1f  min %d  max %d",
+                    FrameCounters::GetName(c).c_str(), FrameCounters::GetLast(c), FrameCounters::GetAvg(c),
+                    FrameCounters::GetMin(c), FrameCounters::GetMax(c))));
+            aLabelWidth = std::max(aLabelWidth, mFont->StringWidth(aLines.back()));
+        }
+    }
+
+    int aWidth = STATS_BAR_WIDTH + 8 + (aLabelWidth > 0 ? aLabelWidth + 6 : 0);
+    int aHeight = aCounters.size() * aLineHeight + 4;
+    if (aWidth != mWidth || aHeight != mHeight)
+        Resize(mX, mY, aWidth, aHeight);
+
+    g->SetColor(Color(0, 0, 0, 192));
+    g->FillRect(0, 0, aWidth, aHeight);
+    if (mFont != NULL)
+        g->SetFont(mFont);
+
+    for (size_t i = 0; i < aCounters.size(); i++) {
+        int c = aCounters[i];
+        int y = 2 + i * aLineHeight;
+        int aBarY = y + (aLineHeight - STATS_BAR_HEIGHT) / 2;
+        int aMax = FrameCounters::GetMax(c);
+
+        g->SetColor(Color(64, 64, 64));
+        g->FillRect(4, aBarY, STATS_BAR_WIDTH, STATS_BAR_HEIGHT);
+        if (aMax > 0) {
+            // Red when the last frame is the worst of the history
+            int aLast = FrameCounters::GetLast(c);
+            g->SetColor(aLast >= aMax ? Color(255, 64, 64) : Color(64, 192, 64));
+            g->FillRect(4, aBarY, (int) ((double) aLast * STATS_BAR_WIDTH / aMax), STATS_BAR_HEIGHT);
+            g->SetColor(Color(255, 255, 255));
+            g->FillRect(4 + (int) (FrameCounters::GetAvg(c) * STATS_BAR_WIDTH / aMax), aBarY - 1, 1, STATS_BAR_HEIGHT + 2);
+        }
+
+        if (mFont != NULL) {
+            g->SetColor(Color(255, 255, 255));
+            g->DrawString(aLines[i], STATS_BAR_WIDTH + 10, y + mFont->GetAscent());
+        }
+    }
+}
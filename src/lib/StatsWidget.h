@@ -0,0 +1,33 @@
+#ifndef __STATSWIDGET_H__
+#define __STATSWIDGET_H__
+
+#include "Widget.h"
+
+namespace Sexy
+{
+
+class Font;
+
+// Shows the FrameCounters: the last frame, avg, min and max of the history
+// and a bar of the last frame against the max. Without a font only the bars
+// are drawn.
+//
+// Not added like other widgets; WidgetManager::SetOverlayWidget() draws it
+// last, over everything, and it never gets input. SexyAppBase::ShowStats()
+// and Ctrl+F3 toggle it.
+class StatsWidget : public Widget
+{
+public:
+    Font*                   mFont;
+    // Counters that never got above 0 in the history are left out
+    bool                    mHideIdle;
+
+public:
+    StatsWidget(Font* theFont = NULL);
+
+    virtual void            Draw(Graphics* g);
+};
+
+}
+
+#endif //__STATSWIDGET_H__
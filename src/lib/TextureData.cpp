@@ -23,9 +23,8 @@ static int gMinTextureWidth = 64;
 static int gMaxTextureWidth = 64;
 static int gMaxTextureHeight = 64;
 static int gMaxTextureAspectRatio = 1;
-#if 0
-static Uint32 gSupportedPixelFormats;
-#endif
+static Uint32 gSupportedPixelFormats = PixelFormat_A8R8G8B8;
+static bool gDitherTextures = false;
 static const int MAX_TEXTURE_SIZE = 2048;
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -320,6 +319,67 @@ GLuint TextureData::GetTexture(int x, int y, int &width, int &height, float &u1,
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 
+PixelFormat TextureData::GetBestPixelFormat(Image *theImage)
+{
+    MemoryImage* anImage = dynamic_cast<MemoryImage*>(theImage);
+    if (anImage == NULL || (mImageFlags & D3DImageFlag_UseA8R8G8B8))
+        return PixelFormat_A8R8G8B8;
+
+    // A format the image asks for overrides the global ones
+    Uint32 aFormats = 0;
+    if (mImageFlags & D3DImageFlag_UseA4R4G4B4)
+        aFormats |= PixelFormat_A4R4G4B4;
+    if (mImageFlags & D3DImageFlag_UseR5G6B5)
+        aFormats |= PixelFormat_R5G6B5;
+    if (mImageFlags & D3DImageFlag_UseA8)
+        aFormats |= PixelFormat_A8;
+    if (aFormats == 0)
+        aFormats = gSupportedPixelFormats;
+
+    if ((aFormats & (PixelFormat_A4R4G4B4 | PixelFormat_R5G6B5 | PixelFormat_A8)) == 0)
+        return PixelFormat_A8R8G8B8;
+
+    // R5G6B5 would lose the alpha and A8 the colors, those images keep
+    // a format that can hold them.
+    // A palletized image is read through its color table, GetBits() would
+    // turn it back into 32 bit bits.
+    bool hasAlpha = false;
+    bool hasColor = false;
+    int aSize = anImage->GetWidth() * anImage->GetHeight();
+    const uint32_t* aBits = anImage->mBits;
+    int aNumColors = aSize;
+    bool aUsedColors[256];
+    if (aBits == NULL && anImage->mColorTable != NULL) {
+        memset(aUsedColors, 0, sizeof(aUsedColors));
+        for (int i = 0; i < aSize; i++)
+            aUsedColors[anImage->mColorIndices[i]] = true;
+        aBits = anImage->mColorTable;
+        aNumColors = 256;
+    } else if (aBits == NULL) {
+        aBits = anImage->GetBits();
+    }
+    for (int i = 0; i < aNumColors && !(hasAlpha && hasColor); i++) {
+        if (aBits == anImage->mColorTable && !aUsedColors[i])
+            continue;
+        uint32_t aPixel = aBits[i];
+        if ((aPixel >> 24) != 0xFF)
+            hasAlpha = true;
+        if ((aPixel >> 24) != 0 && (aPixel & 0xFFFFFF) != 0xFFFFFF)
+            hasColor = true;
+    }
+
+    if ((aFormats & PixelFormat_A8) && !hasColor)
+        return PixelFormat_A8;
+    if ((aFormats & PixelFormat_R5G6B5) && !hasAlpha)
+        return PixelFormat_R5G6B5;
+    if (aFormats & PixelFormat_A4R4G4B4)
+        return PixelFormat_A4R4G4B4;
+    return PixelFormat_A8R8G8B8;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+
 void TextureData::CreateTextures(Image *theImage)
 {
     theImage->DeleteSWBuffers(); // don't need these buffers for 3d drawing
@@ -328,14 +388,17 @@ void TextureData::CreateTextures(Image *theImage)
 
     mHasAlpha = theImage->GetHasAlpha();
     
-    // Release texture if image size has changed
-    // Why don't we check mBitsChangedCount?
+    // Release texture if image size has changed. Changed bits are uploaded
+    // again too, they may no longer fit the reduced format of the old
+    // textures (e.g. alpha was added to an R5G6B5 image).
     bool createNewTextures = false;
     if (mWidth != theImage->GetWidth() || mHeight != theImage->GetHeight()
-            || theImage->GetD3DFlags() != mImageFlags) {
+            || theImage->GetD3DFlags() != mImageFlags
+            || theImage->GetBitsChangedCount() != mBitsChangedCount) {
         ReleaseTextures();
         mImageFlags = theImage->GetD3DFlags();
         CreateTextureDimensions(theImage);
+        mPixelFormat = GetBestPixelFormat(theImage);
         createNewTextures = true;
     }
 
@@ -345,14 +408,13 @@ void TextureData::CreateTextures(Image *theImage)
     int aWidth = theImage->GetWidth();
 
     int aFormatSize = 4;
-#if 0
-    if (aFormat == PixelFormat_Palette8)
+    if (mPixelFormat == PixelFormat_A8)
         aFormatSize = 1;
-    else if (aFormat == PixelFormat_R5G6B5)
+    else if (mPixelFormat == PixelFormat_R5G6B5)
         aFormatSize = 2;
-    else if (aFormat == PixelFormat_A4R4G4B4)
+    else if (mPixelFormat == PixelFormat_A4R4G4B4)
         aFormatSize = 2;
-#endif
+    bool dither = gDitherTextures || (mImageFlags & D3DImageFlag_Dither) != 0;
 
     (*GLExtensions::glGenBuffers_ptr)(1, &mVBO_colors);
     (*GLExtensions::glBindBuffer_ptr)(GL_ARRAY_BUFFER, mVBO_colors);
@@ -376,7 +438,7 @@ void TextureData::CreateTextures(Image *theImage)
             TextureDataPiece &aPiece = mTextures[i++];
             if (createNewTextures) {
 
-                aPiece.mTexture = theImage->CreateTexture(x, y, aPiece.mWidth, aPiece.mHeight);
+                aPiece.mTexture = theImage->CreateTexture(x, y, aPiece.mWidth, aPiece.mHeight, mPixelFormat, dither);
                 if (aPiece.mTexture == 0) // create texture failure
                 {
                     // TODO. This dies silently. Maybe assert(0) is better.
@@ -540,7 +602,7 @@ void TextureData::Blt(float theX, float theY, const Rect& theSrcRect, const Colo
             glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(D3DTLVERTEX), &(aVertex[0].color));
             glVertexPointer(2, GL_SHORT, sizeof(D3DTLVERTEX), &(aVertex[0].sx));
             glTexCoordPointer(2, GL_SHORT, sizeof(D3DTLVERTEX), &(aVertex[0].tu));
-            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            GLState::getInstance()->drawArrays(GL_TRIANGLE_STRIP, 0, 4);
 
 
             srcX += aWidth;
@@ -577,7 +639,7 @@ void TextureData::Blt(const Color& theColor)
         GLState::getInstance()->bindTexture(GL_TEXTURE_2D, mTextures[i].mTexture);
         glVertexPointer(2, GL_SHORT, sizeof(D3DTLVERTEX), BUFFER_OFFSET(mTextures[i].vertex_offset));
         glTexCoordPointer(2, GL_SHORT, sizeof(D3DTLVERTEX), BUFFER_OFFSET(mTextures[i].texture_offset));
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        GLState::getInstance()->drawArrays(GL_TRIANGLE_STRIP, 0, 4);
     }
 
     //unbind buffer
@@ -594,7 +656,7 @@ void TextureData::Blt()
         glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(D3DTLVERTEX), BUFFER_OFFSET(mTextures[i].color_offset));
         glTexCoordPointer(2, GL_SHORT, sizeof(D3DTLVERTEX), BUFFER_OFFSET(mTextures[i].texture_offset));
 
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        GLState::getInstance()->drawArrays(GL_TRIANGLE_STRIP, 0, 4);
     }
 
     //unbind buffer
@@ -687,7 +749,7 @@ void TextureData::BltTransformed(const SexyMatrix3 &theTrans, const Rect& theSrc
                 glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(D3DTLVERTEX), &(aVertex[0].color));
                 glVertexPointer(2, GL_SHORT, sizeof(D3DTLVERTEX), &(aVertex[0].sx));
                 glTexCoordPointer(2, GL_SHORT, sizeof(D3DTLVERTEX), &(aVertex[0].tu));
-                glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+                GLState::getInstance()->drawArrays(GL_TRIANGLE_STRIP, 0, 4);
             } else {
                 VertexList aList;
 
@@ -771,7 +833,7 @@ void TextureData::BltTriangles(const TriVertex theVertices[][3], int theNumTrian
             aD3DVertex[2].tv = aTriVerts[2].v * mMaxTotalV * TEXTURESCALING;
 
             if ((aVertexCacheNum == 300) || (aTriangleNum == theNumTriangles - 1)) {
-                glDrawArrays(GL_TRIANGLES, 0, aVertexCacheNum);
+                GLState::getInstance()->drawArrays(GL_TRIANGLES, 0, aVertexCacheNum);
                 aVertexCacheNum = 0;
             }
         }
@@ -858,7 +920,7 @@ void TextureData::BltTriangles(const TriVertex theVertices[][3], int theNumTrian
                         glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(D3DTLVERTEX), &(aList[0].color));
                         glVertexPointer(2, GL_SHORT, sizeof(D3DTLVERTEX), &(aList[0].sx));
                         glTexCoordPointer(2, GL_SHORT, sizeof(D3DTLVERTEX), &(aList[0].tu));
-                        glDrawArrays(GL_TRIANGLE_FAN, 0, aList.size());
+                        GLState::getInstance()->drawArrays(GL_TRIANGLE_FAN, 0, aList.size());
                     }
                 }
             }
@@ -876,6 +938,12 @@ void TextureData::SetMaxTextureDimension(int maxWidth, int maxHeight)
         gMaxTextureHeight = MAX_TEXTURE_SIZE;
 }
 
+void TextureData::SetTexturePixelFormats(Uint32 thePixelFormats, bool dither)
+{
+    gSupportedPixelFormats = thePixelFormats | PixelFormat_A8R8G8B8;
+    gDitherTextures = dither;
+}
+
 void TextureData::SetMaxTextureAspectRatio(int maxAspectRatio)
 {
     gMaxTextureAspectRatio = maxAspectRatio;
@@ -50,7 +50,8 @@ enum PixelFormat
     PixelFormat_A8R8G8B8            =           0x0001,
     PixelFormat_A4R4G4B4            =           0x0002,
     PixelFormat_R5G6B5              =           0x0004,
-    PixelFormat_Palette8            =           0x0008
+    PixelFormat_Palette8            =           0x0008,
+    PixelFormat_A8                  =           0x0010      // Alpha only, for images that are white where they aren't transparent
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -89,12 +90,18 @@ public:
     static void SetMinMaxTextureDimension(int minWidth, int miHeight, int maxWidth, int maxHeight, int maxAspectRatio);
     static void SetMaxTextureDimension(int maxWidth, int maxHeight);
     static void SetMaxTextureAspectRatio(int maxAspectRatio);
+    // The reduced formats (a mask of PixelFormat values) that textures of
+    // images without a D3DImageFlag format of their own may use. Defaults
+    // to PixelFormat_A8R8G8B8 only.
+    static void SetTexturePixelFormats(Uint32 thePixelFormats, bool dither = false);
     bool hasAlpha() const { return mHasAlpha;}
+    int     GetTexMemSize() const { return mTexMemSize; }
 
 private:
     void    ReleaseTextures();
     void    CreateTextureDimensions(Image *theImage);
     GLuint  GetTexture(int x, int y, int &width, int &height, float &u1, float &v1, float &u2, float &v2);
+    PixelFormat GetBestPixelFormat(Image *theImage);
     void    CreateTextures(Image *theImage);
     void    CreateTexturesFromSubs(Image *theImage);
     void    GetBestTextureDimensions(int &theWidth, int &theHeight, bool isEdge, Uint32 theImageFlags, bool isPow2, bool isSquare);
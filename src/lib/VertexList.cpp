@@ -1,4 +1,5 @@
 #include "VertexList.h"
+#include "GLState.h"
 
 using namespace Sexy;
 
@@ -148,6 +149,6 @@ void VertexList::DrawPolyClipped(const Rect *theClipRect) const
         glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(D3DTLVERTEX), &(aList[0].color));
         glVertexPointer(2, GL_SHORT, sizeof(D3DTLVERTEX), &(aList[0].sx));
         glTexCoordPointer(2, GL_SHORT, sizeof(D3DTLVERTEX), &(aList[0].tu));
-        glDrawArrays(GL_TRIANGLE_FAN, 0, aList.size());
+        GLState::getInstance()->drawArrays(GL_TRIANGLE_FAN, 0, aList.size());
     }
 }
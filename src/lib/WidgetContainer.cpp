@@ -1,6 +1,7 @@
 #include "WidgetContainer.h"
 #include "WidgetManager.h"
 #include "Widget.h"
+#include "FrameCounters.h"
 #if 0
 #include "Debug.h"
 #endif
@@ -568,6 +569,9 @@ void WidgetContainer::DrawAll(ModalFlags* theFlags, Graphics* g)
     if ((mClip) && (theFlags->GetFlags() & WIDGETFLAGS_CLIP))
         g->ClipRect(0, 0, mWidth, mHeight);
 
+    if (theFlags->GetFlags() & WIDGETFLAGS_DRAW)
+        FrameCounters::Add(FrameCounter_WidgetsDrawn);
+
     if (mWidgets.size() == 0)
     {
         if (theFlags->GetFlags() & WIDGETFLAGS_DRAW)
@@ -5,6 +5,7 @@
 #include "SexyAppBase.h"
 #include "MemoryImage.h"
 #include "DDImage.h"
+#include "FrameCounters.h"
 #if 0
 #include "PerfTimer.h"
 #include "Debug.h"
@@ -24,6 +25,7 @@ WidgetManager::WidgetManager(SexyAppBase* theApp)
     mImage = NULL;
     mLastHadTransients = false;
     mPopupCommandWidget = NULL;
+    mOverlayWidget = NULL;
     mFocusWidget = NULL;
     mLastDownWidget = NULL;
     mOverWidget = NULL;
@@ -416,6 +418,22 @@ bool WidgetManager::DrawScreen()
     //bool hasTransients = false;
     //bool hasDirtyTransients = false;
 
+    // The overlay changes every frame and is see-through. What is beneath
+    // last frame's overlay is drawn again, so it isn't drawn over itself.
+    bool drawOverlay = mOverlayWidget != NULL && mOverlayWidget->mVisible;
+    if (drawOverlay)
+    {
+        WidgetList::iterator anItr = mWidgets.begin();
+        while (anItr != mWidgets.end())
+        {
+            Widget* aWidget = *anItr;
+            if (aWidget->mVisible && aWidget->Intersects(mOverlayWidget))
+                aWidget->MarkDirty();
+            ++anItr;
+        }
+        aDirtyCount++;
+    }
+
     // Survey
     WidgetList::iterator anItr = mWidgets.begin();
     while (anItr != mWidgets.end())
@@ -473,6 +491,28 @@ bool WidgetManager::DrawScreen()
 
     FlushDeferredOverlayWidgets(&aScrG, 0x7FFFFFFF);
 
+    if (drawOverlay)
+    {
+        // The overlay shows the frame counters, its own drawing is taken
+        // back out of them. What other threads add meanwhile goes too.
+        int aNumCounters = FrameCounters::GetNumCounters();
+        int aCounts[MAX_FRAME_COUNTERS];
+        for (int i = 0; i < aNumCounters; i++)
+            aCounts[i] = FrameCounters::GetCurrent(i);
+
+        aScrG.PushState();
+        aScrG.Translate(mOverlayWidget->mX - mMouseDestRect.mX, mOverlayWidget->mY - mMouseDestRect.mY);
+        mOverlayWidget->Draw(&aScrG);
+        aScrG.PopState();
+        drewStuff = true;
+
+        for (int i = 0; i < aNumCounters; i++)
+        {
+            if (!FrameCounters::IsGauge(i))
+                FrameCounters::Add(i, aCounts[i] - FrameCounters::GetCurrent(i));
+        }
+    }
+
     if (aDDImage != NULL && surfaceLocked)
         aDDImage->UnlockSurface();
 
@@ -514,6 +554,12 @@ void WidgetManager::SetPopupCommandWidget(Widget* theList)
     AddWidget(mPopupCommandWidget);
 }
 
+void WidgetManager::SetOverlayWidget(Widget* theWidget)
+{
+    mOverlayWidget = theWidget;
+    MarkAllDirty();
+}
+
 void WidgetManager::RemovePopupCommandWidget()
 {
     if (mPopupCommandWidget != NULL)
@@ -48,6 +48,7 @@ public:
     Widget*                 mOverWidget;
     Widget*                 mBaseModalWidget;
     Widget*                 mPopupCommandWidget;
+    Widget*                 mOverlayWidget;         // Drawn last, gets no input
     FlagsMod                mLostFocusFlagsMod;
     FlagsMod                mBelowModalFlagsMod;
     FlagsMod                mDefaultBelowModalFlagsMod;
@@ -114,6 +115,8 @@ public:
     bool                    UpdateFrame();
     bool                    UpdateFrameF(float theFrac);
     void                    SetPopupCommandWidget(Widget* theList);
+    // Not owned. NULL to remove it.
+    void                    SetOverlayWidget(Widget* theWidget);
     void                    RemovePopupCommandWidget();
     void                    MousePosition(int x, int y);
     void                    RehupMouse();
@@ -9,9 +9,91 @@
 
 using namespace Sexy;
 
+// Characters that end a run of plain ASCII copied in one go by AppendRun().
+enum
+{
+    XML_STOP_NAME   = 1,    // element names, attribute keys and unquoted values
+    XML_STOP_QUOTED = 2,    // quoted attribute values
+    XML_STOP_TEXT   = 4     // comments and CDATA sections
+};
+
+static unsigned char gXMLStops[256];
+
+static bool InitXMLStops()
+{
+    for (int i = 0; i < 256; i++)
+    {
+        // Control characters, line breaks and multi-byte sequences always go through NextElement()
+        if (i < 32 || i >= 0x80)
+            gXMLStops[i] = XML_STOP_NAME | XML_STOP_QUOTED | XML_STOP_TEXT;
+        else
+            gXMLStops[i] = 0;
+    }
+
+    const char* aNameStops = " \"=<>/?";
+    for (const char* aChar = aNameStops; *aChar != 0; aChar++)
+        gXMLStops[(uchar)*aChar] |= XML_STOP_NAME;
+
+    gXMLStops[(uchar)'"'] |= XML_STOP_QUOTED;
+    gXMLStops[(uchar)'='] |= XML_STOP_QUOTED;
+    gXMLStops[(uchar)'>'] |= XML_STOP_TEXT;
+    return true;
+}
+
+static bool gXMLStopsInitialized = InitXMLStops();
+
+static void AppendUTF8Char(std::string& theString, wchar_t theChar)
+{
+    unsigned long aChar = (unsigned long)theChar;
+    if (aChar < 0x80)
+    {
+        theString += (char)aChar;
+    }
+    else if (aChar < 0x800)
+    {
+        theString += (char)(0xC0 | (aChar >> 6));
+        theString += (char)(0x80 | (aChar & 0x3F));
+    }
+    else if (aChar < 0x10000)
+    {
+        theString += (char)(0xE0 | (aChar >> 12));
+        theString += (char)(0x80 | ((aChar >> 6) & 0x3F));
+        theString += (char)(0x80 | (aChar & 0x3F));
+    }
+    else
+    {
+        theString += (char)(0xF0 | (aChar >> 18));
+        theString += (char)(0x80 | ((aChar >> 12) & 0x3F));
+        theString += (char)(0x80 | ((aChar >> 6) & 0x3F));
+        theString += (char)(0x80 | (aChar & 0x3F));
+    }
+}
+
+// Attribute strings keep characters outside of ASCII UTF-8 encoded.
+static inline void AppendAttributeChar(SexyString& theString, wchar_t theChar)
+{
+#ifdef _USE_WIDE_STRING
+    theString += theChar;
+#else
+    if (theChar < 0x80)
+        theString += (char)theChar;
+    else
+        AppendUTF8Char(theString, theChar);
+#endif
+}
+
+// Most strings have no entities, those are left alone.
+static inline void DecodeString(SexyString& theString)
+{
+    if (theString.find(_S('&')) != SexyString::npos)
+        theString = XMLDecodeString(theString);
+}
+
 XMLParser::XMLParser()
 {
     mFile = NULL;
+    mDataPos = NULL;
+    mDataEnd = NULL;
     mLineNum = 0;
     mAllowComments = false;
     mGetCharFunc = &XMLParser::GetUTF8Char;
@@ -68,13 +150,55 @@ bool XMLParser::AddAttribute(XMLElement* theElement, const SexyString& theAttrib
     return aRet.second;
 }
 
+void XMLParser::SetDataSource()
+{
+    mDataPos = mData.empty() ? NULL : &mData[0];
+    mDataEnd = mDataPos + mData.size();
+
+    // Skip the byte order mark
+    if (mGetCharFunc == &XMLParser::GetUTF8Char && mData.size() >= 3 &&
+        mData[0] == 0xEF && mData[1] == 0xBB && mData[2] == 0xBF)
+        mDataPos += 3;
+}
+
+// Reads the rest of the file into mData, pak files are decrypted in one go.
+bool XMLParser::ReadData()
+{
+    long aStart = p_ftell(mFile);
+    p_fseek(mFile, 0, SEEK_END);
+    long aFileLen = p_ftell(mFile) - aStart;
+    p_fseek(mFile, aStart, SEEK_SET);
+
+    mData.resize(aFileLen > 0 ? aFileLen : 0);
+    bool aSuccess = mData.empty() || p_fread(&mData[0], 1, mData.size(), mFile) == mData.size();
+
+    p_fclose(mFile);
+    mFile = NULL;
+
+    SetDataSource();
+    return aSuccess;
+}
+
+// Copies characters up to the next one in theStops straight from mData.
+void XMLParser::AppendRun(SexyString* theString, int theStops)
+{
+    const uchar* aRunEnd = mDataPos;
+    while (aRunEnd != mDataEnd && (gXMLStops[*aRunEnd] & theStops) == 0)
+        ++aRunEnd;
+
+    if (aRunEnd != mDataPos)
+    {
+        theString->append(mDataPos, aRunEnd);
+        mDataPos = aRunEnd;
+    }
+}
+
 bool XMLParser::GetAsciiChar(wchar_t* theChar, bool* error)
 {
-    uchar aChar = 0;
-    if (p_fread(&aChar, sizeof(aChar), 1, mFile) != 1)
+    if (mDataPos == mDataEnd)
         return false;
 
-    *theChar = aChar;
+    *theChar = *mDataPos++;
     return true;
 }
 
@@ -87,12 +211,13 @@ bool XMLParser::GetUTF8Char(wchar_t* theChar, bool* error)
         0xF8,       // 4 extra bytes
         0xFC        // 5 extra bytes
     };
-    *error = true;
-
     int aTempChar = 0;
     // Read first byte
-    if (p_fread(&aTempChar, 1, 1, mFile) == 1)
+    if (mDataPos != mDataEnd)
     {
+        *error = true;
+        aTempChar = *mDataPos++;
+
         if ((aTempChar & 0x80) != 0)
         {
             // There will be extra bytes
@@ -120,8 +245,9 @@ bool XMLParser::GetUTF8Char(wchar_t* theChar, bool* error)
             while (aLen > 0)
             {
                 // Read next byte
-                if (p_fread(&anExtraChar, 1, 1, mFile) != 1)
+                if (mDataPos == mDataEnd)
                     return false;
+                anExtraChar = *mDataPos++;
                 if ((anExtraChar & 0xC0) != 0x80)
                     return false; // sanity check: high bit set, and next highest bit NOT set.
 
@@ -160,6 +286,7 @@ bool XMLParser::GetUTF8Char(wchar_t* theChar, bool* error)
         if (aTempChar == 0xFEFF && mFirstChar) // zero-width non breaking space as the first char is a byte order marker (aka BOM).
         {
             mFirstChar = false;
+            *error = false;
             return GetUTF8Char(theChar, error);
         }
 
@@ -317,6 +444,13 @@ bool XMLParser::OpenFile(const std::string& theFileName)
         }
     }
 
+    if ((mGetCharFunc == &XMLParser::GetAsciiChar || mGetCharFunc == &XMLParser::GetUTF8Char) && !ReadData())
+    {
+        mLineNum = 0;
+        Fail(StringToSexyString("Unable to read file " + theFileName));
+        return false;
+    }
+
     mFileName = theFileName.c_str();
     Init();
     return true;
@@ -326,16 +460,33 @@ void XMLParser::SetStringSource(const std::wstring& theString)
 {
     Init();
 
-    int aSize = theString.size();
+    // Store it UTF-8 encoded so it is scanned like a file
+    std::string aString;
+    aString.reserve(theString.size());
+    for (size_t i = 0; i < theString.size(); i++)
+        AppendUTF8Char(aString, theString[i]);
 
-    mBufferedText.resize(aSize);
-    for (int i = 0; i < aSize; i++)
-        mBufferedText[i] = theString[aSize - i - 1];
+    mData.assign(aString.begin(), aString.end());
+    mGetCharFunc = &XMLParser::GetUTF8Char;
+    SetDataSource();
 }
 
 void XMLParser::SetStringSource(const std::string& theString)
 {
-    SetStringSource(StringToWString(theString));
+    Init();
+
+    mData.assign(theString.begin(), theString.end());
+    mGetCharFunc = &XMLParser::GetAsciiChar;
+    SetDataSource();
+}
+
+void XMLParser::SetUTF8Source(const char* theData, int theLength)
+{
+    Init();
+
+    mData.assign(theData, theData + theLength);
+    mGetCharFunc = &XMLParser::GetUTF8Char;
+    SetDataSource();
 }
 
 bool XMLParser::NextElement(XMLElement* theElement)
@@ -346,6 +497,7 @@ bool XMLParser::NextElement(XMLElement* theElement)
         theElement->mSection = mSection;
         theElement->mValue = _S("");
         theElement->mAttributes.clear();
+        theElement->mAttributeIteratorList.clear();
         theElement->mInstruction.erase();
 
         bool hasSpace = false;
@@ -354,14 +506,56 @@ bool XMLParser::NextElement(XMLElement* theElement)
 
         bool doingAttribute = false;
         bool AttributeVal = false;
-        std::wstring aAttributeKey;
-        std::wstring aAttributeValue;
+        SexyString aAttributeKey;
+        SexyString aAttributeValue;
 
-        std::wstring aLastAttributeKey;
+        SexyString aLastAttributeKey;
 
         for (;;)
         {
-            // Process character by character
+            // Copy runs of plain characters in one go, the ones that matter are
+            // processed character by character
+
+            if (mDataPos != mDataEnd && mBufferedText.empty())
+            {
+                switch (theElement->mType)
+                {
+                    case XMLElement::TYPE_NONE:
+                        while (mDataPos != mDataEnd && ::isspace(*mDataPos))
+                        {
+                            if (*mDataPos == '\n')
+                                mLineNum++;
+                            ++mDataPos;
+                        }
+                        break;
+
+                    case XMLElement::TYPE_COMMENT:
+                    case XMLElement::TYPE_CDATA:
+                        AppendRun(&theElement->mInstruction, XML_STOP_TEXT);
+                        break;
+
+                    case XMLElement::TYPE_START:
+                        // "!--" and "![CDATA[" are checked one character at a time
+                        if (hasSpace || (!theElement->mValue.empty() && theElement->mValue[0] == _S('!')))
+                            break;
+
+                        if (!doingAttribute)
+                            AppendRun(&theElement->mValue, inQuote ? XML_STOP_QUOTED : XML_STOP_NAME);
+                        else if (!AttributeVal)
+                            AppendRun(&aAttributeKey, inQuote ? XML_STOP_QUOTED : XML_STOP_NAME);
+                        else
+                            AppendRun(&aAttributeValue, inQuote ? XML_STOP_QUOTED : XML_STOP_NAME);
+                        break;
+
+                    case XMLElement::TYPE_ELEMENT:
+                        if (!hasSpace)
+                            AppendRun(&theElement->mValue, inQuote ? XML_STOP_QUOTED : XML_STOP_NAME);
+                        break;
+
+                    default:
+                        break;
+                }
+            }
 
             wchar_t c;
             int aVal;
@@ -373,9 +567,14 @@ bool XMLParser::NextElement(XMLElement* theElement)
 
                 aVal = 1;
             }
+            else if (mDataPos != mDataEnd && *mDataPos < 0x80)
+            {
+                c = *mDataPos++;
+                aVal = 1;
+            }
             else
             {
-                if (mFile != NULL)
+                if (mFile != NULL || mDataPos != NULL)
                 {
                     bool error = false;
                     if ((this->*mGetCharFunc)(&c, &error))
@@ -495,7 +694,7 @@ bool XMLParser::NextElement(XMLElement* theElement)
                             {
                                 bool insertEnd = false;
 
-                                if (aAttributeKey == L"/")
+                                if (aAttributeKey == _S("/"))
                                 {
                                     // We will get this if we have a space before the />, so we can ignore it
                                     //  and go about our business now
@@ -508,19 +707,19 @@ bool XMLParser::NextElement(XMLElement* theElement)
                                     {
 //                                      theElement->mAttributes[aLastAttributeKey] = aAttributeValue;
 
-                                        aAttributeKey = XMLDecodeString(aAttributeKey);
-                                        aAttributeValue = XMLDecodeString(aAttributeValue);
+                                        DecodeString(aAttributeKey);
+                                        DecodeString(aAttributeValue);
 
                                         aLastAttributeKey = aAttributeKey;
-                                        AddAttribute(theElement, WStringToSexyString(aLastAttributeKey), WStringToSexyString(aAttributeValue));
+                                        AddAttribute(theElement, aLastAttributeKey, aAttributeValue);
 
-                                        aAttributeKey = L"";
-                                        aAttributeValue = L"";
+                                        aAttributeKey = _S("");
+                                        aAttributeValue = _S("");
                                     }
 
                                     if (aLastAttributeKey.length() > 0)
                                     {
-                                        SexyString aVal = theElement->mAttributes[WStringToSexyString(aLastAttributeKey)];
+                                        SexyString aVal = theElement->mAttributes[aLastAttributeKey];
 
                                         int aLen = aVal.length();
 
@@ -529,7 +728,7 @@ bool XMLParser::NextElement(XMLElement* theElement)
                                             // Its an empty element, fake start and end segments
 //                                          theElement->mAttributes[aLastAttributeKey] = aVal.substr(0, aLen - 1);
 
-                                            AddAttribute(theElement, WStringToSexyString(aLastAttributeKey), XMLDecodeString(aVal.substr(0, aLen - 1)));
+                                            AddAttribute(theElement, aLastAttributeKey, XMLDecodeString(aVal.substr(0, aLen - 1)));
 
                                             insertEnd = true;
                                         }
@@ -562,7 +761,7 @@ bool XMLParser::NextElement(XMLElement* theElement)
 
                                     // clear out aAttributeKey, since it contains "/" as its value and will insert
                                     // it into the element's attribute map.
-                                    aAttributeKey = L"";
+                                    aAttributeKey = _S("");
 
                                     //OLD: mBufferedText = "</" + theElement->mValue + ">" + mBufferedText;
                                 }
@@ -665,15 +864,15 @@ bool XMLParser::NextElement(XMLElement* theElement)
                                 {
                                     if (doingAttribute)
                                     {
-                                        aAttributeKey = XMLDecodeString(aAttributeKey);
-                                        aAttributeValue = XMLDecodeString(aAttributeValue);
+                                        DecodeString(aAttributeKey);
+                                        DecodeString(aAttributeValue);
 
 //                                      theElement->mAttributes[aAttributeKey] = aAttributeValue;
 
-                                        AddAttribute(theElement, WStringToSexyString(aAttributeKey), WStringToSexyString(aAttributeValue));
+                                        AddAttribute(theElement, aAttributeKey, aAttributeValue);
 
-                                        aAttributeKey = L"";
-                                        aAttributeValue = L"";
+                                        aAttributeKey = _S("");
+                                        aAttributeValue = _S("");
 
                                         aLastAttributeKey = aAttributeKey;
                                     }
@@ -688,7 +887,7 @@ bool XMLParser::NextElement(XMLElement* theElement)
                                 hasSpace = false;
                             }
 
-                            std::wstring* aStrPtr = NULL;
+                            SexyString* aStrPtr = NULL;
 
                             if (!doingAttribute)
                             {
@@ -712,7 +911,7 @@ bool XMLParser::NextElement(XMLElement* theElement)
 
                             if (aStrPtr != NULL)
                             {
-                                *aStrPtr += c;
+                                AppendAttributeChar(*aStrPtr, c);
                             }
                         }
                         else
@@ -739,14 +938,14 @@ bool XMLParser::NextElement(XMLElement* theElement)
 
         if (aAttributeKey.length() > 0)
         {
-            aAttributeKey = XMLDecodeString(aAttributeKey);
-            aAttributeValue = XMLDecodeString(aAttributeValue);
+            DecodeString(aAttributeKey);
+            DecodeString(aAttributeValue);
 //          theElement->mAttributes[aAttributeKey] = aAttributeValue;
 
-            AddAttribute(theElement, WStringToSexyString(aAttributeKey), WStringToSexyString(aAttributeValue));
+            AddAttribute(theElement, aAttributeKey, aAttributeValue);
         }
 
-        theElement->mValue = XMLDecodeString(theElement->mValue);
+        DecodeString(theElement->mValue);
 
         // Ignore comments
         if ((theElement->mType != XMLElement::TYPE_COMMENT) || mAllowComments)
@@ -4,6 +4,7 @@
 #include <map>
 #include <list>
 #include <string>
+#include <vector>
 
 #include "Common.h"
 
@@ -56,6 +57,10 @@ protected:
     bool                    mHasFailed;
     bool                    mAllowComments;
     XMLParserBuffer         mBufferedText;
+    // ASCII and UTF-8 sources are read in one go and scanned from memory.
+    std::vector<uchar>      mData;
+    const uchar*            mDataPos;
+    const uchar*            mDataEnd;
     SexyString              mSection;
     bool                    (XMLParser::*mGetCharFunc)(wchar_t* theChar, bool* error);
     bool                    mForcedEncodingType;
@@ -67,6 +72,9 @@ protected:
     void                    Init();
 
     bool                    AddAttribute(XMLElement* theElement, const SexyString& aAttributeKey, const SexyString& aAttributeValue);
+    void                    SetDataSource();
+    bool                    ReadData();
+    void                    AppendRun(SexyString* theString, int theStops);
 
     bool                    GetAsciiChar(wchar_t* theChar, bool* error);
     bool                    GetUTF8Char(wchar_t* theChar, bool* error);
@@ -92,6 +100,7 @@ public:
     bool                    OpenFile(const std::string& theFilename);
     void                    SetStringSource(const std::wstring& theString);
     void                    SetStringSource(const std::string& theString);
+    void                    SetUTF8Source(const char* theData, int theLength);
     bool                    NextElement(XMLElement* theElement);
     SexyString              GetErrorText();
     int                     GetCurrentLineNum();
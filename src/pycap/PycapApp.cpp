@@ -58,6 +58,7 @@ PycapApp::PycapApp()
     mPythonHomeSet = false;
     mPythonPathSet = false;
     mBundled       = false;
+    mThreadState   = NULL;
     //-------------------
 }
 
@@ -67,6 +68,12 @@ PycapApp::PycapApp()
 
 PycapApp::~PycapApp()
 {
+    // take the interpreter lock back for good
+    if (mThreadState != NULL) {
+        PyEval_RestoreThread(mThreadState);
+        mThreadState = NULL;
+    }
+
     // clean up board if necessary
     if (mBoard != NULL) {
         mWidgetManager->RemoveWidget(mBoard);
@@ -136,6 +143,12 @@ void PycapApp::Init(int argc, char*argv[], bool bundled)
     }
 
     Py_Initialize();
+    PyEval_InitThreads();
+
+    // Let go of the interpreter lock, so the loading thread can have it
+    // while this thread isn't in Python. It's held again until Init returns.
+    mThreadState = PyEval_SaveThread();
+    PycapLock lock;
 
     PyRun_SimpleString("import sys");
 
@@ -189,10 +202,14 @@ void PycapApp::Init(int argc, char*argv[], bool bundled)
         {"set3DAccelerated", pSet3DAccelerated, METH_VARARGS, "set whether application has 3D acceleration enabled or not"},
         {"isKeyDown", pIsKeyDown, METH_VARARGS, "isKeyDown()\nReturns a boolean indicating if the queried key is down"},
         {"getUserLanguage", pGetUserLanguage, METH_VARARGS, "getUserLanguage returns a string with the user locale"},
+        {"drawList", pDrawList, METH_VARARGS, "drawList( commands )\nDraw a buffer of float32 commands, DRAWLIST_STRIDE floats each: an op (DRAW_IMAGE, FILL_RECT, SET_COLOUR, ...) and its arguments. One call instead of one per sprite."},
         {NULL, NULL, 0, NULL}
     };
 
-    Py_InitModule("Pycap", resMethods);
+    PyObject* module = Py_InitModule("Pycap", resMethods);
+    if (module) {
+        addDrawListConstants(module);
+    }
     // general error location warning
     if (PyErr_Occurred()) {
         PyErr_SetString(PyExc_StandardError, "Some kind of python error occurred in PycapApp(), while importing Pycap module.");
@@ -357,6 +374,7 @@ void PycapApp::LoadingThreadProc()
     SexyAppBase::LoadingThreadProc();
 
     // create the res object
+    PycapLock lock;
     mResources = new PycapResources();
 }
 
@@ -373,6 +391,7 @@ void PycapApp::LoadingThreadCompleted()
     if (mResFailed || !PycapApp::sApp->pDict) {
         // Nothing much happens if we return before adding the board... just a black screen
         // Error message widget should be added here
+        PycapLock lock;
         PyErr_SetString(PyExc_StandardError, "The game did not load properly. Sorry, but it's not going to work.");
         PyErr_Print();
         mShutdown = true;
@@ -406,6 +425,7 @@ void PycapApp::LoadingThreadCompleted()
 
 void PycapApp::GotFocus()
 {
+    PycapLock lock;
     PyObject* pGFFunc = PyDict_GetItemString(PycapApp::sApp->pDict, "gotFocus");
 
     if (pGFFunc && PyCallable_Check(pGFFunc)) {
@@ -419,6 +439,7 @@ void PycapApp::GotFocus()
 
 void PycapApp::LostFocus()
 {
+    PycapLock lock;
     PyObject* pLFFunc = PyDict_GetItemString(PycapApp::sApp->pDict, "lostFocus");
 
     if (pLFFunc && PyCallable_Check(pLFFunc)) {
@@ -437,6 +458,7 @@ void PycapApp::SwitchScreenMode(bool wantWindowed, bool is3d)
 
     // attempt to call python fullscreen or windowed notifier
     // failed attempts still notify, but notify correctly
+    PycapLock lock;
     if (mIsWindowed) {
         // windowed
         PyObject* pWFunc = PyDict_GetItemString(PycapApp::sApp->pDict, "onWindowed");
@@ -1658,3 +1680,187 @@ PyObject* PycapApp::pDrawQuadTextured(PyObject* self, PyObject* args)
     Py_INCREF(Py_None);
     return Py_None;
 }
+
+//--------------------------------------------------
+// pDrawList
+//
+// Draws a whole list of commands in one call. The list is any buffer of
+// float32s (array.array('f'), bytes, numpy), DRAWLIST_STRIDE of them for
+// each command: the op and up to seven arguments, unused ones ignored.
+//
+//   DRAW_IMAGE              image, x, y
+//   DRAW_IMAGE_ROT          image, x, y, angle
+//   DRAW_IMAGE_ROT_SCALED   image, x, y, angle, scaleX, scaleY
+//   DRAW_IMAGE_SCALED       image, x, y, width, height
+//   DRAW_IMAGE_SRC          image, x, y, srcX, srcY, srcWidth, srcHeight
+//   FILL_RECT               x, y, width, height
+//   SET_COLOUR              red, green, blue, alpha
+//   SET_COLOURIZE           on
+//   SET_DRAWMODE            additive
+//--------------------------------------------------
+
+enum {
+    DRAW_IMAGE = 0,
+    DRAW_IMAGE_ROT,
+    DRAW_IMAGE_ROT_SCALED,
+    DRAW_IMAGE_SCALED,
+    DRAW_IMAGE_SRC,
+    FILL_RECT,
+    SET_COLOUR,
+    SET_COLOURIZE,
+    SET_DRAWMODE,
+    DRAWLIST_STRIDE = 8
+};
+
+// how many arguments each op takes
+static const int drawListArgs[SET_DRAWMODE + 1] = { 3, 4, 6, 5, 7, 4, 4, 1, 1 };
+
+// most values are cast to int, so NaNs, infinities and anything far off
+// screen are refused; the bound leaves room for the sums of two of them
+static bool drawListValueOk(float value)
+{
+    return value > -1e9f && value < 1e9f;
+}
+
+void PycapApp::addDrawListConstants(PyObject* module)
+{
+    PyModule_AddIntConstant(module, "DRAW_IMAGE", DRAW_IMAGE);
+    PyModule_AddIntConstant(module, "DRAW_IMAGE_ROT", DRAW_IMAGE_ROT);
+    PyModule_AddIntConstant(module, "DRAW_IMAGE_ROT_SCALED", DRAW_IMAGE_ROT_SCALED);
+    PyModule_AddIntConstant(module, "DRAW_IMAGE_SCALED", DRAW_IMAGE_SCALED);
+    PyModule_AddIntConstant(module, "DRAW_IMAGE_SRC", DRAW_IMAGE_SRC);
+    PyModule_AddIntConstant(module, "FILL_RECT", FILL_RECT);
+    PyModule_AddIntConstant(module, "SET_COLOUR", SET_COLOUR);
+    PyModule_AddIntConstant(module, "SET_COLOURIZE", SET_COLOURIZE);
+    PyModule_AddIntConstant(module, "SET_DRAWMODE", SET_DRAWMODE);
+    PyModule_AddIntConstant(module, "DRAWLIST_STRIDE", DRAWLIST_STRIDE);
+}
+
+PyObject* PycapApp::pDrawList(PyObject* self, PyObject* args)
+{
+    // parse the arguments
+    const char* data;
+    int length;
+    if (!PyArg_ParseTuple(args, "s#", &data, &length)) {
+        PyErr_SetString(PyExc_StandardError, "drawList: failed to parse arguments");
+        PyErr_Print();
+        Py_INCREF(Py_None);
+        return Py_None;
+    }
+
+    // check that we're currently drawing
+    Graphics* graphics = sApp->mBoard->getGraphics();
+    if (!graphics) {
+        // fail, 'cos we can only do this while drawing
+        PyErr_SetString(PyExc_StandardError, "drawList: Not currently drawing");
+        PyErr_Print();
+        Py_INCREF(Py_None);
+        return Py_None;
+    }
+
+    bool is3D = sApp->Is3DAccelerated();
+    int count = length / (DRAWLIST_STRIDE * sizeof(float));
+    int lastIndex = -1;
+    Image* image = NULL;
+
+    for (int n = 0; n < count; n++) {
+        // the buffer needn't be aligned
+        float c[DRAWLIST_STRIDE];
+        memcpy(c, data + n * sizeof(c), sizeof(c));
+
+        int op = drawListValueOk(c[0]) ? (int) c[0] : -1;
+        if (op < 0 || op > SET_DRAWMODE) {
+            // throw an exception
+            PyErr_SetString(PyExc_StandardError, StrFormat("drawList: Unknown op %g in command %d.", c[0], n).c_str());
+            PyErr_Print();
+            // exit, returning None/NULL
+            Py_INCREF(Py_None);
+            return Py_None;
+        }
+
+        for (int k = 1; k <= drawListArgs[op]; k++) {
+            if (!drawListValueOk(c[k])) {
+                // throw an exception
+                PyErr_SetString(PyExc_StandardError, StrFormat("drawList: Bad argument %g in command %d.", c[k], n).c_str());
+                PyErr_Print();
+                // exit, returning None/NULL
+                Py_INCREF(Py_None);
+                return Py_None;
+            }
+        }
+
+        if (op <= DRAW_IMAGE_SRC) {
+            // get the image, most lists draw runs of the same one
+            int i = (int) c[1];
+            if (i < 0) {
+                image = NULL;
+            } else if (i != lastIndex) {
+                image = sApp->mResources->getImage(i);
+                lastIndex = i;
+            }
+            if (!image) {
+                // throw an exception
+                PyErr_SetString(PyExc_StandardError, StrFormat("drawList: Failed to reference image %d in command %d.", i, n).c_str());
+                PyErr_Print();
+                // exit, returning None/NULL
+                Py_INCREF(Py_None);
+                return Py_None;
+            }
+        }
+
+        switch (op) {
+        case DRAW_IMAGE:
+            graphics->DrawImageF(image, c[2], c[3]);
+            break;
+
+        case DRAW_IMAGE_ROT:
+            graphics->DrawImageRotatedF(image, c[2], c[3], c[4]);
+            break;
+
+        case DRAW_IMAGE_ROT_SCALED:
+            if (is3D) {
+                Sexy::Transform t;
+                t.Scale(c[5], c[6]);
+                t.RotateRad(c[4]);
+                t.Translate(image->GetWidth() / 2, image->GetHeight() / 2);
+                graphics->DrawImageTransform(image, t, c[2], c[3]);
+            }
+            break;
+
+        case DRAW_IMAGE_SCALED:
+            // same as drawImageScaled
+            if (!is3D && c[4] < 0.0f) {
+                int w = (int) -c[4];
+                graphics->DrawImageMirror(image, Rect((int) (c[2] - w), (int) c[3], w, (int) c[5]), Rect(0, 0, image->GetWidth(), image->GetHeight()), true);
+            } else {
+                graphics->DrawImage(image, (int) c[2], (int) c[3], (int) c[4], (int) c[5]);
+            }
+            break;
+
+        case DRAW_IMAGE_SRC:
+            graphics->DrawImageF(image, c[2], c[3], Rect((int) c[4], (int) c[5], (int) c[6], (int) c[7]));
+            break;
+
+        case FILL_RECT:
+            graphics->FillRect((int) c[1], (int) c[2], (int) c[3], (int) c[4]);
+            break;
+
+        case SET_COLOUR:
+            graphics->SetColor(Color((int) c[1], (int) c[2], (int) c[3], (int) c[4]));
+            break;
+
+        case SET_COLOURIZE:
+            graphics->SetColorizeImages(c[1] != 0.0f);
+            break;
+
+        case SET_DRAWMODE:
+            graphics->SetDrawMode(c[1] != 0.0f ? Graphics::DRAWMODE_ADDITIVE : Graphics::DRAWMODE_NORMAL);
+            break;
+
+        }
+    }
+
+    // return, 'cos we're done
+    Py_INCREF(Py_None);
+    return Py_None;
+}
@@ -25,6 +25,20 @@ namespace Sexy
 // class declarations
 class PycapBoard;
 
+// Holds the Python interpreter lock for as long as it's in scope. Every call
+// from C++ into Python takes one, as they can come from any thread: the
+// loading thread runs loadBase, the main thread runs the board hooks.
+// Taking it again on a thread that already has it is fine.
+class PycapLock
+{
+public:
+    PycapLock()     { mState = PyGILState_Ensure(); }
+    ~PycapLock()    { PyGILState_Release(mState); }
+
+private:
+    PyGILState_STATE    mState;
+};
+
 
 // Tutorial Application class
 class PycapApp : public SexyAppBase
@@ -78,6 +92,7 @@ private:
     bool                mPythonHomeSet;
     bool                mPythonPathSet;
     bool                mBundled;
+    PyThreadState*      mThreadState;       // the main thread's, while it doesn't hold the interpreter lock
 
     // pycap module functions
     static PyObject* pMarkDirty(PyObject* self, PyObject* args);            // cause a draw call
@@ -119,6 +134,8 @@ private:
     static PyObject* pSet3DAccelerated(PyObject* self, PyObject* args);     // set whether application has 3D acceleration enabled or not
     static PyObject* pIsKeyDown(PyObject* self, PyObject* args);            // returns a boolean indicating if the queried key is down
     static PyObject* pGetUserLanguage(PyObject* self, PyObject* args);      // detects the user locale
+    static PyObject* pDrawList(PyObject* self, PyObject* args);             // draw a whole buffer of draw commands in one call
+    static void      addDrawListConstants(PyObject* module);                // the ops of drawList
 };
 
 
@@ -30,6 +30,8 @@ using namespace Sexy;
 
 PycapBoard::PycapBoard()
 {
+    PycapLock lock;
+
     // call python game init function
     PyObject* pInitFunc = PyDict_GetItemString(PycapApp::sApp->pDict, "init");
 
@@ -80,6 +82,8 @@ PycapBoard::PycapBoard()
 
 PycapBoard::~PycapBoard()
 {
+    PycapLock lock;
+
     // call python shutdown function
     PyObject* pFiniFunc = PyDict_GetItemString(PycapApp::sApp->pDict, "fini");
 
@@ -102,6 +106,8 @@ void PycapBoard::UpdateF(float delta)
     // call parent
     Widget::UpdateF(delta);
 
+    PycapLock lock;
+
     // Python exit-check
     // Checked on entering incase a non-update function has set it
     if (pExitGame) {
@@ -168,6 +174,7 @@ void PycapBoard::Draw(Graphics *g)
         return;
 
     // enter draw code
+    PycapLock lock;
     graphics = g;
 
     // call draw function
@@ -195,6 +202,7 @@ void PycapBoard::KeyDown(KeyCode key)
         return;
 
     // Python keydown hook
+    PycapLock lock;
     PyObject* pArgs = PyTuple_New(1);
     PyObject* pKey = PyInt_FromLong(key);
     PyTuple_SetItem(pArgs, 0, pKey);
@@ -220,6 +228,7 @@ void PycapBoard::KeyUp(KeyCode key)
         return;
 
     // Python keyup hook
+    PycapLock lock;
     PyObject* pArgs = PyTuple_New(1);
     PyObject* pKey = PyInt_FromLong(key);
     PyTuple_SetItem(pArgs, 0, pKey);
@@ -241,6 +250,7 @@ void PycapBoard::KeyUp(KeyCode key)
 void PycapBoard::MouseEnter()
 {
     // call python function if it exists
+    PycapLock lock;
     if (pMouseEnterFunc)
         PyObject_CallObject(pMouseEnterFunc, NULL);
 
@@ -259,6 +269,7 @@ void PycapBoard::MouseEnter()
 void PycapBoard::MouseLeave()
 {
     // call python function if it exists
+    PycapLock lock;
     if (pMouseLeaveFunc)
         PyObject_CallObject(pMouseLeaveFunc, NULL);
 
@@ -278,6 +289,7 @@ void PycapBoard::MouseMove(int x, int y)
 {
     // Python mouse move hook
     if (pMouseMoveFunc) {
+        PycapLock lock;
         PyObject* pArgs = PyTuple_New(2);
         PyObject* pX = PyInt_FromLong(x);
         PyObject* pY = PyInt_FromLong(y);
@@ -314,6 +326,7 @@ void PycapBoard::MouseDown(int x, int y, int theBtnNum, int theClickCount)
 {
     // Python mouse down hook
     if (pMouseDownFunc) {
+        PycapLock lock;
         PyObject* pArgs = PyTuple_New(3);
         PyObject* pX = PyInt_FromLong(x);
         PyObject* pY = PyInt_FromLong(y);
@@ -341,6 +354,7 @@ void PycapBoard::MouseUp(int x, int y, int theBtnNum, int theClickCount)
 {
     // Python mouse up hook
     if (pMouseUpFunc) {
+        PycapLock lock;
         PyObject* pArgs = PyTuple_New(3);
         PyObject* pX = PyInt_FromLong(x);
         PyObject* pY = PyInt_FromLong(y);
@@ -368,6 +382,7 @@ void PycapBoard::MouseWheel(int delta)
 {
     // Python mouse move hook
     if (pMouseWheelFunc) {
+        PycapLock lock;
         PyObject* pArgs = PyTuple_New(1);
         PyObject* pX = PyInt_FromLong(delta);
         PyTuple_SetItem(pArgs, 0, pX);
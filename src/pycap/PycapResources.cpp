@@ -14,6 +14,8 @@
 #include "PycapApp.h"
 
 #include "DDImage.h"
+#include "MemoryImage.h"
+#include "ImageLib.h"
 #include "ImageFont.h"
 //#include "SysFont.h"
 #include "SoundManager.h"
@@ -25,6 +27,8 @@
 
 
 #include <Python.h>
+#include <structmember.h>
+#include <set>
 
 // namespace
 using namespace Sexy;
@@ -32,6 +36,176 @@ using namespace Sexy;
 // static data definition
 PycapResources* PycapResources::sRes = NULL;
 
+//--------------------------------------------------
+// Pixels
+//
+// What lockPixels returns. It hands the bits of an image out through the
+// buffer protocol, so memoryview or numpy work on the whole image at once.
+// Each pixel is a native uint32 0xAARRGGBB, rows are stride bytes apart.
+// BitsChanged is called once, when the pixels are released.
+//--------------------------------------------------
+
+struct PycapPixels {
+    PyObject_HEAD
+    MemoryImage*    image;      // NULL once released, or once PycapResources is gone
+    uint32_t*       bits;
+    int             width;
+    int             height;
+    int             stride;     // in bytes
+    int             readOnly;
+    int             exports;    // buffers handed out and not given back yet
+    Py_ssize_t      shape[2];
+    Py_ssize_t      strides[2];
+};
+
+static PyTypeObject PycapPixelsType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    "PycapRes.Pixels"
+};
+
+static PyBufferProcs PycapPixelsBufferProcs;
+
+// the pixels that haven't been released, ~PycapResources lets go of their
+// images before deleting them
+static std::set<PycapPixels*> livePixels;
+
+static void forgetAllPixels()
+{
+    for (std::set<PycapPixels*>::iterator it = livePixels.begin(); it != livePixels.end(); ++it) {
+        (*it)->image = NULL;
+        (*it)->bits = NULL;
+    }
+    livePixels.clear();
+}
+
+// give the image back, committing any changes
+static bool releasePixels(PycapPixels* pixels)
+{
+    if (pixels->image == NULL) {
+        return true;
+    }
+    if (pixels->exports > 0) {
+        PyErr_SetString(PyExc_BufferError, "Couldn't release pixels: A memoryview of them still exists.");
+        return false;
+    }
+
+    if (!pixels->readOnly) {
+        pixels->image->BitsChanged();
+    }
+    if (PycapResources::sRes) {
+        PycapResources::sRes->unlockImage(pixels->image);
+    }
+    livePixels.erase(pixels);
+    pixels->image = NULL;
+    pixels->bits = NULL;
+    return true;
+}
+
+static void pixelsDealloc(PyObject* self)
+{
+    releasePixels((PycapPixels*) self);
+    Py_TYPE(self)->tp_free(self);
+}
+
+static int pixelsGetBuffer(PyObject* self, Py_buffer* view, int flags)
+{
+    PycapPixels* pixels = (PycapPixels*) self;
+    if (pixels->image == NULL) {
+        PyErr_SetString(PyExc_BufferError, "Pixels have been released.");
+        view->obj = NULL;
+        return -1;
+    }
+    if ((flags & PyBUF_WRITABLE) && pixels->readOnly) {
+        PyErr_SetString(PyExc_BufferError, "Pixels were locked read only.");
+        view->obj = NULL;
+        return -1;
+    }
+
+    view->buf = pixels->bits;
+    view->obj = self;
+    Py_INCREF(self);
+    view->len = pixels->height * pixels->stride;
+    view->readonly = pixels->readOnly;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+    if (flags & PyBUF_ND) {
+        // rows of uint32 pixels
+        view->itemsize = sizeof(uint32_t);
+        view->format = (flags & PyBUF_FORMAT) ? (char*) "I" : NULL;
+        view->ndim = 2;
+        view->shape = pixels->shape;
+        view->strides = ((flags & PyBUF_STRIDES) == PyBUF_STRIDES) ? pixels->strides : NULL;
+    } else {
+        // just the bytes
+        view->itemsize = 1;
+        view->format = (flags & PyBUF_FORMAT) ? (char*) "B" : NULL;
+        view->ndim = 1;
+        view->shape = NULL;
+        view->strides = NULL;
+    }
+
+    pixels->exports++;
+    return 0;
+}
+
+static void pixelsReleaseBuffer(PyObject* self, Py_buffer* view)
+{
+    ((PycapPixels*) self)->exports--;
+}
+
+static PyObject* pixelsCommit(PyObject* self, PyObject* args)
+{
+    PycapPixels* pixels = (PycapPixels*) self;
+    if (pixels->image != NULL && !pixels->readOnly) {
+        pixels->image->BitsChanged();
+    }
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+static PyObject* pixelsRelease(PyObject* self, PyObject* args)
+{
+    if (!releasePixels((PycapPixels*) self)) {
+        return NULL;
+    }
+
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
+static PyObject* pixelsEnter(PyObject* self, PyObject* args)
+{
+    Py_INCREF(self);
+    return self;
+}
+
+static PyObject* pixelsExit(PyObject* self, PyObject* args)
+{
+    if (!releasePixels((PycapPixels*) self)) {
+        return NULL;
+    }
+
+    // don't swallow exceptions from the with block
+    Py_INCREF(Py_False);
+    return Py_False;
+}
+
+static PyMethodDef PycapPixelsMethods[] = {
+    {"commit", pixelsCommit, METH_NOARGS, "commit()\nMake the changes so far visible, without releasing the pixels."},
+    {"release", pixelsRelease, METH_NOARGS, "release()\nCommit the changes and give the image back. Memoryviews of the pixels must be gone by then."},
+    {"__enter__", pixelsEnter, METH_NOARGS, ""},
+    {"__exit__", pixelsExit, METH_VARARGS, ""},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyMemberDef PycapPixelsMembers[] = {
+    {(char*) "width", T_INT, offsetof(PycapPixels, width), READONLY, (char*) "Width in pixels."},
+    {(char*) "height", T_INT, offsetof(PycapPixels, height), READONLY, (char*) "Height in pixels."},
+    {(char*) "stride", T_INT, offsetof(PycapPixels, stride), READONLY, (char*) "Bytes from one row to the next."},
+    {NULL, 0, 0, 0, NULL}
+};
+
 // functions
 
 //--------------------------------------------------
@@ -44,6 +218,11 @@ PycapResources::PycapResources()
     // Initialize non-resource members
 
     sRes = this;
+    nextLoad = 0;
+    loadMutex = SDL_CreateMutex();
+    loadCond = SDL_CreateCond();
+    loadDoneCond = SDL_CreateCond();
+    loadThreadsQuit = false;
     //--------------------------------
 
     //---------------------------
@@ -63,8 +242,15 @@ PycapResources::PycapResources()
         {"unloadSound", pUnloadSound, METH_VARARGS, "unloadSound( sound )\nUnload a sound file from its resource index."},
         {"loadTune", pLoadTune, METH_VARARGS, "loadTune( fileName )\nLoad a music file, and return its resource index."},
         {"unloadTune", pUnloadTune, METH_VARARGS, "unloadTune( tune )\nUnload a music file created by loadTune."},
+        {"loadImageAsync", pLoadImageAsync, METH_VARARGS, "loadImageAsync( fileName )\nStart loading an image in the background, and return a load handle for loadResult."},
+        {"loadFontAsync", pLoadFontAsync, METH_VARARGS, "loadFontAsync( fileName )\nStart loading an image font in the background, and return a load handle for loadResult."},
+        {"loadSoundAsync", pLoadSoundAsync, METH_VARARGS, "loadSoundAsync( fileName )\nStart loading a sound file in the background, and return a load handle for loadResult."},
+        {"loadTuneAsync", pLoadTuneAsync, METH_VARARGS, "loadTuneAsync( fileName )\nStart loading a music file in the background, and return a load handle for loadResult."},
+        {"loadResult", pLoadResult, METH_VARARGS, "loadResult( handle, wait=0 )\nReturns None while the load is still going, then the resource index, or -1 if it failed. The handle is done with once the index or -1 has been returned. With wait set, waits for the load to finish."},
+        {"loadsPending", pLoadsPending, METH_VARARGS, "loadsPending()\nReturns the number of background loads whose result hasn't been collected by loadResult yet."},
         {"getPixel", pGetPixel, METH_VARARGS, "getPixel( image, x, y )\nReturns a tuple representing the colour and alpha data of the specified pixel."},
         {"setPixel", pSetPixel, METH_VARARGS, "setPixel( image, x, y, r, g, b, a )\nSets the colour and alpha data of the specified pixel. Change will not be visible on screen until refreshPixels is called."},
+        {"lockPixels", pLockPixels, METH_VARARGS, "lockPixels( image, readOnly=0 )\nLock the pixels of an image for direct access. Returns a Pixels object that supports the buffer protocol: memoryview(pixels) or numpy.asarray(pixels) gives height rows of width uint32 0xAARRGGBB pixels. Changes become visible when the Pixels are released, with release() or at the end of a with block."},
         {"refreshPixels", pRefreshPixels, METH_VARARGS, "refreshPixels( image )\nSubmits pixel data changes to the image. Without calling this setPixel will have no visible effect. This only needs to be called once to send all setPixel changes though, so try to batch up all your changes into one refresh."},
         {"imageGreyScale", pImageGreyScale, METH_VARARGS, "convert an image to grey scale"},
         {"imageGetHighBound", pImageGetHighBound, METH_VARARGS, "Get the highest none alpha pixel"},
@@ -74,6 +260,18 @@ PycapResources::PycapResources()
         {NULL, NULL, 0, NULL}
     };
     Py_InitModule("PycapRes", resMethods);
+
+    // the type lockPixels returns
+    PycapPixelsBufferProcs.bf_getbuffer = pixelsGetBuffer;
+    PycapPixelsBufferProcs.bf_releasebuffer = pixelsReleaseBuffer;
+    PycapPixelsType.tp_basicsize = sizeof(PycapPixels);
+    PycapPixelsType.tp_dealloc = pixelsDealloc;
+    PycapPixelsType.tp_as_buffer = &PycapPixelsBufferProcs;
+    PycapPixelsType.tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_NEWBUFFER;
+    PycapPixelsType.tp_doc = "Locked pixels of an image, see lockPixels.";
+    PycapPixelsType.tp_methods = PycapPixelsMethods;
+    PycapPixelsType.tp_members = PycapPixelsMembers;
+    PyType_Ready(&PycapPixelsType);
     // general error location warning
     if (PyErr_Occurred()) {
         PyErr_SetString(PyExc_StandardError, "Some kind of python error occurred in PycapResources(), while importing PycapRes.");
@@ -117,6 +315,29 @@ PycapResources::~PycapResources()
     if (sRes == this) {
         sRes = NULL;
     }
+
+    // pixels still held by python, like a module global, outlive the
+    // images deleted below. Released or deallocated later they touch nothing.
+    forgetAllPixels();
+
+    // drop the loads nobody collected
+    // Releasing a sound also drops its pending load, soundLoaded won't be
+    // called with a deleted PycapLoad afterwards.
+    stopLoadThreads();
+    for (std::map<int, PycapLoad*>::iterator lit = loads.begin(); lit != loads.end(); ++lit) {
+        PycapLoad* load = lit->second;
+        delete load->decoded;
+        delete load->fontData;
+        delete load->tune;
+        if (load->type == PycapLoad::SOUND && PycapApp::sApp->mSoundManager) {
+            PycapApp::sApp->mSoundManager->ReleaseSound(load->slot);
+        }
+        delete load;
+    }
+    loads.clear();
+    SDL_DestroyCond(loadDoneCond);
+    SDL_DestroyCond(loadCond);
+    SDL_DestroyMutex(loadMutex);
     //------------------------------
 
     //-------------------
@@ -162,7 +383,7 @@ PycapResources::~PycapResources()
 Image* PycapResources::getImage(int index)
 {
     // check bounds
-    if (index >= (int) sRes->images.size()) {
+    if (index < 0 || index >= (int) sRes->images.size()) {
         // exit, returning None/NULL
         return NULL;
     }
@@ -173,21 +394,28 @@ Image* PycapResources::getImage(int index)
 
 
 //--------------------------------------------------
-// loadImage
+// decodeImage
 //--------------------------------------------------
 
-Image* PycapResources::loadImage(const std::string& fileName)
+ImageLib::Image* PycapResources::decodeImage(const std::string& fileName)
 {
-    Image* newImage = (DDImage*) PycapApp::sApp->GetImage(fileName);
-    if (newImage == NULL) {
-        PycapApp::sApp->resLoadFailed();
-        PyErr_SetString(PyExc_StandardError, ("Image " + fileName + " could not be loaded").c_str());
-        PyErr_Print();
-        return NULL;
-    }
+    // what SexyAppBase::GetImage does, up to making the MemoryImage
+    return ImageLib::GetImage(PycapApp::sApp->GetAppResourceFileName(fileName), PycapApp::sApp->mLookForAlpha);
+}
+
+//--------------------------------------------------
+// makeImage
+//--------------------------------------------------
+
+Image* PycapResources::makeImage(ImageLib::Image* decoded)
+{
+    // the MemoryImage adds itself to the app's image set
+    MemoryImage* newImage = new MemoryImage();
+    newImage->SetBits(decoded->GetBits(), decoded->GetWidth(), decoded->GetHeight(), true);
+    delete decoded;
 
     // palletize
-    ((DDImage*) newImage)->Palletize(); // attempt to palletize, don't worry if it fails
+    newImage->Palletize(); // attempt to palletize, don't worry if it fails
 
     // return new image
     return newImage;
@@ -200,7 +428,7 @@ Image* PycapResources::loadImage(const std::string& fileName)
 Font* PycapResources::getFont(int index)
 {
     // check bounds
-    if (index >= (int) sRes->fonts.size()) {
+    if (index < 0 || index >= (int) sRes->fonts.size()) {
         // exit, returning None/NULL
         return NULL;
     }
@@ -219,9 +447,6 @@ Font* PycapResources::loadFont(const std::string& fileName)
     ImageFont* newFont = new ImageFont(PycapApp::sApp, fileName);
     if (!newFont->mFontData->mInitialized) {
         delete newFont;
-        PycapApp::sApp->resLoadFailed();
-        PyErr_SetString(PyExc_StandardError, ("Font " + fileName + " could not be loaded").c_str());
-        PyErr_Print();
         return NULL;
     }
 
@@ -267,7 +492,7 @@ Font* PycapResources::sysFont(
 bool PycapResources::soundExists(int index)
 {
     // check bounds
-    if (index >= (int) sRes->sounds.size()) {
+    if (index < 0 || index >= (int) sRes->sounds.size()) {
         // out of bounds, so sound doesn't exist
         return false;
     }
@@ -284,17 +509,29 @@ bool PycapResources::soundExists(int index)
 bool PycapResources::loadSound(int id, const std::string& fileName)
 {
     // attempt to load
-    if (!PycapApp::sApp->mSoundManager || !PycapApp::sApp->mSoundManager->LoadSound(id, fileName)) {
-        // report error
-        PycapApp::sApp->resLoadFailed();
-        PyErr_SetString(PyExc_StandardError, ("Sound " + fileName + " could not be loaded").c_str());
-        PyErr_Print();
+    return PycapApp::sApp->mSoundManager && PycapApp::sApp->mSoundManager->LoadSound(id, fileName);
+}
 
-        return false;
-    }
+//--------------------------------------------------
+// loadTune
+//--------------------------------------------------
 
-    // success!
-    return true;
+bool PycapResources::loadTune(int id, const std::string& fileName)
+{
+    // attempt to load
+    return PycapApp::sApp->mMusicInterface && PycapApp::sApp->mMusicInterface->LoadMusic(id, fileName);
+}
+
+//--------------------------------------------------
+// loadFailed
+//--------------------------------------------------
+
+void PycapResources::loadFailed(const std::string& what, const std::string& fileName)
+{
+    // report error
+    PycapApp::sApp->resLoadFailed();
+    PyErr_SetString(PyExc_StandardError, (what + " " + fileName + " could not be loaded").c_str());
+    PyErr_Print();
 }
 
 //--------------------------------------------------
@@ -309,7 +546,7 @@ int PycapResources::getTune(int index)
 
 
     // check bounds
-    if (index >= (int) sRes->tunes.size()) {
+    if (index < 0 || index >= (int) sRes->tunes.size()) {
         // exit, returning None/NULL
         return -1;
     }
@@ -336,9 +573,15 @@ PyObject* PycapResources::pLoadImage(PyObject* self, PyObject* args)
 
     }
 
-    // load from the file
-    Image* newImage = sRes->loadImage(filename);
-    if (!newImage) {
+    // decode the file, letting other python threads run meanwhile
+    std::string fileName = filename;
+    ImageLib::Image* decoded;
+    Py_BEGIN_ALLOW_THREADS
+    decoded = decodeImage(fileName);
+    Py_END_ALLOW_THREADS
+    if (!decoded) {
+        sRes->loadFailed("Image", fileName);
+
         // throw an exception
         PyErr_SetString(PyExc_StandardError, "loadImage: Failed to load image file");
         PyErr_Print();
@@ -348,28 +591,37 @@ PyObject* PycapResources::pLoadImage(PyObject* self, PyObject* args)
         return Py_None;
     }
 
+    // return image index value
+    return Py_BuildValue("i", sRes->addImage(sRes->makeImage(decoded)));
+}
+
+//--------------------------------------------------
+// addImage
+//--------------------------------------------------
+
+int PycapResources::addImage(Image* image)
+{
     // add image to our collection
     int index;
     // test for free slot
-    if (sRes->freeImages.empty()) {
+    if (freeImages.empty()) {
         // add new entry in images
-        sRes->images.push_back(newImage);
+        images.push_back(image);
 
         // set index
-        index = sRes->images.size() - 1;
+        index = images.size() - 1;
     } else {
         // set index
-        index = sRes->freeImages.back();
+        index = freeImages.back();
 
         // reuse slot
-        (sRes->images[index]) = newImage;
+        images[index] = image;
 
         // remove free index
-        sRes->freeImages.pop_back();
+        freeImages.pop_back();
     }
 
-    // return image index value
-    return Py_BuildValue("i", index);
+    return index;
 }
 
 //--------------------------------------------------
@@ -500,6 +752,17 @@ PyObject* PycapResources::pUnloadImage(PyObject* self, PyObject* args)
         return Py_None;
     }
 
+    // test for locked pixels
+    if (sRes->lockedImages.find(sRes->images[index]) != sRes->lockedImages.end()) {
+        // throw an exception
+        PyErr_SetString(PyExc_StandardError, "Couldn't unload image: Its pixels are locked.");
+        PyErr_Print();
+
+        // exit, returning None/NULL
+        Py_INCREF(Py_None);
+        return Py_None;
+    }
+
     // unload the image
     delete sRes->images[index];
     sRes->images[index] = NULL;
@@ -530,8 +793,12 @@ PyObject* PycapResources::pLoadFont(PyObject* self, PyObject* args)
     }
 
     // load from the file
-    Font* newFont = sRes->loadFont(filename);
+    // The font loads its images through the app, so the lock is kept
+    std::string fileName = filename;
+    Font* newFont = sRes->loadFont(fileName);
     if (!newFont) {
+        sRes->loadFailed("Font", fileName);
+
         // throw an exception
         PyErr_SetString(PyExc_StandardError, "Failed to load a font file.");
         PyErr_Print();
@@ -541,28 +808,37 @@ PyObject* PycapResources::pLoadFont(PyObject* self, PyObject* args)
         return Py_None;
     }
 
+    // return font index value
+    return Py_BuildValue("i", sRes->addFont(newFont));
+}
+
+//--------------------------------------------------
+// addFont
+//--------------------------------------------------
+
+int PycapResources::addFont(Font* font)
+{
     // add font to our collection
     int index;
     // test for free slot
-    if (sRes->freeFonts.empty()) {
+    if (freeFonts.empty()) {
         // add new entry in fonts
-        sRes->fonts.push_back(newFont);
+        fonts.push_back(font);
 
         // set index
-        index = sRes->fonts.size() - 1;
+        index = fonts.size() - 1;
     } else {
         // set index
-        index = sRes->freeFonts.back();
+        index = freeFonts.back();
 
         // reuse slot
-        (sRes->fonts[index]) = newFont;
+        fonts[index] = font;
 
         // remove free index
-        sRes->freeFonts.pop_back();
+        freeFonts.pop_back();
     }
 
-    // return font index value
-    return Py_BuildValue("i", index);
+    return index;
 }
 
 //--------------------------------------------------
@@ -850,15 +1126,20 @@ PyObject* PycapResources::pLoadSound(PyObject* self, PyObject* args)
 
     // find a free slot
     // (Popcap's sound manager requires us to choose one)
-    int slot;
-    if (sRes->freeSounds.empty()) {
-        slot = sRes->sounds.size();
-    } else {
-        slot = sRes->freeSounds.back();
-    }
+    // It's taken before letting go of the interpreter lock, so another
+    // python thread loading a sound meanwhile doesn't get the same one.
+    int slot = sRes->reserveSound();
 
     // attempt to load from the file
-    if (!sRes->loadSound(slot, filename)) {
+    std::string fileName = filename;
+    bool loaded;
+    Py_BEGIN_ALLOW_THREADS
+    loaded = sRes->loadSound(slot, fileName);
+    Py_END_ALLOW_THREADS
+    if (!loaded) {
+        sRes->freeSounds.push_front(slot);
+        sRes->loadFailed("Sound", fileName);
+
         // throw an exception
         PyErr_SetString(PyExc_StandardError, "Failed to load a sound file.");
         PyErr_Print();
@@ -869,21 +1150,31 @@ PyObject* PycapResources::pLoadSound(PyObject* self, PyObject* args)
     }
 
     // record that we've added the sound
-    if (sRes->freeSounds.empty()) {
-        // add new entry in sounds
-        sRes->sounds.push_back(true);
-    } else {
-        // reuse slot
-        (sRes->sounds[slot]) = true;
-
-        // remove free index
-        sRes->freeSounds.pop_back();
-    }
+    sRes->sounds[slot] = true;
 
     // return sound index value
     return Py_BuildValue("i", slot);
 }
 
+//--------------------------------------------------
+// reserveSound
+//--------------------------------------------------
+
+int PycapResources::reserveSound()
+{
+    // the slot stays marked as not loaded until the sound is
+    int slot;
+    if (freeSounds.empty()) {
+        slot = sounds.size();
+        sounds.push_back(false);
+    } else {
+        slot = freeSounds.back();
+        freeSounds.pop_back();
+    }
+
+    return slot;
+}
+
 //--------------------------------------------------
 // pUnloadSound
 //--------------------------------------------------
@@ -953,9 +1244,18 @@ PyObject* PycapResources::pLoadTune(PyObject* self, PyObject* args)
         return Py_None;
     }
 
-    int index = sRes->tunes.size();
+    int index = sRes->reserveTune();
+
+    // attempt to load from the file
+    // The main thread plays from the music interface, so the lock is kept
+    std::string fileName = filename;
+    bool loaded = sRes->loadTune(index, fileName);
+    if (!loaded) {
+        // give the slot back if nothing was reserved after it
+        if (index == (int) sRes->tunes.size() - 1) {
+            sRes->tunes.pop_back();
+        }
 
-    if (!PycapApp::sApp->mMusicInterface || !PycapApp::sApp->mMusicInterface->LoadMusic(index, filename)) {
         // throw an exception
         PyErr_SetString(PyExc_StandardError, "Failed to load a music file.");
         PyErr_Print();
@@ -965,12 +1265,23 @@ PyObject* PycapResources::pLoadTune(PyObject* self, PyObject* args)
         return Py_None;
     }
 
-    sRes->tunes.push_back(index);
+    sRes->tunes[index] = index;
 
     // return tune index value
     return Py_BuildValue("i", index);
 }
 
+//--------------------------------------------------
+// reserveTune
+//--------------------------------------------------
+
+int PycapResources::reserveTune()
+{
+    // -1 until the tune is loaded
+    tunes.push_back(-1);
+    return tunes.size() - 1;
+}
+
 //--------------------------------------------------
 // pUnloadTune
 //--------------------------------------------------
@@ -1014,6 +1325,378 @@ PyObject* PycapResources::pUnloadTune(PyObject* self, PyObject* args)
     return Py_None;
 }
 
+//--------------------------------------------------
+// Async loading
+//
+// The async load functions return a handle straight away. Images, fonts
+// and tunes are decoded without the interpreter lock on a loader thread,
+// and loadResult gives the resource index once that's done. The slot is
+// only taken then, under the lock, apart from sounds and tunes which need
+// theirs up front. What needs the app or the music interface is left to
+// finishLoad: making a font's images and loading the prepared tune.
+//--------------------------------------------------
+
+//--------------------------------------------------
+// startLoad
+//--------------------------------------------------
+
+int PycapResources::startLoad(PycapLoad* load)
+{
+    load->slot = -1;
+    load->decoded = NULL;
+    load->fontData = NULL;
+    load->tune = NULL;
+    load->done = false;
+    load->success = false;
+
+    int handle = nextLoad++;
+    loads[handle] = load;
+
+    if (load->type == PycapLoad::SOUND) {
+        // the sound manager decodes on its own loader threads, and calls
+        // soundLoaded from FinishLoads, which loadResult calls
+        load->slot = reserveSound();
+        if (!PycapApp::sApp->mSoundManager ||
+            !PycapApp::sApp->mSoundManager->LoadSoundAsync(load->slot, load->fileName, soundLoaded, load)) {
+            load->done = true;
+        }
+        return handle;
+    }
+
+    if (load->type == PycapLoad::TUNE) {
+        load->slot = reserveTune();
+        if (!PycapApp::sApp->mMusicInterface) {
+            load->done = true;
+            return handle;
+        }
+    } else if (load->type == PycapLoad::FONT) {
+        // made here as it looks up its logger, decoded on a loader thread
+        load->fontData = new FontData();
+    }
+
+    startLoadThreads();
+
+    SDL_LockMutex(loadMutex);
+    loadQueue.push_back(load);
+    SDL_CondSignal(loadCond);
+    SDL_UnlockMutex(loadMutex);
+    return handle;
+}
+
+//--------------------------------------------------
+// startLoadThreads
+//--------------------------------------------------
+
+void PycapResources::startLoadThreads()
+{
+    if (!loadThreads.empty()) {
+        return;
+    }
+
+    int numThreads = std::max(1, std::min(4, SDL_GetCPUCount() - 1));
+    for (int i = 0; i < numThreads; i++) {
+#if SDL_VERSION_ATLEAST(2,0,0)
+        SDL_Thread* thread = SDL_CreateThread(loadThreadProc, "PycapLoad", this);
+#else
+        SDL_Thread* thread = SDL_CreateThread(loadThreadProc, this);
+#endif
+        if (thread != NULL) {
+            loadThreads.push_back(thread);
+        }
+    }
+}
+
+//--------------------------------------------------
+// stopLoadThreads
+//--------------------------------------------------
+
+void PycapResources::stopLoadThreads()
+{
+    SDL_LockMutex(loadMutex);
+    loadThreadsQuit = true;
+    SDL_CondBroadcast(loadCond);
+    SDL_UnlockMutex(loadMutex);
+
+    for (size_t i = 0; i < loadThreads.size(); i++) {
+        SDL_WaitThread(loadThreads[i], NULL);
+    }
+    loadThreads.clear();
+    loadQueue.clear();
+}
+
+//--------------------------------------------------
+// loadThreadProc
+//--------------------------------------------------
+
+int PycapResources::loadThreadProc(void* arg)
+{
+    // no Python in here, the loader threads never take the interpreter lock
+    PycapResources* res = (PycapResources*) arg;
+
+    SDL_LockMutex(res->loadMutex);
+    for (;;) {
+        while (res->loadQueue.empty() && !res->loadThreadsQuit) {
+            SDL_CondWait(res->loadCond, res->loadMutex);
+        }
+        if (res->loadThreadsQuit) {
+            break;
+        }
+
+        PycapLoad* load = res->loadQueue.front();
+        res->loadQueue.pop_front();
+        SDL_UnlockMutex(res->loadMutex);
+
+        // nothing but the load is touched until it's marked done
+        bool success = false;
+        if (load->type == PycapLoad::IMAGE) {
+            load->decoded = decodeImage(load->fileName);
+            success = load->decoded != NULL;
+        } else if (load->type == PycapLoad::FONT) {
+            success = load->fontData->Decode(load->fileName);
+        } else if (load->type == PycapLoad::TUNE) {
+            load->tune = PycapApp::sApp->mMusicInterface->PrepareMusic(load->fileName);
+            success = load->tune != NULL;
+        }
+
+        SDL_LockMutex(res->loadMutex);
+        load->success = success;
+        load->done = true;
+        SDL_CondBroadcast(res->loadDoneCond);
+    }
+    SDL_UnlockMutex(res->loadMutex);
+    return 0;
+}
+
+//--------------------------------------------------
+// soundLoaded
+//--------------------------------------------------
+
+void PycapResources::soundLoaded(void* arg, unsigned int sfxID, bool success)
+{
+    // called by whichever thread runs FinishLoads, which may be the
+    // ResourceManager's loading thread, or straight from LoadSoundAsync
+    PycapLoad* load = (PycapLoad*) arg;
+    SDL_LockMutex(sRes->loadMutex);
+    load->success = success;
+    load->done = true;
+    SDL_UnlockMutex(sRes->loadMutex);
+}
+
+//--------------------------------------------------
+// finishLoad
+//--------------------------------------------------
+
+PyObject* PycapResources::finishLoad(PycapLoad* load)
+{
+    // with the interpreter lock, fonts get their images and tunes are
+    // loaded into the music interface now
+    Font* font = NULL;
+    if (load->type == PycapLoad::FONT) {
+        if (load->success) {
+            ImageFont* newFont = new ImageFont(PycapApp::sApp, load->fontData);
+            if (newFont->mFontData->mInitialized) {
+                font = newFont;
+            } else {
+                delete newFont;
+            }
+            load->success = font != NULL;
+        } else {
+            delete load->fontData;
+        }
+        load->fontData = NULL;
+    } else if (load->type == PycapLoad::TUNE && load->success) {
+        load->success = PycapApp::sApp->mMusicInterface->LoadPreparedMusic(load->slot, load->tune);
+        load->tune = NULL;
+    }
+
+    int index = -1;
+    if (load->success) {
+        switch (load->type) {
+        case PycapLoad::IMAGE:
+            index = addImage(makeImage(load->decoded));
+            break;
+        case PycapLoad::FONT:
+            index = addFont(font);
+            break;
+        case PycapLoad::SOUND:
+            sounds[load->slot] = true;
+            index = load->slot;
+            break;
+        case PycapLoad::TUNE:
+            tunes[load->slot] = load->slot;
+            index = load->slot;
+            break;
+        }
+    } else {
+        switch (load->type) {
+        case PycapLoad::IMAGE:
+            loadFailed("Image", load->fileName);
+            break;
+        case PycapLoad::FONT:
+            loadFailed("Font", load->fileName);
+            break;
+        case PycapLoad::SOUND:
+            freeSounds.push_front(load->slot);
+            loadFailed("Sound", load->fileName);
+            break;
+        case PycapLoad::TUNE:
+            PyErr_SetString(PyExc_StandardError, ("Tune " + load->fileName + " could not be loaded").c_str());
+            PyErr_Print();
+            break;
+        }
+    }
+
+    delete load;
+    return Py_BuildValue("i", index);
+}
+
+//--------------------------------------------------
+// loadAsync
+//--------------------------------------------------
+
+PyObject* PycapResources::loadAsync(PyObject* args, PycapLoad::Type type, const char* name)
+{
+    // parse the arguments
+    char* filename;
+    if (!PyArg_ParseTuple(args, "s", &filename)) {
+        // throw an exception
+        PyErr_SetString(PyExc_StandardError, (std::string(name) + ": failed to parse arguments").c_str());
+        PyErr_Print();
+
+        // exit, returning None/NULL
+        Py_INCREF(Py_None);
+        return Py_None;
+    }
+
+    PycapLoad* load = new PycapLoad();
+    load->type = type;
+    load->fileName = filename;
+
+    // return load handle
+    return Py_BuildValue("i", sRes->startLoad(load));
+}
+
+//--------------------------------------------------
+// pLoadImageAsync
+//--------------------------------------------------
+
+PyObject* PycapResources::pLoadImageAsync(PyObject* self, PyObject* args)
+{
+    return loadAsync(args, PycapLoad::IMAGE, "loadImageAsync");
+}
+
+//--------------------------------------------------
+// pLoadFontAsync
+//--------------------------------------------------
+
+PyObject* PycapResources::pLoadFontAsync(PyObject* self, PyObject* args)
+{
+    return loadAsync(args, PycapLoad::FONT, "loadFontAsync");
+}
+
+//--------------------------------------------------
+// pLoadSoundAsync
+//--------------------------------------------------
+
+PyObject* PycapResources::pLoadSoundAsync(PyObject* self, PyObject* args)
+{
+    return loadAsync(args, PycapLoad::SOUND, "loadSoundAsync");
+}
+
+//--------------------------------------------------
+// pLoadTuneAsync
+//--------------------------------------------------
+
+PyObject* PycapResources::pLoadTuneAsync(PyObject* self, PyObject* args)
+{
+    return loadAsync(args, PycapLoad::TUNE, "loadTuneAsync");
+}
+
+//--------------------------------------------------
+// pLoadResult
+//--------------------------------------------------
+
+PyObject* PycapResources::pLoadResult(PyObject* self, PyObject* args)
+{
+    // parse the arguments
+    int handle;
+    int wait = 0;
+    if (!PyArg_ParseTuple(args, "i|i", &handle, &wait)) {
+        // throw an exception
+        PyErr_SetString(PyExc_StandardError, "loadResult: failed to parse arguments");
+        PyErr_Print();
+
+        // exit, returning None/NULL
+        Py_INCREF(Py_None);
+        return Py_None;
+    }
+
+    std::map<int, PycapLoad*>::iterator it = sRes->loads.find(handle);
+    if (it == sRes->loads.end()) {
+        // throw an exception
+        PyErr_SetString(PyExc_StandardError, "loadResult: no load with that handle, or its result was already returned.");
+        PyErr_Print();
+
+        // exit, returning None/NULL
+        Py_INCREF(Py_None);
+        return Py_None;
+    }
+    PycapLoad* load = it->second;
+
+    bool done;
+    if (load->type == PycapLoad::SOUND) {
+        // finishing sound loads only calls soundLoaded, which takes
+        // loadMutex but no Python, so the wait lets go of the interpreter
+        if (PycapApp::sApp->mSoundManager) {
+            PycapApp::sApp->mSoundManager->FinishLoads(false);
+            SDL_LockMutex(sRes->loadMutex);
+            done = load->done;
+            SDL_UnlockMutex(sRes->loadMutex);
+            if (wait && !done) {
+                Py_BEGIN_ALLOW_THREADS
+                PycapApp::sApp->mSoundManager->FinishLoads(true);
+                Py_END_ALLOW_THREADS
+            }
+        }
+        SDL_LockMutex(sRes->loadMutex);
+        done = load->done;
+        SDL_UnlockMutex(sRes->loadMutex);
+    } else {
+        // the mutex is let go of before taking the interpreter lock back,
+        // as the other way round startLoad could deadlock with us
+        if (wait) {
+            Py_BEGIN_ALLOW_THREADS
+            SDL_LockMutex(sRes->loadMutex);
+            while (!load->done) {
+                SDL_CondWait(sRes->loadDoneCond, sRes->loadMutex);
+            }
+            SDL_UnlockMutex(sRes->loadMutex);
+            Py_END_ALLOW_THREADS
+        }
+        SDL_LockMutex(sRes->loadMutex);
+        done = load->done;
+        SDL_UnlockMutex(sRes->loadMutex);
+    }
+
+    if (!done) {
+        // still loading
+        Py_INCREF(Py_None);
+        return Py_None;
+    }
+
+    sRes->loads.erase(it);
+    return sRes->finishLoad(load);
+}
+
+//--------------------------------------------------
+// pLoadsPending
+//--------------------------------------------------
+
+PyObject* PycapResources::pLoadsPending(PyObject* self, PyObject* args)
+{
+    return Py_BuildValue("i", (int) sRes->loads.size());
+}
+
 //--------------------------------------------------
 // pGetPixel
 //--------------------------------------------------
@@ -1259,6 +1942,89 @@ PyObject* PycapResources::pRefreshPixels(PyObject* self, PyObject* args)
     }
 }
 
+//--------------------------------------------------
+// lockImage / unlockImage
+//--------------------------------------------------
+
+void PycapResources::lockImage(Image* image)
+{
+    lockedImages[image]++;
+}
+
+void PycapResources::unlockImage(Image* image)
+{
+    std::map<Image*, int>::iterator it = lockedImages.find(image);
+    if (it != lockedImages.end() && --it->second == 0) {
+        lockedImages.erase(it);
+    }
+}
+
+//--------------------------------------------------
+// pLockPixels
+//--------------------------------------------------
+
+PyObject* PycapResources::pLockPixels(PyObject* self, PyObject* args)
+{
+    // parse the arguments
+    int index;
+    int readOnly = 0;
+    if (!PyArg_ParseTuple(args, "i|i", &index, &readOnly)) {
+        // throw an exception
+        PyErr_SetString(PyExc_StandardError, "lockPixels: failed to parse arguments");
+        PyErr_Print();
+
+        // exit, returning None/NULL
+        Py_INCREF(Py_None);
+        return Py_None;
+    }
+
+    // test for out of range
+    if (index < 0 || index >= (int) sRes->images.size()) {
+        // throw an exception
+        PyErr_SetString(PyExc_StandardError, "Couldn't lock pixels for image: Index out of range.");
+        PyErr_Print();
+
+        // exit, returning None/NULL
+        Py_INCREF(Py_None);
+        return Py_None;
+    }
+
+    // grab pixels
+    MemoryImage* image = dynamic_cast<MemoryImage*> (sRes->images[index]);
+    uint32_t* bits = image ? image->GetBits() : NULL;
+    if (!bits) {
+        // throw an exception
+        PyErr_SetString(PyExc_StandardError, "Couldn't lock pixels for image: Image not loaded or has no bits.");
+        PyErr_Print();
+
+        // exit, returning None/NULL
+        Py_INCREF(Py_None);
+        return Py_None;
+    }
+
+    PycapPixels* pixels = PyObject_New(PycapPixels, &PycapPixelsType);
+    if (!pixels) {
+        return NULL;
+    }
+    pixels->image = image;
+    pixels->bits = bits;
+    pixels->width = image->GetWidth();
+    pixels->height = image->GetHeight();
+    pixels->stride = pixels->width * sizeof(uint32_t);
+    pixels->readOnly = readOnly != 0;
+    pixels->exports = 0;
+    pixels->shape[0] = pixels->height;
+    pixels->shape[1] = pixels->width;
+    pixels->strides[0] = pixels->stride;
+    pixels->strides[1] = sizeof(uint32_t);
+
+    // unloadImage leaves it alone while it's locked
+    sRes->lockImage(image);
+    livePixels.insert(pixels);
+
+    return (PyObject*) pixels;
+}
+
 struct PaletteMashLookup {
     uint32_t OldValue;
     uint32_t NewValue;
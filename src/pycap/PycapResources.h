@@ -13,12 +13,18 @@
 #include "SexyAppBase.h"
 #include <vector>
 #include <list>
+#include <map>
 
 #ifndef __PYCAPRESOURCES_H__
 #define __PYCAPRESOURCES_H__
 
 #include <Python.h>
 
+namespace ImageLib
+{
+class Image;
+}
+
 // use the Sexy namespace
 namespace Sexy
 {
@@ -27,8 +33,25 @@ namespace Sexy
 class Image;
 class Font;
 class ImageFont;
+class FontData;
+class PreparedMusic;
 //class SysFont;
 
+// A load started by one of the async load functions, see loadResult
+struct PycapLoad
+{
+    enum Type { IMAGE, FONT, SOUND, TUNE };
+
+    Type            type;
+    std::string     fileName;
+    int             slot;       // sounds and tunes get theirs up front
+    ImageLib::Image* decoded;   // the pixels of an image, made into an Image by finishLoad
+    FontData*       fontData;   // a font, decoded but without its images yet
+    PreparedMusic*  tune;       // a tune's file work, loaded by finishLoad
+    bool            done;       // guarded by loadMutex
+    bool            success;
+};
+
 // Pycap Resources class
 class PycapResources
 {
@@ -48,10 +71,19 @@ public:
     bool                    soundExists( int index );
     int                     getTune( int index );
 
+    // images with locked pixels, which can't be unloaded
+    void                    lockImage( Image* image );
+    void                    unlockImage( Image* image );
+
 private:
 
     // resource loading
-    Image*                  loadImage( const std::string& fileName );           // attempt load an image and convert pallete
+    // Only decodeImage, and loadSound as the sound manager locks itself, may
+    // run without the interpreter lock. The others add to the app's image
+    // set or the music interface, which the main thread uses with the lock
+    // held.
+    static ImageLib::Image* decodeImage( const std::string& fileName );         // attempt to read an image file, touches nothing shared
+    Image*                  makeImage( ImageLib::Image* decoded );              // make a decoded image into an Image and convert pallete
     Font*                   loadFont( const std::string& fileName );            // attempt load an image font
     Font*                   sysFont(                                            // attempt to create a system font
                                 const std::string& faceName,
@@ -62,6 +94,26 @@ private:
                                 bool underline
                                 );
     bool                    loadSound( int id, const std::string& fileName );   // attempt load a sound into a given slot
+    bool                    loadTune( int id, const std::string& fileName );    // attempt load a music file into a given slot
+    void                    loadFailed( const std::string& what, const std::string& fileName );  // report a failed load
+
+    // resource slots
+    int                     addImage( Image* image );
+    int                     addFont( Font* font );
+    int                     reserveSound();
+    int                     reserveTune();
+
+    // async loading
+    // Images are decoded on pycap's own loader threads, sounds are handed to
+    // the sound manager's async loading. Fonts and tunes are loaded by
+    // finishLoad.
+    int                     startLoad( PycapLoad* load );
+    void                    startLoadThreads();
+    void                    stopLoadThreads();
+    PyObject*               finishLoad( PycapLoad* load );
+    static int              loadThreadProc( void* arg );
+    static void             soundLoaded( void* arg, unsigned int sfxID, bool success );
+    static PyObject*        loadAsync( PyObject* args, PycapLoad::Type type, const char* name );
 
     // Python resource handling functions
     // Resources are simply referenced by index. Failed prints errors to err.txt.
@@ -79,9 +131,16 @@ private:
     static PyObject* pUnloadSound( PyObject* self, PyObject* args );    // attempt to unload a given sound.
     static PyObject* pLoadTune( PyObject* self, PyObject* args );       // attempt to load a music file
     static PyObject* pUnloadTune( PyObject* self, PyObject* args );     // attempt to unload a given music file.
+    static PyObject* pLoadImageAsync( PyObject* self, PyObject* args ); // start loading an image in the background. Returns a load handle.
+    static PyObject* pLoadFontAsync( PyObject* self, PyObject* args );  // start loading a font in the background. Returns a load handle.
+    static PyObject* pLoadSoundAsync( PyObject* self, PyObject* args ); // start loading a sound in the background. Returns a load handle.
+    static PyObject* pLoadTuneAsync( PyObject* self, PyObject* args );  // start loading a music file in the background. Returns a load handle.
+    static PyObject* pLoadResult( PyObject* self, PyObject* args );     // get the resource index of a background load, once it's done.
+    static PyObject* pLoadsPending( PyObject* self, PyObject* args );   // get the number of background loads not collected yet.
     static PyObject* pGetPixel( PyObject* self, PyObject* args );       // attempt to read pixel data from a locked image.
     static PyObject* pSetPixel( PyObject* self, PyObject* args );       // attempt to set pixel data from a locked image.
     static PyObject* pRefreshPixels( PyObject* self, PyObject* args );  // attempt to refresh an image from memory data.
+    static PyObject* pLockPixels( PyObject* self, PyObject* args );     // lock the pixels of an image for access through the buffer protocol.
     static PyObject* pMashPalette( PyObject* self, PyObject* args );    // write garbage into the specified image's palette :)
     static PyObject* pMashImage( PyObject* self, PyObject* args );      // distort image data in some way
     static PyObject* pImageGreyScale( PyObject* self, PyObject* args ); // convert image to grey scale.
@@ -107,6 +166,17 @@ private:
     std::vector<bool>                   sounds;     // flags indicating whether sounds are valid
     std::list<int>                      freeSounds; // list of empty sound slots
     std::vector<int>                    tunes;      // collection of music segment objects
+    std::map<Image*, int>               lockedImages; // lock counts of images with locked pixels
+
+    // async loads
+    std::map<int, PycapLoad*>           loads;      // by handle, until loadResult hands out the result
+    int                                 nextLoad;   // next load handle
+    std::vector<SDL_Thread*>            loadThreads;
+    SDL_mutex*                          loadMutex;
+    SDL_cond*                           loadCond;
+    SDL_cond*                           loadDoneCond;
+    std::list<PycapLoad*>               loadQueue;  // guarded by loadMutex
+    bool                                loadThreadsQuit;
 };
 
 }
@@ -8,24 +8,35 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <map>
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
 #include <ctime>
 #include <stdint.h>
 
 #include <sys/stat.h>
 #include <dirent.h>
+#include <unistd.h>
+#include <pthread.h>
 
 using namespace std;
 
 #define POPPAK_MAGIC    (0xBAC04AC0)
-#define POPPAK_VERSION  (0x0)
+#define POPPAK_VERSION  (0x1)
 
+// Version 1 adds the hash of the contents to every entry, and entries
+// sharing the contents of an earlier one. Version 0 paks are still read.
 enum
 {
+    FILEFLAGS_SHARED = 0x01,        // contents are at the position that follows, stored once for all entries that have them
     FILEFLAGS_END = 0x80,           // indicates end of header
 };
 
+#define COPY_BUFFER_SIZE    (1 << 20)           // of reads and writes
+#define KEEP_MAX_SIZE       (4 << 20)           // files up to this size are kept in memory after hashing them...
+#define KEEP_BUDGET         (256 << 20)         // ...until this much is kept
+
 // Base for all exceptions
 class Exception
 {
@@ -150,6 +161,22 @@ const string ErrorReadingFileException::diag() const
     return buffer;
 }
 
+class ErrorWritingFileException : Exception
+{
+public:
+    ErrorWritingFileException(const string & name) : Exception(), _name(name) {}
+
+    virtual const string    diag() const;
+private:
+    const string    _name;
+};
+const string ErrorWritingFileException::diag() const
+{
+    char buffer[100];
+    sprintf(buffer, "Error writing file: \"%s\"", _name.c_str());
+    return buffer;
+}
+
 class DirectoryDoesNotExistException : Exception
 {
 public:
@@ -169,19 +196,32 @@ const string DirectoryDoesNotExistException::diag() const
 class PopPakFileInfo
 {
 public:
-    PopPakFileInfo(time_t time, const string & name, long int size, long int pos, int64_t filetime);
+    PopPakFileInfo(time_t time, const string & name, long int size, long int pos, int64_t filetime, uint64_t hash = 0);
 
     time_t          Time() const { return _time; }
     const string    Name() const { return _name; }
     long int        Size() const { return _size; }
     long int        Pos() const { return _pos; }
     uint64_t        Filetime() const { return _filetime; }
+    uint64_t        Hash() const { return _hash; }
 private:
     time_t          _time;
     const string    _name;
     long int        _size;
     long int        _pos;
     int64_t         _filetime;      // Windows FILETIME
+    uint64_t        _hash;          // FNV-1a of the contents, 0 in version 0 paks
+};
+
+// An entry of the pak finish() is building
+struct PopPakBuildEntry
+{
+    PopPakFileInfo *            info;
+    const PopPakFileInfo *      old;        // unchanged entry of the previous pak, copied from there
+    uint64_t                    hash;
+    const PopPakBuildEntry *    same;       // earlier entry with the same contents, or NULL
+    long int                    pos;        // of the contents, from the start of the data
+    uint8_t *                   contents;   // kept from hashing, or NULL
 };
 
 class PopPak
@@ -190,6 +230,7 @@ public:
     PopPak(const char* name, const string& mode);
     void            printdir();
     void            add_to_pak(const string & name);
+    void            set_previous(PopPak * previous);
     void            extract(const string & dir);
     void            finish();
     void            close();
@@ -202,34 +243,142 @@ public:
     void            writel(uint32_t l);
     void            writeq(uint64_t q);
     void            writestr(const string & str);
-    void            writebuf(uint8_t * buf, int len);
+    void            writebuf(const uint8_t * buf, int len);
+    void            flush();
     time_t          filetime_to_unixtime(uint64_t time) const;
+    uint64_t        unixtime_to_filetime(time_t time) const;
 
 private:
     void            readinfos();
+    bool            up_to_date(const vector<PopPakBuildEntry> & entries) const;
+    FILE *          open_contents(const PopPakBuildEntry & entry) const;
+    size_t          read_contents(const PopPakBuildEntry & entry, FILE * fp, uint8_t * buf, size_t len) const;
+    bool            same_contents(const PopPakBuildEntry & a, const PopPakBuildEntry & b) const;
+    void            hash_entry(PopPakBuildEntry & entry);
+    static void     hash_entry_proc(void * arg, size_t i);
 
 private:
     const string    _name;
     string          _mode;
     FILE *          _fp;
     long int        _dataoffset;
+    int32_t         _version;
     vector<PopPakFileInfo*>     _fileinfos;
+    PopPak *        _previous;      // pak being updated, see set_previous()
+    vector<uint8_t> _wbuf;          // xor'ed bytes not written yet
+
+    // finish() state shared with the hashing threads
+    vector<PopPakBuildEntry> *  _entries;
+    const vector<size_t> *      _tohash;    // indices in _entries
+    pthread_mutex_t _lock;
+    long int        _kept;          // bytes of contents kept in memory
+    Exception *     _error;         // first error of the hashing threads
 };
 
-PopPakFileInfo::PopPakFileInfo(time_t time, const string& name, long int size, long int pos, int64_t filetime) :
+PopPakFileInfo::PopPakFileInfo(time_t time, const string& name, long int size, long int pos, int64_t filetime, uint64_t hash) :
         _time(time),
         _name(name),
         _size(size),
         _pos(pos),
-        _filetime(filetime)
+        _filetime(filetime),
+        _hash(hash)
+{
+}
+
+// XORs len bytes with 0xF7 into dst, eight at a time. dst may be src.
+static void xorbuf(uint8_t * dst, const uint8_t * src, size_t len)
 {
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t q;
+        memcpy(&q, src + i, sizeof(q));
+        q ^= 0xF7F7F7F7F7F7F7F7ull;
+        memcpy(dst + i, &q, sizeof(q));
+    }
+    for (; i < len; i++) {
+        dst[i] = src[i] ^ 0xF7;
+    }
+}
+
+static uint64_t fnv1a(uint64_t hash, const uint8_t * buf, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        hash ^= buf[i];
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+#define FNV1A_INIT  (0xCBF29CE484222325ull)
+
+// Calls func(arg, i) for i in 0..count-1 on as many threads as there are CPUs
+static void run_parallel(size_t count, void (*func)(void * arg, size_t i), void * arg)
+{
+    struct Job
+    {
+        void            (*func)(void * arg, size_t i);
+        void *          arg;
+        size_t          count;
+        size_t          next;
+        pthread_mutex_t lock;
+
+        static void * run(void * ptr)
+        {
+            Job * job = (Job *)ptr;
+            for (;;) {
+                pthread_mutex_lock(&job->lock);
+                size_t i = job->next++;
+                pthread_mutex_unlock(&job->lock);
+                if (i >= job->count) {
+                    break;
+                }
+                job->func(job->arg, i);
+            }
+            return NULL;
+        }
+    };
+
+    Job job;
+    job.func = func;
+    job.arg = arg;
+    job.count = count;
+    job.next = 0;
+    pthread_mutex_init(&job.lock, NULL);
+
+    long int nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (nthreads < 1) {
+        nthreads = 1;
+    }
+    if ((size_t)nthreads > count) {
+        nthreads = count;
+    }
+    vector<pthread_t> threads;
+    for (long int i = 1; i < nthreads; i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, Job::run, &job) == 0) {
+            threads.push_back(thread);
+        }
+    }
+    // This thread takes part too
+    Job::run(&job);
+    for (size_t i = 0; i < threads.size(); i++) {
+        pthread_join(threads[i], NULL);
+    }
+    pthread_mutex_destroy(&job.lock);
 }
 
 PopPak::PopPak(const char* name, const string& mode) :
         _name(name),
         _fp(0),
         _dataoffset(0),
-        _fileinfos()
+        _version(POPPAK_VERSION),
+        _fileinfos(),
+        _previous(0),
+        _wbuf(),
+        _entries(0),
+        _tohash(0),
+        _kept(0),
+        _error(0)
 {
     if (mode == "rb") {
         _mode = "r";
@@ -322,51 +471,59 @@ const uint8_t * PopPak::readcontent(const PopPakFileInfo * info, int & len)
     uint8_t *   buf = new uint8_t[len];
     int         nr;
     long int    pos;
-    fseek(_fp, info->Pos() + _dataoffset, SEEK_SET);
+    pos = info->Pos() + _dataoffset;
+    fseek(_fp, pos, SEEK_SET);
     nr = fread(buf, sizeof(buf[0]), len, _fp);
     if (nr != len) {
         throw (Exception *)new FileCorruptionException(_name.c_str(), pos);
     }
-    for (int i = 0; i < len; i++) {
-        buf[i] ^= 0xF7;
-    }
+    xorbuf(buf, buf, len);
     return buf;
 }
 
+// The write functions xor into _wbuf, which is written out when it's full
+// and by flush()
 void PopPak::writeb(uint8_t b)
 {
-    b = b ^ 0xF7;
-    fwrite(&b, sizeof(b), 1, _fp);
+    writebuf(&b, sizeof(b));
 }
 
 void PopPak::writel(uint32_t l)
 {
-    l = l ^ 0xF7F7F7F7;
-    fwrite(&l, sizeof(l), 1, _fp);
+    writebuf((const uint8_t *)&l, sizeof(l));
 }
 
 void PopPak::writeq(uint64_t q)
 {
-    q = q ^ 0xF7F7F7F7F7F7F7F7ull;
-    fwrite(&q, sizeof(q), 1, _fp);
+    writebuf((const uint8_t *)&q, sizeof(q));
 }
 
 void PopPak::writestr(const string & str)
 {
-    for (size_t i = 0; i < str.length(); i++) {
-        uint8_t b = str[i];
-        b = b ^ 0xF7;
-        fwrite(&b, sizeof(b), 1, _fp);
+    writebuf((const uint8_t *)str.data(), str.length());
+}
+
+void PopPak::writebuf(const uint8_t * buf, int len)
+{
+    while (len > 0) {
+        size_t used = _wbuf.size();
+        size_t n = min((size_t)len, COPY_BUFFER_SIZE - used);
+        _wbuf.resize(used + n);
+        xorbuf(&_wbuf[used], buf, n);
+        buf += n;
+        len -= n;
+        if (_wbuf.size() == COPY_BUFFER_SIZE) {
+            flush();
+        }
     }
 }
 
-void PopPak::writebuf(uint8_t * buf, int len)
+void PopPak::flush()
 {
-    for (int i = 0; i < len; i++) {
-        uint8_t b = buf[i];
-        b = b ^ 0xF7;
-        fwrite(&b, sizeof(b), 1, _fp);
+    if (!_wbuf.empty() && fwrite(&_wbuf[0], 1, _wbuf.size(), _fp) != _wbuf.size()) {
+        throw (Exception *)new ErrorWritingFileException(_name);
     }
+    _wbuf.clear();
 }
 
 // Convert filetime to unix time (seconds since 1970-jan-1)
@@ -388,6 +545,11 @@ time_t PopPak::filetime_to_unixtime(uint64_t time) const
     return (time_t)time;
 }
 
+uint64_t PopPak::unixtime_to_filetime(time_t time) const
+{
+    return ((uint64_t)time + 11644473600ull) * 10000000;
+}
+
 static string convert_slashes(string name)
 {
     for (size_t i = 0; i < name.length(); i++) {
@@ -407,10 +569,11 @@ void PopPak::readinfos()
         throw (Exception *)new BadMagicException(magic);
     }
     int32_t version = readl();
-    if (version != POPPAK_VERSION) {
+    if (version != 0 && version != POPPAK_VERSION) {
         close();
         throw (Exception *)new BadVersionException(version);
     }
+    _version = version;
     long int    pos = 0;
     while (1) {
         uint8_t  flags = readb();
@@ -427,7 +590,18 @@ void PopPak::readinfos()
         uint64_t filetime = readq();
         time_t time = filetime_to_unixtime(filetime);
 
-        PopPakFileInfo *    info = new PopPakFileInfo(time, name, size, pos, filetime);
+        uint64_t hash = 0;
+        if (version >= 1) {
+            hash = readq();
+        }
+
+        if (flags & FILEFLAGS_SHARED) {
+            long int sharedpos = readl();
+            _fileinfos.push_back(new PopPakFileInfo(time, name, size, sharedpos, filetime, hash));
+            continue;
+        }
+
+        PopPakFileInfo *    info = new PopPakFileInfo(time, name, size, pos, filetime, hash);
         _fileinfos.push_back(info);
 
         pos += size;
@@ -435,6 +609,142 @@ void PopPak::readinfos()
     cout << "nr of files: " << _fileinfos.size() << endl;
 }
 
+// Reuse the unchanged entries of previous, the pak being updated. An entry
+// is unchanged when its name, size and modification time are. It's copied
+// from previous without reading the file.
+void PopPak::set_previous(PopPak * previous)
+{
+    _previous = previous;
+}
+
+// Whether previous has exactly the entries to be written, in which case
+// there's nothing to do
+bool PopPak::up_to_date(const vector<PopPakBuildEntry> & entries) const
+{
+    if (!_previous || _previous->_fileinfos.size() != entries.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (entries[i].old != _previous->_fileinfos[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Opens whatever the contents of entry are read from, at their start
+FILE * PopPak::open_contents(const PopPakBuildEntry & entry) const
+{
+    if (entry.old) {
+        FILE * fp = fopen(_previous->_name.c_str(), "rb");
+        if (!fp || fseek(fp, _previous->_dataoffset + entry.old->Pos(), SEEK_SET) != 0) {
+            throw (Exception *)new ErrorReadingFileException(_previous->_name);
+        }
+        return fp;
+    }
+
+    FILE * fp = fopen(entry.info->Name().c_str(), "rb");
+    if (!fp) {
+        throw (Exception *)new FileNotFoundException(entry.info->Name());
+    }
+    return fp;
+}
+
+// Reads the next len bytes of the contents of entry, not xor'ed
+size_t PopPak::read_contents(const PopPakBuildEntry & entry, FILE * fp, uint8_t * buf, size_t len) const
+{
+    size_t nr = fread(buf, 1, len, fp);
+    if (nr != len) {
+        throw (Exception *)new ErrorReadingFileException(entry.old ? _previous->_name : entry.info->Name());
+    }
+    if (entry.old) {
+        xorbuf(buf, buf, nr);
+    }
+    return nr;
+}
+
+// Hashes are only trusted this far, entries with the same hash and size
+// are compared before they share their contents
+bool PopPak::same_contents(const PopPakBuildEntry & a, const PopPakBuildEntry & b) const
+{
+    if (a.contents && b.contents) {
+        return memcmp(a.contents, b.contents, a.info->Size()) == 0;
+    }
+
+    vector<uint8_t> bufa(COPY_BUFFER_SIZE);
+    vector<uint8_t> bufb(COPY_BUFFER_SIZE);
+    FILE * fpa = a.contents ? 0 : open_contents(a);
+    FILE * fpb = b.contents ? 0 : open_contents(b);
+    bool same = true;
+    for (long int done = 0; same && done < a.info->Size(); done += COPY_BUFFER_SIZE) {
+        size_t len = min((long int)COPY_BUFFER_SIZE, a.info->Size() - done);
+        const uint8_t * pa = a.contents ? a.contents + done : &bufa[0];
+        const uint8_t * pb = b.contents ? b.contents + done : &bufb[0];
+        if (fpa) {
+            read_contents(a, fpa, &bufa[0], len);
+        }
+        if (fpb) {
+            read_contents(b, fpb, &bufb[0], len);
+        }
+        same = memcmp(pa, pb, len) == 0;
+    }
+    if (fpa) {
+        fclose(fpa);
+    }
+    if (fpb) {
+        fclose(fpb);
+    }
+    return same;
+}
+
+// Runs on the hashing threads. Small files are kept in memory, so they
+// needn't be read again to be written.
+void PopPak::hash_entry(PopPakBuildEntry & entry)
+{
+    long int size = entry.info->Size();
+    bool keep = false;
+    if (size <= KEEP_MAX_SIZE) {
+        pthread_mutex_lock(&_lock);
+        if (_kept + size <= KEEP_BUDGET) {
+            _kept += size;
+            keep = true;
+        }
+        pthread_mutex_unlock(&_lock);
+    }
+
+    FILE * fp = open_contents(entry);
+    vector<uint8_t> buf;
+    if (keep) {
+        entry.contents = new uint8_t[size];
+    } else {
+        buf.resize(COPY_BUFFER_SIZE);
+    }
+    uint64_t hash = FNV1A_INIT;
+    for (long int done = 0; done < size; done += COPY_BUFFER_SIZE) {
+        size_t len = min((long int)COPY_BUFFER_SIZE, size - done);
+        uint8_t * p = keep ? entry.contents + done : &buf[0];
+        read_contents(entry, fp, p, len);
+        hash = fnv1a(hash, p, len);
+    }
+    fclose(fp);
+    entry.hash = hash;
+}
+
+void PopPak::hash_entry_proc(void * arg, size_t i)
+{
+    PopPak * pak = (PopPak *)arg;
+    try {
+        pak->hash_entry((*pak->_entries)[(*pak->_tohash)[i]]);
+    }
+    catch (Exception * e) {
+        pthread_mutex_lock(&pak->_lock);
+        if (!pak->_error) {
+            pak->_error = e;
+        }
+        pthread_mutex_unlock(&pak->_lock);
+    }
+}
+
 void PopPak::finish()
 {
     if (_fp) {
@@ -442,19 +752,103 @@ void PopPak::finish()
         fclose(_fp);
     }
 
+    // Entries of the previous pak that can be reused. They need a hash,
+    // which version 0 paks don't have.
+    map<string, const PopPakFileInfo *> previous;
+    if (_previous && _previous->_version >= 1) {
+        for (size_t i = 0; i < _previous->_fileinfos.size(); i++) {
+            previous[_previous->_fileinfos[i]->Name()] = _previous->_fileinfos[i];
+        }
+    }
+
+    vector<PopPakBuildEntry> entries(_fileinfos.size());
+    vector<size_t> tohash;
+    for (size_t i = 0; i < _fileinfos.size(); i++) {
+        PopPakBuildEntry & entry = entries[i];
+        entry.info = _fileinfos[i];
+        entry.old = 0;
+        entry.hash = 0;
+        entry.same = 0;
+        entry.pos = 0;
+        entry.contents = 0;
+
+        map<string, const PopPakFileInfo *>::const_iterator it = previous.find(convert_slashes(entry.info->Name()));
+        if (it != previous.end()
+                && it->second->Size() == entry.info->Size()
+                && it->second->Filetime() == entry.info->Filetime()) {
+            entry.old = it->second;
+            entry.hash = entry.old->Hash();
+        } else {
+            tohash.push_back(i);
+        }
+    }
+
+    if (up_to_date(entries)) {
+        cout << "Pak is up to date: " << _name.c_str() << endl;
+        _fp = 0;
+        return;
+    }
+
+    // Read and hash the new and changed files, on all CPUs
+    pthread_mutex_init(&_lock, NULL);
+    _entries = &entries;
+    _tohash = &tohash;
+    _kept = 0;
+    _error = 0;
+    run_parallel(tohash.size(), hash_entry_proc, this);
+    _entries = 0;
+    _tohash = 0;
+    pthread_mutex_destroy(&_lock);
+    if (_error) {
+        for (size_t i = 0; i < entries.size(); i++) {
+            delete [] entries[i].contents;
+        }
+        throw _error;
+    }
+
+    // Identical contents are stored once
+    map<pair<uint64_t, long int>, vector<const PopPakBuildEntry *> > unique;
+    long int pos = 0;
+    size_t nshared = 0;
+    for (size_t i = 0; i < entries.size(); i++) {
+        PopPakBuildEntry & entry = entries[i];
+        vector<const PopPakBuildEntry *> & candidates = unique[make_pair(entry.hash, entry.info->Size())];
+        for (size_t j = 0; j < candidates.size() && !entry.same; j++) {
+            if (same_contents(*candidates[j], entry)) {
+                entry.same = candidates[j];
+            }
+        }
+        if (entry.same) {
+            entry.pos = entry.same->pos;
+            nshared++;
+            continue;
+        }
+        candidates.push_back(&entry);
+        entry.pos = pos;
+        pos += entry.info->Size();
+    }
+
+    // Written next to the pak and renamed when done, as the previous pak
+    // may be this one
+    const string tmpname = _name + ".tmp";
     cout << "Creating new pak: " << _name.c_str() << endl;
-    _fp = fopen(_name.c_str(), "wb");
+    _fp = fopen(tmpname.c_str(), "wb");
+    if (!_fp) {
+        throw (Exception *)new ErrorWritingFileException(tmpname);
+    }
+    _wbuf.reserve(COPY_BUFFER_SIZE);
 
     writel(POPPAK_MAGIC);
     writel(POPPAK_VERSION);
 
     // Write the contents of all files to the pak.
     // Do the xor thing.
-    for (size_t i = 0; i < _fileinfos.size(); i++) {
-        PopPakFileInfo *    info = _fileinfos[i];
+    for (size_t i = 0; i < entries.size(); i++) {
+        const PopPakBuildEntry & entry = entries[i];
+        PopPakFileInfo *    info = entry.info;
 
         // Flags
-        writeb(0);
+        writeb(entry.same ? FILEFLAGS_SHARED : 0);
 
         if (info->Name().length() > 255) {
             throw (Exception *)new FilenameTooLongException(info->Name());
@@ -465,31 +859,53 @@ void PopPak::finish()
         writel(info->Size());
 
         writeq(info->Filetime());
+
+        writeq(entry.hash);
+
+        if (entry.same) {
+            writel(entry.pos);
+        }
     }
     // Terminate file info header
     writeb(FILEFLAGS_END);
 
     // Write all files too
-    for (size_t i = 0; i < _fileinfos.size(); i++) {
-        PopPakFileInfo *    info = _fileinfos[i];
-
-        FILE * fp = fopen(info->Name().c_str(), "rb");
-        if (!fp) {
-            throw (Exception *)new Exception();
+    vector<uint8_t> buffer(COPY_BUFFER_SIZE);
+    for (size_t i = 0; i < entries.size(); i++) {
+        PopPakBuildEntry & entry = entries[i];
+        if (entry.same) {
+            delete [] entry.contents;
+            entry.contents = 0;
             continue;
         }
-        uint8_t *   buffer  = new uint8_t[info->Size()];
-        long int fsize = (int)fread(buffer, sizeof(buffer[0]), info->Size(), fp);
-        if (fsize != info->Size()) {
-            throw (Exception *)new ErrorReadingFileException(info->Name());
+        if (entry.contents) {
+            writebuf(entry.contents, entry.info->Size());
+            delete [] entry.contents;
+            entry.contents = 0;
+            continue;
+        }
+
+        FILE * fp = open_contents(entry);
+        for (long int done = 0; done < entry.info->Size(); done += COPY_BUFFER_SIZE) {
+            size_t len = min((long int)COPY_BUFFER_SIZE, entry.info->Size() - done);
+            read_contents(entry, fp, &buffer[0], len);
+            writebuf(&buffer[0], len);
         }
-        writebuf(buffer, info->Size());
-        delete [] buffer;
         fclose(fp);
     }
+    flush();
 
-    fclose(_fp);
+    if (fclose(_fp) != 0) {
+        _fp = 0;
+        throw (Exception *)new ErrorWritingFileException(tmpname);
+    }
     _fp = 0;
+    if (rename(tmpname.c_str(), _name.c_str()) != 0) {
+        throw (Exception *)new ErrorWritingFileException(_name);
+    }
+
+    cout << "files: " << entries.size() << ", reused: " << (entries.size() - tohash.size())
+         << ", shared: " << nshared << endl;
 }
 
 static const string dirname(const string & fname)
@@ -593,7 +1009,7 @@ void PopPak::add_to_pak(const string & name)
         long int size = s.st_size;
         time_t time = s.st_mtime;
 
-        PopPakFileInfo *    info = new PopPakFileInfo(time, name, size, -1, 0);
+        PopPakFileInfo *    info = new PopPakFileInfo(time, name, size, -1, unixtime_to_filetime(time));
         _fileinfos.push_back(info);
     }
 }
@@ -604,7 +1020,8 @@ void usage()
 Usage:\n\
     tuxpak -l zipfile.pak         # Show listing of a pak\n\
     tuxpak -e zipfile.pak target  # Extract pak into target dir\n\
-    tuxpak -c zipfile.pak src ... # Create pak from sources\
+    tuxpak -c zipfile.pak src ... # Create pak from sources\n\
+    tuxpak -u zipfile.pak src ... # Update pak from sources, reusing unchanged files\
 ";
     cout << txt << endl;
 }
@@ -619,14 +1036,24 @@ int main(int argc, char** argv)
             PopPak * zf = new PopPak(argv[2], "r");
             zf->printdir();
             zf->close();
-        } else if (argc >= 4 && string(argv[1]) == "-c") {
+        } else if (argc >= 4 && (string(argv[1]) == "-c" || string(argv[1]) == "-u")) {
             // Create new pak
             PopPak * zf = new PopPak(argv[2], "w");
             for (int i = 3; i < argc; i++) {
                 zf->add_to_pak(argv[i]);
             }
+            // Update the existing one, if there is one
+            PopPak * previous = 0;
+            struct stat s;
+            if (string(argv[1]) == "-u" && stat(argv[2], &s) == 0) {
+                previous = new PopPak(argv[2], "r");
+                zf->set_previous(previous);
+            }
             zf->finish();
             zf->close();
+            if (previous) {
+                previous->close();
+            }
         } else if (argc == 4 && string(argv[1]) == "-e") {
             // Extract pak
             PopPak * zf = new PopPak(argv[2], "r");
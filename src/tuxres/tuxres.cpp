@@ -0,0 +1,138 @@
+/*
+ * File:   tuxres.cpp
+ *
+ * Compiles a resources.xml into the binary form that
+ * ResourceManager::ParseResourcesFile() loads instead of parsing the XML.
+ * By default it is written next to the XML as resources.xml.bin, which is
+ * where ResourceManager looks for it. It is used until the XML changes.
+ *
+ * The image font descriptors of the manifest are compiled as well, each to
+ * a .bin next to it that FontData::Load() picks up the same way. With -f it
+ * compiles a single font descriptor instead of a manifest.
+ *
+ * With -i it also decodes every image of the manifest into an image cache
+ * folder, see ImageLib::gPrebuiltImageCacheFolder. Pack that folder into
+ * main.pak as imagecache/ and the images are not decoded at load time.
+ */
+
+#include <iostream>
+#include <string>
+
+#include "ResourceManager.h"
+#include "ImageFont.h"
+#include "ImageLib.h"
+
+using namespace std;
+
+class ResourceCompiler : public Sexy::ResourceManager
+{
+public:
+    ResourceCompiler() : ResourceManager(NULL) {}
+
+    int CacheImages(const string& theFolder)
+    {
+        int aCount = 0;
+        for (ResMap::iterator anItr = mImageMap.begin(); anItr != mImageMap.end(); ++anItr) {
+            ImageRes* aRes = (ImageRes*) anItr->second;
+            if (aRes->mFromProgram)
+                continue;
+
+            // Same as DoLoadImage(), with the default SexyAppBase::mLookForAlpha
+            bool lookForAlpha = aRes->mAlphaImage.empty() && aRes->mAlphaGridImage.empty() && !(aRes->mNoAlphaSet && aRes->mNoAlpha);
+            if (!ImageLib::PrebuildCachedImage(aRes->mPath, lookForAlpha, theFolder)) {
+                cerr << "Failed to load image: " << aRes->mPath << endl;
+                continue;
+            }
+            aCount++;
+        }
+        return aCount;
+    }
+
+    int CompileFonts()
+    {
+        int aCount = 0;
+        for (ResMap::iterator anItr = mFontMap.begin(); anItr != mFontMap.end(); ++anItr) {
+            FontRes* aRes = (FontRes*) anItr->second;
+            if (aRes->mFromProgram || aRes->mSysFont || !aRes->mImagePath.empty() || aRes->mPath.compare(0, 5, "!ref:") == 0)
+                continue;
+
+            if (!CompileFont(aRes->mPath, Sexy::FontData::GetCompiledFileName(aRes->mPath)))
+                continue;
+            aCount++;
+        }
+        return aCount;
+    }
+
+    static bool CompileFont(const string& theSource, const string& theOutput)
+    {
+        Sexy::FontData* aFontData = new Sexy::FontData();
+        bool aSuccess = aFontData->Compile(theSource, theOutput);
+        if (!aSuccess)
+            cerr << "Failed to compile font: " << theSource << ": "
+                 << (aFontData->mError.empty() ? "can't read or write it" : aFontData->mError) << endl;
+        delete aFontData;
+        return aSuccess;
+    }
+};
+
+static void usage(const char * prog)
+{
+    cerr << "Usage: " << prog << " [-i <imagecache>] <resources.xml> [<output>]" << endl;
+    cerr << "       " << prog << " -f <font.txt> [<output>]" << endl;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 2 && string(argv[1]) == "-f") {
+        if (argc > 4) {
+            usage(argv[0]);
+            return 1;
+        }
+
+        string source = argv[2];
+        string output = argc > 3 ? argv[3] : Sexy::FontData::GetCompiledFileName(source);
+        if (!ResourceCompiler::CompileFont(source, output))
+            return 1;
+
+        cout << "Wrote " << output << endl;
+        return 0;
+    }
+
+    string imageCache;
+    int arg = 1;
+    if (argc > 2 && string(argv[1]) == "-i") {
+        imageCache = argv[2];
+        if (!imageCache.empty() && imageCache[imageCache.length() - 1] != '/')
+            imageCache += '/';
+        arg = 3;
+    }
+
+    if (argc - arg < 1 || argc - arg > 2) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    string source = argv[arg];
+    string output = argc - arg > 1 ? argv[arg + 1] : Sexy::ResourceManager::GetCompiledResourcesFileName(source);
+
+    ResourceCompiler manager;
+    if (!manager.CompileResourcesFile(source, output)) {
+        cerr << manager.GetErrorText() << endl;
+        return 1;
+    }
+
+    cout << "Wrote " << output << " ("
+         << manager.GetNumImages("") << " images, "
+         << manager.GetNumSounds("") << " sounds, "
+         << manager.GetNumFonts("") << " fonts)" << endl;
+
+    int fonts = manager.CompileFonts();
+    if (fonts > 0)
+        cout << "Compiled " << fonts << " font descriptors" << endl;
+
+    if (!imageCache.empty()) {
+        int count = manager.CacheImages(imageCache);
+        cout << "Cached " << count << " images in " << imageCache << endl;
+    }
+    return 0;
+}